@@ -0,0 +1,836 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rtl_bench/harness.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+
+#include "rtl/pounds.h"
+#include "rtl_bench/stats.hpp"
+
+namespace rtl_bench {
+
+// -------------------------------------------
+// histogram
+
+static heap_allocator g_heap;
+
+static const double kPicosPerNano = 1000.0;
+
+bool init_histogram(histogram* h) { return h->init(kHighestTrackablePs); }
+
+// -------------------------------------------
+// state
+
+state::state(int64_t arg, uint64_t batch_size, uint64_t target_samples,
+             perf_counters* perf)
+    : m_arg(arg),
+      m_batch_size(batch_size == 0U ? 1U : batch_size),
+      m_target_samples(target_samples),
+      m_samples(0U),
+      m_ops(0U),
+      m_skipped(false),
+      m_hist(&g_heap),
+      m_start(0U),
+      m_perf(perf),
+      m_timed_ops(0U) {
+  if (!init_histogram(&m_hist)) {
+    skip("could not allocate the histogram");
+  }
+}
+
+void state::record(double total_ns, uint64_t ops) {
+  if (ops == 0U) {
+    ops = 1U;
+  }
+  double ps = total_ns * kPicosPerNano / static_cast<double>(ops);
+  m_hist.record(ps <= 0.0 ? 0U : static_cast<uint64_t>(ps + 0.5));
+  m_samples++;
+  m_ops += ops;
+}
+
+void state::set_counter(const char* name, double value) {
+  for (auto& c : m_counters) {
+    if (c.first == name) {
+      c.second = value;
+      return;
+    }
+  }
+  m_counters.emplace_back(name, value);
+}
+
+void state::skip(const char* reason) {
+  m_skipped = true;
+  m_skip_reason = reason;
+}
+
+// -------------------------------------------
+// Registry and options
+
+namespace {
+
+struct benchmark_entry {
+  std::string m_name;
+  benchmark_fn m_fn;
+  int64_t m_arg;
+  uint64_t m_batch_size;
+};
+
+struct summary {
+  uint64_t m_samples;
+  uint64_t m_ops;
+  double m_mean_ns;
+  double m_min_ns;
+  double m_p50_ns;
+  double m_p90_ns;
+  double m_p99_ns;
+  double m_p999_ns;
+  double m_max_ns;
+  std::vector<std::pair<std::string, double>> m_counters;
+};
+
+struct result {
+  std::string m_name;
+  int64_t m_arg;
+  bool m_skipped;
+  std::string m_skip_reason;
+  std::vector<summary> m_reps;
+  summary m_aggregate;
+  // Standard deviation of the per repetition means
+  double m_rep_stddev_ns;
+};
+
+struct options {
+  std::string m_filter;
+  uint64_t m_repetitions = 5U;
+  uint64_t m_warmup = 1U;
+  uint64_t m_samples = 1000U;
+  uint64_t m_batch = 0U;
+  int m_cpu = -1;
+  std::string m_format = "console";
+  std::string m_out;
+  bool m_perf = false;
+  std::string m_baseline;
+  std::string m_save_baseline;
+  double m_alpha = 0.05;
+  double m_threshold_pct = 5.0;
+  std::vector<std::pair<std::string, std::string>> m_extra;
+};
+
+// Function local statics so registration from other translation units'
+// static initializers doesn't depend on initialization order
+std::vector<benchmark_entry>& registry() {
+  static std::vector<benchmark_entry> r;
+  return r;
+}
+
+options& opts() {
+  static options o;
+  return o;
+}
+
+// Opened by run() when --perf is given
+perf_counters& perf() {
+  static perf_counters p;
+  return p;
+}
+
+const char* find_extra(const char* name) {
+  for (auto const& kv : opts().m_extra) {
+    if (kv.first == name) {
+      return kv.second.c_str();
+    }
+  }
+  return nullptr;
+}
+
+bool parse_uint(const char* s, uint64_t* out) {
+  char* end = nullptr;
+  if (*s == '\0' || *s == '-') {
+    return false;
+  }
+  unsigned long long v = std::strtoull(s, &end, 10);
+  if (*end != '\0') {
+    return false;
+  }
+  *out = v;
+  return true;
+}
+
+bool parse_double(const char* s, double* out) {
+  char* end = nullptr;
+  double v = std::strtod(s, &end);
+  if (*s == '\0' || *end != '\0' || v < 0.0) {
+    return false;
+  }
+  *out = v;
+  return true;
+}
+
+void print_usage(const char* prog) {
+  std::cerr
+      << "Usage: " << prog << " [options]\n"
+      << "  --filter=<substr>      only run benchmarks containing substr\n"
+      << "  --repetitions=<n>      measured repetitions (default 5)\n"
+      << "  --warmup=<n>           discarded repetitions (default 1)\n"
+      << "  --samples=<n>          samples per repetition (default 1000)\n"
+      << "  --batch=<n>            override the batch size of every "
+         "benchmark\n"
+      << "  --cpu=<n>              pin the benchmark thread to a cpu\n"
+      << "  --format=<fmt>         console, csv or json (default console)\n"
+      << "  --out=<path>           write the report to a file\n"
+      << "  --perf                 report hardware counters per operation\n"
+      << "  --save-baseline=<path> also write the results to a baseline "
+         "file\n"
+      << "  --baseline=<path>      compare against a baseline file and fail "
+         "on\n"
+      << "                         significant slowdowns\n"
+      << "  --alpha=<p>            significance level (default 0.05)\n"
+      << "  --threshold=<pct>      smallest slowdown reported (default 5)\n"
+      << "  --list                 list the benchmarks and exit\n"
+      << "  --<name>=<value>       benchmark specific options\n";
+}
+
+double to_ns(uint64_t ps) { return static_cast<double>(ps) / kPicosPerNano; }
+
+summary summarize(histogram const& h, uint64_t ops,
+                  std::vector<std::pair<std::string, double>> counters) {
+  summary s;
+  s.m_samples = h.count();
+  s.m_ops = ops;
+  s.m_mean_ns = h.mean() / kPicosPerNano;
+  s.m_min_ns = to_ns(h.min());
+  s.m_p50_ns = to_ns(h.value_at_percentile(50.0));
+  s.m_p90_ns = to_ns(h.value_at_percentile(90.0));
+  s.m_p99_ns = to_ns(h.value_at_percentile(99.0));
+  s.m_p999_ns = to_ns(h.value_at_percentile(99.9));
+  s.m_max_ns = to_ns(h.max());
+  s.m_counters = std::move(counters);
+  return s;
+}
+
+// Adds the hardware counters per timed operation to the state's counters
+void add_perf_counters(state& st) {
+  uint64_t values[perf_counters::kNumCounters];
+  if (st.timed_ops() == 0U || !perf().read(values)) {
+    return;
+  }
+  for (size_t i = 0U; i < perf_counters::kNumCounters; i++) {
+    perf_counters::counter c = static_cast<perf_counters::counter>(i);
+    if (perf().available(c)) {
+      std::string name = std::string(perf_counters::name(c)) + "/op";
+      st.set_counter(name.c_str(), static_cast<double>(values[i]) /
+                                       static_cast<double>(st.timed_ops()));
+    }
+  }
+}
+
+result run_one(benchmark_entry const& e) {
+  options const& o = opts();
+  uint64_t batch = o.m_batch != 0U ? o.m_batch : e.m_batch_size;
+  perf_counters* pc = perf().is_open() ? &perf() : nullptr;
+
+  result r;
+  r.m_name = e.m_name;
+  r.m_arg = e.m_arg;
+  r.m_skipped = false;
+  r.m_rep_stddev_ns = 0.0;
+
+  for (uint64_t i = 0U; i < o.m_warmup; i++) {
+    state st(e.m_arg, batch, o.m_samples, pc);
+    e.m_fn(st);
+    if (st.skipped()) {
+      r.m_skipped = true;
+      r.m_skip_reason = st.skip_reason();
+      return r;
+    }
+  }
+
+  histogram merged(&g_heap);
+  if (!init_histogram(&merged)) {
+    r.m_skipped = true;
+    r.m_skip_reason = "could not allocate the histogram";
+    return r;
+  }
+  uint64_t total_ops = 0U;
+  std::vector<std::pair<std::string, double>> counter_sums;
+
+  for (uint64_t i = 0U; i < o.m_repetitions; i++) {
+    state st(e.m_arg, batch, o.m_samples, pc);
+    if (pc != nullptr) pc->reset();
+    e.m_fn(st);
+    if (st.skipped()) {
+      r.m_skipped = true;
+      r.m_skip_reason = st.skip_reason();
+      return r;
+    }
+    if (pc != nullptr) add_perf_counters(st);
+
+    r.m_reps.push_back(summarize(st.hist(), st.ops(), st.counters()));
+    merged.merge(st.hist());
+    total_ops += st.ops();
+
+    for (auto const& c : st.counters()) {
+      auto it = std::find_if(
+          counter_sums.begin(), counter_sums.end(),
+          [&](std::pair<std::string, double> const& kv) {
+            return kv.first == c.first;
+          });
+      if (it == counter_sums.end()) {
+        counter_sums.push_back(c);
+      } else {
+        it->second += c.second;
+      }
+    }
+  }
+
+  // Counters are averaged over the repetitions
+  for (auto& c : counter_sums) {
+    c.second /= static_cast<double>(std::max<uint64_t>(1U, o.m_repetitions));
+  }
+  r.m_aggregate = summarize(merged, total_ops, std::move(counter_sums));
+
+  if (r.m_reps.size() > 1U) {
+    double m = 0.0;
+    for (auto const& s : r.m_reps) m += s.m_mean_ns;
+    m /= static_cast<double>(r.m_reps.size());
+    double var = 0.0;
+    for (auto const& s : r.m_reps) {
+      var += (s.m_mean_ns - m) * (s.m_mean_ns - m);
+    }
+    r.m_rep_stddev_ns =
+        std::sqrt(var / static_cast<double>(r.m_reps.size() - 1U));
+  }
+
+  return r;
+}
+
+// -------------------------------------------
+// Reporting
+
+const char* build_type() {
+#ifdef NDEBUG
+  return "release";
+#else
+  return "debug";
+#endif
+}
+
+std::string host_name() {
+  char buf[256];
+  if (gethostname(buf, sizeof(buf)) != 0) {
+    return "unknown";
+  }
+  buf[sizeof(buf) - 1U] = '\0';
+  return buf;
+}
+
+std::string date_string() {
+  std::time_t now = std::time(nullptr);
+  std::tm tm_utc;
+  char buf[64];
+  if (gmtime_r(&now, &tm_utc) == nullptr ||
+      std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", &tm_utc) == 0U) {
+    return "unknown";
+  }
+  return buf;
+}
+
+std::string json_escape(std::string const& s) {
+  std::string out;
+  for (char c : s) {
+    switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20U) {
+          char tmp[8];
+          std::snprintf(tmp, sizeof(tmp), "\\u%04x", c);
+          out += tmp;
+        } else {
+          out += c;
+        }
+    }
+  }
+  return out;
+}
+
+void write_json_summary(std::ostream& os, summary const& s,
+                        const char* indent) {
+  os << indent << "\"samples\": " << s.m_samples << ",\n"
+     << indent << "\"ops\": " << s.m_ops << ",\n"
+     << indent << "\"mean_ns\": " << s.m_mean_ns << ",\n"
+     << indent << "\"min_ns\": " << s.m_min_ns << ",\n"
+     << indent << "\"p50_ns\": " << s.m_p50_ns << ",\n"
+     << indent << "\"p90_ns\": " << s.m_p90_ns << ",\n"
+     << indent << "\"p99_ns\": " << s.m_p99_ns << ",\n"
+     << indent << "\"p999_ns\": " << s.m_p999_ns << ",\n"
+     << indent << "\"max_ns\": " << s.m_max_ns << ",\n"
+     << indent << "\"counters\": {";
+  for (size_t i = 0U; i < s.m_counters.size(); i++) {
+    os << (i == 0U ? "" : ", ") << "\""
+       << json_escape(s.m_counters[i].first)
+       << "\": " << s.m_counters[i].second;
+  }
+  os << "}";
+}
+
+void write_json(std::ostream& os, std::vector<result> const& results) {
+  options const& o = opts();
+  os << "{\n"
+     << "  \"context\": {\n"
+     << "    \"date\": \"" << date_string() << "\",\n"
+     << "    \"host\": \"" << json_escape(host_name()) << "\",\n"
+     << "    \"num_cpus\": " << num_cpus() << ",\n"
+     << "    \"pinned_cpu\": " << o.m_cpu << ",\n"
+     << "    \"build\": \"" << build_type() << "\",\n"
+     << "    \"rtl_version\": \"" << RTL_BENCH_RTL_VERSION << "\",\n"
+     << "    \"word_size_bits\": " << RTL_TARGET_WORD_SIZE_BITS << ",\n"
+     << "    \"cycle_clock_hz\": "
+     << static_cast<uint64_t>(rtl::cycle_clock::frequency()) << ",\n"
+     << "    \"repetitions\": " << o.m_repetitions << ",\n"
+     << "    \"warmup\": " << o.m_warmup << ",\n"
+     << "    \"samples\": " << o.m_samples << ",\n"
+     << "    \"perf_counters\": {";
+  for (size_t i = 0U; i < perf_counters::kNumCounters; i++) {
+    perf_counters::counter c = static_cast<perf_counters::counter>(i);
+    os << (i == 0U ? "" : ", ") << "\"" << perf_counters::name(c) << "\": \""
+       << (!o.m_perf ? "disabled"
+                     : (perf().available(c) ? "available" : "unavailable"))
+       << "\"";
+  }
+  os << "}\n"
+     << "  },\n"
+     << "  \"benchmarks\": [";
+
+  for (size_t i = 0U; i < results.size(); i++) {
+    result const& r = results[i];
+    os << (i == 0U ? "\n" : ",\n") << "    {\n"
+       << "      \"name\": \"" << json_escape(r.m_name) << "\",\n"
+       << "      \"arg\": " << r.m_arg << ",\n";
+    if (r.m_skipped) {
+      os << "      \"skipped\": \"" << json_escape(r.m_skip_reason)
+         << "\"\n    }";
+      continue;
+    }
+
+    os << "      \"repetitions\": [";
+    for (size_t j = 0U; j < r.m_reps.size(); j++) {
+      os << (j == 0U ? "\n" : ",\n") << "        {\n";
+      write_json_summary(os, r.m_reps[j], "          ");
+      os << "\n        }";
+    }
+    os << "\n      ],\n"
+       << "      \"aggregate\": {\n"
+       << "        \"rep_stddev_ns\": " << r.m_rep_stddev_ns << ",\n";
+    write_json_summary(os, r.m_aggregate, "        ");
+    os << "\n      }\n    }";
+  }
+  os << "\n  ]\n}\n";
+}
+
+void write_csv_row(std::ostream& os, result const& r, const char* rep,
+                   summary const& s) {
+  os << r.m_name << "," << rep << "," << s.m_samples << "," << s.m_ops << ","
+     << s.m_mean_ns << "," << s.m_min_ns << "," << s.m_p50_ns << ","
+     << s.m_p90_ns << "," << s.m_p99_ns << "," << s.m_p999_ns << ","
+     << s.m_max_ns << ",";
+  for (size_t i = 0U; i < s.m_counters.size(); i++) {
+    os << (i == 0U ? "" : ";") << s.m_counters[i].first << "="
+       << s.m_counters[i].second;
+  }
+  os << "\n";
+}
+
+void write_csv(std::ostream& os, std::vector<result> const& results) {
+  os << "Name,Repetition,Samples,Ops,MeanNs,MinNs,P50Ns,P90Ns,P99Ns,P999Ns,"
+        "MaxNs,Counters\n";
+  for (result const& r : results) {
+    if (r.m_skipped) {
+      continue;
+    }
+    for (size_t j = 0U; j < r.m_reps.size(); j++) {
+      write_csv_row(os, r, std::to_string(j).c_str(), r.m_reps[j]);
+    }
+    write_csv_row(os, r, "aggregate", r.m_aggregate);
+  }
+}
+
+void write_console(std::ostream& os, std::vector<result> const& results) {
+  os << std::left << std::setw(40) << "Benchmark" << std::right
+     << std::setw(12) << "Mean" << std::setw(12) << "P50" << std::setw(12)
+     << "P99" << std::setw(12) << "P99.9" << std::setw(12) << "Max"
+     << std::setw(12) << "StdDev" << "\n";
+  os << std::string(112, '-') << "\n";
+
+  os << std::fixed << std::setprecision(2);
+  for (result const& r : results) {
+    os << std::left << std::setw(40) << r.m_name << std::right;
+    if (r.m_skipped) {
+      os << "  skipped: " << r.m_skip_reason << "\n";
+      continue;
+    }
+    summary const& s = r.m_aggregate;
+    os << std::setw(12) << s.m_mean_ns << std::setw(12) << s.m_p50_ns
+       << std::setw(12) << s.m_p99_ns << std::setw(12) << s.m_p999_ns
+       << std::setw(12) << s.m_max_ns << std::setw(12) << r.m_rep_stddev_ns;
+    for (auto const& c : s.m_counters) {
+      os << "  " << c.first << "=" << c.second;
+    }
+    os << "\n";
+  }
+  os << "(times are in ns per operation)\n";
+}
+
+// -------------------------------------------
+// Baselines
+//
+// A baseline is the csv report of an earlier run.  Every compared metric is
+// tested over the repetitions with a one sided Mann-Whitney U test, a
+// slowdown is reported when it is both significant and larger than the
+// threshold.  The max is left out, it is too noisy to compare.
+
+struct metric {
+  const char* m_name;
+  double summary::*m_field;
+  // Column in the csv report
+  size_t m_column;
+};
+
+const metric kMetrics[] = {
+    {"mean", &summary::m_mean_ns, 4U}, {"p50", &summary::m_p50_ns, 6U},
+    {"p90", &summary::m_p90_ns, 7U},   {"p99", &summary::m_p99_ns, 8U},
+    {"p99.9", &summary::m_p999_ns, 9U},
+};
+
+using baseline = std::map<std::string, std::vector<summary>>;
+
+bool read_baseline(std::string const& path, baseline* out) {
+  std::ifstream in(path.c_str());
+  if (!in) {
+    return false;
+  }
+
+  std::string line;
+  // Header
+  if (!std::getline(in, line)) {
+    return false;
+  }
+  while (std::getline(in, line)) {
+    std::vector<std::string> fields;
+    std::stringstream ss(line);
+    std::string f;
+    while (std::getline(ss, f, ',')) fields.push_back(f);
+    if (fields.size() < 11U || fields[1] == "aggregate") {
+      continue;
+    }
+
+    summary s = summary();
+    for (metric const& m : kMetrics) {
+      s.*m.m_field = std::strtod(fields[m.m_column].c_str(), nullptr);
+    }
+    (*out)[fields[0]].push_back(s);
+  }
+  return true;
+}
+
+// Prints the slowdowns to stderr and returns how many there were
+size_t compare_baseline(baseline const& base,
+                        std::vector<result> const& results) {
+  options const& o = opts();
+  size_t compared = 0U;
+  size_t regressions = 0U;
+
+  std::cerr << std::fixed << std::setprecision(2);
+  for (result const& r : results) {
+    auto it = base.find(r.m_name);
+    if (r.m_skipped || it == base.end()) {
+      if (!r.m_skipped) {
+        std::cerr << "Not in the baseline: " << r.m_name << std::endl;
+      }
+      continue;
+    }
+    compared++;
+
+    for (metric const& m : kMetrics) {
+      std::vector<double> before;
+      std::vector<double> after;
+      for (summary const& s : it->second) before.push_back(s.*m.m_field);
+      for (summary const& s : r.m_reps) after.push_back(s.*m.m_field);
+
+      double old_median = median(before);
+      double new_median = median(after);
+      if (old_median <= 0.0) {
+        continue;
+      }
+      double change_pct = (new_median / old_median - 1.0) * 100.0;
+      double p = mann_whitney_greater(before, after);
+      if (p < o.m_alpha && change_pct >= o.m_threshold_pct) {
+        regressions++;
+        std::cerr << "REGRESSION " << r.m_name << " " << m.m_name << ": "
+                  << old_median << " -> " << new_median << " ns (+"
+                  << change_pct << "%, p=" << std::setprecision(4) << p
+                  << std::setprecision(2) << ")" << std::endl;
+      }
+    }
+  }
+
+  std::cerr << "Compared " << compared << " benchmarks against "
+            << o.m_baseline << " (alpha " << o.m_alpha << ", threshold "
+            << o.m_threshold_pct << "%): " << regressions
+            << " regression(s)" << std::endl;
+  if (o.m_repetitions < 3U) {
+    std::cerr << "Too few repetitions for a significant result, use "
+                 "--repetitions=10 or more"
+              << std::endl;
+  }
+  return regressions;
+}
+
+}  // namespace
+
+// -------------------------------------------
+// Public functions
+
+bool register_benchmark(const char* name, benchmark_fn fn,
+                        std::vector<int64_t> const& args,
+                        uint64_t batch_size) {
+  if (args.empty()) {
+    registry().push_back(benchmark_entry{name, fn, 0, batch_size});
+    return true;
+  }
+
+  for (int64_t a : args) {
+    registry().push_back(benchmark_entry{
+        std::string(name) + "/" + std::to_string(a), fn, a, batch_size});
+  }
+  return true;
+}
+
+bool register_benchmark_variant(std::string const& name, benchmark_fn fn,
+                                int64_t arg, uint64_t batch_size) {
+  registry().push_back(benchmark_entry{name, fn, arg, batch_size});
+  return true;
+}
+
+bool pin_thread_to_cpu(int cpu) {
+  if (cpu < 0 || cpu >= CPU_SETSIZE) {
+    return false;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+int num_cpus() {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    return CPU_COUNT(&set);
+  }
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? static_cast<int>(n) : 1;
+}
+
+int64_t option_int(const char* name, int64_t def) {
+  const char* v = find_extra(name);
+  if (v == nullptr) {
+    return def;
+  }
+  char* end = nullptr;
+  long long r = std::strtoll(v, &end, 10);
+  return (*v != '\0' && *end == '\0') ? r : def;
+}
+
+std::string option_str(const char* name, const char* def) {
+  const char* v = find_extra(name);
+  return v == nullptr ? def : v;
+}
+
+int run(int argc, char** argv) {
+  options& o = opts();
+  bool list_only = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (a == "--help" || a == "-h") {
+      print_usage(argv[0]);
+      return 0;
+    }
+    if (a == "--list") {
+      list_only = true;
+      continue;
+    }
+    if (a == "--perf") {
+      o.m_perf = true;
+      continue;
+    }
+    if (a.compare(0, 2, "--") != 0 || a.find('=') == std::string::npos) {
+      std::cerr << "Unknown argument: " << a << std::endl;
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+
+    size_t eq = a.find('=');
+    std::string key = a.substr(2, eq - 2);
+    std::string val = a.substr(eq + 1);
+    bool ok = true;
+
+    if (key == "filter") {
+      o.m_filter = val;
+    } else if (key == "repetitions") {
+      ok = parse_uint(val.c_str(), &o.m_repetitions) && o.m_repetitions > 0U;
+    } else if (key == "warmup") {
+      ok = parse_uint(val.c_str(), &o.m_warmup);
+    } else if (key == "samples") {
+      ok = parse_uint(val.c_str(), &o.m_samples) && o.m_samples > 0U;
+    } else if (key == "batch") {
+      ok = parse_uint(val.c_str(), &o.m_batch);
+    } else if (key == "cpu") {
+      uint64_t cpu = 0U;
+      ok = parse_uint(val.c_str(), &cpu);
+      o.m_cpu = static_cast<int>(cpu);
+    } else if (key == "format") {
+      ok = val == "console" || val == "csv" || val == "json";
+      o.m_format = val;
+    } else if (key == "out") {
+      o.m_out = val;
+    } else if (key == "baseline") {
+      o.m_baseline = val;
+    } else if (key == "save-baseline") {
+      o.m_save_baseline = val;
+    } else if (key == "alpha") {
+      ok = parse_double(val.c_str(), &o.m_alpha);
+    } else if (key == "threshold") {
+      ok = parse_double(val.c_str(), &o.m_threshold_pct);
+    } else {
+      o.m_extra.emplace_back(key, val);
+    }
+
+    if (!ok) {
+      std::cerr << "Bad value for --" << key << ": " << val << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (list_only) {
+    for (auto const& e : registry()) {
+      std::cout << e.m_name << "\n";
+    }
+    return 0;
+  }
+
+  // Read up front so a missing baseline doesn't cost a full run
+  baseline base;
+  if (!o.m_baseline.empty() && !read_baseline(o.m_baseline, &base)) {
+    std::cerr << "No baseline at " << o.m_baseline << std::endl;
+    return kExitNoBaseline;
+  }
+
+  if (o.m_cpu >= 0 && !pin_thread_to_cpu(o.m_cpu)) {
+    std::cerr << "Could not pin to cpu " << o.m_cpu << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Keep the calibration out of the first benchmark
+  rtl::cycle_clock::calibrate();
+
+  // Counters are per thread, open them on the thread running the benchmarks
+  if (o.m_perf) {
+    if (!perf().open()) {
+      std::cerr << "Hardware counters unavailable: " << perf().error()
+                << std::endl;
+    } else if (!perf().error().empty()) {
+      std::cerr << "Hardware counters " << perf().error() << std::endl;
+    }
+  }
+
+#ifdef NDEBUG
+  std::cerr << "RELEASE BUILD" << std::endl;
+#else
+  std::cerr << "DEBUG BUILD" << std::endl;
+#endif
+
+  std::vector<result> results;
+  for (auto const& e : registry()) {
+    if (!o.m_filter.empty() && e.m_name.find(o.m_filter) == std::string::npos) {
+      continue;
+    }
+    std::cerr << "Running " << e.m_name << std::endl;
+    results.push_back(run_one(e));
+  }
+
+  std::ofstream file;
+  if (!o.m_out.empty()) {
+    file.open(o.m_out.c_str());
+    if (!file) {
+      std::cerr << "Could not open " << o.m_out << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  std::ostream& os = o.m_out.empty() ? std::cout : file;
+
+  if (o.m_format == "json") {
+    write_json(os, results);
+  } else if (o.m_format == "csv") {
+    write_csv(os, results);
+  } else {
+    write_console(os, results);
+  }
+
+  os.flush();
+  if (!os) {
+    return EXIT_FAILURE;
+  }
+
+  if (!o.m_save_baseline.empty()) {
+    std::ofstream out(o.m_save_baseline.c_str());
+    write_csv(out, results);
+    out.flush();
+    if (!out) {
+      std::cerr << "Could not write " << o.m_save_baseline << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!o.m_baseline.empty() && compare_baseline(base, results) > 0U) {
+    return EXIT_FAILURE;
+  }
+  return 0;
+}
+
+}  // namespace rtl_bench
@@ -0,0 +1,264 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RTL_BENCH_HARNESS_HPP
+#define RTL_BENCH_HARNESS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rtl/pounds.h"
+#include "rtl_bench/perf.hpp"
+#include "rtlcpp/histogram.hpp"
+#include "rtlcpp/utility.hpp"
+
+/*
+ * The RTL benchmark harness.
+ *
+ * Benchmarks are plain functions taking an rtl_bench::state and are
+ * registered with RTL_BENCHMARK() (or RTL_BENCHMARK_ARGS() to run the same
+ * function once per argument).  The harness runs every registered
+ * benchmark for a number of warmup repetitions (discarded) followed by the
+ * measured repetitions, records every sample in a histogram and prints a
+ * summary per repetition plus an aggregate over all repetitions.
+ *
+ * A benchmark does its own (untimed) setup and then loops:
+ *
+ *    void bm_push(rtl_bench::state& st) {
+ *      rtl::vector<int> v(&alloc);
+ *      while (st.keep_running()) {
+ *        st.start_timer();
+ *        for (uint64_t i = 0; i < st.batch_size(); i++) v.push_back(i);
+ *        st.stop_timer(st.batch_size());
+ *      }
+ *    }
+ *    RTL_BENCHMARK(bm_push);
+ *    RTL_BENCHMARK_MAIN();
+ *
+ * Every stop_timer() records one sample of (elapsed time / ops), timed with
+ * rtl::cycle_clock which the harness calibrates before running.  Timing
+ * single operations is fine for slow operations, fast ones should be
+ * batched so the clock overhead doesn't dominate.
+ *
+ * Common command line options (run with --help for the full list):
+ *
+ *    --filter=<substr>     only run benchmarks whose name contains substr
+ *    --repetitions=<n>     measured repetitions per benchmark
+ *    --warmup=<n>          discarded repetitions per benchmark
+ *    --samples=<n>         samples per repetition (keep_running())
+ *    --batch=<n>           override every benchmark's batch size
+ *    --cpu=<n>             pin the benchmark thread to cpu n
+ *    --format=console|csv|json
+ *    --out=<path>          write the report to a file instead of stdout
+ *    --perf                count hardware events between start_timer() and
+ *                          stop_timer() and report them per operation
+ *    --save-baseline=<path>
+ *                          also write the csv report to path
+ *    --baseline=<path>     compare every repetition's mean and percentiles
+ *                          with a saved baseline (one sided Mann-Whitney U
+ *                          test at --alpha) and fail on slowdowns larger
+ *                          than --threshold percent
+ *
+ * Anything else of the form --name=value is kept and can be read by the
+ * benchmarks with option_int()/option_str().
+ */
+
+namespace rtl_bench {
+
+//! Plain heap allocator for the harness' own bookkeeping
+struct heap_allocator {
+  void* allocate(size_t size) { return std::malloc(size); }
+  void deallocate(void* p) { std::free(p); }
+};
+
+/*!
+ * Per-operation times are recorded in picoseconds so that batched samples
+ * of fast operations keep their sub-nanosecond part.
+ */
+using histogram = rtl::histogram<heap_allocator>;
+
+//! Values above this (one hour) are counted as overflows
+static const uint64_t kHighestTrackablePs = 3600ULL * 1000000000000ULL;
+
+//! Initializes a histogram with the layout the harness uses
+bool init_histogram(histogram* h);
+
+/*!
+ * Passed to every benchmark function, used to record samples.
+ */
+class state {
+ private:
+  int64_t m_arg;
+  uint64_t m_batch_size;
+  uint64_t m_target_samples;
+  uint64_t m_samples;
+  uint64_t m_ops;
+  bool m_skipped;
+  std::string m_skip_reason;
+  histogram m_hist;
+  std::vector<std::pair<std::string, double>> m_counters;
+  uint64_t m_start;
+  perf_counters* m_perf;
+  uint64_t m_timed_ops;
+
+ public:
+  /*!
+   * @param perf if not nullptr, counts hardware events between
+   * start_timer() and stop_timer()
+   */
+  state(int64_t arg, uint64_t batch_size, uint64_t target_samples,
+        perf_counters* perf = nullptr);
+
+  //! The argument given at registration (zero if none)
+  int64_t arg() const { return m_arg; }
+
+  //! The number of operations a benchmark should time per sample
+  uint64_t batch_size() const { return m_batch_size; }
+
+  //! The number of samples to record per repetition
+  uint64_t target_samples() const { return m_target_samples; }
+
+  //! True until target_samples() samples have been recorded
+  bool keep_running() const {
+    return !m_skipped && m_samples < m_target_samples;
+  }
+
+  //! Starts timing a sample
+  void start_timer() {
+    if (m_perf != nullptr) m_perf->start();
+    m_start = rtl::cycle_clock::start();
+  }
+
+  //! Stops timing and records one sample of (elapsed / ops) picoseconds
+  void stop_timer(uint64_t ops = 1U) {
+    uint64_t end = rtl::cycle_clock::stop();
+    if (m_perf != nullptr) m_perf->stop();
+    m_timed_ops += ops;
+    record(rtl::cycle_clock::to_ns(end - m_start), ops);
+  }
+
+  /*!
+   * Records one sample that was timed by the benchmark itself.
+   *
+   * @param total_ns the time it took to perform ops operations
+   * @param ops the number of operations performed
+   */
+  void record(double total_ns, uint64_t ops = 1U);
+
+  //! Adds a custom value to the report of this repetition
+  void set_counter(const char* name, double value);
+
+  //! Marks the benchmark as skipped (e.g. unsupported on this machine)
+  void skip(const char* reason);
+
+  bool skipped() const { return m_skipped; }
+  std::string const& skip_reason() const { return m_skip_reason; }
+  histogram const& hist() const { return m_hist; }
+  uint64_t ops() const { return m_ops; }
+  //! The operations timed with start_timer()/stop_timer()
+  uint64_t timed_ops() const { return m_timed_ops; }
+  std::vector<std::pair<std::string, double>> const& counters() const {
+    return m_counters;
+  }
+};
+
+using benchmark_fn = void (*)(state&);
+
+/*!
+ * Registers a benchmark, normally used through the RTL_BENCHMARK macros.
+ *
+ * If args is non-empty the benchmark is registered once per argument with
+ * the name "name/arg".
+ *
+ * @return always true, so it can initialize a static variable
+ */
+bool register_benchmark(const char* name, benchmark_fn fn,
+                        std::vector<int64_t> const& args = {},
+                        uint64_t batch_size = 1U);
+
+/*!
+ * Registers a single benchmark under exactly the given name, passing it arg.
+ * Used to register variants generated at run time (call it before run()),
+ * decoding whatever arg encodes in the benchmark.
+ *
+ * @return always true
+ */
+bool register_benchmark_variant(std::string const& name, benchmark_fn fn,
+                                int64_t arg, uint64_t batch_size = 1U);
+
+//! Pins the calling thread to a cpu, returns false if that failed
+bool pin_thread_to_cpu(int cpu);
+
+//! The number of cpus available to this process
+int num_cpus();
+
+//! Reads --name=value from the command line, or def if not given
+int64_t option_int(const char* name, int64_t def);
+std::string option_str(const char* name, const char* def);
+
+//! Returned by run() when the --baseline file doesn't exist (CTest's skip)
+static const int kExitNoBaseline = 77;
+
+/*!
+ * Parses the command line, runs every registered benchmark and writes the
+ * report.
+ *
+ * @return zero on success, kExitNoBaseline if the --baseline file doesn't
+ * exist, other non-zero values on bad arguments, failures or slowdowns
+ * against the baseline
+ */
+int run(int argc, char** argv);
+
+//! Keeps the compiler from optimizing away a value
+template <typename T>
+inline void do_not_optimize(T const& value) {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  static volatile const T* sink;
+  sink = &value;
+#endif
+}
+
+//! Keeps the compiler from reordering memory accesses around this point
+inline void clobber_memory() {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : : "memory");
+#endif
+}
+
+}  // namespace rtl_bench
+
+#define RTL_BENCHMARK(fn)                                \
+  static const bool RTL_CONCAT(rtl_bench_registered_, fn) \
+      __attribute__((unused)) = rtl_bench::register_benchmark(#fn, fn)
+
+#define RTL_BENCHMARK_ARGS(fn, ...)                       \
+  static const bool RTL_CONCAT(rtl_bench_registered_, fn) \
+      __attribute__((unused)) =                           \
+          rtl_bench::register_benchmark(#fn, fn, {__VA_ARGS__})
+
+#define RTL_BENCHMARK_BATCH(fn, batch)                    \
+  static const bool RTL_CONCAT(rtl_bench_registered_, fn) \
+      __attribute__((unused)) =                           \
+          rtl_bench::register_benchmark(#fn, fn, {}, batch)
+
+#define RTL_BENCHMARK_MAIN() \
+  int main(int argc, char** argv) { return rtl_bench::run(argc, argv); }
+
+#endif  // RTL_BENCH_HARNESS_HPP
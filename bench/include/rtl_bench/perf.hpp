@@ -0,0 +1,98 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RTL_BENCH_PERF_HPP
+#define RTL_BENCH_PERF_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace rtl_bench {
+
+/*!
+ * Hardware performance counters of the calling thread, read as one
+ * perf_event_open group so they all cover exactly the same instructions.
+ *
+ * Only user space is counted.  Counters the CPU or the kernel doesn't
+ * support are left out of the group and reported as unavailable; if the
+ * group can't be opened at all (not Linux, perf_event_paranoid too high,
+ * running in a container without CAP_PERFMON, ...) open() fails and
+ * error() says why.
+ */
+class perf_counters final {
+ public:
+  enum counter : size_t {
+    kInstructions = 0U,
+    kCacheMisses,
+    kLLCMisses,
+    kBranchMisses,
+    kDTLBMisses,
+    kNumCounters,
+  };
+
+  //! The name used for a counter in reports
+  static const char* name(counter c);
+
+ private:
+  int m_fds[kNumCounters];
+  // Position of each counter in the group read, or -1 if unavailable
+  int m_index[kNumCounters];
+  size_t m_num_open;
+  std::string m_error;
+
+ public:
+  perf_counters();
+  ~perf_counters();
+
+  perf_counters(perf_counters const&) = delete;
+  perf_counters& operator=(perf_counters const&) = delete;
+
+  /*!
+   * Opens the counters for the calling thread, disabled.
+   *
+   * @return false if no counter could be opened, see error()
+   */
+  bool open();
+
+  void close();
+
+  bool is_open() const { return m_num_open > 0U; }
+
+  //! Why open() failed or which counters are missing
+  std::string const& error() const { return m_error; }
+
+  bool available(counter c) const { return m_index[c] >= 0; }
+
+  //! Starts counting (a system call, keep it outside the timed region)
+  void start();
+
+  //! Stops counting, the counts accumulate over start()/stop() pairs
+  void stop();
+
+  //! Zeroes every counter
+  void reset();
+
+  /*!
+   * Reads every counter, scaled up if the kernel had to multiplex them.
+   * Unavailable counters read as zero.
+   *
+   * @return false if the read failed
+   */
+  bool read(uint64_t values[kNumCounters]) const;
+};
+
+}  // namespace rtl_bench
+
+#endif  // RTL_BENCH_PERF_HPP
@@ -0,0 +1,43 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef RTL_BENCH_STATS_HPP
+#define RTL_BENCH_STATS_HPP
+
+#include <vector>
+
+namespace rtl_bench {
+
+/*!
+ * One sided Mann-Whitney U test: the p-value of the hypothesis that values
+ * drawn like b tend to be larger than values drawn like a.
+ *
+ * Uses the exact distribution of U when both samples have at most 20
+ * values (ties counted as half, which makes the exact p-value slightly
+ * conservative) and the normal approximation with tie correction
+ * otherwise.  Note that with very few values nothing can be significant,
+ * e.g. the smallest possible p-value for 3 against 3 is 0.05.
+ *
+ * @return the p-value, 1.0 if either sample is empty
+ */
+double mann_whitney_greater(std::vector<double> const& a,
+                            std::vector<double> const& b);
+
+//! The median, 0.0 for an empty vector
+double median(std::vector<double> v);
+
+}  // namespace rtl_bench
+
+#endif  // RTL_BENCH_STATS_HPP
@@ -0,0 +1,62 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RTL_BENCH_TOPOLOGY_HPP
+#define RTL_BENCH_TOPOLOGY_HPP
+
+#include <vector>
+
+namespace rtl_bench {
+
+//! Where a logical cpu sits, as reported by the kernel
+struct cpu_info {
+  int m_cpu;
+  int m_core;
+  int m_package;
+};
+
+/*!
+ * The logical cpus this process may run on.  Reads
+ * /sys/devices/system/cpu/cpu<n>/topology on Linux; where that isn't
+ * available every cpu is reported as its own core in package 0.
+ */
+std::vector<cpu_info> cpu_topology();
+
+//! How two threads are placed relative to each other
+enum class placement {
+  //! Both on the same logical cpu
+  kSameCore = 0,
+  //! Hyper-threads of the same physical core
+  kSmtSiblings,
+  //! Different physical cores of the same package
+  kSameSocket,
+  //! Different packages
+  kCrossSocket,
+};
+
+static const int kNumPlacements = 4;
+
+//! A short name for reports, e.g. "smt_siblings"
+const char* placement_name(placement p);
+
+/*!
+ * Picks two cpus with the requested placement.
+ *
+ * @return false if this machine (or the affinity mask) has no such pair
+ */
+bool find_cpu_pair(placement p, int* first, int* second);
+
+}  // namespace rtl_bench
+
+#endif  // RTL_BENCH_TOPOLOGY_HPP
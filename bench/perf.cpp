@@ -0,0 +1,199 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rtl_bench/perf.hpp"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif
+
+#include <cstring>
+
+namespace rtl_bench {
+
+namespace {
+
+#if defined(__linux__)
+
+struct event_config {
+  uint32_t m_type;
+  uint64_t m_config;
+};
+
+uint64_t cache_config(uint64_t cache) {
+  return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8U) |
+         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16U);
+}
+
+// In perf_counters::counter order, the first one leads the group
+const event_config kEvents[perf_counters::kNumCounters] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HW_CACHE, cache_config(PERF_COUNT_HW_CACHE_LL)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE, cache_config(PERF_COUNT_HW_CACHE_DTLB)},
+};
+
+int open_event(event_config const& e, int group_fd) {
+  struct perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = e.m_type;
+  attr.config = e.m_config;
+  attr.disabled = group_fd == -1 ? 1U : 0U;
+  attr.exclude_kernel = 1U;
+  attr.exclude_hv = 1U;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return static_cast<int>(
+      syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0UL));
+}
+
+#endif
+
+}  // namespace
+
+const char* perf_counters::name(counter c) {
+  switch (c) {
+    case kInstructions:
+      return "instructions";
+    case kCacheMisses:
+      return "cache_misses";
+    case kLLCMisses:
+      return "llc_misses";
+    case kBranchMisses:
+      return "branch_misses";
+    case kDTLBMisses:
+      return "dtlb_misses";
+    default:
+      return "unknown";
+  }
+}
+
+perf_counters::perf_counters() : m_num_open(0U) {
+  for (size_t i = 0U; i < kNumCounters; i++) {
+    m_fds[i] = -1;
+    m_index[i] = -1;
+  }
+}
+
+perf_counters::~perf_counters() { close(); }
+
+bool perf_counters::open() {
+  close();
+
+#if defined(__linux__)
+  m_fds[0] = open_event(kEvents[0], -1);
+  if (m_fds[0] < 0) {
+    m_error = std::string("perf_event_open failed: ") + std::strerror(errno);
+    if (errno == EACCES || errno == EPERM) {
+      m_error += " (check /proc/sys/kernel/perf_event_paranoid)";
+    }
+    return false;
+  }
+  m_index[0] = 0;
+  m_num_open = 1U;
+
+  for (size_t i = 1U; i < kNumCounters; i++) {
+    m_fds[i] = open_event(kEvents[i], m_fds[0]);
+    if (m_fds[i] < 0) {
+      m_error += m_error.empty() ? "unavailable: " : ", ";
+      m_error += name(static_cast<counter>(i));
+      continue;
+    }
+    m_index[i] = static_cast<int>(m_num_open++);
+  }
+  return true;
+#else
+  m_error = "perf_event_open is only available on Linux";
+  return false;
+#endif
+}
+
+void perf_counters::close() {
+#if defined(__linux__)
+  for (size_t i = 0U; i < kNumCounters; i++) {
+    if (m_fds[i] >= 0) {
+      (void)::close(m_fds[i]);
+    }
+    m_fds[i] = -1;
+    m_index[i] = -1;
+  }
+#endif
+  m_num_open = 0U;
+  m_error.clear();
+}
+
+void perf_counters::start() {
+#if defined(__linux__)
+  if (is_open()) {
+    (void)ioctl(m_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+#endif
+}
+
+void perf_counters::stop() {
+#if defined(__linux__)
+  if (is_open()) {
+    (void)ioctl(m_fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  }
+#endif
+}
+
+void perf_counters::reset() {
+#if defined(__linux__)
+  if (is_open()) {
+    (void)ioctl(m_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  }
+#endif
+}
+
+bool perf_counters::read(uint64_t values[kNumCounters]) const {
+  for (size_t i = 0U; i < kNumCounters; i++) {
+    values[i] = 0U;
+  }
+  if (!is_open()) {
+    return false;
+  }
+
+#if defined(__linux__)
+  // nr, time_enabled, time_running, then one value per open counter
+  uint64_t buf[3U + kNumCounters];
+  ssize_t want = static_cast<ssize_t>((3U + m_num_open) * sizeof(uint64_t));
+  if (::read(m_fds[0], buf, sizeof(buf)) != want || buf[0] != m_num_open) {
+    return false;
+  }
+
+  double scale = 1.0;
+  if (buf[2] != 0U && buf[2] < buf[1]) {
+    scale = static_cast<double>(buf[1]) / static_cast<double>(buf[2]);
+  }
+  for (size_t i = 0U; i < kNumCounters; i++) {
+    if (m_index[i] >= 0) {
+      values[i] = static_cast<uint64_t>(
+          static_cast<double>(buf[3 + m_index[i]]) * scale);
+    }
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+}  // namespace rtl_bench
@@ -0,0 +1,121 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "rtl_bench/stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+namespace rtl_bench {
+
+namespace {
+
+const size_t kMaxExact = 20U;
+
+// Upper tail P(U >= u) of U under the null hypothesis, where U counts the
+// (a, b) pairs with b > a.  Looking at the largest of all n + m values: if
+// it belongs to b it beats all n values of a, so
+//
+//    count(n, m, u) = count(n, m - 1, u - n) + count(n - 1, m, u)
+double exact_upper_tail(size_t n, size_t m, uint64_t u) {
+  const size_t max_u = n * m;
+  // counts[j][k] is count(i, j, k) for the current i
+  std::vector<std::vector<double>> counts(
+      m + 1U, std::vector<double>(max_u + 1U, 0.0));
+  for (size_t j = 0U; j <= m; j++) counts[j][0] = 1.0;
+
+  for (size_t i = 1U; i <= n; i++) {
+    // count(i, 0, k) stays 1 for k == 0, the rest is built from j - 1
+    for (size_t j = 1U; j <= m; j++) {
+      for (size_t k = max_u + 1U; k-- > 0U;) {
+        double from_b = k >= i ? counts[j - 1U][k - i] : 0.0;
+        counts[j][k] = from_b + counts[j][k];
+      }
+    }
+  }
+
+  double total = 0.0;
+  double tail = 0.0;
+  for (size_t k = 0U; k <= max_u; k++) {
+    total += counts[m][k];
+    if (k >= u) tail += counts[m][k];
+  }
+  return total > 0.0 ? tail / total : 1.0;
+}
+
+}  // namespace
+
+double mann_whitney_greater(std::vector<double> const& a,
+                            std::vector<double> const& b) {
+  const size_t n = a.size();
+  const size_t m = b.size();
+  if (n == 0U || m == 0U) {
+    return 1.0;
+  }
+
+  double u = 0.0;
+  for (double y : b) {
+    for (double x : a) {
+      if (y > x) {
+        u += 1.0;
+      } else if (y == x) {
+        u += 0.5;
+      }
+    }
+  }
+
+  if (n <= kMaxExact && m <= kMaxExact) {
+    return exact_upper_tail(n, m, static_cast<uint64_t>(std::floor(u)));
+  }
+
+  // Normal approximation, the variance is reduced by the ties
+  std::vector<double> all(a);
+  all.insert(all.end(), b.begin(), b.end());
+  std::sort(all.begin(), all.end());
+  double ties = 0.0;
+  for (size_t i = 0U; i < all.size();) {
+    size_t j = i;
+    while (j < all.size() && all[j] == all[i]) j++;
+    double t = static_cast<double>(j - i);
+    ties += t * t * t - t;
+    i = j;
+  }
+
+  const double dn = static_cast<double>(n);
+  const double dm = static_cast<double>(m);
+  const double total = dn + dm;
+  const double mean = dn * dm / 2.0;
+  const double var =
+      dn * dm / 12.0 * ((total + 1.0) - ties / (total * (total - 1.0)));
+  if (var <= 0.0) {
+    return 1.0;
+  }
+  // With continuity correction
+  const double z = (u - mean - 0.5) / std::sqrt(var);
+  return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+double median(std::vector<double> v) {
+  if (v.empty()) {
+    return 0.0;
+  }
+  std::sort(v.begin(), v.end());
+  size_t mid = v.size() / 2U;
+  return v.size() % 2U == 1U ? v[mid] : (v[mid - 1U] + v[mid]) / 2.0;
+}
+
+}  // namespace rtl_bench
@@ -0,0 +1,121 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rtl_bench/topology.hpp"
+
+#include <sched.h>
+
+#include <fstream>
+#include <string>
+
+namespace rtl_bench {
+
+namespace {
+
+// Reads a single integer from a sysfs file, -1 if it doesn't exist
+int read_topology(int cpu, const char* file) {
+  std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
+                     "/topology/" + file;
+  std::ifstream in(path.c_str());
+  int v = -1;
+  if (!(in >> v)) {
+    return -1;
+  }
+  return v;
+}
+
+}  // namespace
+
+std::vector<cpu_info> cpu_topology() {
+  std::vector<cpu_info> cpus;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+    return cpus;
+  }
+
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(cpu, &set)) {
+      continue;
+    }
+    int core = read_topology(cpu, "core_id");
+    int package = read_topology(cpu, "physical_package_id");
+    if (core < 0 || package < 0) {
+      core = cpu;
+      package = 0;
+    }
+    cpus.push_back(cpu_info{cpu, core, package});
+  }
+  return cpus;
+}
+
+const char* placement_name(placement p) {
+  switch (p) {
+    case placement::kSameCore:
+      return "same_core";
+    case placement::kSmtSiblings:
+      return "smt_siblings";
+    case placement::kSameSocket:
+      return "same_socket";
+    case placement::kCrossSocket:
+      return "cross_socket";
+    default:
+      return "unknown";
+  }
+}
+
+bool find_cpu_pair(placement p, int* first, int* second) {
+  std::vector<cpu_info> cpus = cpu_topology();
+
+  for (cpu_info const& a : cpus) {
+    if (p == placement::kSameCore) {
+      *first = a.m_cpu;
+      *second = a.m_cpu;
+      return true;
+    }
+
+    for (cpu_info const& b : cpus) {
+      if (b.m_cpu == a.m_cpu) {
+        continue;
+      }
+      bool same_package = a.m_package == b.m_package;
+      bool same_core = same_package && a.m_core == b.m_core;
+
+      bool match = false;
+      switch (p) {
+        case placement::kSmtSiblings:
+          match = same_core;
+          break;
+        case placement::kSameSocket:
+          match = same_package && !same_core;
+          break;
+        case placement::kCrossSocket:
+          match = !same_package;
+          break;
+        default:
+          break;
+      }
+
+      if (match) {
+        *first = a.m_cpu;
+        *second = b.m_cpu;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+}  // namespace rtl_bench
@@ -0,0 +1,50 @@
+# Benchmark regression tests, see RTL_BENCH_REGRESSION in the README.
+#
+# rtl_add_bench_regression(<target> [args...]) registers a harness based
+# benchmark:
+#
+#   - the bench_baselines target runs it with --save-baseline, writing
+#     ${RTL_BENCH_BASELINE_DIR}/<target>.csv
+#   - a CTest test labelled "bench" runs it with --baseline against that
+#     file, failing on significant slowdowns and skipping when there is no
+#     baseline yet
+#
+# Extra args (e.g. a --filter) are passed to both runs.  Does nothing unless
+# RTL_BENCH_REGRESSION is on.
+
+set(RTL_BENCH_BASELINE_DIR "${CMAKE_SOURCE_DIR}/bench/baselines" CACHE PATH
+        "Where the benchmark regression baselines are kept")
+set(RTL_BENCH_REGRESSION_ARGS "--repetitions=10 --alpha=0.01 --threshold=10" CACHE STRING
+        "Harness options for the baseline and regression runs")
+
+if (${RTL_BENCH_REGRESSION})
+    enable_testing()
+    add_custom_target(bench_baselines)
+endif ()
+
+function(rtl_add_bench_regression target)
+    if (NOT ${RTL_BENCH_REGRESSION})
+        return()
+    endif ()
+
+    set(baseline "${RTL_BENCH_BASELINE_DIR}/${target}.csv")
+    separate_arguments(common_args UNIX_COMMAND "${RTL_BENCH_REGRESSION_ARGS}")
+
+    add_custom_target(bench_baseline_${target}
+            COMMAND ${CMAKE_COMMAND} -E make_directory ${RTL_BENCH_BASELINE_DIR}
+            COMMAND $<TARGET_FILE:${target}> ${common_args} ${ARGN}
+                    --save-baseline=${baseline}
+            DEPENDS ${target}
+            USES_TERMINAL
+            )
+    add_dependencies(bench_baselines bench_baseline_${target})
+
+    add_test(NAME bench_regression_${target}
+            COMMAND ${target} ${common_args} ${ARGN} --baseline=${baseline})
+    set_tests_properties(bench_regression_${target} PROPERTIES
+            LABELS bench
+            SKIP_RETURN_CODE 77
+            RUN_SERIAL TRUE
+            TIMEOUT 3600
+            )
+endfunction()
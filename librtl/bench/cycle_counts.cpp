@@ -12,183 +12,124 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+// Times TLSF against the system allocator while randomly churning a set of
+// blocks: every iteration frees a random slot (if it is in use) and
+// allocates a new block of random size into it.
+//
+// Every benchmark takes the number of slots as its argument, the block
+// sizes are drawn from [32, 4096) with a seed set by --seed (default 42)
+// so runs are comparable.
+
 #include <sys/mman.h>
 
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <random>
 #include <utility>
 #include <vector>
 
-#ifdef _WIN32
-#include <intrin.h>
-#elif __x86_64__
-#include <x86intrin.h>
-#elif __arm__
-static inline unsigned __rdtsc(void) {
-  unsigned cc;
-  asm volatile("mrc p15, 0, %0, c15, c12, 1" : "=r"(cc));
-  return cc;
-}
-#else
-#error "unknown platform"
-#endif
-
-#include <random>
-
 #include "rtl/rtl.h"
+#include "rtl_bench/harness.hpp"
+
+static const size_t kBlkMin = 32;
+static const size_t kBlkMax = 4 * 1024;
+static const size_t kArenaSize = 1024 * 1024 * 100;  // 100 MB
+
+struct TLSFAllocator {
+  void* m_buf = nullptr;
+  struct rtl_tlsf_arena* m_arena = nullptr;
+
+  bool init() {
+    m_buf = mmap(0, kArenaSize, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (m_buf == MAP_FAILED) {
+      m_buf = nullptr;
+      return false;
+    }
 
-struct results {
-  uint64_t idx;
-  const char* allocator;
-  const char* op;
-  size_t blk_size;
-  uint64_t time;
-};
-
-void print_result(results const& r) {
-  std::cout << r.idx << "," << r.allocator << "," << r.op << "," << r.blk_size
-            << "," << r.time << std::endl;
-}
-
-void run_bench_rtl(uint64_t loops, size_t blk_min, size_t blk_max,
-                   size_t num_blocks, size_t seed) {
-  size_t buf_size = 1024 * 1024 * 100;  // 100 MB
+    // Fault in the whole arena so page faults don't end up in the samples
+    memset(m_buf, 0x33, kArenaSize);
 
-  void* buf = mmap(0, buf_size, PROT_READ | PROT_WRITE,
-                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return rtl_tlsf_make_arena(&m_arena, m_buf, kArenaSize) >= 0;
+  }
 
-  for (size_t i = 0; i < buf_size; i++) {
-    *((unsigned char*)buf + i) = 0x33;
-    //      *((unsigned char*)buf + i) = 0x00;
+  ~TLSFAllocator() {
+    if (m_buf != nullptr) munmap(m_buf, kArenaSize);
   }
 
-  struct rtl_tlsf_arena* arena;
+  void* allocate(size_t size) { return rtl_tlsf_alloc(m_arena, size); }
+  void deallocate(void* p) { rtl_tlsf_free(m_arena, p); }
+};
 
-  int err = rtl_tlsf_make_arena(&arena, buf, buf_size);
+struct SystemAllocator {
+  bool init() { return true; }
+  void* allocate(size_t size) { return malloc(size); }
+  void deallocate(void* p) { free(p); }
+};
 
-  if (err < 0) {
-    std::cerr << "Could not make arena: " << err << std::endl;
+template <typename Alloc, bool TimeFree>
+void churn(rtl_bench::state& st) {
+  Alloc alloc;
+  if (!alloc.init()) {
+    st.skip("could not make arena");
     return;
   }
 
-  size_t num_blks{num_blocks};
+  size_t num_blks = static_cast<size_t>(st.arg());
   std::vector<std::pair<void*, size_t>> blks{num_blks};
 
-  uint64_t start, end;
   std::minstd_rand gen;
+  gen.seed(static_cast<unsigned>(rtl_bench::option_int("seed", 42)));
 
-  gen.seed(seed);
-
-  size_t blk_size;
-
-  for (uint64_t i = 0; i < loops; i++) {
+  while (st.keep_running()) {
     size_t idx = gen() % num_blks;
-    blk_size = blk_min + (gen() % (blk_max - blk_min));
+    size_t blk_size = kBlkMin + (gen() % (kBlkMax - kBlkMin));
 
     if (blks[idx].first) {
-      start = __rdtsc();
-      rtl_tlsf_free(arena, blks[idx].first);
-      end = __rdtsc();
-      print_result({i, "RTL", "free", blks[idx].second, end - start});
+      if (TimeFree) st.start_timer();
+      alloc.deallocate(blks[idx].first);
+      if (TimeFree) st.stop_timer();
 
-      blks[idx].first = NULL;
+      blks[idx].first = nullptr;
       blks[idx].second = 0;
     }
 
-    start = __rdtsc();
-    blks[idx].first = rtl_tlsf_alloc(arena, blk_size);
-    end = __rdtsc();
+    if (!TimeFree) st.start_timer();
+    void* p = alloc.allocate(blk_size);
+    if (!TimeFree) st.stop_timer();
 
-    if (blks[idx].first) {
+    if (p) {
+      // Touch the block like a real user would
+      memset(p, 0x33, blk_size);
+      blks[idx].first = p;
       blks[idx].second = blk_size;
-
-      unsigned char* tmp = (unsigned char*)blks[idx].first;
-      for (size_t i = 0; i < blk_size; i++) {
-        *(tmp + i) = 0x33;
-      }
-
-      print_result({i, "RTL", "malloc", blk_size, end - start});
     }
   }
 
   for (auto& p : blks) {
-    if (p.first) rtl_tlsf_free(arena, p.first);
+    if (p.first) alloc.deallocate(p.first);
   }
-
-  munmap(buf, buf_size);
 }
 
-void run_bench_malloc(uint64_t loops, size_t blk_min, size_t blk_max,
-                      size_t num_blocks, size_t seed) {
-  size_t num_blks{num_blocks};
-  std::vector<std::pair<void*, size_t>> blks{num_blks};
-
-  uint64_t start, end;
-  std::minstd_rand gen;
-
-  gen.seed(seed);
-
-  size_t blk_size;
-
-  for (uint64_t i = 0; i < loops; i++) {
-    size_t idx = gen() % num_blks;
-    blk_size = blk_min + (gen() % (blk_max - blk_min));
-
-    if (blks[idx].first) {
-      start = __rdtsc();
-      free(blks[idx].first);
-      end = __rdtsc();
-      print_result({i, "SYSTEM", "free", blks[idx].second, end - start});
-
-      blks[idx].first = NULL;
-      blks[idx].second = 0;
-    }
-
-    start = __rdtsc();
-    blks[idx].first = malloc(blk_size);
-    end = __rdtsc();
+static void rtl_malloc(rtl_bench::state& st) {
+  churn<TLSFAllocator, false>(st);
+}
 
-    if (blks[idx].first) {
-      blks[idx].second = blk_size;
-      print_result({i, "SYSTEM", "malloc", blk_size, end - start});
-    }
-  }
+static void rtl_free(rtl_bench::state& st) { churn<TLSFAllocator, true>(st); }
 
-  for (auto& p : blks) {
-    if (p.first) free(p.first);
-  }
+static void system_malloc(rtl_bench::state& st) {
+  churn<SystemAllocator, false>(st);
 }
 
-void print_results(std::vector<results> const& rtla) {
-  for (results const& r : rtla) {
-    print_result(r);
-  }
+static void system_free(rtl_bench::state& st) {
+  churn<SystemAllocator, true>(st);
 }
 
-int main() {
-  uint64_t loops = 1000000;
-  size_t blk_min = 32;
-  size_t blk_max = 4 * 1024;
-
-  std::random_device seeder;
-  std::mt19937 engine(seeder());
-  std::uniform_int_distribution<int> dist(3, 10000);
-
-#ifdef NDEBUG
-  std::cerr << "RELEASE BUILD" << std::endl;
-#else
-  std::cerr << "DEBUG BUILD" << std::endl;
-#endif
-
-  std::cout << "Index,Allocator,Operation,Block_Size,Time" << std::endl;
-  //  for (uint32_t i = 0; i < 4294967295; i++) {
-  for (uint32_t i = 0; i < 5; i++) {
-    int num_blocks = dist(engine);
-    int seed = dist(engine);
-
-    run_bench_rtl(loops, blk_min, blk_max, num_blocks, seed);
-    run_bench_malloc(loops, blk_min, blk_max, num_blocks, seed);
-  }
+RTL_BENCHMARK_ARGS(rtl_malloc, 100, 1000, 10000);
+RTL_BENCHMARK_ARGS(rtl_free, 100, 1000, 10000);
+RTL_BENCHMARK_ARGS(system_malloc, 100, 1000, 10000);
+RTL_BENCHMARK_ARGS(system_free, 100, 1000, 10000);
 
-  return 0;
-}
+RTL_BENCHMARK_MAIN();
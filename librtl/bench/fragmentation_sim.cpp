@@ -0,0 +1,342 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Long running fragmentation simulation for the TLSF arena.
+//
+// Every tick allocates one block whose size and lifetime (in ticks) are
+// drawn from configurable distributions, then frees every block whose
+// lifetime ran out.  Every --report-every operations one CSV row is printed
+// with the state of the arena (from rtl_tlsf_get_stats()), the allocation
+// failures so far and the allocation latency over the interval.
+//
+// Distributions are given as name:param:param...
+//
+//    sizes      uniform:<min>:<max>
+//               bimodal:<p_small>:<small_min>:<small_max>:<large_min>:
+//                       <large_max>
+//               powerlaw:<alpha>:<min>:<max>
+//    lifetimes  uniform:<min>:<max>
+//               exponential:<mean>
+//               powerlaw:<alpha>:<min>:<max>
+//
+// A comma separated list of distributions for --sizes and/or --lifetimes
+// makes the workload shift phase every --phase-ops operations, cycling
+// through the list.
+//
+// e.g. to run 5 billion operations in a 16 MB arena shifting from small
+// short lived blocks to large long lived ones every 500 million:
+//
+//    ./fragmentation_sim --arena-mb=16 --ops=5000000000
+//        --phase-ops=500000000 --sizes=uniform:16:256,powerlaw:1.2:256:65536
+//        --lifetimes=exponential:1000,powerlaw:1.5:100:1000000
+
+#include <sys/mman.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rtl/rtl.h"
+#include "rtl_bench/harness.hpp"
+#include "rtlcpp/utility.hpp"
+
+namespace {
+
+using rng = std::mt19937_64;
+
+double uniform01(rng& gen) {
+  return std::generate_canonical<double, 53>(gen);
+}
+
+// Inverse transform sampling of a Pareto distribution truncated to
+// [min, max]
+double sample_powerlaw(rng& gen, double alpha, double min, double max) {
+  double u = uniform01(gen);
+  double lo = std::pow(min, -alpha);
+  double hi = std::pow(max, -alpha);
+  return std::pow(lo - u * (lo - hi), -1.0 / alpha);
+}
+
+uint64_t sample_uniform(rng& gen, double min, double max) {
+  return static_cast<uint64_t>(min + uniform01(gen) * (max - min + 1.0));
+}
+
+struct distribution {
+  std::string m_spec;
+  std::string m_name;
+  std::vector<double> m_params;
+
+  // Parses name:param:param..., checking the number of parameters
+  bool parse(std::string const& spec, bool is_size) {
+    m_spec = spec;
+    std::stringstream ss(spec);
+    std::string part;
+    if (!std::getline(ss, m_name, ':')) {
+      return false;
+    }
+    while (std::getline(ss, part, ':')) {
+      char* end = nullptr;
+      double v = std::strtod(part.c_str(), &end);
+      if (part.empty() || *end != '\0' || v < 0.0) {
+        return false;
+      }
+      m_params.push_back(v);
+    }
+
+    std::vector<double> const& p = m_params;
+    if (m_name == "uniform") {
+      return p.size() == 2U && p[0] <= p[1];
+    }
+    if (m_name == "powerlaw") {
+      return p.size() == 3U && p[0] > 0.0 && p[1] > 0.0 && p[1] <= p[2];
+    }
+    if (is_size && m_name == "bimodal") {
+      return p.size() == 5U && p[0] <= 1.0 && p[1] <= p[2] && p[3] <= p[4];
+    }
+    if (!is_size && m_name == "exponential") {
+      return p.size() == 1U && p[0] > 0.0;
+    }
+    return false;
+  }
+
+  uint64_t sample(rng& gen) const {
+    std::vector<double> const& p = m_params;
+    if (m_name == "uniform") {
+      return sample_uniform(gen, p[0], p[1]);
+    }
+    if (m_name == "powerlaw") {
+      return static_cast<uint64_t>(sample_powerlaw(gen, p[0], p[1], p[2]));
+    }
+    if (m_name == "bimodal") {
+      return uniform01(gen) < p[0] ? sample_uniform(gen, p[1], p[2])
+                                   : sample_uniform(gen, p[3], p[4]);
+    }
+    // exponential
+    return static_cast<uint64_t>(-std::log(1.0 - uniform01(gen)) * p[0]);
+  }
+};
+
+bool parse_list(std::string const& list, bool is_size,
+                std::vector<distribution>* out) {
+  std::stringstream ss(list);
+  std::string spec;
+  while (std::getline(ss, spec, ',')) {
+    distribution d;
+    if (!d.parse(spec, is_size)) {
+      std::cerr << "Bad " << (is_size ? "size" : "lifetime")
+                << " distribution: " << spec << std::endl;
+      return false;
+    }
+    out->push_back(d);
+  }
+  return !out->empty();
+}
+
+struct options {
+  uint64_t m_arena_mb = 64U;
+  uint64_t m_ops = 100000000U;
+  uint64_t m_report_every = 10000000U;
+  uint64_t m_phase_ops = 0U;
+  uint64_t m_seed = 42U;
+  std::string m_sizes = "uniform:16:4096";
+  std::string m_lifetimes = "exponential:10000";
+};
+
+void print_usage(const char* prog) {
+  std::cerr
+      << "Usage: " << prog << " [options]\n"
+      << "  --arena-mb=<n>         arena size in MB (default 64)\n"
+      << "  --ops=<n>              allocations plus frees (default 1e8)\n"
+      << "  --report-every=<n>     operations between reports (default "
+         "1e7)\n"
+      << "  --phase-ops=<n>        operations per phase (default: never "
+         "shift)\n"
+      << "  --sizes=<dist,...>     block sizes (default uniform:16:4096)\n"
+      << "  --lifetimes=<dist,...> lifetimes in ticks (default "
+         "exponential:10000)\n"
+      << "  --seed=<n>             random seed (default 42)\n";
+}
+
+bool parse_args(int argc, char** argv, options* o) {
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    size_t eq = a.find('=');
+    if (a.compare(0, 2, "--") != 0 || eq == std::string::npos) {
+      return false;
+    }
+    std::string key = a.substr(2, eq - 2);
+    std::string val = a.substr(eq + 1);
+
+    if (key == "sizes") {
+      o->m_sizes = val;
+      continue;
+    }
+    if (key == "lifetimes") {
+      o->m_lifetimes = val;
+      continue;
+    }
+
+    char* end = nullptr;
+    uint64_t v = std::strtoull(val.c_str(), &end, 10);
+    if (val.empty() || *end != '\0') {
+      return false;
+    }
+    if (key == "arena-mb") {
+      o->m_arena_mb = v;
+    } else if (key == "ops") {
+      o->m_ops = v;
+    } else if (key == "report-every") {
+      o->m_report_every = v;
+    } else if (key == "phase-ops") {
+      o->m_phase_ops = v;
+    } else if (key == "seed") {
+      o->m_seed = v;
+    } else {
+      return false;
+    }
+  }
+  return o->m_arena_mb > 0U && o->m_report_every > 0U;
+}
+
+struct live_block {
+  uint64_t m_death;
+  void* m_ptr;
+
+  bool operator>(live_block const& other) const {
+    return m_death > other.m_death;
+  }
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  options o;
+  if (!parse_args(argc, argv, &o)) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::vector<distribution> sizes;
+  std::vector<distribution> lifetimes;
+  if (!parse_list(o.m_sizes, true, &sizes) ||
+      !parse_list(o.m_lifetimes, false, &lifetimes)) {
+    return EXIT_FAILURE;
+  }
+
+  size_t arena_size = static_cast<size_t>(o.m_arena_mb) * 1024U * 1024U;
+  if (arena_size > rtl_tlsf_maximum_arena_size()) {
+    arena_size = rtl_tlsf_maximum_arena_size();
+  }
+
+  void* buf = mmap(0, arena_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buf == MAP_FAILED) {
+    std::cerr << "Could not map the arena" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::memset(buf, 0, arena_size);
+
+  struct rtl_tlsf_arena* arena = nullptr;
+  if (rtl_tlsf_make_arena(&arena, buf, arena_size) != 0) {
+    std::cerr << "Could not make the arena" << std::endl;
+    munmap(buf, arena_size);
+    return EXIT_FAILURE;
+  }
+
+  rtl_bench::heap_allocator heap;
+  rtl_bench::histogram latency(&heap);
+  if (!rtl_bench::init_histogram(&latency)) {
+    std::cerr << "Could not allocate the histogram" << std::endl;
+    munmap(buf, arena_size);
+    return EXIT_FAILURE;
+  }
+  rtl::cycle_clock::calibrate();
+
+  rng gen(o.m_seed);
+  std::priority_queue<live_block, std::vector<live_block>,
+                      std::greater<live_block>>
+      live;
+
+  uint64_t ops = 0U;
+  uint64_t tick = 0U;
+  uint64_t attempts = 0U;
+  uint64_t failures = 0U;
+  uint64_t next_report = o.m_report_every;
+
+  std::cout << "ops,phase,live_blocks,free_bytes,used_bytes,"
+               "largest_free_block,free_blocks,failed_allocs,"
+               "failed_per_billion,alloc_p50_ns,alloc_p99_ns,alloc_max_ns\n";
+
+  while (ops < o.m_ops) {
+    size_t phase =
+        o.m_phase_ops == 0U ? 0U : static_cast<size_t>(ops / o.m_phase_ops);
+    distribution const& sd = sizes[phase % sizes.size()];
+    distribution const& ld = lifetimes[phase % lifetimes.size()];
+
+    size_t sz = static_cast<size_t>(sd.sample(gen));
+    uint64_t lifetime = ld.sample(gen);
+
+    uint64_t t0 = rtl::cycle_clock::start();
+    void* p = rtl_tlsf_alloc(arena, sz);
+    uint64_t t1 = rtl::cycle_clock::stop();
+    latency.record(static_cast<uint64_t>(rtl::cycle_clock::to_ns(t1 - t0) *
+                                         1000.0));
+    attempts++;
+    ops++;
+
+    if (p == nullptr) {
+      failures++;
+    } else {
+      live.push(live_block{tick + lifetime, p});
+    }
+
+    while (!live.empty() && live.top().m_death <= tick) {
+      rtl_tlsf_free(arena, live.top().m_ptr);
+      live.pop();
+      ops++;
+    }
+    tick++;
+
+    if (ops >= next_report || ops >= o.m_ops) {
+      struct rtl_tlsf_stats stats;
+      (void)rtl_tlsf_get_stats(arena, &stats);
+      double per_billion = static_cast<double>(failures) * 1e9 /
+                           static_cast<double>(attempts);
+      std::cout << ops << "," << phase << "," << live.size() << ","
+                << stats.free_bytes << "," << stats.used_bytes << ","
+                << stats.largest_free_block << "," << stats.free_blocks << ","
+                << failures << "," << per_billion << ","
+                << latency.value_at_percentile(50.0) / 1000U << ","
+                << latency.value_at_percentile(99.0) / 1000U << ","
+                << latency.max() / 1000U << std::endl;
+      latency.reset();
+      next_report += o.m_report_every;
+    }
+  }
+
+  std::cerr << failures << " of " << attempts << " allocations failed"
+            << std::endl;
+
+  munmap(buf, arena_size);
+  return EXIT_SUCCESS;
+}
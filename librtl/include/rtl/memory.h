@@ -20,6 +20,19 @@
 
 #include "pounds.h"  // For memory alignment
 
+/*
+ * With RTL_HEADER_ONLY defined the TLSF functions are static inline and
+ * their definitions are included at the end of this header, so the
+ * compiler can inline and specialize them into every caller instead of
+ * calling into librtl.  Define it for every translation unit (the
+ * RTL_HEADER_ONLY CMake option does that for everything linking librtl).
+ */
+#if defined(RTL_HEADER_ONLY)
+#define RTL_TLSF_API static inline
+#else
+#define RTL_TLSF_API
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif  // __cplusplus
@@ -43,10 +56,10 @@ static inline size_t rtl_align(size_t word_size, size_t sz) {
 struct rtl_tlsf_arena;
 
 //! Returns the minimum size that is needed to make an arena
-size_t rtl_tlsf_minimum_arena_size(void);
+RTL_TLSF_API size_t rtl_tlsf_minimum_arena_size(void);
 
 //! Returns the maximum size that an arena can handle
-size_t rtl_tlsf_maximum_arena_size(void);
+RTL_TLSF_API size_t rtl_tlsf_maximum_arena_size(void);
 
 /*!
  * \brief rtl_tlsf_make_arena constructs an arena from an existing memory region
@@ -80,7 +93,8 @@ size_t rtl_tlsf_maximum_arena_size(void);
  * \param sz the size of the memory buffer
  * \return 0 on success, otherwise -1, -2, -3, -4
  */
-int rtl_tlsf_make_arena(struct rtl_tlsf_arena** arena, void* memory, size_t sz);
+RTL_TLSF_API int rtl_tlsf_make_arena(struct rtl_tlsf_arena** arena,
+                                     void* memory, size_t sz);
 
 /*!
  * \brief rtl_tlsf_alloc allocates a chunk of memory that is at least sz big
@@ -101,7 +115,7 @@ int rtl_tlsf_make_arena(struct rtl_tlsf_arena** arena, void* memory, size_t sz);
  * \param sz the size of the request.
  * \return a pointer to contiguous memory if successful, otherwise NULL
  */
-void* rtl_tlsf_alloc(struct rtl_tlsf_arena* arena, size_t sz);
+RTL_TLSF_API void* rtl_tlsf_alloc(struct rtl_tlsf_arena* arena, size_t sz);
 
 /*!
  * \brief rtl_tlsf_free frees a piece of memory allocated by rtl_tlsf_alloc.
@@ -118,10 +132,53 @@ void* rtl_tlsf_alloc(struct rtl_tlsf_arena* arena, size_t sz);
  * \param arena a constructed memory arena
  * \param ptr the pointer to memory needing to be freed
  */
-void rtl_tlsf_free(struct rtl_tlsf_arena* arena, void* ptr);
+RTL_TLSF_API void rtl_tlsf_free(struct rtl_tlsf_arena* arena, void* ptr);
+
+/*!
+ * Usage statistics of an arena, filled in by rtl_tlsf_get_stats().
+ *
+ * Block sizes include the per block header, so free_bytes + used_bytes ==
+ * total_bytes.
+ */
+struct rtl_tlsf_stats {
+  //! Bytes managed by the arena (everything after the arena header)
+  size_t total_bytes;
+  //! Bytes in free blocks
+  size_t free_bytes;
+  //! Bytes in allocated blocks
+  size_t used_bytes;
+  //! The most a single allocation could get from the largest free block
+  size_t largest_free_block;
+  //! Number of free blocks
+  size_t free_blocks;
+  //! Number of allocated blocks
+  size_t used_blocks;
+};
+
+/*!
+ * \brief rtl_tlsf_get_stats walks an arena and reports how much of it is free
+ * and how fragmented that free space is.
+ *
+ * *** IMPORTANT***
+ * *** This visits every block in the arena.  Its run time grows with the
+ * *** number of blocks so it shouldn't be called from a real time path.
+ *
+ * This function assumes that arena is fully constructed.  Behavior is undefined
+ * if this isn't the case.
+ *
+ * \param arena a constructed memory arena
+ * \param stats where to write the statistics
+ * \return 0 on success, -1 if arena or stats is NULL
+ */
+RTL_TLSF_API int rtl_tlsf_get_stats(const struct rtl_tlsf_arena* arena,
+                                    struct rtl_tlsf_stats* stats);
 
 #ifdef __cplusplus
 }
 #endif  // __cplusplus
 
+#if defined(RTL_HEADER_ONLY)
+#include "rtl/memory.incl"
+#endif
+
 #endif  // RTL_MEMORY_H
@@ -0,0 +1,144 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RTL_POOL_H
+#define RTL_POOL_H
+
+#include <stddef.h>  // For size_t
+
+#include "memory.h"  // For rtl_tlsf_arena
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+/*
+ * A fixed block pool allocator.  Every block has the same size, so there is
+ * no searching or splitting: rtl_pool_alloc() and rtl_pool_free() are a
+ * handful of instructions whatever the size of the pool.
+ *
+ * Free blocks are kept on a singly linked list threaded through the blocks
+ * themselves, so there is no per block header and the blocks are packed
+ * back to back.  Blocks that were never handed out aren't on the list yet,
+ * which keeps rtl_pool_make() constant time as well.
+ *
+ * A pool is not thread-safe.
+ */
+
+//! Opaque type for a pool
+struct rtl_pool;
+
+/*!
+ * \brief rtl_pool_buffer_size returns how big a buffer has to be to hold
+ * num_blocks blocks of block_size bytes
+ *
+ * Blocks are rounded up to a multiple of rtl_pool_block_alignment() and
+ * are aligned to it.  The buffer itself only has to be aligned like a
+ * pointer, the size includes room to align the first block.
+ *
+ * \param block_size the size of every block
+ * \param num_blocks the number of blocks
+ * \return the buffer size, 0 if it doesn't fit in a size_t
+ */
+size_t rtl_pool_buffer_size(size_t block_size, size_t num_blocks);
+
+//! Returns the alignment of every block, the strictest alignment of any
+//! fundamental type (intmax_t, long double, pointers)
+size_t rtl_pool_block_alignment(void);
+
+/*!
+ * \brief rtl_pool_make constructs a pool from an existing memory region
+ *
+ * Like rtl_tlsf_make_arena() the pool lives at the start of memory and
+ * the rest of the buffer is carved into as many blocks as fit, see
+ * rtl_pool_buffer_size().  When done with the pool release the buffer
+ * however it was obtained.
+ *
+ * This function returns:
+ *
+ * 0 on Success
+ * -1 if the pool or memory pointer is null
+ * -2 if the memory pointer isn't aligned like a pointer
+ * -3 if the buffer can't hold a single block
+ *
+ * If this function fails, then the pool pointer won't be modified.
+ *
+ * \param pool the pointer to a pointer of the pool type
+ * \param memory the memory buffer for the pool to use
+ * \param sz the size of the memory buffer
+ * \param block_size the size of every block
+ * \return 0 on success, otherwise -1, -2, -3
+ */
+int rtl_pool_make(struct rtl_pool** pool, void* memory, size_t sz,
+                  size_t block_size);
+
+/*!
+ * \brief rtl_pool_make_from_arena constructs a pool of num_blocks blocks
+ * in a single allocation from arena
+ *
+ * Release the pool with rtl_tlsf_free(arena, pool).
+ *
+ * This function returns:
+ *
+ * 0 on Success
+ * -1 if the pool or arena pointer is null
+ * -3 if num_blocks is 0 or the size overflows
+ * -5 if the arena couldn't provide the memory
+ *
+ * \param pool the pointer to a pointer of the pool type
+ * \param arena a constructed memory arena
+ * \param block_size the size of every block
+ * \param num_blocks the number of blocks
+ * \return 0 on success, otherwise -1, -3, -5
+ */
+int rtl_pool_make_from_arena(struct rtl_pool** pool,
+                             struct rtl_tlsf_arena* arena, size_t block_size,
+                             size_t num_blocks);
+
+/*!
+ * \brief rtl_pool_alloc returns a block of rtl_pool_block_size() bytes
+ *
+ * \param pool a constructed pool
+ * \return a block, or NULL if every block is in use
+ */
+void* rtl_pool_alloc(struct rtl_pool* pool);
+
+/*!
+ * \brief rtl_pool_free gives a block back to the pool
+ *
+ * *** IMPORTANT***
+ * *** ptr must have come from rtl_pool_alloc() on the same pool and can
+ * *** only be freed once, neither is checked.
+ *
+ * It is ok to pass in NULL for the ptr parameter.
+ *
+ * \param pool a constructed pool
+ * \param ptr the block to free
+ */
+void rtl_pool_free(struct rtl_pool* pool, void* ptr);
+
+//! Returns the size of every block, after rounding
+size_t rtl_pool_block_size(const struct rtl_pool* pool);
+
+//! Returns the total number of blocks in the pool
+size_t rtl_pool_num_blocks(const struct rtl_pool* pool);
+
+//! Returns the number of blocks rtl_pool_alloc() can still hand out
+size_t rtl_pool_free_blocks(const struct rtl_pool* pool);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+
+#endif  // RTL_POOL_H
@@ -17,6 +17,11 @@
 
 #include "stdint.h" // For the UINTXXX_T type
 
+#if defined(_MSC_VER)
+#include <intrin.h> // For _ReadWriteBarrier, _mm_mfence, _mm_prefetch and
+                    // _BitScanReverse
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif  // __cplusplus
@@ -69,6 +74,121 @@ extern "C" {
 #define RTL_ARCH_ARM
 #endif
 
+#if defined(__aarch64__) || defined(__arm64) || defined(_M_ARM64)
+#define RTL_ARCH_ARM64
+#endif
+
+
+// Assumed size of a cache line, used to pad apart data written by different
+// cores
+#define RTL_CACHE_LINE_SIZE 64
+
+
+/*
+ * Memory barriers for code that can't use C11 <stdatomic.h>.
+ *
+ * RTL_COMPILER_BARRIER()  stops the compiler moving memory accesses across it
+ * RTL_ACQUIRE_BARRIER()   placed after a load, keeps later loads and stores
+ *                         after it
+ * RTL_RELEASE_BARRIER()   placed before a store, keeps earlier loads and
+ *                         stores before it
+ * RTL_MEMORY_BARRIER()    a full fence
+ *
+ * RTL_HAS_MEMORY_BARRIERS is defined when this compiler and architecture
+ * are supported.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+
+#define RTL_COMPILER_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+#if defined(RTL_ARCH_X86)
+// x86 only reorders stores after later loads, acquire and release are free
+#define RTL_ACQUIRE_BARRIER() RTL_COMPILER_BARRIER()
+#define RTL_RELEASE_BARRIER() RTL_COMPILER_BARRIER()
+#define RTL_MEMORY_BARRIER() __asm__ __volatile__("mfence" ::: "memory")
+#elif defined(RTL_ARCH_ARM64)
+#define RTL_ACQUIRE_BARRIER() __asm__ __volatile__("dmb ishld" ::: "memory")
+#define RTL_RELEASE_BARRIER() __asm__ __volatile__("dmb ish" ::: "memory")
+#define RTL_MEMORY_BARRIER() __asm__ __volatile__("dmb ish" ::: "memory")
+#elif defined(RTL_ARCH_ARM) && defined(__ARM_ARCH) && __ARM_ARCH >= 7
+#define RTL_ACQUIRE_BARRIER() __asm__ __volatile__("dmb ish" ::: "memory")
+#define RTL_RELEASE_BARRIER() __asm__ __volatile__("dmb ish" ::: "memory")
+#define RTL_MEMORY_BARRIER() __asm__ __volatile__("dmb ish" ::: "memory")
+#elif defined(RTL_ARCH_PPC)
+#define RTL_ACQUIRE_BARRIER() __asm__ __volatile__("lwsync" ::: "memory")
+#define RTL_RELEASE_BARRIER() __asm__ __volatile__("lwsync" ::: "memory")
+#define RTL_MEMORY_BARRIER() __asm__ __volatile__("sync" ::: "memory")
+#elif defined(RTL_ARCH_MIPS)
+#define RTL_ACQUIRE_BARRIER() __asm__ __volatile__("sync" ::: "memory")
+#define RTL_RELEASE_BARRIER() __asm__ __volatile__("sync" ::: "memory")
+#define RTL_MEMORY_BARRIER() __asm__ __volatile__("sync" ::: "memory")
+#else
+// Older ARM cores and anything else, let the compiler pick the fence
+#define RTL_ACQUIRE_BARRIER() __sync_synchronize()
+#define RTL_RELEASE_BARRIER() __sync_synchronize()
+#define RTL_MEMORY_BARRIER() __sync_synchronize()
+#endif
+
+#define RTL_HAS_MEMORY_BARRIERS
+
+#elif defined(_MSC_VER) && defined(RTL_ARCH_X86)
+
+#define RTL_COMPILER_BARRIER() _ReadWriteBarrier()
+#define RTL_ACQUIRE_BARRIER() _ReadWriteBarrier()
+#define RTL_RELEASE_BARRIER() _ReadWriteBarrier()
+#define RTL_MEMORY_BARRIER() _mm_mfence()
+
+#define RTL_HAS_MEMORY_BARRIERS
+
+#endif
+
+
+/*
+ * RTL_PREFETCH(ADDR, RW) hints that the cache line holding ADDR will soon be
+ * read (RW 0) or written (RW 1).  It never faults and compiles to nothing
+ * where the compiler has no prefetch intrinsic.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define RTL_PREFETCH(ADDR, RW) __builtin_prefetch((ADDR), (RW))
+#elif defined(_MSC_VER) && defined(RTL_ARCH_X86)
+#define RTL_PREFETCH(ADDR, RW) \
+  ((void)(RW), _mm_prefetch((const char*)(ADDR), _MM_HINT_T0))
+#else
+#define RTL_PREFETCH(ADDR, RW) ((void)(ADDR), (void)(RW))
+#endif
+
+
+/*
+ * rtl_msb64() returns the index (0..63) of the most significant bit set in
+ * a non-zero value, using the compiler's bit scan where there is one.
+ */
+static inline uint32_t rtl_msb64(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return 63U - (uint32_t)__builtin_clzll(x);
+#elif defined(_MSC_VER) && (defined(RTL_ARCH_X86_64) || defined(RTL_ARCH_ARM64))
+  unsigned long idx;
+  (void)_BitScanReverse64(&idx, x);
+  return (uint32_t)idx;
+#elif defined(_MSC_VER)
+  unsigned long idx;
+  if (_BitScanReverse(&idx, (unsigned long)(x >> 32))) {
+    return 32U + (uint32_t)idx;
+  }
+  (void)_BitScanReverse(&idx, (unsigned long)x);
+  return (uint32_t)idx;
+#else
+  uint32_t r = 0U;
+  uint32_t shift;
+  for (shift = 32U; shift != 0U; shift >>= 1U) {
+    if ((x >> shift) != 0U) {
+      x >>= shift;
+      r += shift;
+    }
+  }
+  return r;
+#endif
+}
+
 #ifdef __cplusplus
 }
 #endif  // __cplusplus
@@ -16,7 +16,9 @@
 #define RTL_RTL_H
 
 #include "memory.h"
+#include "pool.h"
 #include "pounds.h"
+#include "spsc.h"
 
 
 #ifdef __cplusplus
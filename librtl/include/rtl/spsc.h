@@ -0,0 +1,200 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RTL_SPSC_H
+#define RTL_SPSC_H
+
+#include <stdint.h>  // For uint32_t
+
+#include "pounds.h"  // For RTL_CACHE_LINE_SIZE
+
+/*
+ * C11 atomics are used when this is compiled as C11 or later and the
+ * compiler has them, otherwise volatile indexes and the barriers from
+ * pounds.h.  Define RTL_NO_STDATOMIC to always use the barriers.
+ *
+ * Both index types are a plain 32 bit word, so C, C11 and C++ code that
+ * include this header all agree on the layout of struct rtl_spsc.
+ */
+#if !defined(__cplusplus) && !defined(RTL_NO_STDATOMIC) && \
+    defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && \
+    !defined(__STDC_NO_ATOMICS__)
+#define RTL_SPSC_STDATOMIC
+#endif
+
+#if defined(RTL_SPSC_STDATOMIC)
+#include <stdatomic.h>
+typedef _Atomic uint32_t rtl_spsc_index;
+#else
+typedef volatile uint32_t rtl_spsc_index;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+/*!
+ * A lock-free single producer, single consumer (SPSC) byte ring buffer, the
+ * C counterpart of rtl::spsc_ringbuffer.
+ *
+ * Neither side ever blocks or disables interrupts, so one end can be an
+ * interrupt handler and the other a task.  The SPSC properties are up to
+ * the caller:
+ *
+ * 1) Only the producer may call rtl_spsc_write(), rtl_spsc_reserve() and
+ *    rtl_spsc_commit()
+ *
+ * 2) Only the consumer may call rtl_spsc_read(), rtl_spsc_peek() and
+ *    rtl_spsc_consume()
+ *
+ * Like rtl::spsc_ringbuffer the read and write indexes each sit on their
+ * own cache line so the two sides don't false share.  Put the struct on a
+ * RTL_CACHE_LINE_SIZE boundary to keep the buffer pointer off those lines
+ * too.
+ *
+ * It is a "one behind" ring buffer, a buffer of capacity bytes holds at
+ * most capacity - 1.  The buffer isn't owned by the ring buffer.
+ *
+ * The members are only to give the struct its size, don't touch them.
+ */
+struct rtl_spsc {
+  unsigned char* buf;
+  uint32_t capacity;
+  uint32_t writable_capacity;
+  unsigned char pad0[RTL_CACHE_LINE_SIZE];
+
+  //! Owned by the consumer, the next byte to read
+  rtl_spsc_index read_index;
+  unsigned char pad1[RTL_CACHE_LINE_SIZE - sizeof(uint32_t)];
+
+  //! Owned by the producer, the next byte to write
+  rtl_spsc_index write_index;
+  unsigned char pad2[RTL_CACHE_LINE_SIZE - sizeof(uint32_t)];
+};
+
+/*!
+ * \brief rtl_spsc_init sets up a ring buffer over buf
+ *
+ * Must be called before the producer or consumer use the ring buffer.
+ *
+ * This function returns:
+ *
+ * 0 on Success
+ * -1 if rb or buf is NULL
+ * -2 if capacity is less than 2
+ *
+ * \param rb the ring buffer
+ * \param buf the memory for the ring buffer to use
+ * \param capacity the size of buf, the ring buffer holds capacity - 1 bytes
+ * \return 0 on success, otherwise -1 or -2
+ */
+int rtl_spsc_init(struct rtl_spsc* rb, unsigned char* buf, uint32_t capacity);
+
+//! Returns the most bytes the ring buffer can hold (capacity - 1)
+uint32_t rtl_spsc_writable_capacity(const struct rtl_spsc* rb);
+
+/*!
+ * \brief rtl_spsc_approx_size returns the number of bytes in the ring buffer
+ *
+ * The size is approximate if the other side is running at the same time:
+ * smaller than the actual size while the producer writes, larger while the
+ * consumer reads.
+ */
+uint32_t rtl_spsc_approx_size(const struct rtl_spsc* rb);
+
+//! Returns 1 if the ring buffer is empty, otherwise 0
+int rtl_spsc_empty(const struct rtl_spsc* rb);
+
+/*!
+ * \brief rtl_spsc_write copies all sz bytes of input into the ring buffer
+ *
+ * Either all of input is written or none of it, the bytes may wrap around
+ * the end of the buffer.  Producer only.
+ *
+ * This function returns:
+ *
+ * 0 on Success (including when sz is 0)
+ * -1 if input is NULL
+ * -2 if there isn't room for sz bytes
+ *
+ * \param rb the ring buffer
+ * \param input the bytes to write
+ * \param sz the number of bytes to write
+ * \return 0 on success, otherwise -1 or -2
+ */
+int rtl_spsc_write(struct rtl_spsc* rb, const unsigned char* input,
+                   uint32_t sz);
+
+/*!
+ * \brief rtl_spsc_read copies up to max_read bytes out of the ring buffer
+ *
+ * Consumer only.
+ *
+ * \param rb the ring buffer
+ * \param output where to copy the bytes to, must hold max_read bytes
+ * \param max_read the most bytes to read
+ * \return the number of bytes read, 0 if output is NULL
+ */
+uint32_t rtl_spsc_read(struct rtl_spsc* rb, unsigned char* output,
+                       uint32_t max_read);
+
+/*!
+ * \brief rtl_spsc_reserve returns contiguous space to write into in place
+ *
+ * On entry *sz is the number of bytes wanted, on return it is the number
+ * that may be written to the returned pointer, which can be less (or 0)
+ * when the free space wraps around the end of the buffer or the consumer
+ * is behind.  Nothing becomes visible to the consumer until
+ * rtl_spsc_commit().  Producer only.
+ *
+ * \param rb the ring buffer
+ * \param sz the number of bytes wanted, set to the number available
+ * \return where to write the bytes
+ */
+unsigned char* rtl_spsc_reserve(struct rtl_spsc* rb, uint32_t* sz);
+
+/*!
+ * \brief rtl_spsc_commit publishes sz bytes written after rtl_spsc_reserve()
+ *
+ * sz must not be larger than the size rtl_spsc_reserve() returned.
+ * Producer only.
+ */
+void rtl_spsc_commit(struct rtl_spsc* rb, uint32_t sz);
+
+/*!
+ * \brief rtl_spsc_peek returns contiguous bytes to read in place
+ *
+ * On entry *sz is the number of bytes wanted, on return it is the number
+ * that may be read from the returned pointer.  The bytes stay in the ring
+ * buffer until rtl_spsc_consume().  Consumer only.
+ *
+ * \param rb the ring buffer
+ * \param sz the number of bytes wanted, set to the number available
+ * \return where to read the bytes from
+ */
+const unsigned char* rtl_spsc_peek(struct rtl_spsc* rb, uint32_t* sz);
+
+/*!
+ * \brief rtl_spsc_consume releases sz bytes read after rtl_spsc_peek()
+ *
+ * sz must not be larger than the size rtl_spsc_peek() returned.  Consumer
+ * only.
+ */
+void rtl_spsc_consume(struct rtl_spsc* rb, uint32_t sz);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+
+#endif  // RTL_SPSC_H
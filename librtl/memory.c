@@ -12,6 +12,10 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include "memory.incl"
+// With RTL_HEADER_ONLY every user compiles the TLSF functions in through
+// rtl/memory.h, so librtl doesn't need its own copy
+#if !defined(RTL_HEADER_ONLY)
+#include "rtl/memory.incl"
+#endif
 
 typedef int make_iso_compilers_quiet;
@@ -0,0 +1,186 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rtl/pool.h"
+
+#include <stdint.h>  // For SIZE_MAX, intmax_t and uintptr_t
+
+// The pool header only needs to be aligned like a pointer
+struct pool_header_alignment_struct {
+  char c;
+  void* vptr;
+};
+
+#define POOL_HEADER_ALIGNMENT \
+  (offsetof(struct pool_header_alignment_struct, vptr))
+
+// Blocks are aligned for any fundamental type, the same union memory.incl
+// takes its ALIGNMENT_REQUIREMENT from
+struct pool_alignment_struct {
+  char c;
+  union {
+    intmax_t imax;
+    long double ldbl;
+    void* vptr;
+    void (*fptr)(void);
+  } u;
+};
+
+#define POOL_ALIGNMENT (offsetof(struct pool_alignment_struct, u))
+
+struct pool_free_block {
+  struct pool_free_block* next;
+};
+
+struct rtl_pool {
+  //! Blocks that were freed, most recent first
+  struct pool_free_block* free_list;
+  //! The first block
+  unsigned char* blocks;
+  size_t block_size;
+  size_t num_blocks;
+  //! Blocks from here on were never handed out and aren't on free_list
+  size_t untouched;
+  size_t free_blocks;
+};
+
+// The header plus the most that aligning the first block can skip, when
+// the memory is only aligned like a pointer
+static size_t pool_header_size(void) {
+  return sizeof(struct rtl_pool) + POOL_ALIGNMENT - POOL_HEADER_ALIGNMENT;
+}
+
+static size_t pool_round_block_size(size_t block_size) {
+  if (block_size < sizeof(struct pool_free_block)) {
+    block_size = sizeof(struct pool_free_block);
+  }
+  if (block_size > SIZE_MAX - POOL_ALIGNMENT) {
+    return 0U;
+  }
+  return rtl_align(POOL_ALIGNMENT, block_size);
+}
+
+size_t rtl_pool_buffer_size(size_t block_size, size_t num_blocks) {
+  size_t rounded = pool_round_block_size(block_size);
+  if (rounded == 0U || num_blocks > (SIZE_MAX - pool_header_size()) / rounded) {
+    return 0U;
+  }
+  return pool_header_size() + rounded * num_blocks;
+}
+
+size_t rtl_pool_block_alignment(void) { return POOL_ALIGNMENT; }
+
+int rtl_pool_make(struct rtl_pool** pool, void* memory, size_t sz,
+                  size_t block_size) {
+  struct rtl_pool* pool_ptr;
+  size_t rounded;
+  size_t offset;
+
+  if (pool == NULL || memory == NULL) {
+    return -1;
+  }
+
+  if (!RTL_PTR_IS_ALIGNED(memory, POOL_HEADER_ALIGNMENT)) {
+    return -2;
+  }
+
+  // The blocks start at the first POOL_ALIGNMENT boundary after the header
+  offset = (size_t)((uintptr_t)memory + sizeof(struct rtl_pool));
+  offset = rtl_align(POOL_ALIGNMENT, offset) - (size_t)(uintptr_t)memory;
+
+  rounded = pool_round_block_size(block_size);
+  if (rounded == 0U || sz < offset || sz - offset < rounded) {
+    return -3;
+  }
+
+  pool_ptr = (struct rtl_pool*)memory;
+  pool_ptr->free_list = NULL;
+  pool_ptr->blocks = (unsigned char*)memory + offset;
+  pool_ptr->block_size = rounded;
+  pool_ptr->num_blocks = (sz - offset) / rounded;
+  pool_ptr->untouched = 0U;
+  pool_ptr->free_blocks = pool_ptr->num_blocks;
+
+  *pool = pool_ptr;
+  return 0;
+}
+
+int rtl_pool_make_from_arena(struct rtl_pool** pool,
+                             struct rtl_tlsf_arena* arena, size_t block_size,
+                             size_t num_blocks) {
+  size_t sz;
+  void* memory;
+
+  if (pool == NULL || arena == NULL) {
+    return -1;
+  }
+
+  sz = rtl_pool_buffer_size(block_size, num_blocks);
+  if (num_blocks == 0U || sz == 0U) {
+    return -3;
+  }
+
+  memory = rtl_tlsf_alloc(arena, sz);
+  if (memory == NULL) {
+    return -5;
+  }
+
+  if (rtl_pool_make(pool, memory, sz, block_size) != 0) {
+    // The arena handed out memory it shouldn't have
+    rtl_tlsf_free(arena, memory);
+    return -5;
+  }
+  return 0;
+}
+
+void* rtl_pool_alloc(struct rtl_pool* pool) {
+  struct pool_free_block* blk = pool->free_list;
+
+  if (blk != NULL) {
+    pool->free_list = blk->next;
+  } else if (pool->untouched < pool->num_blocks) {
+    blk = (struct pool_free_block*)(pool->blocks +
+                                    pool->untouched * pool->block_size);
+    pool->untouched++;
+  } else {
+    return NULL;
+  }
+
+  pool->free_blocks--;
+  return blk;
+}
+
+void rtl_pool_free(struct rtl_pool* pool, void* ptr) {
+  struct pool_free_block* blk = (struct pool_free_block*)ptr;
+
+  if (blk == NULL) {
+    return;
+  }
+
+  blk->next = pool->free_list;
+  pool->free_list = blk;
+  pool->free_blocks++;
+}
+
+size_t rtl_pool_block_size(const struct rtl_pool* pool) {
+  return pool->block_size;
+}
+
+size_t rtl_pool_num_blocks(const struct rtl_pool* pool) {
+  return pool->num_blocks;
+}
+
+size_t rtl_pool_free_blocks(const struct rtl_pool* pool) {
+  return pool->free_blocks;
+}
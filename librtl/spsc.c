@@ -0,0 +1,232 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rtl/spsc.h"
+
+#include <string.h>  // For memcpy
+
+// struct rtl_spsc must look the same whichever index type was used
+RTL_C_STATIC_ASSERT(sizeof(rtl_spsc_index) == sizeof(uint32_t),
+                    rtl_spsc_index_is_a_word);
+
+#if defined(RTL_SPSC_STDATOMIC)
+
+static uint32_t load_relaxed(const rtl_spsc_index* index) {
+  return atomic_load_explicit(index, memory_order_relaxed);
+}
+
+static uint32_t load_acquire(const rtl_spsc_index* index) {
+  return atomic_load_explicit(index, memory_order_acquire);
+}
+
+static void store_release(rtl_spsc_index* index, uint32_t value) {
+  atomic_store_explicit(index, value, memory_order_release);
+}
+
+#elif defined(RTL_HAS_MEMORY_BARRIERS)
+
+// An aligned 32 bit volatile access is a single load or store everywhere
+// librtl runs, the barriers give it the ordering
+
+static uint32_t load_relaxed(const rtl_spsc_index* index) { return *index; }
+
+static uint32_t load_acquire(const rtl_spsc_index* index) {
+  uint32_t value = *index;
+  RTL_ACQUIRE_BARRIER();
+  return value;
+}
+
+static void store_release(rtl_spsc_index* index, uint32_t value) {
+  RTL_RELEASE_BARRIER();
+  *index = value;
+}
+
+#else
+#error "rtl_spsc needs <stdatomic.h> or memory barriers from pounds.h"
+#endif
+
+static uint32_t advance(const struct rtl_spsc* rb, uint32_t index,
+                        uint32_t sz) {
+  // sz is never more than the capacity, so one subtraction wraps it
+  index += sz;
+  if (index >= rb->capacity) {
+    index -= rb->capacity;
+  }
+  return index;
+}
+
+static uint32_t bytes_written(const struct rtl_spsc* rb, uint32_t write_index,
+                              uint32_t read_index) {
+  if (write_index >= read_index) {
+    return write_index - read_index;
+  }
+  return rb->capacity - read_index + write_index;
+}
+
+int rtl_spsc_init(struct rtl_spsc* rb, unsigned char* buf, uint32_t capacity) {
+  if (rb == NULL || buf == NULL) {
+    return -1;
+  }
+  if (capacity < 2U) {
+    return -2;
+  }
+
+  rb->buf = buf;
+  rb->capacity = capacity;
+  rb->writable_capacity = capacity - 1U;
+#if defined(RTL_SPSC_STDATOMIC)
+  atomic_init(&rb->read_index, 0U);
+  atomic_init(&rb->write_index, 0U);
+#else
+  rb->read_index = 0U;
+  rb->write_index = 0U;
+#endif
+  return 0;
+}
+
+uint32_t rtl_spsc_writable_capacity(const struct rtl_spsc* rb) {
+  return rb->writable_capacity;
+}
+
+uint32_t rtl_spsc_approx_size(const struct rtl_spsc* rb) {
+  uint32_t write_index = load_acquire(&rb->write_index);
+  uint32_t read_index = load_acquire(&rb->read_index);
+  return bytes_written(rb, write_index, read_index);
+}
+
+int rtl_spsc_empty(const struct rtl_spsc* rb) {
+  return load_acquire(&rb->read_index) == load_acquire(&rb->write_index);
+}
+
+int rtl_spsc_write(struct rtl_spsc* rb, const unsigned char* input,
+                   uint32_t sz) {
+  uint32_t write_index;
+  uint32_t read_index;
+  uint32_t until_end;
+
+  if (sz == 0U) {
+    return 0;
+  }
+  if (input == NULL) {
+    return -1;
+  }
+
+  write_index = load_relaxed(&rb->write_index);
+  // Acquire so the bytes the consumer read are done with before reuse
+  read_index = load_acquire(&rb->read_index);
+
+  if (sz > rb->writable_capacity - bytes_written(rb, write_index, read_index)) {
+    return -2;
+  }
+
+  until_end = rb->capacity - write_index;
+  if (sz <= until_end) {
+    (void)memcpy(&rb->buf[write_index], input, sz);
+  } else {
+    (void)memcpy(&rb->buf[write_index], input, until_end);
+    (void)memcpy(&rb->buf[0], input + until_end, sz - until_end);
+  }
+
+  store_release(&rb->write_index, advance(rb, write_index, sz));
+  return 0;
+}
+
+uint32_t rtl_spsc_read(struct rtl_spsc* rb, unsigned char* output,
+                       uint32_t max_read) {
+  uint32_t write_index;
+  uint32_t read_index;
+  uint32_t sz;
+  uint32_t until_end;
+
+  if (output == NULL) {
+    return 0U;
+  }
+
+  read_index = load_relaxed(&rb->read_index);
+  write_index = load_acquire(&rb->write_index);
+
+  sz = bytes_written(rb, write_index, read_index);
+  if (sz > max_read) {
+    sz = max_read;
+  }
+  if (sz == 0U) {
+    return 0U;
+  }
+
+  until_end = rb->capacity - read_index;
+  if (sz <= until_end) {
+    (void)memcpy(output, &rb->buf[read_index], sz);
+  } else {
+    (void)memcpy(output, &rb->buf[read_index], until_end);
+    (void)memcpy(output + until_end, &rb->buf[0], sz - until_end);
+  }
+
+  store_release(&rb->read_index, advance(rb, read_index, sz));
+  return sz;
+}
+
+unsigned char* rtl_spsc_reserve(struct rtl_spsc* rb, uint32_t* sz) {
+  uint32_t write_index = load_relaxed(&rb->write_index);
+  uint32_t read_index = load_acquire(&rb->read_index);
+  uint32_t contiguous;
+
+  if (write_index >= read_index) {
+    // Up to the end of the buffer, but the last byte is only free if the
+    // write index doesn't wrap onto the read index
+    contiguous = rb->capacity - write_index;
+    if (read_index == 0U) {
+      contiguous--;
+    }
+  } else {
+    contiguous = read_index - write_index - 1U;
+  }
+
+  if (contiguous < *sz) {
+    *sz = contiguous;
+  }
+  return &rb->buf[write_index];
+}
+
+void rtl_spsc_commit(struct rtl_spsc* rb, uint32_t sz) {
+  if (sz == 0U) {
+    return;
+  }
+  store_release(&rb->write_index,
+                advance(rb, load_relaxed(&rb->write_index), sz));
+}
+
+const unsigned char* rtl_spsc_peek(struct rtl_spsc* rb, uint32_t* sz) {
+  uint32_t read_index = load_relaxed(&rb->read_index);
+  uint32_t write_index = load_acquire(&rb->write_index);
+  uint32_t contiguous;
+
+  if (write_index >= read_index) {
+    contiguous = write_index - read_index;
+  } else {
+    contiguous = rb->capacity - read_index;
+  }
+
+  if (contiguous < *sz) {
+    *sz = contiguous;
+  }
+  return &rb->buf[read_index];
+}
+
+void rtl_spsc_consume(struct rtl_spsc* rb, uint32_t sz) {
+  if (sz == 0U) {
+    return;
+  }
+  store_release(&rb->read_index,
+                advance(rb, load_relaxed(&rb->read_index), sz));
+}
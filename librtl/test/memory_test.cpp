@@ -13,7 +13,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include "memory.incl"
+#include "rtl/memory.incl"
+#include <sys/mman.h>
 #include <cstring>
 #include <iostream>
 
@@ -340,6 +341,93 @@ TEST_F(UniquePointerTests, ArenaSmokeTest) {
   delete[] buf;
 }
 
+TEST_F(UniquePointerTests, StatsTest) {
+  struct rtl_tlsf_arena* arena{nullptr};
+  struct rtl_tlsf_stats stats;
+
+  const RTL_UWORD sz = 16384;
+  char* buf = new char[sz];
+
+  ASSERT_EQ(rtl_tlsf_make_arena(&arena, buf, sz), 0);
+
+  ASSERT_EQ(rtl_tlsf_get_stats(NULL, &stats), -1);
+  ASSERT_EQ(rtl_tlsf_get_stats(arena, NULL), -1);
+
+  ASSERT_EQ(rtl_tlsf_get_stats(arena, &stats), 0);
+  const size_t total = stats.total_bytes;
+  ASSERT_GT(total, 0U);
+  ASSERT_LE(total, sz - sizeof(rtl_tlsf_arena));
+  ASSERT_EQ(stats.free_bytes, total);
+  ASSERT_EQ(stats.used_bytes, 0U);
+  ASSERT_EQ(stats.free_blocks, 1U);
+  ASSERT_EQ(stats.used_blocks, 0U);
+  ASSERT_EQ(stats.largest_free_block, total - START_OF_USER_DATA_OFFSET);
+
+  void* ptrs[4];
+  for (int i = 0; i < 4; i++) {
+    ptrs[i] = rtl_tlsf_alloc(arena, 100);
+    ASSERT_NE(ptrs[i], nullptr);
+  }
+
+  ASSERT_EQ(rtl_tlsf_get_stats(arena, &stats), 0);
+  ASSERT_EQ(stats.total_bytes, total);
+  ASSERT_EQ(stats.used_blocks, 4U);
+  ASSERT_EQ(stats.free_blocks, 1U);
+  ASSERT_EQ(stats.free_bytes + stats.used_bytes, total);
+  ASSERT_GE(stats.used_bytes, 4U * 100U);
+
+  // Freeing every other block leaves holes that can't merge
+  rtl_tlsf_free(arena, ptrs[0]);
+  rtl_tlsf_free(arena, ptrs[2]);
+
+  ASSERT_EQ(rtl_tlsf_get_stats(arena, &stats), 0);
+  ASSERT_EQ(stats.used_blocks, 2U);
+  ASSERT_EQ(stats.free_blocks, 3U);
+  ASSERT_EQ(stats.free_bytes + stats.used_bytes, total);
+  ASSERT_LT(stats.largest_free_block, stats.free_bytes);
+
+  rtl_tlsf_free(arena, ptrs[1]);
+  rtl_tlsf_free(arena, ptrs[3]);
+
+  ASSERT_EQ(rtl_tlsf_get_stats(arena, &stats), 0);
+  ASSERT_EQ(stats.free_blocks, 1U);
+  ASSERT_EQ(stats.free_bytes, total);
+  ASSERT_EQ(stats.largest_free_block, total - START_OF_USER_DATA_OFFSET);
+
+  delete[] buf;
+}
+
+TEST_F(UniquePointerTests, MaximumArenaTest) {
+  struct rtl_tlsf_arena* arena{nullptr};
+  const size_t max_sz = rtl_tlsf_maximum_arena_size();
+
+  // Only the ends of the buffer are touched, so reserve the address space
+  // without committing memory.  64 bit targets have a maximum larger than
+  // any address space, those can't run this.
+  const size_t sz = max_sz + ALIGNMENT_REQUIREMENT;
+  void* map = mmap(nullptr, sz, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (map == MAP_FAILED) {
+    GTEST_SKIP() << "Can't reserve " << sz << " bytes of address space";
+  }
+  char* buf = static_cast<char*>(map);
+
+  ASSERT_EQ(rtl_tlsf_make_arena(&arena, buf, sz), -4);
+  ASSERT_EQ(rtl_tlsf_make_arena(&arena, buf, max_sz + 1U), -4);
+  ASSERT_EQ(rtl_tlsf_make_arena(&arena, buf, max_sz), 0);
+
+  struct rtl_tlsf_stats stats;
+  ASSERT_EQ(rtl_tlsf_get_stats(arena, &stats), 0);
+  ASSERT_LT(stats.total_bytes, MAXIMUM_BLOCK_SIZE);
+  ASSERT_EQ(stats.free_blocks, 1U);
+
+  void* ptr = rtl_tlsf_alloc(arena, 100);
+  ASSERT_NE(ptr, nullptr);
+  rtl_tlsf_free(arena, ptr);
+
+  ASSERT_EQ(munmap(map, sz), 0);
+}
+
 TEST_F(UniquePointerTests, temptest) {
     ASSERT_TRUE(safe_to_cast_to_rtl_uword(4294967295));
 }
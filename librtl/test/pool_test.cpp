@@ -0,0 +1,175 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <set>
+#include <vector>
+
+#include "rtl/pool.h"
+
+struct PoolDescriptor {
+  uint64_t m_id;
+  uint32_t m_flags;
+  void* m_data;
+};
+
+TEST(PoolTest, MakeTest) {
+  alignas(64) unsigned char buf[1024];
+  struct rtl_pool* pool = NULL;
+
+  ASSERT_EQ(-1, rtl_pool_make(NULL, buf, sizeof(buf), 16U));
+  ASSERT_EQ(-1, rtl_pool_make(&pool, NULL, sizeof(buf), 16U));
+  ASSERT_EQ(-2, rtl_pool_make(&pool, buf + 1, sizeof(buf) - 1U, 16U));
+  ASSERT_EQ(-3, rtl_pool_make(&pool, buf, 8U, 16U));
+  ASSERT_EQ(-3, rtl_pool_make(&pool, buf, sizeof(buf), SIZE_MAX));
+  ASSERT_EQ(nullptr, pool);
+
+  size_t sz = rtl_pool_buffer_size(sizeof(PoolDescriptor), 10U);
+  ASSERT_GT(sz, 10U * sizeof(PoolDescriptor));
+  ASSERT_LE(sz, sizeof(buf));
+  ASSERT_EQ(0U, rtl_pool_buffer_size(SIZE_MAX / 2U, 4U));
+
+  ASSERT_EQ(0, rtl_pool_make(&pool, buf, sz, sizeof(PoolDescriptor)));
+  ASSERT_EQ(10U, rtl_pool_num_blocks(pool));
+  ASSERT_EQ(10U, rtl_pool_free_blocks(pool));
+  ASSERT_GE(rtl_pool_block_size(pool), sizeof(PoolDescriptor));
+
+  // Tiny blocks still hold the free list link
+  ASSERT_EQ(0, rtl_pool_make(&pool, buf, sizeof(buf), 1U));
+  ASSERT_GE(rtl_pool_block_size(pool), sizeof(void*));
+}
+
+TEST(PoolTest, AllocFreeTest) {
+  const size_t kBlocks = 64U;
+  size_t sz = rtl_pool_buffer_size(sizeof(PoolDescriptor), kBlocks);
+  std::vector<uint64_t> buf(sz / sizeof(uint64_t) + 1U);
+  struct rtl_pool* pool = NULL;
+  ASSERT_EQ(0, rtl_pool_make(&pool, buf.data(), sz, sizeof(PoolDescriptor)));
+
+  const size_t block_size = rtl_pool_block_size(pool);
+  const unsigned char* begin = reinterpret_cast<unsigned char*>(buf.data());
+  const unsigned char* end = begin + sz;
+
+  std::set<void*> seen;
+  std::vector<PoolDescriptor*> live;
+  for (size_t i = 0U; i < kBlocks; i++) {
+    PoolDescriptor* d = static_cast<PoolDescriptor*>(rtl_pool_alloc(pool));
+    ASSERT_NE(nullptr, d);
+    ASSERT_TRUE(seen.insert(d).second);
+    ASSERT_GE(reinterpret_cast<unsigned char*>(d), begin);
+    ASSERT_LE(reinterpret_cast<unsigned char*>(d) + block_size, end);
+    ASSERT_EQ(0U, reinterpret_cast<uintptr_t>(d) % alignof(PoolDescriptor));
+    d->m_id = i;
+    d->m_flags = 0U;
+    d->m_data = d;
+    live.push_back(d);
+  }
+  ASSERT_EQ(0U, rtl_pool_free_blocks(pool));
+  ASSERT_EQ(nullptr, rtl_pool_alloc(pool));
+
+  // Nothing overlapped
+  for (size_t i = 0U; i < kBlocks; i++) {
+    ASSERT_EQ(i, live[i]->m_id);
+    ASSERT_EQ(live[i], live[i]->m_data);
+  }
+
+  rtl_pool_free(pool, NULL);
+  for (size_t i = 0U; i < kBlocks; i += 2U) {
+    rtl_pool_free(pool, live[i]);
+  }
+  ASSERT_EQ(kBlocks / 2U, rtl_pool_free_blocks(pool));
+
+  // Freed blocks are reused, most recent first
+  ASSERT_EQ(live[kBlocks - 2U], rtl_pool_alloc(pool));
+  for (size_t i = 1U; i < kBlocks / 2U; i++) {
+    void* p = rtl_pool_alloc(pool);
+    ASSERT_NE(nullptr, p);
+    ASSERT_EQ(1U, seen.count(p));
+  }
+  ASSERT_EQ(nullptr, rtl_pool_alloc(pool));
+}
+
+// The strictest alignment of a fundamental type, like ALIGNMENT_REQUIREMENT
+// in memory.incl
+union PoolMaxAlign {
+  intmax_t m_imax;
+  long double m_ldbl;
+  void* m_vptr;
+  void (*m_fptr)(void);
+};
+
+TEST(PoolTest, BlockAlignmentTest) {
+  const size_t kAlign = rtl_pool_block_alignment();
+  ASSERT_EQ(alignof(PoolMaxAlign), kAlign);
+  ASSERT_GE(kAlign, alignof(long double));
+  ASSERT_GE(kAlign, alignof(uint64_t));
+  ASSERT_GE(kAlign, alignof(double));
+
+  // Buffers that are only aligned like a pointer still give aligned blocks
+  const size_t kBlocks = 8U;
+  alignas(64) unsigned char buf[1024];
+  for (size_t shift = 0U; shift < 64U; shift += sizeof(void*)) {
+    for (size_t block_size = 1U; block_size <= 3U * kAlign; block_size++) {
+      size_t sz = rtl_pool_buffer_size(block_size, kBlocks);
+      ASSERT_LE(shift + sz, sizeof(buf));
+      struct rtl_pool* pool = NULL;
+      ASSERT_EQ(0, rtl_pool_make(&pool, buf + shift, sz, block_size));
+      ASSERT_EQ(kBlocks, rtl_pool_num_blocks(pool));
+      ASSERT_EQ(0U, rtl_pool_block_size(pool) % kAlign);
+      for (size_t i = 0U; i < kBlocks; i++) {
+        void* p = rtl_pool_alloc(pool);
+        ASSERT_NE(nullptr, p);
+        ASSERT_EQ(0U, reinterpret_cast<uintptr_t>(p) % kAlign);
+      }
+    }
+  }
+}
+
+TEST(PoolTest, ArenaTest) {
+  const size_t kArenaSize = 64U * 1024U;
+  void* mem = std::malloc(kArenaSize);
+  ASSERT_NE(nullptr, mem);
+  struct rtl_tlsf_arena* arena = NULL;
+  ASSERT_EQ(0, rtl_tlsf_make_arena(&arena, mem, kArenaSize));
+
+  struct rtl_pool* pool = NULL;
+  ASSERT_EQ(-1, rtl_pool_make_from_arena(NULL, arena, 32U, 16U));
+  ASSERT_EQ(-1, rtl_pool_make_from_arena(&pool, NULL, 32U, 16U));
+  ASSERT_EQ(-3, rtl_pool_make_from_arena(&pool, arena, 32U, 0U));
+  ASSERT_EQ(-5, rtl_pool_make_from_arena(&pool, arena, 32U, kArenaSize));
+
+  ASSERT_EQ(0, rtl_pool_make_from_arena(&pool, arena, 32U, 100U));
+  ASSERT_EQ(100U, rtl_pool_num_blocks(pool));
+  void* a = rtl_pool_alloc(pool);
+  void* b = rtl_pool_alloc(pool);
+  ASSERT_NE(nullptr, a);
+  ASSERT_NE(nullptr, b);
+  ASSERT_EQ(0U, reinterpret_cast<uintptr_t>(a) % rtl_pool_block_alignment());
+  ASSERT_EQ(0U, reinterpret_cast<uintptr_t>(b) % rtl_pool_block_alignment());
+  rtl_pool_free(pool, a);
+  rtl_pool_free(pool, b);
+
+  struct rtl_tlsf_stats before;
+  ASSERT_EQ(0, rtl_tlsf_get_stats(arena, &before));
+  rtl_tlsf_free(arena, pool);
+  struct rtl_tlsf_stats after;
+  ASSERT_EQ(0, rtl_tlsf_get_stats(arena, &after));
+  ASSERT_EQ(0U, after.used_blocks);
+  ASSERT_GT(after.free_bytes, before.free_bytes);
+
+  std::free(mem);
+}
@@ -0,0 +1,177 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "rtl/spsc.h"
+
+TEST(SPSCTest, InitTest) {
+  unsigned char buf[8];
+  struct rtl_spsc rb;
+
+  ASSERT_EQ(-1, rtl_spsc_init(NULL, buf, sizeof(buf)));
+  ASSERT_EQ(-1, rtl_spsc_init(&rb, NULL, sizeof(buf)));
+  ASSERT_EQ(-2, rtl_spsc_init(&rb, buf, 1U));
+  ASSERT_EQ(0, rtl_spsc_init(&rb, buf, sizeof(buf)));
+
+  ASSERT_EQ(7U, rtl_spsc_writable_capacity(&rb));
+  ASSERT_EQ(0U, rtl_spsc_approx_size(&rb));
+  ASSERT_EQ(1, rtl_spsc_empty(&rb));
+
+  // The indexes never share a cache line
+  ASSERT_GE(offsetof(struct rtl_spsc, write_index) -
+                offsetof(struct rtl_spsc, read_index),
+            static_cast<size_t>(RTL_CACHE_LINE_SIZE));
+  ASSERT_GE(offsetof(struct rtl_spsc, read_index) -
+                offsetof(struct rtl_spsc, writable_capacity),
+            static_cast<size_t>(RTL_CACHE_LINE_SIZE));
+}
+
+TEST(SPSCTest, WriteReadTest) {
+  unsigned char buf[8];
+  struct rtl_spsc rb;
+  ASSERT_EQ(0, rtl_spsc_init(&rb, buf, sizeof(buf)));
+
+  const unsigned char in[] = {1, 2, 3, 4, 5, 6, 7, 8};
+  unsigned char out[8] = {0};
+
+  ASSERT_EQ(0, rtl_spsc_write(&rb, in, 0U));
+  ASSERT_EQ(-1, rtl_spsc_write(&rb, NULL, 1U));
+  // All or nothing
+  ASSERT_EQ(-2, rtl_spsc_write(&rb, in, 8U));
+  ASSERT_EQ(1, rtl_spsc_empty(&rb));
+
+  ASSERT_EQ(0, rtl_spsc_write(&rb, in, 5U));
+  ASSERT_EQ(5U, rtl_spsc_approx_size(&rb));
+  ASSERT_EQ(-2, rtl_spsc_write(&rb, in, 3U));
+  ASSERT_EQ(0U, rtl_spsc_read(&rb, NULL, 5U));
+
+  ASSERT_EQ(3U, rtl_spsc_read(&rb, out, 3U));
+  ASSERT_EQ(0, std::memcmp(in, out, 3U));
+
+  // Wraps around the end of the buffer
+  ASSERT_EQ(0, rtl_spsc_write(&rb, in + 2, 5U));
+  ASSERT_EQ(7U, rtl_spsc_approx_size(&rb));
+  ASSERT_EQ(7U, rtl_spsc_read(&rb, out, sizeof(out)));
+  const unsigned char expected[] = {4, 5, 3, 4, 5, 6, 7};
+  ASSERT_EQ(0, std::memcmp(expected, out, sizeof(expected)));
+
+  ASSERT_EQ(1, rtl_spsc_empty(&rb));
+  ASSERT_EQ(0U, rtl_spsc_read(&rb, out, sizeof(out)));
+}
+
+TEST(SPSCTest, ReserveCommitTest) {
+  unsigned char buf[8];
+  struct rtl_spsc rb;
+  ASSERT_EQ(0, rtl_spsc_init(&rb, buf, sizeof(buf)));
+
+  // Read index at 0, so the last byte can't be used
+  uint32_t sz = 100U;
+  unsigned char* w = rtl_spsc_reserve(&rb, &sz);
+  ASSERT_EQ(buf, w);
+  ASSERT_EQ(7U, sz);
+
+  sz = 3U;
+  w = rtl_spsc_reserve(&rb, &sz);
+  ASSERT_EQ(3U, sz);
+  w[0] = 10;
+  w[1] = 11;
+  w[2] = 12;
+  // Nothing is visible before the commit
+  ASSERT_EQ(1, rtl_spsc_empty(&rb));
+  rtl_spsc_commit(&rb, 3U);
+  ASSERT_EQ(3U, rtl_spsc_approx_size(&rb));
+
+  sz = 100U;
+  const unsigned char* r = rtl_spsc_peek(&rb, &sz);
+  ASSERT_EQ(3U, sz);
+  ASSERT_EQ(10, r[0]);
+  ASSERT_EQ(12, r[2]);
+  rtl_spsc_consume(&rb, 2U);
+  ASSERT_EQ(1U, rtl_spsc_approx_size(&rb));
+
+  // Free space runs to the end of the buffer and then wraps
+  sz = 100U;
+  w = rtl_spsc_reserve(&rb, &sz);
+  ASSERT_EQ(&buf[3], w);
+  ASSERT_EQ(5U, sz);
+  rtl_spsc_commit(&rb, 5U);
+
+  sz = 100U;
+  w = rtl_spsc_reserve(&rb, &sz);
+  ASSERT_EQ(&buf[0], w);
+  ASSERT_EQ(1U, sz);
+  rtl_spsc_commit(&rb, 1U);
+  ASSERT_EQ(7U, rtl_spsc_approx_size(&rb));
+
+  // Full
+  sz = 1U;
+  (void)rtl_spsc_reserve(&rb, &sz);
+  ASSERT_EQ(0U, sz);
+
+  // Readable bytes stop at the end of the buffer
+  sz = 100U;
+  r = rtl_spsc_peek(&rb, &sz);
+  ASSERT_EQ(&buf[2], r);
+  ASSERT_EQ(6U, sz);
+  rtl_spsc_consume(&rb, 6U);
+
+  sz = 100U;
+  r = rtl_spsc_peek(&rb, &sz);
+  ASSERT_EQ(&buf[0], r);
+  ASSERT_EQ(1U, sz);
+  rtl_spsc_consume(&rb, 1U);
+  ASSERT_EQ(1, rtl_spsc_empty(&rb));
+}
+
+TEST(SPSCTest, ThreadedTest) {
+  // An odd capacity so messages keep straddling the end of the buffer
+  std::vector<unsigned char> buf(1001U);
+  struct rtl_spsc rb;
+  ASSERT_EQ(0, rtl_spsc_init(&rb, buf.data(), 1001U));
+
+  const uint32_t kMessages = 200000U;
+
+  std::thread producer([&rb, kMessages]() {
+    for (uint32_t i = 0U; i < kMessages; i++) {
+      while (rtl_spsc_write(&rb, reinterpret_cast<unsigned char*>(&i),
+                            sizeof(i)) != 0) {
+      }
+    }
+  });
+
+  uint32_t expected = 0U;
+  bool in_order = true;
+  unsigned char bytes[sizeof(uint32_t)];
+  uint32_t have = 0U;
+  while (expected < kMessages) {
+    have += rtl_spsc_read(&rb, bytes + have, sizeof(bytes) - have);
+    if (have == sizeof(bytes)) {
+      uint32_t v;
+      std::memcpy(&v, bytes, sizeof(v));
+      in_order = in_order && v == expected;
+      expected++;
+      have = 0U;
+    }
+  }
+  producer.join();
+
+  ASSERT_TRUE(in_order);
+  ASSERT_EQ(1, rtl_spsc_empty(&rb));
+}
@@ -20,6 +20,11 @@
 
 #include "rtlcpp/utility.hpp"
 
+// With RTL_HEADER_ONLY allocator.hpp already has these inline
+#if !defined(RTL_HEADER_ONLY)
+#include "rtlcpp/allocator_impl.hpp"
+#endif
+
 namespace rtl {
 
 MMapMemoryResource::MMapMemoryResource(MMapMemoryResource&& o) noexcept
@@ -74,67 +79,4 @@ void MMapMemoryResource::uninit() {
   m_initialized = false;
 }
 
-namespace detail {
-
-RTAllocator::RTAllocator(RTAllocator&& o) noexcept
-    : m_initialized(rtl::exchange(o.m_initialized, false)),
-      m_arena(rtl::exchange(o.m_arena, nullptr)),
-      m_buf(rtl::exchange(o.m_buf, nullptr)),
-      m_capacity(rtl::exchange(o.m_capacity, 0)) {}
-
-RTAllocator& RTAllocator::operator=(RTAllocator&& o) noexcept {
-  if (this != &o) {
-    m_initialized = rtl::exchange(o.m_initialized, false);
-    m_arena = rtl::exchange(o.m_arena, nullptr);
-    m_buf = rtl::exchange(o.m_buf, nullptr);
-    m_capacity = rtl::exchange(o.m_capacity, 0);
-  }
-  return *this;
-}
-
-void* RTAllocator::allocate(std::size_t bytes) {
-  assert(m_initialized);
-  return rtl_tlsf_alloc(m_arena, bytes);
-}
-
-void RTAllocator::deallocate(void* p) {
-  assert(m_initialized);
-  rtl_tlsf_free(m_arena, p);
-}
-
-bool RTAllocator::init(void* buf, size_t capacity) {
-  if (m_initialized) {
-    return true;
-  }
-
-  if (capacity == 0U) {
-    return false;
-  }
-
-  m_capacity = capacity;
-
-  m_buf = buf;
-
-  if (rtl_tlsf_make_arena(&m_arena, m_buf, m_capacity) < 0) {
-    return false;
-  }
-
-  m_initialized = true;
-
-  return true;
-}
-
-void RTAllocator::uninit() {
-  if (!m_initialized) {
-    return;
-  }
-
-  m_buf = nullptr;
-  m_arena = nullptr;
-  m_capacity = 0U;
-  m_initialized = false;
-}
-
-}  // namespace detail
-
 }  // namespace rtl
@@ -0,0 +1,147 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The cost of calling into the allocator, built twice from this file:
+//
+//    alloc_call_bench              rtl_tlsf_alloc()/rtl_tlsf_free() and
+//                                  detail::RTAllocator are out of line calls
+//                                  into librtl and librtlcpp
+//    alloc_call_bench_header_only  the same with RTL_HEADER_ONLY, so all of
+//                                  it inlines into the loops below
+//
+// Compare the two reports to see what the header only build saves.  (If the
+// whole build already uses RTL_HEADER_ONLY both are header only.)
+//
+// The argument is the allocation size in bytes.  Every sample allocates and
+// frees --burst blocks, the time is per allocate or free.
+//
+//    tlsf          rtl_tlsf_alloc() and rtl_tlsf_free() on the arena
+//    allocator_st  rtl::RTAllocatorST::allocate() and deallocate()
+//    vector_grow   growing an rtl::vector<unsigned char> to the argument
+//                  size one push_back() at a time, per push_back()
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "rtl_bench/harness.hpp"
+#include "rtlcpp/rtlcpp.hpp"
+
+namespace {
+
+const size_t kArenaSize = 16U * 1024U * 1024U;
+
+// Plain heap memory rather than MMapMemoryResource, so nothing from
+// allocator.cpp is linked next to the inline copies in the header only
+// build
+void* g_buf = nullptr;
+struct rtl_tlsf_arena* g_arena = nullptr;
+rtl::RTAllocatorST g_alloc;
+
+size_t burst() {
+  return static_cast<size_t>(rtl_bench::option_int("burst", 256));
+}
+
+struct tlsf_calls {
+  static void* allocate(size_t sz) { return rtl_tlsf_alloc(g_arena, sz); }
+  static void deallocate(void* p) { rtl_tlsf_free(g_arena, p); }
+};
+
+struct allocator_calls {
+  static void* allocate(size_t sz) { return g_alloc.allocate(sz); }
+  static void deallocate(void* p) { g_alloc.deallocate(p); }
+};
+
+template <typename Calls>
+void run_burst(rtl_bench::state& st) {
+  const size_t sz = static_cast<size_t>(st.arg());
+  const size_t n = burst();
+  std::vector<void*> held(n, nullptr);
+  bool ok = true;
+
+  while (st.keep_running()) {
+    st.start_timer();
+    for (size_t i = 0U; i < n; i++) {
+      held[i] = Calls::allocate(sz);
+      rtl_bench::do_not_optimize(held[i]);
+    }
+    for (size_t i = 0U; i < n; i++) {
+      Calls::deallocate(held[i]);
+    }
+    st.stop_timer(2U * n);
+
+    for (size_t i = 0U; i < n; i++) {
+      ok &= held[i] != nullptr;
+    }
+  }
+
+  if (!ok) {
+    st.skip("the arena ran out of memory");
+  }
+}
+
+void tlsf(rtl_bench::state& st) { run_burst<tlsf_calls>(st); }
+
+void allocator_st(rtl_bench::state& st) { run_burst<allocator_calls>(st); }
+
+void vector_grow(rtl_bench::state& st) {
+  const size_t n = static_cast<size_t>(st.arg());
+  bool ok = true;
+
+  while (st.keep_running()) {
+    st.start_timer();
+    {
+      rtl::vector<unsigned char, rtl::RTAllocatorST> v(&g_alloc);
+      for (size_t i = 0U; i < n; i++) {
+        ok &= v.push_back(static_cast<unsigned char>(i));
+      }
+      rtl_bench::do_not_optimize(v.size());
+    }
+    st.stop_timer(n);
+  }
+
+  if (!ok) {
+    st.skip("the arena ran out of memory");
+  }
+}
+
+}  // namespace
+
+RTL_BENCHMARK_ARGS(tlsf, 16, 64, 256, 4096);
+RTL_BENCHMARK_ARGS(allocator_st, 16, 64, 256, 4096);
+RTL_BENCHMARK_ARGS(vector_grow, 16, 256, 4096);
+
+int main(int argc, char** argv) {
+#if defined(RTL_HEADER_ONLY)
+  std::cerr << "Allocator calls are inline (RTL_HEADER_ONLY)" << std::endl;
+#else
+  std::cerr << "Allocator calls are out of line" << std::endl;
+#endif
+
+  // One half for the bare arena, one for the allocator.  malloc() memory
+  // is aligned for any fundamental type, as an arena needs.
+  const size_t half = kArenaSize / 2U;
+  g_buf = std::malloc(kArenaSize);
+  if (g_buf == nullptr || rtl_tlsf_make_arena(&g_arena, g_buf, half) != 0 ||
+      !g_alloc.init(static_cast<unsigned char*>(g_buf) + half, half)) {
+    std::cerr << "Could not initialize the arenas" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  int rval = rtl_bench::run(argc, argv);
+  g_alloc.uninit();
+  std::free(g_buf);
+  return rval;
+}
@@ -0,0 +1,308 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// How the allocator front-ends scale with the number of threads.
+//
+// The argument of every benchmark is the number of threads.  Each thread
+// churns its own set of --slots blocks: every operation picks a random slot,
+// frees the block in it and allocates a new one of random size in
+// [16, --max-size].  --cross percent of the frees are handed to another
+// thread (through an spsc_ringbuffer per pair of threads) which frees them,
+// the way buffers move between producers and consumers.
+//
+// Every sample runs --ops operations on every thread.  The reported time is
+// wall clock per operation over all threads (lower is better, the inverse
+// of throughput) and the counters are:
+//
+//    Mops/s              operations per second over all threads
+//    op_p50/p99/p999/max per call latency of allocate() and deallocate()
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <random>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "rtl_bench/harness.hpp"
+#include "rtlcpp/rtlcpp.hpp"
+
+namespace {
+
+const size_t kArenaSize = 256U * 1024U * 1024U;
+
+size_t arena_size() {
+  return std::min(kArenaSize, rtl_tlsf_maximum_arena_size());
+}
+
+// One TLSF arena behind the given lock
+template <typename Mutex>
+struct tlsf_front {
+  rtl::MMapMemoryResource m_mr;
+  rtl::RTAllocator<Mutex> m_alloc;
+
+  bool init(size_t) {
+    return m_mr.init(arena_size()) &&
+           m_alloc.init(m_mr.get_buf(), m_mr.get_capacity());
+  }
+  void* allocate(size_t thread, size_t sz) {
+    (void)thread;
+    return m_alloc.allocate(sz);
+  }
+  void deallocate(void* p) { m_alloc.deallocate(p); }
+};
+
+// One locked arena per thread, frees go back to the arena owning the block
+struct partitioned_front {
+  rtl::MMapMemoryResource m_mr;
+  std::unique_ptr<rtl::RTAllocatorMT[]> m_allocs;
+  size_t m_slice;
+  unsigned char* m_base;
+
+  bool init(size_t threads) {
+    if (!m_mr.init(arena_size())) return false;
+    m_allocs.reset(new rtl::RTAllocatorMT[threads]);
+    m_slice = m_mr.get_capacity() / threads;
+    m_slice -= m_slice % 64U;
+    m_base = static_cast<unsigned char*>(m_mr.get_buf());
+    for (size_t i = 0U; i < threads; i++) {
+      if (!m_allocs[i].init(m_base + i * m_slice, m_slice)) return false;
+    }
+    return true;
+  }
+  void* allocate(size_t thread, size_t sz) {
+    return m_allocs[thread].allocate(sz);
+  }
+  void deallocate(void* p) {
+    size_t owner = static_cast<size_t>(static_cast<unsigned char*>(p) -
+                                       m_base) /
+                   m_slice;
+    m_allocs[owner].deallocate(p);
+  }
+};
+
+struct malloc_front {
+  bool init(size_t) { return true; }
+  void* allocate(size_t, size_t sz) { return std::malloc(sz); }
+  void deallocate(void* p) { std::free(p); }
+};
+
+struct worker_result {
+  uint64_t m_ops;
+  uint64_t m_failed;
+};
+
+template <typename Front>
+void run_scaling(rtl_bench::state& st) {
+  const size_t threads = static_cast<size_t>(st.arg());
+  const uint64_t ops = static_cast<uint64_t>(rtl_bench::option_int("ops",
+                                                                   20000));
+  const size_t slots = static_cast<size_t>(rtl_bench::option_int("slots",
+                                                                 256));
+  const size_t max_size = static_cast<size_t>(
+      std::max<int64_t>(16, rtl_bench::option_int("max-size", 512)));
+  const uint32_t cross_pct = static_cast<uint32_t>(
+      std::min<int64_t>(100, rtl_bench::option_int("cross", 25)));
+
+  Front front;
+  if (!front.init(threads)) {
+    st.skip("could not set up the allocator");
+    return;
+  }
+
+  // rings[from * threads + to] carries blocks for "to" to free.  The rings
+  // are cache line aligned which plain new doesn't honor before C++17, so
+  // they are placed in storage aligned by hand
+  static_assert(std::is_trivially_destructible<rtl::spsc_ringbuffer>::value,
+                "the rings are never destroyed");
+  const uint32_t kRingBytes = 16384U;
+  const size_t num_rings = threads * threads;
+  std::vector<unsigned char> ring_mem(num_rings * kRingBytes);
+  std::vector<unsigned char> ring_storage(
+      num_rings * sizeof(rtl::spsc_ringbuffer) + RTL_CACHE_LINE_SIZE);
+  void* ring_base = ring_storage.data();
+  size_t ring_space = ring_storage.size();
+  (void)std::align(RTL_CACHE_LINE_SIZE,
+                   num_rings * sizeof(rtl::spsc_ringbuffer), ring_base,
+                   ring_space);
+  std::vector<rtl::spsc_ringbuffer*> rings;
+  for (size_t i = 0U; i < num_rings; i++) {
+    rings.push_back(new (static_cast<unsigned char*>(ring_base) +
+                         i * sizeof(rtl::spsc_ringbuffer))
+                        rtl::spsc_ringbuffer(ring_mem.data() + i * kRingBytes,
+                                             kRingBytes));
+  }
+
+  rtl_bench::heap_allocator heap;
+  std::vector<std::unique_ptr<rtl_bench::histogram>> hists;
+  for (size_t i = 0U; i < threads; i++) {
+    hists.emplace_back(new rtl_bench::histogram(&heap));
+    if (!rtl_bench::init_histogram(hists.back().get())) {
+      st.skip("could not allocate the histograms");
+      return;
+    }
+  }
+
+  std::vector<std::vector<void*>> blocks(threads,
+                                         std::vector<void*>(slots, nullptr));
+  uint64_t total_failed = 0U;
+  double total_ns = 0.0;
+  uint64_t total_ops = 0U;
+
+  auto free_timed = [&](size_t t, void* p) {
+    uint64_t t0 = rtl::cycle_clock::now();
+    front.deallocate(p);
+    uint64_t t1 = rtl::cycle_clock::now();
+    hists[t]->record(
+        static_cast<uint64_t>(rtl::cycle_clock::to_ns(t1 - t0) * 1000.0));
+  };
+
+  auto drain_inbox = [&](size_t t, uint64_t* n) {
+    void* p;
+    for (size_t from = 0U; from < threads; from++) {
+      rtl::spsc_ringbuffer& rb = *rings[from * threads + t];
+      while (rb.read(reinterpret_cast<unsigned char*>(&p), sizeof(p)) ==
+             sizeof(p)) {
+        free_timed(t, p);
+        (*n)++;
+      }
+    }
+  };
+
+  while (st.keep_running()) {
+    std::atomic<size_t> ready{0U};
+    std::atomic<bool> go{false};
+    std::atomic<size_t> done{0U};
+    std::vector<worker_result> results(threads, worker_result{0U, 0U});
+    std::vector<std::thread> workers;
+
+    for (size_t t = 0U; t < threads; t++) {
+      workers.emplace_back([&, t]() {
+        std::minstd_rand gen(static_cast<unsigned>(t * 7919U + total_ops));
+        std::vector<void*>& mine = blocks[t];
+        worker_result& r = results[t];
+
+        ready++;
+        while (!go.load(std::memory_order_acquire)) {
+        }
+
+        for (uint64_t i = 0U; i < ops; i++) {
+          size_t slot = gen() % slots;
+          if (mine[slot] != nullptr) {
+            size_t to = t;
+            if (threads > 1U && gen() % 100U < cross_pct) {
+              to = (t + 1U + gen() % (threads - 1U)) % threads;
+            }
+            void* p = mine[slot];
+            if (to == t ||
+                !rings[t * threads + to]->write(
+                    reinterpret_cast<const unsigned char*>(&p), sizeof(p))) {
+              free_timed(t, p);
+            }
+            mine[slot] = nullptr;
+            r.m_ops++;
+          }
+
+          size_t sz = 16U + gen() % (max_size - 15U);
+          uint64_t t0 = rtl::cycle_clock::now();
+          void* p = front.allocate(t, sz);
+          uint64_t t1 = rtl::cycle_clock::now();
+          hists[t]->record(static_cast<uint64_t>(
+              rtl::cycle_clock::to_ns(t1 - t0) * 1000.0));
+          if (p == nullptr) {
+            r.m_failed++;
+          } else {
+            static_cast<unsigned char*>(p)[0] = 1U;
+            mine[slot] = p;
+          }
+          r.m_ops++;
+
+          if ((i & 63U) == 0U) drain_inbox(t, &r.m_ops);
+        }
+
+        done++;
+        // Keep freeing what the others send until everybody is done
+        while (done.load(std::memory_order_acquire) < threads) {
+          drain_inbox(t, &r.m_ops);
+        }
+        drain_inbox(t, &r.m_ops);
+      });
+    }
+
+    while (ready.load() < threads) {
+      std::this_thread::yield();
+    }
+    uint64_t start = rtl::cycle_clock::start();
+    go.store(true, std::memory_order_release);
+    for (std::thread& w : workers) w.join();
+    uint64_t end = rtl::cycle_clock::stop();
+
+    uint64_t sample_ops = 0U;
+    for (worker_result const& r : results) {
+      sample_ops += r.m_ops;
+      total_failed += r.m_failed;
+    }
+    double ns = rtl::cycle_clock::to_ns(end - start);
+    st.record(ns, sample_ops);
+    total_ns += ns;
+    total_ops += sample_ops;
+  }
+
+  // Blocks still in the slots, the rings were drained by their owners
+  for (size_t t = 0U; t < threads; t++) {
+    for (void* p : blocks[t]) {
+      if (p != nullptr) front.deallocate(p);
+    }
+  }
+
+  rtl_bench::histogram merged(&heap);
+  if (rtl_bench::init_histogram(&merged)) {
+    for (auto const& h : hists) merged.merge(*h);
+    st.set_counter("op_p50_ns", merged.value_at_percentile(50.0) / 1000.0);
+    st.set_counter("op_p99_ns", merged.value_at_percentile(99.0) / 1000.0);
+    st.set_counter("op_p999_ns", merged.value_at_percentile(99.9) / 1000.0);
+    st.set_counter("op_max_ns", merged.max() / 1000.0);
+  }
+  if (total_ns > 0.0) {
+    st.set_counter("Mops/s", static_cast<double>(total_ops) * 1e3 / total_ns);
+  }
+  st.set_counter("failed", static_cast<double>(total_failed));
+}
+
+void tlsf_mutex(rtl_bench::state& st) {
+  run_scaling<tlsf_front<std::mutex>>(st);
+}
+
+void tlsf_spinlock(rtl_bench::state& st) {
+  run_scaling<tlsf_front<rtl::SpinLock>>(st);
+}
+
+void tlsf_per_thread(rtl_bench::state& st) {
+  run_scaling<partitioned_front>(st);
+}
+
+void system_malloc(rtl_bench::state& st) { run_scaling<malloc_front>(st); }
+
+}  // namespace
+
+RTL_BENCHMARK_ARGS(tlsf_mutex, 1, 2, 4, 8, 16);
+RTL_BENCHMARK_ARGS(tlsf_spinlock, 1, 2, 4, 8, 16);
+RTL_BENCHMARK_ARGS(tlsf_per_thread, 1, 2, 4, 8, 16);
+RTL_BENCHMARK_ARGS(system_malloc, 1, 2, 4, 8, 16);
+
+RTL_BENCHMARK_MAIN();
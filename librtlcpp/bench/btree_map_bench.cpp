@@ -0,0 +1,172 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// rtl::btree_map against std::map.  The argument is the number of entries,
+// 64 bit keys spread over a range 4 times larger, and the map is full
+// before anything is timed.  Every sample times a batch of:
+//
+//    find    get() of a random key that is in the map
+//    churn   insert of a key that isn't in the map and erase of one that is,
+//            so the size stays the same
+//    scan    lower_bound() of a random key and a walk over the next 64
+//            entries
+//
+// Run with --perf to see the cache misses per operation.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "rtl_bench/harness.hpp"
+#include "rtlcpp/rtlcpp.hpp"
+
+namespace {
+
+const size_t kArenaSize = 512U * 1024U * 1024U;
+const uint64_t kBatch = 64U;
+const size_t kScanLength = 64U;
+
+rtl::MMapMemoryResource g_mr;
+rtl::RTAllocatorST g_alloc;
+
+struct rtl_fixture {
+  rtl::btree_map<uint64_t, uint64_t, rtl::RTAllocatorST> m_map;
+
+  rtl_fixture() : m_map(&g_alloc) {}
+  bool put(uint64_t k, uint64_t v) { return m_map.put(k, v); }
+  bool erase(uint64_t k) { return m_map.erase(k); }
+  uint64_t* get(uint64_t k) { return m_map.get(k); }
+  uint64_t scan(uint64_t k) {
+    uint64_t sum = 0U;
+    size_t n = 0U;
+    for (auto it = m_map.lower_bound(k); it.valid() && n < kScanLength;
+         it.next(), n++) {
+      sum += it.value();
+    }
+    return sum;
+  }
+};
+
+struct std_fixture {
+  std::map<uint64_t, uint64_t> m_map;
+
+  bool put(uint64_t k, uint64_t v) {
+    m_map[k] = v;
+    return true;
+  }
+  bool erase(uint64_t k) { return m_map.erase(k) == 1U; }
+  uint64_t* get(uint64_t k) {
+    auto it = m_map.find(k);
+    return it == m_map.end() ? nullptr : &it->second;
+  }
+  uint64_t scan(uint64_t k) {
+    uint64_t sum = 0U;
+    size_t n = 0U;
+    for (auto it = m_map.lower_bound(k); it != m_map.end() && n < kScanLength;
+         ++it, n++) {
+      sum += it->second;
+    }
+    return sum;
+  }
+};
+
+enum class op { kFind, kChurn, kScan };
+
+template <typename Fixture, op Op>
+void run_map(rtl_bench::state& st) {
+  const size_t count = static_cast<size_t>(st.arg());
+  const uint64_t range = count * 4U;
+  std::mt19937_64 gen(42U);
+
+  // keys[0, count) are in the map, the rest are free for churn
+  std::vector<uint64_t> keys(range);
+  std::iota(keys.begin(), keys.end(), 0U);
+  std::shuffle(keys.begin(), keys.end(), gen);
+
+  Fixture m;
+  for (size_t i = 0U; i < count; i++) {
+    if (!m.put(keys[i], keys[i])) {
+      st.skip("could not fill the map");
+      return;
+    }
+  }
+
+  std::vector<size_t> picks(1U << 16U);
+  for (size_t& p : picks) p = static_cast<size_t>(gen() % count);
+
+  size_t pos = 0U;
+  // Churn erases the oldest key and inserts the next free one, cycling
+  // through keys like a ring of size range
+  size_t oldest = 0U;
+  size_t next_free = count;
+  uint64_t sum = 0U;
+  bool ok = true;
+
+  while (st.keep_running()) {
+    st.start_timer();
+    for (uint64_t i = 0U; i < st.batch_size(); i++) {
+      if (Op == op::kFind) {
+        uint64_t* v = m.get(keys[(oldest + picks[pos]) % range]);
+        ok &= v != nullptr;
+        if (v) sum += *v;
+      } else if (Op == op::kChurn) {
+        ok &= m.put(keys[next_free], next_free);
+        ok &= m.erase(keys[oldest]);
+        next_free = (next_free + 1U) % range;
+        oldest = (oldest + 1U) % range;
+      } else {
+        sum += m.scan(keys[(oldest + picks[pos]) % range]);
+      }
+      pos = (pos + 1U) & (picks.size() - 1U);
+    }
+    st.stop_timer(st.batch_size());
+  }
+  rtl_bench::do_not_optimize(sum);
+
+  if (!ok) {
+    st.skip("the map misbehaved");
+  }
+}
+
+void rtl_find(rtl_bench::state& st) { run_map<rtl_fixture, op::kFind>(st); }
+void rtl_churn(rtl_bench::state& st) { run_map<rtl_fixture, op::kChurn>(st); }
+void rtl_scan(rtl_bench::state& st) { run_map<rtl_fixture, op::kScan>(st); }
+void std_find(rtl_bench::state& st) { run_map<std_fixture, op::kFind>(st); }
+void std_churn(rtl_bench::state& st) { run_map<std_fixture, op::kChurn>(st); }
+void std_scan(rtl_bench::state& st) { run_map<std_fixture, op::kScan>(st); }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const std::vector<int64_t> sizes = {1024, 65536, 1048576};
+  rtl_bench::register_benchmark("rtl_find", rtl_find, sizes, kBatch);
+  rtl_bench::register_benchmark("std_find", std_find, sizes, kBatch);
+  rtl_bench::register_benchmark("rtl_churn", rtl_churn, sizes, kBatch);
+  rtl_bench::register_benchmark("std_churn", std_churn, sizes, kBatch);
+  rtl_bench::register_benchmark("rtl_scan", rtl_scan, sizes, kBatch);
+  rtl_bench::register_benchmark("std_scan", std_scan, sizes, kBatch);
+
+  if (!g_mr.init(std::min(kArenaSize, rtl_tlsf_maximum_arena_size()))) {
+    std::cerr << "Could not initialize buffer" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (!g_alloc.init(g_mr.get_buf(), g_mr.get_capacity())) return EXIT_FAILURE;
+
+  return rtl_bench::run(argc, argv);
+}
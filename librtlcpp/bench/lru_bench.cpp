@@ -0,0 +1,157 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// rtl::lru against the usual std::list + std::unordered_map LRU cache.  The
+// argument is the capacity of the cache, the cache is full before anything
+// is timed.  Every sample times a batch of:
+//
+//    hit   get() of a random key that is in the cache
+//    miss  get() of a key that isn't in the cache followed by the put() that
+//          evicts the least recently used entry to make room for it
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "rtl_bench/harness.hpp"
+#include "rtlcpp/rtlcpp.hpp"
+
+namespace {
+
+const size_t kArenaSize = 128U * 1024U * 1024U;
+const uint64_t kBatch = 64U;
+
+rtl::MMapMemoryResource g_mr;
+rtl::RTAllocatorST g_alloc;
+
+struct rtl_cache {
+  rtl::lru<int, int, rtl::RTAllocatorST> m_lru;
+
+  explicit rtl_cache(size_t capacity) : m_lru(&g_alloc, capacity) {}
+  bool get(int key, int* out) { return m_lru.get(key, out); }
+  bool put(int key, int val) { return m_lru.put(key, val); }
+};
+
+class std_cache {
+ private:
+  using list_type = std::list<std::pair<int, int>>;
+
+  list_type m_list;
+  std::unordered_map<int, list_type::iterator> m_map;
+  size_t m_capacity;
+
+ public:
+  explicit std_cache(size_t capacity) : m_capacity(capacity) {
+    m_map.reserve(capacity);
+  }
+
+  bool get(int key, int* out) {
+    auto it = m_map.find(key);
+    if (it == m_map.end()) {
+      return false;
+    }
+    m_list.splice(m_list.begin(), m_list, it->second);
+    *out = it->second->second;
+    return true;
+  }
+
+  bool put(int key, int val) {
+    auto it = m_map.find(key);
+    if (it != m_map.end()) {
+      it->second->second = val;
+      m_list.splice(m_list.begin(), m_list, it->second);
+      return true;
+    }
+    if (m_list.size() == m_capacity) {
+      m_map.erase(m_list.back().first);
+      m_list.pop_back();
+    }
+    m_list.emplace_front(key, val);
+    m_map[key] = m_list.begin();
+    return true;
+  }
+};
+
+template <typename Cache, bool Hit>
+void run_cache(rtl_bench::state& st) {
+  const size_t capacity = static_cast<size_t>(st.arg());
+  Cache cache(capacity);
+  for (size_t i = 0U; i < capacity; i++) {
+    if (!cache.put(static_cast<int>(i), static_cast<int>(i))) {
+      st.skip("could not fill the cache");
+      return;
+    }
+  }
+
+  // Random keys of the cache for hits
+  std::mt19937 gen(42U);
+  std::vector<int> keys(1U << 16U);
+  for (int& k : keys) k = static_cast<int>(gen() % capacity);
+
+  size_t pos = 0U;
+  // Keys only ever go up, so every miss is for a key never seen before
+  int next_key = static_cast<int>(capacity);
+  int sum = 0;
+  bool ok = true;
+
+  while (st.keep_running()) {
+    st.start_timer();
+    for (uint64_t i = 0U; i < st.batch_size(); i++) {
+      int v = 0;
+      if (Hit) {
+        ok &= cache.get(keys[pos], &v);
+        pos = (pos + 1U) & (keys.size() - 1U);
+      } else {
+        ok &= !cache.get(next_key, &v);
+        ok &= cache.put(next_key, next_key);
+        next_key++;
+      }
+      sum += v;
+    }
+    st.stop_timer(st.batch_size());
+  }
+  rtl_bench::do_not_optimize(sum);
+
+  if (!ok) {
+    st.skip("the cache misbehaved");
+  }
+}
+
+void rtl_hit(rtl_bench::state& st) { run_cache<rtl_cache, true>(st); }
+void rtl_miss(rtl_bench::state& st) { run_cache<rtl_cache, false>(st); }
+void std_hit(rtl_bench::state& st) { run_cache<std_cache, true>(st); }
+void std_miss(rtl_bench::state& st) { run_cache<std_cache, false>(st); }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  rtl_bench::register_benchmark("rtl_hit", rtl_hit, {1024, 65536}, kBatch);
+  rtl_bench::register_benchmark("rtl_miss", rtl_miss, {1024, 65536}, kBatch);
+  rtl_bench::register_benchmark("std_hit", std_hit, {1024, 65536}, kBatch);
+  rtl_bench::register_benchmark("std_miss", std_miss, {1024, 65536}, kBatch);
+
+  if (!g_mr.init(kArenaSize)) {
+    std::cerr << "Could not initialize buffer" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (!g_alloc.init(g_mr.get_buf(), g_mr.get_capacity())) return EXIT_FAILURE;
+
+  return rtl_bench::run(argc, argv);
+}
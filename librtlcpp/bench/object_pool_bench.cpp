@@ -0,0 +1,118 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// rtl::object_pool against allocating straight from the TLSF arena and
+// against new/delete.  Every sample takes arg() 64 byte objects and then
+// gives all of them back, the time is per get or put.  Small bursts are
+// repeated so every sample times at least 128 operations.  The pool is
+// created with enough objects up front.
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "rtl_bench/harness.hpp"
+#include "rtlcpp/rtlcpp.hpp"
+
+namespace {
+
+const size_t kArenaSize = 64U * 1024U * 1024U;
+
+rtl::MMapMemoryResource g_mr;
+rtl::RTAllocatorST g_alloc;
+
+struct payload {
+  uint64_t m_data[8];
+
+  explicit payload(uint64_t v) : m_data() { m_data[0] = v; }
+};
+
+struct pool_source {
+  rtl::object_pool<payload, rtl::RTAllocatorST> m_pool;
+
+  explicit pool_source(size_t n) : m_pool(&g_alloc, n) {}
+  payload* get(uint64_t v) { return m_pool.get(v); }
+  void put(payload* p) { m_pool.put(p); }
+};
+
+struct tlsf_source {
+  explicit tlsf_source(size_t) {}
+  payload* get(uint64_t v) {
+    void* p = g_alloc.allocate(sizeof(payload));
+    return p == nullptr ? nullptr : new (p) payload(v);
+  }
+  void put(payload* p) {
+    p->~payload();
+    g_alloc.deallocate(p);
+  }
+};
+
+struct new_source {
+  explicit new_source(size_t) {}
+  payload* get(uint64_t v) { return new (std::nothrow) payload(v); }
+  void put(payload* p) { delete p; }
+};
+
+template <typename Source>
+void run_burst(rtl_bench::state& st) {
+  const size_t n = static_cast<size_t>(st.arg());
+  Source src(n);
+  const size_t reps = n < 64U ? 64U / n : 1U;
+  std::vector<payload*> held(n, nullptr);
+
+  while (st.keep_running()) {
+    bool ok = true;
+
+    st.start_timer();
+    for (size_t r = 0U; r < reps; r++) {
+      for (size_t i = 0U; i < n; i++) {
+        held[i] = src.get(i);
+        rtl_bench::do_not_optimize(held[i]);
+        ok &= held[i] != nullptr;
+      }
+      for (size_t i = 0U; i < n; i++) {
+        if (held[i] != nullptr) src.put(held[i]);
+      }
+    }
+    st.stop_timer(2U * n * reps);
+
+    if (!ok) {
+      st.skip("could not get an object");
+      return;
+    }
+  }
+}
+
+void object_pool(rtl_bench::state& st) { run_burst<pool_source>(st); }
+void tlsf(rtl_bench::state& st) { run_burst<tlsf_source>(st); }
+void new_delete(rtl_bench::state& st) { run_burst<new_source>(st); }
+
+}  // namespace
+
+RTL_BENCHMARK_ARGS(object_pool, 1, 64, 1024);
+RTL_BENCHMARK_ARGS(tlsf, 1, 64, 1024);
+RTL_BENCHMARK_ARGS(new_delete, 1, 64, 1024);
+
+int main(int argc, char** argv) {
+  if (!g_mr.init(kArenaSize)) {
+    std::cerr << "Could not initialize buffer" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (!g_alloc.init(g_mr.get_buf(), g_mr.get_capacity())) return EXIT_FAILURE;
+
+  return rtl_bench::run(argc, argv);
+}
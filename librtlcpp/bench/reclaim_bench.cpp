@@ -0,0 +1,206 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the read-side overhead of the reclamation schemes: how long it
+// takes a reader to safely get at (and touch) a shared object while a
+// writer keeps replacing it.  The argument of each benchmark is the number
+// of reader threads.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "rtl_bench/harness.hpp"
+#include "rtlcpp/rtlcpp.hpp"
+
+struct Payload {
+  uint64_t m_value;
+  explicit Payload(uint64_t v) : m_value(v) {}
+};
+
+using Alloc = rtl::RTAllocatorMT;
+
+template <typename ReadFn>
+double time_reads(size_t num_readers, uint64_t reads_per_thread,
+                  ReadFn read_fn) {
+  std::atomic<bool> go{false};
+  std::atomic<uint64_t> sink{0};
+  std::vector<std::thread> threads;
+  std::vector<double> ns_per_read(num_readers, 0.0);
+
+  for (size_t r = 0; r < num_readers; r++) {
+    threads.emplace_back([&, r]() {
+      while (!go) {
+      }
+      uint64_t local = 0;
+      uint64_t start = rtl::cycle_clock::start();
+      read_fn(r, reads_per_thread, &local);
+      uint64_t end = rtl::cycle_clock::stop();
+      ns_per_read[r] =
+          rtl::cycle_clock::to_ns(end - start) / (double)reads_per_thread;
+      sink += local;
+    });
+  }
+
+  go = true;
+  for (std::thread& t : threads) t.join();
+
+  double sum = 0.0;
+  for (double d : ns_per_read) sum += d;
+  return sum / (double)num_readers;
+}
+
+static rtl::MMapMemoryResource g_mr;
+static Alloc g_alloc;
+
+// Every sample runs arg() readers doing --reads (default 10000) reads each
+// and records the average time per read
+static uint64_t reads_per_sample() {
+  return static_cast<uint64_t>(rtl_bench::option_int("reads", 10000));
+}
+
+template <typename ReadFn>
+void sample_reads(rtl_bench::state& st, ReadFn read_fn) {
+  size_t readers = static_cast<size_t>(st.arg());
+  uint64_t n = reads_per_sample();
+  while (st.keep_running()) {
+    st.record(time_reads(readers, n, read_fn) * (double)n, n);
+  }
+}
+
+// Baseline: an unprotected acquire load, not safe if anything is freed
+static void unprotected(rtl_bench::state& st) {
+  Payload p(1);
+  std::atomic<Payload*> shared{&p};
+  sample_reads(st, [&](size_t, uint64_t n, uint64_t* out) {
+    for (uint64_t i = 0; i < n; i++) {
+      *out += shared.load(std::memory_order_acquire)->m_value;
+    }
+  });
+}
+
+// Readers only pay for the quiescent announcement once per loop
+static void rcu(rtl_bench::state& st) {
+  rtl::rcu_ptr<Payload, Alloc, 16U> rcu(&g_alloc);
+  std::atomic<bool> stop{false};
+  rcu.publish(0U);
+  std::thread writer([&]() {
+    uint64_t v = 0;
+    while (!stop) {
+      rcu.publish(++v);
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  });
+
+  sample_reads(st, [&](size_t, uint64_t n, uint64_t* out) {
+    size_t id;
+    if (!rcu.register_reader(&id)) std::abort();
+    for (uint64_t i = 0; i < n; i++) {
+      *out += rcu.read()->m_value;
+      rcu.quiescent(id);
+    }
+    rcu.unregister_reader(id);
+  });
+
+  stop = true;
+  writer.join();
+}
+
+static void epoch(rtl_bench::state& st) {
+  rtl::epoch_domain<Alloc, 16U> domain(&g_alloc);
+  std::atomic<Payload*> shared{new (g_alloc.allocate(sizeof(Payload)))
+                                   Payload(0)};
+  std::atomic<bool> stop{false};
+  std::thread writer([&]() {
+    size_t id;
+    if (!domain.register_thread(&id)) std::abort();
+    uint64_t v = 0;
+    while (!stop) {
+      void* mem = g_alloc.allocate(sizeof(Payload));
+      if (mem != nullptr) {
+        Payload* old = shared.exchange(new (mem) Payload(++v));
+        while (!domain.retire(id, old)) domain.collect(id);
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    domain.retire(id, shared.exchange(nullptr));
+    domain.unregister_thread(id);
+  });
+
+  sample_reads(st, [&](size_t, uint64_t n, uint64_t* out) {
+    size_t id;
+    if (!domain.register_thread(&id)) std::abort();
+    for (uint64_t i = 0; i < n; i++) {
+      rtl::epoch_guard<decltype(domain)> g(&domain, id);
+      *out += shared.load(std::memory_order_acquire)->m_value;
+    }
+    domain.unregister_thread(id);
+  });
+
+  stop = true;
+  writer.join();
+}
+
+static void hazard(rtl_bench::state& st) {
+  rtl::hazard_domain<Alloc, 16U, 1U> domain(&g_alloc);
+  std::atomic<Payload*> shared{new (g_alloc.allocate(sizeof(Payload)))
+                                   Payload(0)};
+  std::atomic<bool> stop{false};
+  std::thread writer([&]() {
+    size_t id;
+    if (!domain.register_thread(&id)) std::abort();
+    uint64_t v = 0;
+    while (!stop) {
+      void* mem = g_alloc.allocate(sizeof(Payload));
+      if (mem != nullptr) {
+        Payload* old = shared.exchange(new (mem) Payload(++v));
+        while (!domain.retire(id, old)) std::this_thread::yield();
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    domain.retire(id, shared.exchange(nullptr));
+    domain.unregister_thread(id);
+  });
+
+  sample_reads(st, [&](size_t, uint64_t n, uint64_t* out) {
+    size_t id;
+    if (!domain.register_thread(&id)) std::abort();
+    for (uint64_t i = 0; i < n; i++) {
+      *out += domain.protect(id, 0U, shared)->m_value;
+      domain.clear(id, 0U);
+    }
+    domain.unregister_thread(id);
+  });
+
+  stop = true;
+  writer.join();
+}
+
+RTL_BENCHMARK_ARGS(unprotected, 1, 2, 4, 8);
+RTL_BENCHMARK_ARGS(rcu, 1, 2, 4, 8);
+RTL_BENCHMARK_ARGS(epoch, 1, 2, 4, 8);
+RTL_BENCHMARK_ARGS(hazard, 1, 2, 4, 8);
+
+int main(int argc, char** argv) {
+  if (!g_mr.init(64 * 1024 * 1024)) {
+    std::cerr << "Could not initialize buffer" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (!g_alloc.init(g_mr.get_buf(), g_mr.get_capacity())) return EXIT_FAILURE;
+
+  return rtl_bench::run(argc, argv);
+}
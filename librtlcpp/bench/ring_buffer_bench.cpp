@@ -12,9 +12,14 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <atomic>
 #include <random>
+#include <string>
 #include <thread>
+#include <vector>
 
+#include "rtl_bench/harness.hpp"
+#include "rtl_bench/topology.hpp"
 #include "rtlcpp/rtlcpp.hpp"
 
 void producer_contig(rtl::spsc_ringbuffer& rb, std::atomic<bool>& go) {
@@ -137,55 +142,247 @@ void consumer_block(rtl::spsc_ringbuffer& rb, std::atomic<bool>& go) {
   }
 }
 
-int main(int argc, char** argv) {
-  int number_of_loops;
+// Every sample is one producer/consumer pair moving 255 bytes through a
+// deliberately odd sized (48 byte) buffer, timed from the start signal
+// until both threads are joined.
+template <void (*Producer)(rtl::spsc_ringbuffer&, std::atomic<bool>&),
+          void (*Consumer)(rtl::spsc_ringbuffer&, std::atomic<bool>&)>
+void run_transfer(rtl_bench::state& st) {
+  const uint32_t buf_sz{48};
+  unsigned char buf[buf_sz];
 
-  if (argc != 2) {
-    number_of_loops = 10;
-  } else {
-    number_of_loops = std::atoi(argv[1]);
+  while (st.keep_running()) {
+    rtl::spsc_ringbuffer rb(buf, buf_sz);
+    std::atomic<bool> go{false};
+
+    std::thread producer(Producer, std::ref(rb), std::ref(go));
+    std::thread consumer(Consumer, std::ref(rb), std::ref(go));
+
+    st.start_timer();
+    go = true;
+    producer.join();
+    consumer.join();
+    st.stop_timer();
   }
+}
 
-  // Some length between 1-50 to provide oddity write patterns
-  const uint32_t buf_sz{48};
-  unsigned char buf[buf_sz];
-  rtl::spsc_ringbuffer rb(buf, buf_sz);
+static void spsc_contig(rtl_bench::state& st) {
+  run_transfer<producer_contig, consumer_contig>(st);
+}
+
+static void spsc_block(rtl_bench::state& st) {
+  run_transfer<producer_block, consumer_block>(st);
+}
 
-  std::atomic<bool> go{false};
+// -------------------------------------------
+// Cross core latency and throughput
+//
+// Both benchmarks pin their two threads to a pair of cpus picked by
+// rtl_bench::find_cpu_pair() and are registered in main() for every
+// placement and message size (and messages per commit for throughput).
+// Placements this machine doesn't have are reported as skipped.
+
+struct link_config {
+  rtl_bench::placement m_placement;
+  uint32_t m_msg_size;
+  uint32_t m_batch;
+
+  // Packs the config into the benchmark argument, sizes are below 1000
+  static int64_t encode(rtl_bench::placement p, uint32_t msg_size,
+                        uint32_t batch) {
+    return static_cast<int64_t>(p) * 1000000 + msg_size * 1000 + batch;
+  }
+
+  static link_config decode(int64_t arg) {
+    return link_config{static_cast<rtl_bench::placement>(arg / 1000000),
+                       static_cast<uint32_t>((arg / 1000) % 1000),
+                       static_cast<uint32_t>(arg % 1000)};
+  }
+};
 
-  std::vector<std::thread> threads;
+// When both threads share a cpu the other one can't make progress until
+// this one gets descheduled, so yield instead of spinning
+struct waiter {
+  bool m_yield;
 
-  auto start = std::chrono::high_resolution_clock::now();
-  auto end = std::chrono::high_resolution_clock::now();
+  void wait() const {
+    if (m_yield) {
+      std::this_thread::yield();
+    } else {
+      rtl::asm_cpu_relax();
+    }
+  }
+};
+
+// Runs fn on a thread pinned to cpu and the benchmark body on another
+// pinned to driver_cpu, skipping the benchmark if pinning fails
+template <typename EchoFn, typename DriverFn>
+void run_pinned_pair(rtl_bench::state& st, int driver_cpu, int cpu,
+                     EchoFn echo_fn, DriverFn driver_fn) {
+  std::atomic<int> echo_ready{0};
+
+  std::thread echo([&]() {
+    if (!rtl_bench::pin_thread_to_cpu(cpu)) {
+      echo_ready.store(-1, std::memory_order_release);
+      return;
+    }
+    echo_ready.store(1, std::memory_order_release);
+    echo_fn();
+  });
+
+  std::thread driver([&]() {
+    bool pinned = rtl_bench::pin_thread_to_cpu(driver_cpu);
+    int ready;
+    while ((ready = echo_ready.load(std::memory_order_acquire)) == 0) {
+      std::this_thread::yield();
+    }
+    if (!pinned || ready < 0) {
+      st.skip("could not pin the threads");
+    }
+    driver_fn();
+  });
 
-  std::vector<double> times;
+  driver.join();
+  echo.join();
+}
 
-  for (int i = 0; i < number_of_loops; i++) {
-    threads.clear();
-    go = false;
-    threads.emplace_back(producer_contig, std::ref(rb), std::ref(go));
-    threads.emplace_back(consumer_contig, std::ref(rb), std::ref(go));
-    // Start threads
-    go = true;
-    start = std::chrono::high_resolution_clock::now();
-    for (std::thread& t : threads) t.join();
-    end = std::chrono::high_resolution_clock::now();
-
-    double elapsed_time =
-        std::chrono::duration_cast<std::chrono::milliseconds>(end - start)
-            .count();
-    times.push_back(elapsed_time);
+bool find_pair(rtl_bench::state& st, link_config const& c, int* a, int* b) {
+  if (!rtl_bench::find_cpu_pair(c.m_placement, a, b)) {
+    st.skip("no cpu pair with this placement");
+    return false;
   }
+  return true;
+}
+
+// Every sample is one round trip of a message to the other thread and
+// back through a pair of rings
+static void ping_pong(rtl_bench::state& st) {
+  link_config c = link_config::decode(st.arg());
+  int a, b;
+  if (!find_pair(st, c, &a, &b)) return;
+
+  const uint32_t kBufSize = 4096U;
+  std::vector<unsigned char> ping_buf(kBufSize), pong_buf(kBufSize);
+  rtl::spsc_ringbuffer ping(ping_buf.data(), kBufSize);
+  rtl::spsc_ringbuffer pong(pong_buf.data(), kBufSize);
+  std::atomic<bool> stop{false};
+  const uint32_t sz = c.m_msg_size;
+  const waiter w{a == b};
+
+  auto echo = [&]() {
+    std::vector<unsigned char> msg(sz);
+    for (;;) {
+      uint32_t got = 0U;
+      while (got < sz) {
+        uint32_t n = ping.read(msg.data() + got, sz - got);
+        if (n == 0U) {
+          if (stop.load(std::memory_order_acquire)) return;
+          w.wait();
+        }
+        got += n;
+      }
+      while (!pong.write(msg.data(), sz)) w.wait();
+    }
+  };
+
+  auto drive = [&]() {
+    std::vector<unsigned char> msg(sz, 0x5AU), reply(sz);
+    while (st.keep_running()) {
+      st.start_timer();
+      while (!ping.write(msg.data(), sz)) w.wait();
+      uint32_t got = 0U;
+      while (got < sz) {
+        uint32_t n = pong.read(reply.data() + got, sz - got);
+        if (n == 0U) w.wait();
+        got += n;
+      }
+      st.stop_timer();
+    }
+    stop.store(true, std::memory_order_release);
+  };
+
+  run_pinned_pair(st, a, b, echo, drive);
+}
+
+// Every sample streams a fixed number of messages one way, the producer
+// commits m_batch messages per write.  Reports ns per message.
+static void throughput(rtl_bench::state& st) {
+  link_config c = link_config::decode(st.arg());
+  int a, b;
+  if (!find_pair(st, c, &a, &b)) return;
+
+  const uint32_t kBufSize = 64U * 1024U;
+  const uint32_t commit_bytes = c.m_msg_size * c.m_batch;
+  const uint64_t msgs = (8192U / c.m_batch) * c.m_batch;
+  std::vector<unsigned char> buf(kBufSize);
+  rtl::spsc_ringbuffer rb(buf.data(), kBufSize);
+  std::atomic<uint64_t> requested{0U};
+  std::atomic<bool> stop{false};
+  const waiter w{a == b};
+
+  auto produce = [&]() {
+    std::vector<unsigned char> out(commit_bytes, 0x5AU);
+    uint64_t sent = 0U;
+    for (;;) {
+      while (sent == requested.load(std::memory_order_acquire)) {
+        if (stop.load(std::memory_order_acquire)) return;
+        w.wait();
+      }
+      while (!rb.write(out.data(), commit_bytes)) w.wait();
+      sent += c.m_batch;
+    }
+  };
+
+  auto consume = [&]() {
+    std::vector<unsigned char> in(kBufSize);
+    while (st.keep_running()) {
+      uint64_t want = msgs * c.m_msg_size;
+      st.start_timer();
+      requested.fetch_add(msgs, std::memory_order_release);
+      while (want > 0U) {
+        uint32_t n = rb.read(in.data(), kBufSize);
+        if (n == 0U) w.wait();
+        want -= n;
+      }
+      st.stop_timer(msgs);
+    }
+    stop.store(true, std::memory_order_release);
+  };
+
+  run_pinned_pair(st, a, b, produce, consume);
 
-  double sum{0.0};
-  for (double& d : times) {
-    sum += d;
+  if (!st.skipped() && st.hist().count() > 0U) {
+    // Mean picoseconds per message to megabytes per second
+    st.set_counter("MB/s", c.m_msg_size * 1e6 / st.hist().mean());
   }
+}
+
+RTL_BENCHMARK(spsc_contig);
+RTL_BENCHMARK(spsc_block);
+
+int main(int argc, char** argv) {
+  const uint32_t kMsgSizes[] = {8U, 64U, 256U};
+  const uint32_t kBatches[] = {1U, 16U};
 
-  double average = sum / (double)times.size();
+  for (int i = 0; i < rtl_bench::kNumPlacements; i++) {
+    rtl_bench::placement p = static_cast<rtl_bench::placement>(i);
+    std::string prefix = std::string("/") + rtl_bench::placement_name(p) + "/";
 
-  std::cout << "Completed " << number_of_loops << " loops each taking "
-            << average << " milliseconds." << std::endl;
+    for (uint32_t sz : kMsgSizes) {
+      std::string name = "ping_pong" + prefix + std::to_string(sz) + "B";
+      rtl_bench::register_benchmark_variant(
+          name, ping_pong, link_config::encode(p, sz, 1U));
+    }
+
+    for (uint32_t sz : kMsgSizes) {
+      for (uint32_t batch : kBatches) {
+        std::string name = "throughput" + prefix + std::to_string(sz) +
+                           "B/x" + std::to_string(batch);
+        rtl_bench::register_benchmark_variant(
+            name, throughput, link_config::encode(p, sz, batch));
+      }
+    }
+  }
 
-  return 0;
-}
\ No newline at end of file
+  return rtl_bench::run(argc, argv);
+}
@@ -0,0 +1,165 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// rtl::shared_ptr against std::shared_ptr, copying and destroying from
+// 1..N threads.  The argument is the number of threads; every operation
+// copies a shared pointer and destroys the copy, i.e. one increment and one
+// decrement of the strong count.
+//
+//    shared   every thread copies the same pointer, so they all fight over
+//             one control block
+//    private  every thread copies its own pointer
+//
+// Every control block gets cache lines of its own and every thread copies
+// from a pointer on its own stack, so the private case has no false
+// sharing.
+//
+// Every sample runs --ops operations on every thread, the reported time is
+// wall clock per operation over all threads and Mops/s the throughput.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "rtl_bench/harness.hpp"
+#include "rtlcpp/rtlcpp.hpp"
+
+namespace {
+
+// Hands out whole, aligned cache lines
+void* allocate_lines(size_t sz) {
+  size_t rounded = (sz + RTL_CACHE_LINE_SIZE - 1U) / RTL_CACHE_LINE_SIZE *
+                   RTL_CACHE_LINE_SIZE;
+  void* p = nullptr;
+  return posix_memalign(&p, RTL_CACHE_LINE_SIZE, rounded) == 0 ? p : nullptr;
+}
+
+struct line_alloc {
+  void* allocate(size_t sz) { return allocate_lines(sz); }
+  void deallocate(void* p) { std::free(p); }
+};
+
+template <typename T>
+struct std_line_alloc {
+  using value_type = T;
+
+  std_line_alloc() = default;
+  template <typename U>
+  std_line_alloc(std_line_alloc<U> const&) {}
+
+  T* allocate(size_t n) {
+    void* p = allocate_lines(n * sizeof(T));
+    if (p == nullptr) throw std::bad_alloc();
+    return static_cast<T*>(p);
+  }
+  void deallocate(T* p, size_t) { std::free(p); }
+};
+
+template <typename T, typename U>
+bool operator==(std_line_alloc<T> const&, std_line_alloc<U> const&) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(std_line_alloc<T> const&, std_line_alloc<U> const&) {
+  return false;
+}
+
+line_alloc g_alloc;
+
+struct rtl_ptr {
+  using type = rtl::shared_ptr<uint64_t, line_alloc>;
+  static type make() { return rtl::make_shared<uint64_t>(&g_alloc, 42U); }
+};
+
+struct std_ptr {
+  using type = std::shared_ptr<uint64_t>;
+  static type make() {
+    return std::allocate_shared<uint64_t>(std_line_alloc<uint64_t>(), 42U);
+  }
+};
+
+template <typename Ptr, bool Shared>
+void run_copies(rtl_bench::state& st) {
+  const size_t threads = static_cast<size_t>(st.arg());
+  const uint64_t ops = static_cast<uint64_t>(rtl_bench::option_int("ops",
+                                                                   100000));
+
+  std::vector<typename Ptr::type> sources;
+  for (size_t t = 0U; t < (Shared ? 1U : threads); t++) {
+    sources.push_back(Ptr::make());
+    if (!sources.back()) {
+      st.skip("could not make the pointer");
+      return;
+    }
+  }
+
+  double total_ns = 0.0;
+  uint64_t total_ops = 0U;
+  while (st.keep_running()) {
+    std::atomic<size_t> ready{0U};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+
+    for (size_t t = 0U; t < threads; t++) {
+      workers.emplace_back([&, t]() {
+        // A copy on this thread's stack, only the control block is shared
+        typename Ptr::type src = sources[Shared ? 0U : t];
+        ready++;
+        while (!go.load(std::memory_order_acquire)) {
+        }
+        for (uint64_t i = 0U; i < ops; i++) {
+          typename Ptr::type copy(src);
+          rtl_bench::do_not_optimize(copy);
+        }
+      });
+    }
+
+    while (ready.load() < threads) {
+      std::this_thread::yield();
+    }
+    uint64_t start = rtl::cycle_clock::start();
+    go.store(true, std::memory_order_release);
+    for (std::thread& w : workers) w.join();
+    uint64_t end = rtl::cycle_clock::stop();
+
+    double ns = rtl::cycle_clock::to_ns(end - start);
+    st.record(ns, ops * threads);
+    total_ns += ns;
+    total_ops += ops * threads;
+  }
+
+  if (total_ns > 0.0) {
+    st.set_counter("Mops/s", static_cast<double>(total_ops) * 1e3 / total_ns);
+  }
+}
+
+void rtl_shared(rtl_bench::state& st) { run_copies<rtl_ptr, true>(st); }
+void rtl_private(rtl_bench::state& st) { run_copies<rtl_ptr, false>(st); }
+void std_shared(rtl_bench::state& st) { run_copies<std_ptr, true>(st); }
+void std_private(rtl_bench::state& st) { run_copies<std_ptr, false>(st); }
+
+}  // namespace
+
+RTL_BENCHMARK_ARGS(rtl_shared, 1, 2, 4, 8);
+RTL_BENCHMARK_ARGS(rtl_private, 1, 2, 4, 8);
+RTL_BENCHMARK_ARGS(std_shared, 1, 2, 4, 8);
+RTL_BENCHMARK_ARGS(std_private, 1, 2, 4, 8);
+
+RTL_BENCHMARK_MAIN();
@@ -0,0 +1,333 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// cyclictest style scheduling jitter of rtl::PeriodicTask.
+//
+// Runs --tasks periodic tasks for --duration-ms and records, per wake up:
+//
+//  - the wake up latency: how late the task woke compared to when it asked
+//    to (the end of its previous run plus the period)
+//  - the period error: how far the time between two wake ups is from the
+//    period, in either direction
+//
+// A wake up later than a full period is counted as an overrun.  Optionally
+// --load-threads threads burn cpu or memory bandwidth in the background.
+//
+// Real time policies need root or CAP_SYS_NICE, e.g.
+//
+//    sudo ./task_jitter_bench --tasks=4 --period-us=500 --policy=fifo
+//        --priority=80 --cpus=2,3 --duration-ms=60000 --load=memory
+//        --load-threads=2
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rtl_bench/harness.hpp"
+#include "rtlcpp/rtlcpp.hpp"
+
+namespace {
+
+struct options {
+  uint64_t m_tasks = 1U;
+  uint64_t m_period_us = 1000U;
+  uint64_t m_period_step_us = 0U;
+  uint64_t m_duration_ms = 5000U;
+  std::string m_policy = "other";
+  uint64_t m_priority = 0U;
+  std::vector<int> m_cpus;
+  std::string m_load = "none";
+  uint64_t m_load_threads = 0U;
+  std::vector<int> m_load_cpus;
+};
+
+void print_usage(const char* prog) {
+  std::cerr
+      << "Usage: " << prog << " [options]\n"
+      << "  --tasks=<n>            periodic tasks (default 1)\n"
+      << "  --period-us=<n>        period of the first task (default 1000)\n"
+      << "  --period-step-us=<n>   added to the period of every next task\n"
+      << "  --duration-ms=<n>      how long to run (default 5000)\n"
+      << "  --policy=<p>           other, fifo or rr (default other)\n"
+      << "  --priority=<n>         priority for fifo and rr\n"
+      << "  --cpus=<a,b,...>       pin task i to cpus[i % n]\n"
+      << "  --load=<l>             none, cpu or memory (default none)\n"
+      << "  --load-threads=<n>     background load threads (default 0)\n"
+      << "  --load-cpus=<a,b,...>  pin load thread i to load_cpus[i % n]\n";
+}
+
+bool parse_cpus(std::string const& s, std::vector<int>* out) {
+  std::stringstream ss(s);
+  std::string part;
+  while (std::getline(ss, part, ',')) {
+    char* end = nullptr;
+    long v = std::strtol(part.c_str(), &end, 10);
+    if (part.empty() || *end != '\0' || v < 0) {
+      return false;
+    }
+    out->push_back(static_cast<int>(v));
+  }
+  return true;
+}
+
+bool parse_args(int argc, char** argv, options* o) {
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    size_t eq = a.find('=');
+    if (a.compare(0, 2, "--") != 0 || eq == std::string::npos) {
+      return false;
+    }
+    std::string key = a.substr(2, eq - 2);
+    std::string val = a.substr(eq + 1);
+
+    if (key == "policy") {
+      o->m_policy = val;
+      if (val != "other" && val != "fifo" && val != "rr") return false;
+      continue;
+    }
+    if (key == "load") {
+      o->m_load = val;
+      if (val != "none" && val != "cpu" && val != "memory") return false;
+      continue;
+    }
+    if (key == "cpus" || key == "load-cpus") {
+      if (!parse_cpus(val, key == "cpus" ? &o->m_cpus : &o->m_load_cpus)) {
+        return false;
+      }
+      continue;
+    }
+
+    char* end = nullptr;
+    uint64_t v = std::strtoull(val.c_str(), &end, 10);
+    if (val.empty() || *end != '\0') {
+      return false;
+    }
+    if (key == "tasks") {
+      o->m_tasks = v;
+    } else if (key == "period-us") {
+      o->m_period_us = v;
+    } else if (key == "period-step-us") {
+      o->m_period_step_us = v;
+    } else if (key == "duration-ms") {
+      o->m_duration_ms = v;
+    } else if (key == "priority") {
+      o->m_priority = v;
+    } else if (key == "load-threads") {
+      o->m_load_threads = v;
+    } else {
+      return false;
+    }
+  }
+  return o->m_tasks > 0U && o->m_period_us > 0U;
+}
+
+// Everything a task records, only written by the task's own thread
+struct task_state {
+  int m_cpu;
+  uint64_t m_period_ticks;
+  uint64_t m_end;
+  rtl_bench::heap_allocator m_heap;
+  rtl_bench::histogram m_latency;
+  rtl_bench::histogram m_period_error;
+  uint64_t m_overruns;
+  uint64_t m_prev_wake;
+  uint64_t m_prev_exit;
+  bool m_pin_failed;
+
+  task_state(int cpu, uint64_t period_ticks, uint64_t end)
+      : m_cpu(cpu),
+        m_period_ticks(period_ticks),
+        m_end(end),
+        m_heap(),
+        m_latency(&m_heap),
+        m_period_error(&m_heap),
+        m_overruns(0U),
+        m_prev_wake(0U),
+        m_prev_exit(0U),
+        m_pin_failed(false) {}
+
+  bool init() {
+    return rtl_bench::init_histogram(&m_latency) &&
+           rtl_bench::init_histogram(&m_period_error);
+  }
+};
+
+uint64_t ticks_to_ps(uint64_t ticks) {
+  return static_cast<uint64_t>(rtl::cycle_clock::to_ns(ticks) * 1000.0);
+}
+
+struct jitter_task {
+  task_state* m_state;
+
+  // Returning true ends the task
+  bool operator()() {
+    uint64_t wake = rtl::cycle_clock::now();
+    task_state& s = *m_state;
+
+    if (s.m_prev_exit == 0U) {
+      // First run, not a timed wake up
+      if (s.m_cpu >= 0 && !rtl_bench::pin_thread_to_cpu(s.m_cpu)) {
+        s.m_pin_failed = true;
+        return true;
+      }
+    } else {
+      uint64_t expected = s.m_prev_exit + s.m_period_ticks;
+      uint64_t late = wake > expected ? wake - expected : 0U;
+      s.m_latency.record(ticks_to_ps(late));
+      if (late > s.m_period_ticks) {
+        s.m_overruns++;
+      }
+
+      uint64_t interval = wake - s.m_prev_wake;
+      uint64_t err = interval > s.m_period_ticks
+                         ? interval - s.m_period_ticks
+                         : s.m_period_ticks - interval;
+      s.m_period_error.record(ticks_to_ps(err));
+    }
+
+    s.m_prev_wake = wake;
+    s.m_prev_exit = rtl::cycle_clock::now();
+    return wake >= s.m_end;
+  }
+};
+
+void run_load(std::string const& kind, int cpu, std::atomic<bool>& stop) {
+  if (cpu >= 0) {
+    (void)rtl_bench::pin_thread_to_cpu(cpu);
+  }
+
+  if (kind == "cpu") {
+    uint64_t x = 1U;
+    while (!stop.load(std::memory_order_relaxed)) {
+      for (int i = 0; i < 1000; i++) x = x * 6364136223846793005ULL + 1U;
+      rtl_bench::do_not_optimize(x);
+    }
+    return;
+  }
+
+  // Larger than any last level cache so every copy goes to memory
+  const size_t kSize = 64U * 1024U * 1024U;
+  std::vector<unsigned char> a(kSize, 1U), b(kSize, 2U);
+  while (!stop.load(std::memory_order_relaxed)) {
+    std::memcpy(b.data(), a.data(), kSize);
+    rtl_bench::clobber_memory();
+  }
+}
+
+double ps_to_us(uint64_t ps) { return static_cast<double>(ps) / 1e6; }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  options o;
+  if (!parse_args(argc, argv, &o)) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  int policy = SCHED_OTHER;
+  if (o.m_policy == "fifo") policy = SCHED_FIFO;
+  if (o.m_policy == "rr") policy = SCHED_RR;
+  struct sched_param param;
+  std::memset(&param, 0, sizeof(param));
+  param.sched_priority = static_cast<int>(o.m_priority);
+
+  rtl::cycle_clock::calibrate();
+
+  uint64_t end = rtl::cycle_clock::now() +
+                 rtl::cycle_clock::from_ns(o.m_duration_ms * 1e6);
+
+  std::vector<std::unique_ptr<task_state>> states;
+  std::vector<std::unique_ptr<rtl::PeriodicTask<jitter_task>>> tasks;
+  for (uint64_t i = 0U; i < o.m_tasks; i++) {
+    uint64_t period_us = o.m_period_us + i * o.m_period_step_us;
+    int cpu = o.m_cpus.empty() ? -1 : o.m_cpus[i % o.m_cpus.size()];
+    states.emplace_back(new task_state(
+        cpu, rtl::cycle_clock::from_ns(period_us * 1e3), end));
+    if (!states.back()->init()) {
+      std::cerr << "Could not allocate the histograms" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    std::chrono::microseconds period(period_us);
+    rtl::PeriodicTaskOptions opts =
+        o.m_policy == "other" ? rtl::PeriodicTaskOptions(period)
+                              : rtl::PeriodicTaskOptions(policy, param, period);
+    tasks.emplace_back(new rtl::PeriodicTask<jitter_task>(
+        jitter_task{states.back().get()}, opts));
+  }
+
+  // Only started once nothing can fail anymore, returning with joinable
+  // threads would terminate
+  std::atomic<bool> stop_load{false};
+  std::vector<std::thread> load;
+  for (uint64_t i = 0U; i < o.m_load_threads && o.m_load != "none"; i++) {
+    int cpu = o.m_load_cpus.empty()
+                  ? -1
+                  : o.m_load_cpus[i % o.m_load_cpus.size()];
+    load.emplace_back(run_load, o.m_load, cpu, std::ref(stop_load));
+  }
+
+  for (auto& t : tasks) t->start();
+  // Tasks end themselves once the duration is up
+  for (auto& t : tasks) t->join();
+
+  stop_load = true;
+  for (std::thread& t : load) t.join();
+
+  int rval = EXIT_SUCCESS;
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "task,cpu,period_us,wakeups,lat_min_us,lat_avg_us,lat_p99_us,"
+               "lat_p9999_us,lat_max_us,err_p9999_us,err_max_us,overruns\n";
+  for (size_t i = 0U; i < tasks.size(); i++) {
+    task_state const& s = *states[i];
+    if (tasks[i]->errored_out()) {
+      std::cerr << "Task " << i << " could not set its scheduling policy: "
+                << std::strerror(tasks[i]->error_num()) << std::endl;
+      rval = EXIT_FAILURE;
+      continue;
+    }
+    if (s.m_pin_failed) {
+      std::cerr << "Task " << i << " could not pin to cpu " << s.m_cpu
+                << std::endl;
+      rval = EXIT_FAILURE;
+      continue;
+    }
+
+    rtl_bench::histogram const& lat = s.m_latency;
+    rtl_bench::histogram const& err = s.m_period_error;
+    std::cout << i << "," << s.m_cpu << ","
+              << o.m_period_us + i * o.m_period_step_us << "," << lat.count()
+              << "," << ps_to_us(lat.min()) << "," << lat.mean() / 1e6 << ","
+              << ps_to_us(lat.value_at_percentile(99.0)) << ","
+              << ps_to_us(lat.value_at_percentile(99.99)) << ","
+              << ps_to_us(lat.max()) << ","
+              << ps_to_us(err.value_at_percentile(99.99)) << ","
+              << ps_to_us(err.max()) << "," << s.m_overruns << "\n";
+  }
+
+  return rval;
+}
@@ -12,193 +12,131 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+// Compares rtl::unordered_map against std::unordered_map (both with a max
+// load factor of 7).  Every sample times a single put/get/del of a random
+// key, the argument of each benchmark is the number of keys.
+
 #include <climits>
+#include <cstdlib>
 #include <iostream>
 #include <random>
 #include <unordered_map>
 #include <vector>
 
-#ifdef _WIN32
-#include <intrin.h>
-#elif __x86_64__
-#include <x86intrin.h>
-#elif __arm__
-static inline unsigned __rdtsc(void) {
-  unsigned cc;
-  asm volatile("mrc p15, 0, %0, c15, c12, 1" : "=r"(cc));
-  return cc;
-}
-#else
-#error "unknown platform"
-#endif
-
+#include "rtl_bench/harness.hpp"
 #include "rtlcpp/rtlcpp.hpp"
 
-struct results {
-  const char* map_type;
-  const char* op;
-  uint64_t num_count;
-  double time;
-};
+using RTLMap = rtl::unordered_map<int, int, rtl::RTAllocatorST>;
+using STDMap = std::unordered_map<int, int, rtl::hash<int>>;
 
-void print_result(results const& r) {
-  std::cout << r.map_type << "," << r.op << "," << r.num_count << "," << r.time
-            << std::endl;
-}
+static const size_t kBufSize = 500 * 1024 * 1024;
+static const float kMaxLoadFactor = 7.0F;
 
-void run_put(std::vector<int>& input,
-             rtl::unordered_map<int, int, rtl::RTAllocatorST>& m) {
-  auto start = std::chrono::high_resolution_clock::now();
-  auto end = std::chrono::high_resolution_clock::now();
-  for (int i : input) {
-    start = std::chrono::high_resolution_clock::now();
-    bool rval = m.put(i, i);
-    end = std::chrono::high_resolution_clock::now();
-    double elapsed_time =
-        std::chrono::duration<double, std::micro>(end - start).count();
-    if (rval) print_result({"RTL", "Put", input.size(), elapsed_time});
-  }
+static std::vector<int> make_input(size_t n) {
+  std::mt19937 engine(
+      static_cast<unsigned>(rtl_bench::option_int("seed", 42)));
+  std::uniform_int_distribution<int> dist(INT_MIN, INT_MAX);
+  std::vector<int> input;
+  input.reserve(n);
+  for (size_t i = 0; i < n; i++) input.push_back(dist(engine));
+  return input;
 }
 
-void run_put(std::vector<int>& input,
-             std::unordered_map<int, int, rtl::hash<int>>& m) {
-  auto start = std::chrono::high_resolution_clock::now();
-  auto end = std::chrono::high_resolution_clock::now();
-  for (int i : input) {
-    start = std::chrono::high_resolution_clock::now();
-    m[i] = i;
-    end = std::chrono::high_resolution_clock::now();
-    double elapsed_time =
-        std::chrono::duration<double, std::micro>(end - start).count();
-    print_result({"STD", "Put", input.size(), elapsed_time});
-  }
-}
+static rtl::MMapMemoryResource g_mr;
+static rtl::RTAllocatorST g_alloc;
 
-void run_get(std::vector<int>& input,
-             rtl::unordered_map<int, int, rtl::RTAllocatorST>& m) {
-  auto start = std::chrono::high_resolution_clock::now();
-  auto end = std::chrono::high_resolution_clock::now();
-  int* tmp;
-  for (int i : input) {
-    start = std::chrono::high_resolution_clock::now();
-    tmp = m.get(i);
-    end = std::chrono::high_resolution_clock::now();
+struct RTLFixture {
+  RTLMap m_map;
 
-    if (!tmp) continue;
+  RTLFixture() : m_map(&g_alloc, kMaxLoadFactor) {}
 
-    *tmp = 77;
+  void reset() { m_map = RTLMap(&g_alloc, kMaxLoadFactor); }
+  bool put(int k) { return m_map.put(k, k); }
+  int* get(int k) { return m_map.get(k); }
+  bool del(int k) { return m_map.del(k); }
+};
 
-    double elapsed_time =
-        std::chrono::duration<double, std::micro>(end - start).count();
-    print_result({"RTL", "Get", input.size(), elapsed_time});
-  }
-}
+struct STDFixture {
+  STDMap m_map;
 
-void run_get(std::vector<int>& input,
-             std::unordered_map<int, int, rtl::hash<int>>& m) {
-  auto start = std::chrono::high_resolution_clock::now();
-  auto end = std::chrono::high_resolution_clock::now();
-  int* tmp;
-  for (int i : input) {
-    start = std::chrono::high_resolution_clock::now();
-    tmp = &m[i];
-    end = std::chrono::high_resolution_clock::now();
-
-    *tmp = 77;
-
-    double elapsed_time =
-        std::chrono::duration<double, std::micro>(end - start).count();
-    print_result({"STD", "Get", input.size(), elapsed_time});
-  }
-}
+  STDFixture() { m_map.max_load_factor(kMaxLoadFactor); }
 
-void run_del(std::vector<int>& input,
-             rtl::unordered_map<int, int, rtl::RTAllocatorST>& m) {
-  auto start = std::chrono::high_resolution_clock::now();
-  auto end = std::chrono::high_resolution_clock::now();
-  for (int i : input) {
-    start = std::chrono::high_resolution_clock::now();
-    m.del(i);
-    end = std::chrono::high_resolution_clock::now();
-
-    double elapsed_time =
-        std::chrono::duration<double, std::micro>(end - start).count();
-    print_result({"RTL", "Del", input.size(), elapsed_time});
+  void reset() {
+    m_map = STDMap();
+    m_map.max_load_factor(kMaxLoadFactor);
   }
-}
-
-void run_del(std::vector<int>& input,
-             std::unordered_map<int, int, rtl::hash<int>>& m) {
-  auto start = std::chrono::high_resolution_clock::now();
-  auto end = std::chrono::high_resolution_clock::now();
-  for (int i : input) {
-    start = std::chrono::high_resolution_clock::now();
-    m.erase(i);
-    end = std::chrono::high_resolution_clock::now();
-
-    double elapsed_time =
-        std::chrono::duration<double, std::micro>(end - start).count();
-    print_result({"STD", "Del", input.size(), elapsed_time});
+  bool put(int k) {
+    m_map[k] = k;
+    return true;
   }
-}
-
-struct SystemAllocator {
-  void* allocate(size_t sz) { return malloc(sz); }
-
-  void deallocate(void* p) { free(p); }
+  int* get(int k) { return &m_map[k]; }
+  bool del(int k) { return m_map.erase(k) != 0U; }
 };
 
-int main() {
-  std::vector<uint64_t> number_count = {100, 1000, 10000, 100000, 150000};
-  std::vector<std::vector<int>> rand_nums;
-  rand_nums.resize(number_count.size());
-
-  std::random_device seeder;
-  std::mt19937 engine(seeder());
-  std::uniform_int_distribution<int> dist(INT_MIN, INT_MAX);
-  int count = 0;
-  for (uint64_t n : number_count) {
-    for (uint64_t i = 0; i < n; i++) {
-      rand_nums[count].push_back(dist(engine));
-    }
-    count++;
-  }
-
-#ifdef NDEBUG
-  std::cerr << "RELEASE BUILD" << std::endl;
-#else
-  std::cerr << "DEBUG BUILD" << std::endl;
-#endif
+enum class Op { kPut, kGet, kDel };
 
-  std::cout << "MapType,Operation,NumCount,TimeMicro" << std::endl;
+template <typename Fixture, Op op>
+void run_map(rtl_bench::state& st) {
+  std::vector<int> input = make_input(static_cast<size_t>(st.arg()));
+  Fixture f;
 
-  for (std::vector<int> in : rand_nums) {
-    std::unordered_map<int, int, rtl::hash<int>> stdm;
-    stdm.max_load_factor(7);
-
-    run_put(in, stdm);
-    run_get(in, stdm);
-    run_del(in, stdm);
-  }
-
-  const size_t buf_size{500 * 1024 * 1024};
-  {
-    rtl::MMapMemoryResource mr;
-    rtl::RTAllocatorST allocST;
-
-    if (!mr.init(buf_size)) {
-      std::cerr << "Could not initialize buffer" << std::endl;
-      return EXIT_FAILURE;
+  // Every pass goes over all of the keys so each size is timed from an empty
+  // map up to arg() entries, a repetition ends after the pass that reaches
+  // the sample count
+  while (st.keep_running()) {
+    f.reset();
+    if (op != Op::kPut) {
+      for (int k : input) f.put(k);
     }
-    if (!allocST.init(mr.get_buf(), mr.get_capacity())) return EXIT_FAILURE;
-    for (std::vector<int> in : rand_nums) {
-      rtl::unordered_map<int, int, rtl::RTAllocatorST> rtlm(&allocST, 7);
 
-      run_put(in, rtlm);
-      run_get(in, rtlm);
-      run_del(in, rtlm);
+    for (int k : input) {
+      switch (op) {
+        case Op::kPut: {
+          st.start_timer();
+          bool r = f.put(k);
+          st.stop_timer();
+          rtl_bench::do_not_optimize(r);
+          break;
+        }
+        case Op::kGet: {
+          st.start_timer();
+          int* r = f.get(k);
+          st.stop_timer();
+          if (r != nullptr) *r = 77;
+          break;
+        }
+        case Op::kDel: {
+          st.start_timer();
+          bool r = f.del(k);
+          st.stop_timer();
+          rtl_bench::do_not_optimize(r);
+          break;
+        }
+      }
     }
   }
+}
+
+static void rtl_put(rtl_bench::state& st) { run_map<RTLFixture, Op::kPut>(st); }
+static void rtl_get(rtl_bench::state& st) { run_map<RTLFixture, Op::kGet>(st); }
+static void rtl_del(rtl_bench::state& st) { run_map<RTLFixture, Op::kDel>(st); }
+static void std_put(rtl_bench::state& st) { run_map<STDFixture, Op::kPut>(st); }
+static void std_get(rtl_bench::state& st) { run_map<STDFixture, Op::kGet>(st); }
+static void std_del(rtl_bench::state& st) { run_map<STDFixture, Op::kDel>(st); }
+
+RTL_BENCHMARK_ARGS(rtl_put, 100, 1000, 10000, 100000, 150000);
+RTL_BENCHMARK_ARGS(rtl_get, 100, 1000, 10000, 100000, 150000);
+RTL_BENCHMARK_ARGS(rtl_del, 100, 1000, 10000, 100000, 150000);
+RTL_BENCHMARK_ARGS(std_put, 100, 1000, 10000, 100000, 150000);
+RTL_BENCHMARK_ARGS(std_get, 100, 1000, 10000, 100000, 150000);
+RTL_BENCHMARK_ARGS(std_del, 100, 1000, 10000, 100000, 150000);
+
+int main(int argc, char** argv) {
+  if (!g_mr.init(kBufSize)) {
+    std::cerr << "Could not initialize buffer" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (!g_alloc.init(g_mr.get_buf(), g_mr.get_capacity())) return EXIT_FAILURE;
 
-  return EXIT_SUCCESS;
+  return rtl_bench::run(argc, argv);
 }
@@ -0,0 +1,459 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Workload matrix for rtl::unordered_map against std::unordered_map (both
+// with a max load factor of 7 and the same hash).  Benchmarks are named
+//
+//    <map>/<key>/<access>/<mix>/<keys>
+//
+//    map     rtl or std
+//    key     int, pod16 (a 16 byte struct) or string (24 characters, too
+//            long for the small string optimization)
+//    access  uniform or zipf (theta 0.99, the hottest keys are random ones)
+//    mix     read   95% get, 5% overwrite of an existing key
+//            write  50% get, 50% overwrite of an existing key
+//            churn  delete a live key and insert a new one, the number of
+//                   keys stays the same
+//            grow   insert all keys into an empty map, one put per sample
+//    keys    1K to 100M keys in the map
+//
+// The map is filled (and rtl's resize finished) before anything is timed.
+// read, write and churn time batches of operations; after every batch one
+// more operation is timed on its own for the per operation tail latency
+// counters (op_p50/p99/p999/max_ns).  grow times every put and splits them
+// by whether rtl::unordered_map was in the middle of an amortized resize
+// (TRANSFER) at the time:
+//
+//    transfer_pct          percent of puts done while in TRANSFER
+//    stable_p99/max_ns     put latency while STABLE
+//    transfer_p99/max_ns   put latency while TRANSFER
+//
+// Options:
+//
+//    --max-keys=<n>  sizes above this are skipped (default 10000000)
+//    --arena-mb=<n>  TLSF arena for the rtl maps (default 2048, capped at
+//                    rtl_tlsf_maximum_arena_size())
+//    --seed=<n>      seed of the keys and the access pattern (default 42)
+//
+// The matrix is large, use --filter to pick a slice, e.g.
+//
+//    ./unordered_map_matrix_bench --filter=/string/zipf/ --max-keys=100000000
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "rtl_bench/harness.hpp"
+#include "rtlcpp/rtlcpp.hpp"
+
+namespace {
+
+const float kMaxLoadFactor = 7.0F;
+const uint64_t kBatch = 64U;
+const size_t kStreamLen = 1U << 16U;
+
+struct pod16 {
+  uint64_t m_a;
+  uint64_t m_b;
+
+  bool operator==(pod16 const& o) const {
+    return m_a == o.m_a && m_b == o.m_b;
+  }
+};
+
+// Both maps hash with rtl::hash so neither gets a better distribution
+struct key_hash {
+  template <typename K>
+  uint32_t operator()(K const& k) const {
+    return rtl::hash<K>()(k);
+  }
+};
+
+// splitmix64 finalizer, a bijection so distinct ids give distinct keys
+uint64_t mix64(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27U)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31U);
+}
+
+template <typename K>
+K make_key(uint64_t id);
+
+template <>
+int make_key<int>(uint64_t id) {
+  // Multiplying by an odd constant is a bijection mod 2^32
+  return static_cast<int>(static_cast<uint32_t>(id) * 0x9E3779B1U);
+}
+
+template <>
+pod16 make_key<pod16>(uint64_t id) {
+  return pod16{mix64(id), id};
+}
+
+template <>
+std::string make_key<std::string>(uint64_t id) {
+  std::string s = std::to_string(mix64(id));
+  return "key-" + std::string(20U - s.size(), '0') + s;
+}
+
+// Zipfian ranks in [0, n), Gray et al. "Quickly generating billion-record
+// synthetic databases"
+class zipf_generator {
+ public:
+  zipf_generator(uint64_t n, double theta)
+      : m_n(static_cast<double>(n)),
+        m_theta(theta),
+        m_alpha(1.0 / (1.0 - theta)),
+        m_zetan(zeta(n, theta)),
+        m_eta(0.0) {
+    m_eta = (1.0 - std::pow(2.0 / m_n, 1.0 - theta)) /
+            (1.0 - zeta(2U, theta) / m_zetan);
+  }
+
+  template <typename Gen>
+  uint64_t operator()(Gen& gen) {
+    double u = std::generate_canonical<double, 53>(gen);
+    double uz = u * m_zetan;
+    if (uz < 1.0) return 0U;
+    if (uz < 1.0 + std::pow(0.5, m_theta)) return 1U;
+    uint64_t r = static_cast<uint64_t>(
+        m_n * std::pow(m_eta * u - m_eta + 1.0, m_alpha));
+    return r < static_cast<uint64_t>(m_n) ? r : 0U;
+  }
+
+ private:
+  static double zeta(uint64_t n, double theta) {
+    double sum = 0.0;
+    for (uint64_t i = 1U; i <= n; i++) {
+      sum += 1.0 / std::pow(static_cast<double>(i), theta);
+    }
+    return sum;
+  }
+
+  double m_n;
+  double m_theta;
+  double m_alpha;
+  double m_zetan;
+  double m_eta;
+};
+
+rtl::MMapMemoryResource g_mr;
+rtl::RTAllocatorST g_alloc;
+
+// The arena size is an option, so it is mapped by the first benchmark
+bool init_arena() {
+  static bool tried = false;
+  static bool ok = false;
+  if (!tried) {
+    tried = true;
+    size_t sz = static_cast<size_t>(rtl_bench::option_int("arena-mb", 2048)) *
+                1024U * 1024U;
+    if (sz > rtl_tlsf_maximum_arena_size()) {
+      sz = rtl_tlsf_maximum_arena_size();
+    }
+    ok = g_mr.init(sz) && g_alloc.init(g_mr.get_buf(), g_mr.get_capacity());
+  }
+  return ok;
+}
+
+template <typename K>
+struct rtl_fixture {
+  using map_type = rtl::unordered_map<K, int, rtl::RTAllocatorST>;
+  map_type m_map;
+
+  rtl_fixture() : m_map(&g_alloc, kMaxLoadFactor) {}
+
+  bool put(K const& k, int v) { return m_map.put(k, v); }
+  int* get(K const& k) { return m_map.get(k); }
+  bool del(K const& k) { return m_map.del(k); }
+  bool settle() { return m_map.finalize(); }
+  bool in_transfer() const {
+    return m_map.get_state() == map_type::MapState::TRANSFER;
+  }
+};
+
+template <typename K>
+struct std_fixture {
+  std::unordered_map<K, int, key_hash> m_map;
+
+  std_fixture() { m_map.max_load_factor(kMaxLoadFactor); }
+
+  bool put(K const& k, int v) {
+    m_map[k] = v;
+    return true;
+  }
+  int* get(K const& k) {
+    auto it = m_map.find(k);
+    return it == m_map.end() ? nullptr : &it->second;
+  }
+  bool del(K const& k) { return m_map.erase(k) != 0U; }
+  bool settle() { return true; }
+  bool in_transfer() const { return false; }
+};
+
+enum class key_kind { kInt = 0, kPod16, kString, kNum };
+enum class access_pattern { kUniform = 0, kZipf, kNum };
+enum class mix { kRead = 0, kWrite, kChurn, kGrow, kNum };
+
+const char* const kKeyNames[] = {"int", "pod16", "string"};
+const char* const kAccessNames[] = {"uniform", "zipf"};
+const char* const kMixNames[] = {"read", "write", "churn", "grow"};
+const char* const kSizeNames[] = {"1K", "10K", "100K", "1M", "10M", "100M"};
+const uint64_t kSizes[] = {1000U,    10000U,    100000U,
+                           1000000U, 10000000U, 100000000U};
+const int kNumSizes = 6;
+
+struct config {
+  access_pattern m_access;
+  mix m_mix;
+  uint64_t m_keys;
+};
+
+// arg = access * 100 + mix * 10 + size index, the map and key types are
+// template parameters
+int64_t encode(access_pattern a, mix m, int size) {
+  return static_cast<int64_t>(a) * 100 + static_cast<int64_t>(m) * 10 + size;
+}
+
+config decode(int64_t arg) {
+  return config{static_cast<access_pattern>(arg / 100),
+                static_cast<mix>((arg / 10) % 10),
+                kSizes[arg % 10]};
+}
+
+// The top two bits of every stream entry pick get (0) or put (1), the rest
+// is the index of the key
+const uint32_t kIndexMask = (1U << 30U) - 1U;
+
+std::vector<uint32_t> make_stream(config const& c, uint64_t seed) {
+  std::mt19937_64 gen(seed);
+  std::uniform_int_distribution<uint64_t> uniform(0U, c.m_keys - 1U);
+  bool is_zipf = c.m_access == access_pattern::kZipf;
+  zipf_generator zipf(is_zipf ? c.m_keys : 2U, 0.99);
+  uint32_t put_pct = c.m_mix == mix::kRead ? 5U : 50U;
+
+  std::vector<uint32_t> stream(kStreamLen);
+  for (uint32_t& s : stream) {
+    uint64_t idx = is_zipf ? zipf(gen) : uniform(gen);
+    uint32_t is_put = gen() % 100U < put_pct ? 1U : 0U;
+    s = static_cast<uint32_t>(idx) | (is_put << 30U);
+  }
+  return stream;
+}
+
+void record_ticks(rtl_bench::histogram* h, uint64_t ticks) {
+  h->record(static_cast<uint64_t>(rtl::cycle_clock::to_ns(ticks) * 1000.0));
+}
+
+void set_tail_counters(rtl_bench::state& st, const char* prefix,
+                       rtl_bench::histogram const& h) {
+  std::string p(prefix);
+  if (h.count() == 0U) {
+    return;
+  }
+  st.set_counter((p + "_p50_ns").c_str(), h.value_at_percentile(50.0) / 1e3);
+  st.set_counter((p + "_p99_ns").c_str(), h.value_at_percentile(99.0) / 1e3);
+  st.set_counter((p + "_p999_ns").c_str(), h.value_at_percentile(99.9) / 1e3);
+  st.set_counter((p + "_max_ns").c_str(), h.max() / 1e3);
+}
+
+template <typename K, typename Fixture>
+void run_grow(rtl_bench::state& st, std::vector<K> const& keys) {
+  rtl_bench::heap_allocator heap;
+  rtl_bench::histogram stable(&heap);
+  rtl_bench::histogram transfer(&heap);
+  if (!rtl_bench::init_histogram(&stable) ||
+      !rtl_bench::init_histogram(&transfer)) {
+    st.skip("could not allocate the histograms");
+    return;
+  }
+
+  std::unique_ptr<Fixture> f(new Fixture());
+  size_t next = 0U;
+  while (st.keep_running()) {
+    if (next == keys.size()) {
+      f.reset(new Fixture());
+      next = 0U;
+    }
+    bool was_transfer = f->in_transfer();
+
+    uint64_t t0 = rtl::cycle_clock::start();
+    bool r = f->put(keys[next], 1);
+    uint64_t t1 = rtl::cycle_clock::stop();
+
+    if (!r) {
+      st.skip("put failed, the arena is too small (see --arena-mb)");
+      return;
+    }
+    st.record(rtl::cycle_clock::to_ns(t1 - t0), 1U);
+    record_ticks(was_transfer ? &transfer : &stable, t1 - t0);
+    next++;
+  }
+
+  uint64_t total = stable.count() + transfer.count();
+  if (total > 0U) {
+    st.set_counter("transfer_pct", 100.0 * static_cast<double>(
+                                               transfer.count()) /
+                                       static_cast<double>(total));
+  }
+  set_tail_counters(st, "stable", stable);
+  set_tail_counters(st, "transfer", transfer);
+}
+
+template <typename K, typename Fixture>
+void run_matrix(rtl_bench::state& st) {
+  config c = decode(st.arg());
+  if (c.m_keys > static_cast<uint64_t>(
+                     rtl_bench::option_int("max-keys", 10000000))) {
+    st.skip("more keys than --max-keys");
+    return;
+  }
+  if (!init_arena()) {
+    st.skip("could not map the arena");
+    return;
+  }
+
+  uint64_t seed = static_cast<uint64_t>(rtl_bench::option_int("seed", 42));
+  // Churn inserts from a pool of spare keys and puts the deleted ones back
+  // into it
+  size_t spare = c.m_mix == mix::kChurn ? c.m_keys / 8U + 1U : 0U;
+  std::vector<K> keys;
+  keys.reserve(c.m_keys + spare);
+  for (uint64_t i = 0U; i < c.m_keys + spare; i++) {
+    keys.push_back(make_key<K>(mix64(seed) + i));
+  }
+
+  if (c.m_mix == mix::kGrow) {
+    run_grow<K, Fixture>(st, keys);
+    return;
+  }
+
+  std::unique_ptr<Fixture> f(new Fixture());
+  for (uint64_t i = 0U; i < c.m_keys; i++) {
+    if (!f->put(keys[i], static_cast<int>(i))) {
+      st.skip("put failed, the arena is too small (see --arena-mb)");
+      return;
+    }
+  }
+  if (!f->settle()) {
+    st.skip("could not finish resizing");
+    return;
+  }
+
+  std::vector<uint32_t> stream = make_stream(c, seed);
+  size_t pos = 0U;
+  size_t next_spare = 0U;
+  uint64_t found = 0U;
+
+  // One operation of the mix, returns the number of map calls it made
+  auto op = [&]() -> uint64_t {
+    uint32_t s = stream[pos];
+    pos = (pos + 1U) & (kStreamLen - 1U);
+    size_t idx = s & kIndexMask;
+
+    if (c.m_mix == mix::kChurn) {
+      size_t j = c.m_keys + next_spare;
+      next_spare = next_spare + 1U == spare ? 0U : next_spare + 1U;
+      bool d = f->del(keys[idx]);
+      bool p = f->put(keys[j], 1);
+      std::swap(keys[idx], keys[j]);
+      found += (d && p) ? 1U : 0U;
+      return 2U;
+    }
+    if ((s >> 30U) != 0U) {
+      found += f->put(keys[idx], 2) ? 1U : 0U;
+    } else {
+      int* v = f->get(keys[idx]);
+      found += v != nullptr ? 1U : 0U;
+    }
+    return 1U;
+  };
+
+  rtl_bench::heap_allocator heap;
+  rtl_bench::histogram single(&heap);
+  if (!rtl_bench::init_histogram(&single)) {
+    st.skip("could not allocate the histograms");
+    return;
+  }
+
+  double total_ns = 0.0;
+  uint64_t total_ops = 0U;
+  while (st.keep_running()) {
+    uint64_t ops = 0U;
+    uint64_t t0 = rtl::cycle_clock::start();
+    for (uint64_t i = 0U; i < st.batch_size(); i++) ops += op();
+    uint64_t t1 = rtl::cycle_clock::stop();
+    double ns = rtl::cycle_clock::to_ns(t1 - t0);
+    st.record(ns, ops);
+    total_ns += ns;
+    total_ops += ops;
+
+    // Outside of the batch so the fences don't slow the batch down
+    uint64_t s0 = rtl::cycle_clock::start();
+    uint64_t n = op();
+    uint64_t s1 = rtl::cycle_clock::stop();
+    record_ticks(&single, (s1 - s0) / n);
+  }
+  rtl_bench::do_not_optimize(found);
+
+  if (total_ns > 0.0) {
+    st.set_counter("Mops/s", static_cast<double>(total_ops) * 1e3 / total_ns);
+  }
+  set_tail_counters(st, "op", single);
+}
+
+template <typename K>
+void register_key(key_kind k) {
+  for (int a = 0; a < static_cast<int>(access_pattern::kNum); a++) {
+    for (int m = 0; m < static_cast<int>(mix::kNum); m++) {
+      // The order keys are inserted in doesn't depend on the access pattern
+      if (m == static_cast<int>(mix::kGrow) &&
+          a != static_cast<int>(access_pattern::kUniform)) {
+        continue;
+      }
+      for (int s = 0; s < kNumSizes; s++) {
+        std::string suffix = std::string("/") +
+                             kKeyNames[static_cast<int>(k)] + "/" +
+                             kAccessNames[a] + "/" + kMixNames[m] + "/" +
+                             kSizeNames[s];
+        int64_t arg =
+            encode(static_cast<access_pattern>(a), static_cast<mix>(m), s);
+        uint64_t batch = m == static_cast<int>(mix::kGrow) ? 1U : kBatch;
+
+        rtl_bench::register_benchmark_variant(
+            "rtl" + suffix, run_matrix<K, rtl_fixture<K>>, arg, batch);
+        rtl_bench::register_benchmark_variant(
+            "std" + suffix, run_matrix<K, std_fixture<K>>, arg, batch);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  register_key<int>(key_kind::kInt);
+  register_key<pod16>(key_kind::kPod16);
+  register_key<std::string>(key_kind::kString);
+
+  return rtl_bench::run(argc, argv);
+}
@@ -0,0 +1,112 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// rtl::vector against std::vector.  Every sample fills an empty vector with
+// arg() ints and reports the time per push_back:
+//
+//    grow     no reserve(), the vector doubles its capacity as it goes
+//    reserve  reserve(arg()) first (included in the time)
+//    reuse    clear() a vector that already has the capacity and refill it
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "rtl_bench/harness.hpp"
+#include "rtlcpp/rtlcpp.hpp"
+
+namespace {
+
+const size_t kArenaSize = 64U * 1024U * 1024U;
+
+rtl::MMapMemoryResource g_mr;
+rtl::RTAllocatorST g_alloc;
+
+enum class fill { kGrow, kReserve, kReuse };
+
+template <fill F>
+void rtl_fill(rtl_bench::state& st) {
+  const size_t n = static_cast<size_t>(st.arg());
+  rtl::vector<int, rtl::RTAllocatorST> warm(&g_alloc);
+  if (F == fill::kReuse && !warm.reserve(n)) {
+    st.skip("reserve failed");
+    return;
+  }
+
+  while (st.keep_running()) {
+    rtl::vector<int, rtl::RTAllocatorST> fresh(&g_alloc);
+    rtl::vector<int, rtl::RTAllocatorST>& v = F == fill::kReuse ? warm : fresh;
+    bool ok = true;
+
+    st.start_timer();
+    if (F == fill::kReserve) ok = v.reserve(n);
+    if (F == fill::kReuse) v.clear();
+    for (size_t i = 0U; i < n; i++) ok &= v.push_back(static_cast<int>(i));
+    st.stop_timer(n);
+
+    if (!ok) {
+      st.skip("push_back failed");
+      return;
+    }
+    rtl_bench::do_not_optimize(v[n - 1U]);
+  }
+}
+
+template <fill F>
+void std_fill(rtl_bench::state& st) {
+  const size_t n = static_cast<size_t>(st.arg());
+  std::vector<int> warm;
+  if (F == fill::kReuse) warm.reserve(n);
+
+  while (st.keep_running()) {
+    std::vector<int> fresh;
+    std::vector<int>& v = F == fill::kReuse ? warm : fresh;
+
+    st.start_timer();
+    if (F == fill::kReserve) v.reserve(n);
+    if (F == fill::kReuse) v.clear();
+    for (size_t i = 0U; i < n; i++) v.push_back(static_cast<int>(i));
+    st.stop_timer(n);
+
+    rtl_bench::do_not_optimize(v[n - 1U]);
+  }
+}
+
+void rtl_grow(rtl_bench::state& st) { rtl_fill<fill::kGrow>(st); }
+void rtl_reserve(rtl_bench::state& st) { rtl_fill<fill::kReserve>(st); }
+void rtl_reuse(rtl_bench::state& st) { rtl_fill<fill::kReuse>(st); }
+void std_grow(rtl_bench::state& st) { std_fill<fill::kGrow>(st); }
+void std_reserve(rtl_bench::state& st) { std_fill<fill::kReserve>(st); }
+void std_reuse(rtl_bench::state& st) { std_fill<fill::kReuse>(st); }
+
+}  // namespace
+
+RTL_BENCHMARK_ARGS(rtl_grow, 16, 1024, 65536);
+RTL_BENCHMARK_ARGS(rtl_reserve, 16, 1024, 65536);
+RTL_BENCHMARK_ARGS(rtl_reuse, 16, 1024, 65536);
+RTL_BENCHMARK_ARGS(std_grow, 16, 1024, 65536);
+RTL_BENCHMARK_ARGS(std_reserve, 16, 1024, 65536);
+RTL_BENCHMARK_ARGS(std_reuse, 16, 1024, 65536);
+
+int main(int argc, char** argv) {
+  if (!g_mr.init(kArenaSize)) {
+    std::cerr << "Could not initialize buffer" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (!g_alloc.init(g_mr.get_buf(), g_mr.get_capacity())) return EXIT_FAILURE;
+
+  return rtl_bench::run(argc, argv);
+}
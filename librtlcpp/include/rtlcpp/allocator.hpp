@@ -217,4 +217,8 @@ using RTDefaultAllocator = RTAllocatorMT;
 
 }  // namespace rtl
 
+#if defined(RTL_HEADER_ONLY)
+#include "rtlcpp/allocator_impl.hpp"
+#endif
+
 #endif  // RTLCPP_CONCENTS_ALLOCATOR_HPP
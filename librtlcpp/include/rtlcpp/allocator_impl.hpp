@@ -0,0 +1,102 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The out of line part of detail::RTAllocator.  Compiled once into
+// librtlcpp by allocator.cpp, or with RTL_HEADER_ONLY included by
+// allocator.hpp so allocate() and deallocate() inline into the containers
+// along with the TLSF functions.  Don't include this directly.
+
+#ifndef RTLCPP_ALLOCATOR_IMPL_HPP
+#define RTLCPP_ALLOCATOR_IMPL_HPP
+
+#include <cassert>
+
+#include "rtlcpp/allocator.hpp"
+#include "rtlcpp/utility.hpp"
+
+#if defined(RTL_HEADER_ONLY)
+#define RTLCPP_ALLOCATOR_INLINE inline
+#else
+#define RTLCPP_ALLOCATOR_INLINE
+#endif
+
+namespace rtl {
+
+namespace detail {
+
+RTLCPP_ALLOCATOR_INLINE RTAllocator::RTAllocator(RTAllocator&& o) noexcept
+    : m_initialized(rtl::exchange(o.m_initialized, false)),
+      m_arena(rtl::exchange(o.m_arena, nullptr)),
+      m_buf(rtl::exchange(o.m_buf, nullptr)),
+      m_capacity(rtl::exchange(o.m_capacity, 0)) {}
+
+RTLCPP_ALLOCATOR_INLINE RTAllocator& RTAllocator::operator=(
+    RTAllocator&& o) noexcept {
+  if (this != &o) {
+    m_initialized = rtl::exchange(o.m_initialized, false);
+    m_arena = rtl::exchange(o.m_arena, nullptr);
+    m_buf = rtl::exchange(o.m_buf, nullptr);
+    m_capacity = rtl::exchange(o.m_capacity, 0);
+  }
+  return *this;
+}
+
+RTLCPP_ALLOCATOR_INLINE void* RTAllocator::allocate(std::size_t bytes) {
+  assert(m_initialized);
+  return rtl_tlsf_alloc(m_arena, bytes);
+}
+
+RTLCPP_ALLOCATOR_INLINE void RTAllocator::deallocate(void* p) {
+  assert(m_initialized);
+  rtl_tlsf_free(m_arena, p);
+}
+
+RTLCPP_ALLOCATOR_INLINE bool RTAllocator::init(void* buf, size_t capacity) {
+  if (m_initialized) {
+    return true;
+  }
+
+  if (capacity == 0U) {
+    return false;
+  }
+
+  m_capacity = capacity;
+
+  m_buf = buf;
+
+  if (rtl_tlsf_make_arena(&m_arena, m_buf, m_capacity) < 0) {
+    return false;
+  }
+
+  m_initialized = true;
+
+  return true;
+}
+
+RTLCPP_ALLOCATOR_INLINE void RTAllocator::uninit() {
+  if (!m_initialized) {
+    return;
+  }
+
+  m_buf = nullptr;
+  m_arena = nullptr;
+  m_capacity = 0U;
+  m_initialized = false;
+}
+
+}  // namespace detail
+
+}  // namespace rtl
+
+#endif  // RTLCPP_ALLOCATOR_IMPL_HPP
@@ -0,0 +1,304 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RTLCPP_BLOOM_FILTER_HPP
+#define RTLCPP_BLOOM_FILTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "rtl/pounds.h"  // For RTL_CACHE_LINE_SIZE and RTL_PREFETCH
+#include "rtlcpp/allocator.hpp"
+#include "rtlcpp/hash.hpp"
+#include "rtlcpp/utility.hpp"
+
+namespace rtl {
+
+/*!
+ * A split block Bloom filter, answering "definitely not present" or
+ * "maybe present" for keys of type Key.
+ *
+ * The filter is an array of 256 bit blocks starting on a cache line
+ * boundary, two to a 64 byte line, so no block straddles two lines.  A
+ * key picks one block and sets (or tests) one bit in each of the block's
+ * eight 32 bit words, so a query reads exactly one cache line.  The eight
+ * bit positions come from multiplying the hash by eight odd constants, a
+ * loop with no branches the compiler can vectorize.
+ *
+ * With the default of 16 bits per expected key the false positive rate is
+ * about 0.15%, with 10 bits about 1.3%.  Keys can't be removed; once many more
+ * keys than expected were inserted (or many were deleted from the
+ * structure the filter guards) clear() and re-insert the live ones.
+ *
+ * The blocks are allocated once by init(), after that nothing allocates.
+ * A filter that isn't initialized says "maybe" to everything.
+ *
+ * This class is not thread-safe.
+ *
+ * @tparam Key the type of the keys, hashed with rtl::hash<Key>
+ * @tparam Alloc the allocator provided
+ */
+template <typename Key, typename Alloc = RTDefaultAllocator>
+class bloom_filter {
+ public:
+  //! 32 bit words per block, one bit is set in each
+  static const size_t kBlockWords = 8U;
+
+  //! Keys hashed at once by the batch functions before touching the blocks
+  static const size_t kBatchSize = 16U;
+
+ private:
+  static const size_t kBlockBytes = kBlockWords * sizeof(uint32_t);
+  static const size_t kCacheLine = RTL_CACHE_LINE_SIZE;
+
+  Alloc* m_alloc;
+  void* m_mem;
+  uint32_t* m_blocks;
+  size_t m_num_blocks;
+  rtl::hash<Key> m_hasher;
+
+  // rtl::hash is 32 bits, spread it over 64 with the splitmix64 finalizer:
+  // the high half picks the block and the low half the bits
+  static uint64_t mix(uint32_t h) {
+    uint64_t z = h + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27U)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31U);
+  }
+
+  uint64_t hash_of(Key const& key) const {
+    return mix(m_hasher(key));
+  }
+
+  uint32_t* block_of(uint64_t h) const {
+    // Multiply and shift maps the high half onto [0, m_num_blocks) without
+    // a division
+    size_t index = static_cast<size_t>(((h >> 32U) * m_num_blocks) >> 32U);
+    return m_blocks + index * kBlockWords;
+  }
+
+  static void make_mask(uint64_t h, uint32_t* mask) {
+    static const uint32_t kSalts[kBlockWords] = {
+        0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+        0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+    uint32_t lo = static_cast<uint32_t>(h);
+    for (size_t i = 0U; i < kBlockWords; i++) {
+      mask[i] = 1U << ((lo * kSalts[i]) >> 27U);
+    }
+  }
+
+  void insert_hashed(uint64_t h) {
+    uint32_t mask[kBlockWords];
+    make_mask(h, mask);
+    uint32_t* block = block_of(h);
+    for (size_t i = 0U; i < kBlockWords; i++) {
+      block[i] |= mask[i];
+    }
+  }
+
+  bool may_contain_hashed(uint64_t h) const {
+    uint32_t mask[kBlockWords];
+    make_mask(h, mask);
+    const uint32_t* block = block_of(h);
+    uint32_t missing = 0U;
+    for (size_t i = 0U; i < kBlockWords; i++) {
+      missing |= mask[i] & ~block[i];
+    }
+    return missing == 0U;
+  }
+
+  void release() {
+    if (m_mem) {
+      m_alloc->deallocate(m_mem);
+      m_mem = nullptr;
+    }
+    m_blocks = nullptr;
+    m_num_blocks = 0U;
+  }
+
+ public:
+  /*!
+   * Creates an empty filter, init() must be called before inserting.
+   *
+   * This class does not take ownership of the allocator
+   *
+   * @param alloc the allocator provided
+   */
+  explicit bloom_filter(Alloc* alloc)
+      : m_alloc(alloc),
+        m_mem(nullptr),
+        m_blocks(nullptr),
+        m_num_blocks(0U),
+        m_hasher() {}
+
+  ~bloom_filter() { release(); }
+
+  bloom_filter(bloom_filter const&) = delete;
+  bloom_filter& operator=(bloom_filter const&) = delete;
+
+  bloom_filter(bloom_filter&& o) noexcept
+      : m_alloc(rtl::exchange(o.m_alloc, nullptr)),
+        m_mem(rtl::exchange(o.m_mem, nullptr)),
+        m_blocks(rtl::exchange(o.m_blocks, nullptr)),
+        m_num_blocks(rtl::exchange(o.m_num_blocks, 0U)),
+        m_hasher() {}
+
+  bloom_filter& operator=(bloom_filter&& o) noexcept {
+    if (this != &o) {
+      release();
+      m_alloc = rtl::exchange(o.m_alloc, nullptr);
+      m_mem = rtl::exchange(o.m_mem, nullptr);
+      m_blocks = rtl::exchange(o.m_blocks, nullptr);
+      m_num_blocks = rtl::exchange(o.m_num_blocks, 0U);
+    }
+    return *this;
+  }
+
+  /*!
+   * Allocates an empty filter sized for expected_keys.  Can be called again
+   * to resize, which forgets every key inserted so far.
+   *
+   * ***IMPORTANT***
+   *
+   * This allocates, call it during initialization and not on a real time
+   * path.
+   *
+   * @param expected_keys the number of keys the filter is sized for
+   * @param bits_per_key trades memory for fewer false positives
+   * @return true if the blocks were allocated
+   */
+  bool init(size_t expected_keys, size_t bits_per_key = 16U) {
+    if (bits_per_key == 0U) {
+      return false;
+    }
+
+    size_t bits = expected_keys * bits_per_key;
+    size_t blocks = (bits + kBlockBytes * 8U - 1U) / (kBlockBytes * 8U);
+    if (blocks == 0U) {
+      blocks = 1U;
+    }
+
+    release();
+
+    // Over allocate so the blocks can start on a cache line
+    void* mem = m_alloc->allocate(blocks * kBlockBytes + kCacheLine - 1U);
+    if (mem == nullptr) {
+      return false;
+    }
+
+    uintptr_t addr = reinterpret_cast<uintptr_t>(mem);
+    addr = (addr + kCacheLine - 1U) & ~static_cast<uintptr_t>(kCacheLine - 1U);
+
+    m_mem = mem;
+    m_blocks = reinterpret_cast<uint32_t*>(addr);
+    m_num_blocks = blocks;
+    clear();
+    return true;
+  }
+
+  bool is_initialized() const { return m_blocks != nullptr; }
+
+  //! Forgets every key, keeps the blocks
+  void clear() {
+    if (m_blocks) {
+      std::memset(m_blocks, 0, m_num_blocks * kBlockBytes);
+    }
+  }
+
+  //! Adds key, does nothing if the filter isn't initialized
+  void insert(Key const& key) {
+    if (m_blocks) {
+      insert_hashed(hash_of(key));
+    }
+  }
+
+  /*!
+   * @return false if key was definitely never inserted, true if it may
+   * have been
+   */
+  bool may_contain(Key const& key) const {
+    if (!m_blocks) {
+      return true;
+    }
+    return may_contain_hashed(hash_of(key));
+  }
+
+  /*!
+   * Adds count keys.  Hashes kBatchSize keys at a time and prefetches
+   * their blocks before updating them, so the cache misses overlap.
+   */
+  void insert(Key const* keys, size_t count) {
+    if (!m_blocks) {
+      return;
+    }
+    uint64_t hashes[kBatchSize];
+    for (size_t start = 0U; start < count; start += kBatchSize) {
+      size_t n = count - start < kBatchSize ? count - start : kBatchSize;
+      for (size_t i = 0U; i < n; i++) {
+        hashes[i] = hash_of(keys[start + i]);
+        RTL_PREFETCH(block_of(hashes[i]), 1);
+      }
+      for (size_t i = 0U; i < n; i++) {
+        insert_hashed(hashes[i]);
+      }
+    }
+  }
+
+  /*!
+   * Tests count keys like may_contain(), storing the answers in results.
+   * Prefetches like the batch insert().
+   *
+   * @return the number of keys that may be present
+   */
+  size_t may_contain(Key const* keys, size_t count, bool* results) const {
+    if (!m_blocks) {
+      for (size_t i = 0U; i < count; i++) {
+        results[i] = true;
+      }
+      return count;
+    }
+    size_t maybe = 0U;
+    uint64_t hashes[kBatchSize];
+    for (size_t start = 0U; start < count; start += kBatchSize) {
+      size_t n = count - start < kBatchSize ? count - start : kBatchSize;
+      for (size_t i = 0U; i < n; i++) {
+        hashes[i] = hash_of(keys[start + i]);
+        RTL_PREFETCH(block_of(hashes[i]), 0);
+      }
+      for (size_t i = 0U; i < n; i++) {
+        bool r = may_contain_hashed(hashes[i]);
+        results[start + i] = r;
+        maybe += r ? 1U : 0U;
+      }
+    }
+    return maybe;
+  }
+
+  //! The number of 256 bit blocks
+  size_t num_blocks() const { return m_num_blocks; }
+
+  //! The size of the bit array in bytes
+  size_t size_bytes() const { return m_num_blocks * kBlockBytes; }
+};
+
+template <typename Key, typename Alloc>
+const size_t bloom_filter<Key, Alloc>::kBlockWords;
+
+template <typename Key, typename Alloc>
+const size_t bloom_filter<Key, Alloc>::kBatchSize;
+
+}  // namespace rtl
+
+#endif  // RTLCPP_BLOOM_FILTER_HPP
@@ -0,0 +1,751 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RTLCPP_BTREE_MAP_HPP
+#define RTLCPP_BTREE_MAP_HPP
+
+#include <cstdint>
+#include <functional>  // for std::less
+#include <new>
+#include <utility>
+
+#include "rtl/pounds.h"  // For RTL_CACHE_LINE_SIZE
+#include "rtlcpp/allocator.hpp"
+#include "rtlcpp/utility.hpp"
+
+namespace rtl {
+
+namespace detail {
+
+//! The largest capacity from Guess down to Min whose Layout<capacity> fits
+//! in NodeBytes, or Min if none does.  Guess must be an upper bound.
+template <template <size_t> class Layout, size_t NodeBytes, size_t Guess,
+          size_t Min,
+          bool Fits = (Guess <= Min || sizeof(Layout<Guess>) <= NodeBytes)>
+struct btree_node_capacity {
+  static constexpr size_t value =
+      btree_node_capacity<Layout, NodeBytes, Guess - 1U, Min>::value;
+};
+
+template <template <size_t> class Layout, size_t NodeBytes, size_t Guess,
+          size_t Min>
+struct btree_node_capacity<Layout, NodeBytes, Guess, Min, true> {
+  static constexpr size_t value = Guess;
+};
+
+//! An upper bound on the entries of entry_bytes that fit in node_bytes
+//! after header_bytes, at least min
+constexpr size_t btree_capacity_guess(size_t node_bytes, size_t header_bytes,
+                                      size_t entry_bytes, size_t min) {
+  return node_bytes < header_bytes + min * entry_bytes
+             ? min
+             : (node_bytes - header_bytes) / entry_bytes;
+}
+
+}  // namespace detail
+
+/*!
+ * An allocator aware ordered map, implemented as a B+tree.
+ *
+ * Every node is one cache line aligned allocation of at most NodeBytes
+ * bytes holding many keys, so a lookup touches a handful of cache lines
+ * per level instead of one node (and one cache miss) per level like a
+ * red-black tree.  All entries live in the leaves, which are linked to
+ * their siblings so range scans walk the leaves in order without going
+ * back up the tree.
+ *
+ * Insertion splits full nodes and erasure merges or rebalances nodes on
+ * the way down, so get(), put(), erase() and lower_bound() are all
+ * O(log n) with a single pass from the root and at most one node
+ * allocation or free per level.
+ *
+ * If an allocation fails, put() returns false and the tree is left valid
+ * without the new entry.
+ *
+ * K must be copy constructible since separator keys in the inner nodes are
+ * copies of keys in the leaves.  V must be move constructible.
+ *
+ * This class is not thread-safe.
+ *
+ * @tparam K the key type
+ * @tparam V the value type
+ * @tparam Alloc the allocator provided
+ * @tparam Compare strict weak ordering of the keys
+ * @tparam NodeBytes the size of a node, a multiple of the cache line and
+ *                   large enough for 4 entries
+ */
+template <typename K, typename V, typename Alloc = RTDefaultAllocator,
+          typename Compare = std::less<K>, size_t NodeBytes = 256U>
+class btree_map {
+  static_assert(NodeBytes % RTL_CACHE_LINE_SIZE == 0U,
+                "NodeBytes should be a multiple of the cache line size");
+
+ private:
+  struct node {
+    void* m_mem;  // The block from the allocator the node was placed in
+    uint16_t m_count;
+    bool m_leaf;
+  };
+
+  // Nodes are laid out for a capacity of N, so the capacity can be taken
+  // from the real size of the node, padding included
+  template <size_t N>
+  struct alignas(RTL_CACHE_LINE_SIZE) leaf_layout : node {
+    leaf_layout* m_prev;
+    leaf_layout* m_next;
+    alignas(K) unsigned char m_keys[sizeof(K) * N];
+    alignas(V) unsigned char m_vals[sizeof(V) * N];
+
+    K* keys() { return reinterpret_cast<K*>(m_keys); }
+    V* vals() { return reinterpret_cast<V*>(m_vals); }
+  };
+
+  template <size_t N>
+  struct alignas(RTL_CACHE_LINE_SIZE) inner_layout : node {
+    node* m_children[N + 1U];
+    alignas(K) unsigned char m_keys[sizeof(K) * N];
+
+    K* keys() { return reinterpret_cast<K*>(m_keys); }
+  };
+
+  // Splitting and merging needs room for a few entries per node
+  static constexpr size_t kMinCapacity = 4U;
+
+ public:
+  //! The maximum number of entries in a leaf
+  static constexpr size_t kLeafCapacity = detail::btree_node_capacity<
+      leaf_layout, NodeBytes,
+      detail::btree_capacity_guess(NodeBytes,
+                                   sizeof(node) + 2U * sizeof(void*),
+                                   sizeof(K) + sizeof(V), kMinCapacity),
+      kMinCapacity>::value;
+
+  //! The maximum number of keys in an inner node, which has one more child
+  static constexpr size_t kInnerCapacity = detail::btree_node_capacity<
+      inner_layout, NodeBytes,
+      detail::btree_capacity_guess(NodeBytes, sizeof(node) + sizeof(void*),
+                                   sizeof(K) + sizeof(void*), kMinCapacity),
+      kMinCapacity>::value;
+
+ private:
+  using leaf_node = leaf_layout<kLeafCapacity>;
+  using inner_node = inner_layout<kInnerCapacity>;
+
+  static_assert(sizeof(leaf_node) <= NodeBytes &&
+                    sizeof(inner_node) <= NodeBytes,
+                "NodeBytes is too small for 4 entries of K and V");
+  static_assert(kLeafCapacity < 65536U && kInnerCapacity < 65536U,
+                "NodeBytes is too large");
+
+  // Every node but the root holds at least this many entries or keys.
+  // Merging two minimal inner nodes pulls the separator down with them, so
+  // the inner minimum leaves room for it.
+  static constexpr size_t kLeafMin = kLeafCapacity / 2U;
+  static constexpr size_t kInnerMin = (kInnerCapacity - 1U) / 2U;
+
+  Alloc* m_alloc;
+  node* m_root;
+  size_t m_size;
+  size_t m_height;
+  Compare m_less;
+
+ public:
+  /*!
+   * A position in the map, used for in order and range iteration.
+   *
+   * ***IMPORTANT*** Any put() of a new key or erase() invalidates all
+   * iterators.
+   */
+  class iterator {
+   private:
+    leaf_node* m_leaf;
+    size_t m_index;
+
+    iterator(leaf_node* leaf, size_t index) : m_leaf(leaf), m_index(index) {
+      skip_empty();
+    }
+
+    // Moves past the end of a leaf (or an empty root) to the next entry
+    void skip_empty() {
+      while (m_leaf && m_index >= m_leaf->m_count) {
+        m_leaf = m_leaf->m_next;
+        m_index = 0U;
+      }
+    }
+
+    friend class btree_map;
+
+   public:
+    iterator() : m_leaf(nullptr), m_index(0U) {}
+
+    //! False once the iterator has moved past the last entry
+    bool valid() const { return m_leaf != nullptr; }
+
+    //! Behavior is undefined if the iterator is not valid
+    K const& key() const { return m_leaf->keys()[m_index]; }
+    V& value() const { return m_leaf->vals()[m_index]; }
+
+    //! Advances to the next entry in key order
+    void next() {
+      m_index++;
+      skip_empty();
+    }
+  };
+
+  /*!
+   * Construct an empty map with a pointer to the allocator.
+   *
+   * The map does not take ownership of the allocator and does not allocate
+   * until the first put().
+   *
+   * @param alloc  the allocator provided
+   */
+  explicit btree_map(Alloc* alloc)
+      : m_alloc(alloc),
+        m_root(nullptr),
+        m_size(0U),
+        m_height(0U),
+        m_less() {}
+
+  ~btree_map() { clear(); }
+
+  btree_map(btree_map const&) = delete;
+  btree_map& operator=(btree_map const&) = delete;
+
+  btree_map(btree_map&& o) noexcept
+      : m_alloc(rtl::exchange(o.m_alloc, nullptr)),
+        m_root(rtl::exchange(o.m_root, nullptr)),
+        m_size(rtl::exchange(o.m_size, 0U)),
+        m_height(rtl::exchange(o.m_height, 0U)),
+        m_less(std::move(o.m_less)) {}
+
+  btree_map& operator=(btree_map&& o) noexcept {
+    if (this != &o) {
+      clear();
+      m_alloc = rtl::exchange(o.m_alloc, nullptr);
+      m_root = rtl::exchange(o.m_root, nullptr);
+      m_size = rtl::exchange(o.m_size, 0U);
+      m_height = rtl::exchange(o.m_height, 0U);
+      m_less = std::move(o.m_less);
+    }
+    return *this;
+  }
+
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0U; }
+
+  //! The number of levels, 0 for a map that never allocated, 1 for a
+  //! single leaf
+  size_t height() const { return m_height; }
+
+  //! Returns a pointer to the value for key or nullptr if there is none
+  V* get(K const& key) const {
+    if (!m_root) {
+      return nullptr;
+    }
+    leaf_node* leaf = find_leaf(key);
+    size_t i = lower_bound_in(leaf->keys(), leaf->m_count, key);
+    if (i < leaf->m_count && !m_less(key, leaf->keys()[i])) {
+      return &leaf->vals()[i];
+    }
+    return nullptr;
+  }
+
+  bool contains(K const& key) const { return get(key) != nullptr; }
+
+  /*!
+   * Puts value val in the map referenced by key.  Will override entries.
+   *
+   * If this function returns false, a node could not be allocated and the
+   * map is unchanged apart from nodes that were split on the way down.
+   *
+   * @return true if successful, otherwise false
+   */
+  template <typename U>
+  bool put(K const& key, U&& val) {
+    V* existing = get(key);
+    if (existing) {
+      *existing = std::forward<U>(val);
+      return true;
+    }
+
+    if (!m_root) {
+      leaf_node* leaf = new_leaf();
+      if (!leaf) {
+        return false;
+      }
+      m_root = leaf;
+      m_height = 1U;
+    }
+
+    if (is_full(m_root)) {
+      inner_node* root = new_inner();
+      if (!root) {
+        return false;
+      }
+      root->m_children[0] = m_root;
+      if (!split_child(root, 0U)) {
+        free_node(root);
+        return false;
+      }
+      m_root = root;
+      m_height++;
+    }
+
+    // Split every full node on the way down, so the leaf has room and
+    // the separator of a split always fits in its parent
+    node* n = m_root;
+    while (!n->m_leaf) {
+      inner_node* in = static_cast<inner_node*>(n);
+      size_t i = upper_bound_in(in->keys(), in->m_count, key);
+      if (is_full(in->m_children[i])) {
+        if (!split_child(in, i)) {
+          return false;
+        }
+        if (!m_less(key, in->keys()[i])) {
+          i++;
+        }
+      }
+      n = in->m_children[i];
+    }
+
+    leaf_node* leaf = static_cast<leaf_node*>(n);
+    size_t pos = lower_bound_in(leaf->keys(), leaf->m_count, key);
+    shift_right(leaf->keys(), pos, leaf->m_count);
+    shift_right(leaf->vals(), pos, leaf->m_count);
+    new (static_cast<void*>(leaf->keys() + pos)) K(key);
+    new (static_cast<void*>(leaf->vals() + pos)) V(std::forward<U>(val));
+    leaf->m_count++;
+    m_size++;
+    return true;
+  }
+
+  /*!
+   * Removes the entry for key.  Never allocates.
+   *
+   * @return true if an entry was removed, false if there was none
+   */
+  bool erase(K const& key) {
+    if (!contains(key)) {
+      return false;
+    }
+
+    // Make sure every node on the way down can lose an entry without
+    // going under the minimum, by borrowing from or merging with a sibling
+    node* n = m_root;
+    while (!n->m_leaf) {
+      inner_node* in = static_cast<inner_node*>(n);
+      size_t i = upper_bound_in(in->keys(), in->m_count, key);
+      if (at_minimum(in->m_children[i])) {
+        i = fix_child(in, i);
+      }
+      n = in->m_children[i];
+
+      if (in == m_root && in->m_count == 0U) {
+        // The last two children of the root were merged
+        m_root = n;
+        free_node(in);
+        m_height--;
+      }
+    }
+
+    leaf_node* leaf = static_cast<leaf_node*>(n);
+    size_t pos = lower_bound_in(leaf->keys(), leaf->m_count, key);
+    leaf->keys()[pos].~K();
+    leaf->vals()[pos].~V();
+    shift_left(leaf->keys(), pos, leaf->m_count);
+    shift_left(leaf->vals(), pos, leaf->m_count);
+    leaf->m_count--;
+    m_size--;
+    return true;
+  }
+
+  //! Removes all entries and frees every node
+  void clear() {
+    if (m_root) {
+      destroy(m_root);
+      m_root = nullptr;
+    }
+    m_size = 0U;
+    m_height = 0U;
+  }
+
+  //! An iterator to the smallest key
+  iterator begin() const {
+    if (!m_root) {
+      return iterator();
+    }
+    node* n = m_root;
+    while (!n->m_leaf) {
+      n = static_cast<inner_node*>(n)->m_children[0];
+    }
+    return iterator(static_cast<leaf_node*>(n), 0U);
+  }
+
+  /*!
+   * An iterator to the first entry whose key is not less than key, the
+   * start of a range scan.  E.g. every entry in [lo, hi):
+   *
+   *    for (auto it = m.lower_bound(lo); it.valid() && it.key() < hi;
+   *         it.next()) { ... }
+   */
+  iterator lower_bound(K const& key) const {
+    if (!m_root) {
+      return iterator();
+    }
+    leaf_node* leaf = find_leaf(key);
+    return iterator(leaf, lower_bound_in(leaf->keys(), leaf->m_count, key));
+  }
+
+ private:
+  // First index in keys[0, count) whose key is not less than key
+  size_t lower_bound_in(K* keys, size_t count, K const& key) const {
+    size_t lo = 0U;
+    size_t hi = count;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2U;
+      if (m_less(keys[mid], key)) {
+        lo = mid + 1U;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+
+  // First index in keys[0, count) whose key is greater than key, which is
+  // also the child of an inner node to descend into
+  size_t upper_bound_in(K* keys, size_t count, K const& key) const {
+    size_t lo = 0U;
+    size_t hi = count;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2U;
+      if (m_less(key, keys[mid])) {
+        hi = mid;
+      } else {
+        lo = mid + 1U;
+      }
+    }
+    return lo;
+  }
+
+  leaf_node* find_leaf(K const& key) const {
+    node* n = m_root;
+    while (!n->m_leaf) {
+      inner_node* in = static_cast<inner_node*>(n);
+      n = in->m_children[upper_bound_in(in->keys(), in->m_count, key)];
+    }
+    return static_cast<leaf_node*>(n);
+  }
+
+  static bool is_full(node* n) {
+    size_t capacity = n->m_leaf ? kLeafCapacity : kInnerCapacity;
+    return n->m_count == capacity;
+  }
+
+  static bool at_minimum(node* n) {
+    size_t minimum = n->m_leaf ? kLeafMin : kInnerMin;
+    return n->m_count <= minimum;
+  }
+
+  template <typename X>
+  static void move_slot(X* dst, X* src) {
+    new (static_cast<void*>(dst)) X(std::move(*src));
+    src->~X();
+  }
+
+  // Opens a hole at pos in the initialized range [0, count)
+  template <typename X>
+  static void shift_right(X* a, size_t pos, size_t count) {
+    for (size_t i = count; i > pos; i--) {
+      move_slot(a + i, a + i - 1U);
+    }
+  }
+
+  // Closes the hole at pos, [pos + 1, count) is initialized
+  template <typename X>
+  static void shift_left(X* a, size_t pos, size_t count) {
+    for (size_t i = pos + 1U; i < count; i++) {
+      move_slot(a + i - 1U, a + i);
+    }
+  }
+
+  static void replace_key(K* slot, K const& key) {
+    slot->~K();
+    new (static_cast<void*>(slot)) K(key);
+  }
+
+  // The allocator only promises word alignment, so nodes are placed at
+  // the first cache line boundary of a block that is a line larger
+  void* allocate_node(size_t bytes, void** mem) {
+    *mem = m_alloc->allocate(bytes + RTL_CACHE_LINE_SIZE - 1U);
+    if (!*mem) {
+      return nullptr;
+    }
+    uintptr_t p = reinterpret_cast<uintptr_t>(*mem);
+    p = (p + RTL_CACHE_LINE_SIZE - 1U) &
+        ~static_cast<uintptr_t>(RTL_CACHE_LINE_SIZE - 1U);
+    return reinterpret_cast<void*>(p);
+  }
+
+  leaf_node* new_leaf() {
+    void* mem;
+    void* at = allocate_node(sizeof(leaf_node), &mem);
+    if (!at) {
+      return nullptr;
+    }
+    leaf_node* leaf = new (at) leaf_node;
+    leaf->m_mem = mem;
+    leaf->m_count = 0U;
+    leaf->m_leaf = true;
+    leaf->m_prev = nullptr;
+    leaf->m_next = nullptr;
+    return leaf;
+  }
+
+  inner_node* new_inner() {
+    void* mem;
+    void* at = allocate_node(sizeof(inner_node), &mem);
+    if (!at) {
+      return nullptr;
+    }
+    inner_node* in = new (at) inner_node;
+    in->m_mem = mem;
+    in->m_count = 0U;
+    in->m_leaf = false;
+    return in;
+  }
+
+  // Frees a node whose keys and values have already been destroyed
+  void free_node(node* n) { m_alloc->deallocate(n->m_mem); }
+
+  void destroy(node* n) {
+    if (n->m_leaf) {
+      leaf_node* leaf = static_cast<leaf_node*>(n);
+      for (size_t i = 0U; i < leaf->m_count; i++) {
+        leaf->keys()[i].~K();
+        leaf->vals()[i].~V();
+      }
+    } else {
+      inner_node* in = static_cast<inner_node*>(n);
+      for (size_t i = 0U; i <= in->m_count; i++) {
+        destroy(in->m_children[i]);
+      }
+      for (size_t i = 0U; i < in->m_count; i++) {
+        in->keys()[i].~K();
+      }
+    }
+    free_node(n);
+  }
+
+  // Splits the full child i of the non full inner node parent in two
+  bool split_child(inner_node* parent, size_t i) {
+    node* child = parent->m_children[i];
+    node* right;
+
+    if (child->m_leaf) {
+      leaf_node* l = static_cast<leaf_node*>(child);
+      leaf_node* r = new_leaf();
+      if (!r) {
+        return false;
+      }
+      size_t keep = kLeafCapacity / 2U;
+      for (size_t j = keep; j < l->m_count; j++) {
+        move_slot(r->keys() + j - keep, l->keys() + j);
+        move_slot(r->vals() + j - keep, l->vals() + j);
+      }
+      r->m_count = static_cast<uint16_t>(l->m_count - keep);
+      l->m_count = static_cast<uint16_t>(keep);
+
+      r->m_next = l->m_next;
+      r->m_prev = l;
+      if (l->m_next) {
+        l->m_next->m_prev = r;
+      }
+      l->m_next = r;
+
+      shift_right(parent->keys(), i, parent->m_count);
+      new (static_cast<void*>(parent->keys() + i)) K(r->keys()[0]);
+      right = r;
+    } else {
+      inner_node* l = static_cast<inner_node*>(child);
+      inner_node* r = new_inner();
+      if (!r) {
+        return false;
+      }
+      // The middle key moves up, the keys after it go to the right node
+      size_t mid = kInnerCapacity / 2U;
+      for (size_t j = mid + 1U; j < l->m_count; j++) {
+        move_slot(r->keys() + j - mid - 1U, l->keys() + j);
+      }
+      for (size_t j = mid + 1U; j <= l->m_count; j++) {
+        r->m_children[j - mid - 1U] = l->m_children[j];
+      }
+      r->m_count = static_cast<uint16_t>(l->m_count - mid - 1U);
+
+      shift_right(parent->keys(), i, parent->m_count);
+      move_slot(parent->keys() + i, l->keys() + mid);
+      l->m_count = static_cast<uint16_t>(mid);
+      right = r;
+    }
+
+    for (size_t j = parent->m_count + 1U; j > i + 1U; j--) {
+      parent->m_children[j] = parent->m_children[j - 1U];
+    }
+    parent->m_children[i + 1U] = right;
+    parent->m_count++;
+    return true;
+  }
+
+  // Gives child i of parent, which is at its minimum, an entry to spare.
+  // Returns the index of the child that now covers the same keys.
+  size_t fix_child(inner_node* parent, size_t i) {
+    if (i > 0U && !at_minimum(parent->m_children[i - 1U])) {
+      borrow_from_left(parent, i);
+      return i;
+    }
+    if (i < parent->m_count && !at_minimum(parent->m_children[i + 1U])) {
+      borrow_from_right(parent, i);
+      return i;
+    }
+    if (i > 0U) {
+      merge_children(parent, i - 1U);
+      return i - 1U;
+    }
+    merge_children(parent, i);
+    return i;
+  }
+
+  void borrow_from_left(inner_node* parent, size_t i) {
+    node* child = parent->m_children[i];
+    if (child->m_leaf) {
+      leaf_node* c = static_cast<leaf_node*>(child);
+      leaf_node* l = static_cast<leaf_node*>(parent->m_children[i - 1U]);
+      shift_right(c->keys(), 0U, c->m_count);
+      shift_right(c->vals(), 0U, c->m_count);
+      move_slot(c->keys(), l->keys() + l->m_count - 1U);
+      move_slot(c->vals(), l->vals() + l->m_count - 1U);
+      l->m_count--;
+      c->m_count++;
+      replace_key(parent->keys() + i - 1U, c->keys()[0]);
+    } else {
+      inner_node* c = static_cast<inner_node*>(child);
+      inner_node* l = static_cast<inner_node*>(parent->m_children[i - 1U]);
+      shift_right(c->keys(), 0U, c->m_count);
+      for (size_t j = c->m_count + 1U; j > 0U; j--) {
+        c->m_children[j] = c->m_children[j - 1U];
+      }
+      // The separator comes down, the left node's last key goes up
+      move_slot(c->keys(), parent->keys() + i - 1U);
+      c->m_children[0] = l->m_children[l->m_count];
+      move_slot(parent->keys() + i - 1U, l->keys() + l->m_count - 1U);
+      l->m_count--;
+      c->m_count++;
+    }
+  }
+
+  void borrow_from_right(inner_node* parent, size_t i) {
+    node* child = parent->m_children[i];
+    if (child->m_leaf) {
+      leaf_node* c = static_cast<leaf_node*>(child);
+      leaf_node* r = static_cast<leaf_node*>(parent->m_children[i + 1U]);
+      move_slot(c->keys() + c->m_count, r->keys());
+      move_slot(c->vals() + c->m_count, r->vals());
+      shift_left(r->keys(), 0U, r->m_count);
+      shift_left(r->vals(), 0U, r->m_count);
+      r->m_count--;
+      c->m_count++;
+      replace_key(parent->keys() + i, r->keys()[0]);
+    } else {
+      inner_node* c = static_cast<inner_node*>(child);
+      inner_node* r = static_cast<inner_node*>(parent->m_children[i + 1U]);
+      // The separator comes down, the right node's first key goes up
+      move_slot(c->keys() + c->m_count, parent->keys() + i);
+      c->m_children[c->m_count + 1U] = r->m_children[0];
+      move_slot(parent->keys() + i, r->keys());
+      shift_left(r->keys(), 0U, r->m_count);
+      for (size_t j = 0U; j < r->m_count; j++) {
+        r->m_children[j] = r->m_children[j + 1U];
+      }
+      r->m_count--;
+      c->m_count++;
+    }
+  }
+
+  // Merges child i + 1 of parent into child i, both at their minimum
+  void merge_children(inner_node* parent, size_t i) {
+    node* left = parent->m_children[i];
+    node* right = parent->m_children[i + 1U];
+
+    if (left->m_leaf) {
+      leaf_node* l = static_cast<leaf_node*>(left);
+      leaf_node* r = static_cast<leaf_node*>(right);
+      for (size_t j = 0U; j < r->m_count; j++) {
+        move_slot(l->keys() + l->m_count + j, r->keys() + j);
+        move_slot(l->vals() + l->m_count + j, r->vals() + j);
+      }
+      l->m_count = static_cast<uint16_t>(l->m_count + r->m_count);
+      l->m_next = r->m_next;
+      if (r->m_next) {
+        r->m_next->m_prev = l;
+      }
+      parent->keys()[i].~K();
+    } else {
+      inner_node* l = static_cast<inner_node*>(left);
+      inner_node* r = static_cast<inner_node*>(right);
+      move_slot(l->keys() + l->m_count, parent->keys() + i);
+      for (size_t j = 0U; j < r->m_count; j++) {
+        move_slot(l->keys() + l->m_count + 1U + j, r->keys() + j);
+      }
+      for (size_t j = 0U; j <= r->m_count; j++) {
+        l->m_children[l->m_count + 1U + j] = r->m_children[j];
+      }
+      l->m_count = static_cast<uint16_t>(l->m_count + 1U + r->m_count);
+    }
+
+    // The separator slot at i is uninitialized now
+    for (size_t j = i + 1U; j < parent->m_count; j++) {
+      move_slot(parent->keys() + j - 1U, parent->keys() + j);
+    }
+    for (size_t j = i + 1U; j < parent->m_count; j++) {
+      parent->m_children[j] = parent->m_children[j + 1U];
+    }
+    parent->m_count--;
+    free_node(right);
+  }
+};
+
+template <typename K, typename V, typename Alloc, typename Compare,
+          size_t NodeBytes>
+constexpr size_t btree_map<K, V, Alloc, Compare, NodeBytes>::kMinCapacity;
+
+template <typename K, typename V, typename Alloc, typename Compare,
+          size_t NodeBytes>
+constexpr size_t btree_map<K, V, Alloc, Compare, NodeBytes>::kLeafCapacity;
+
+template <typename K, typename V, typename Alloc, typename Compare,
+          size_t NodeBytes>
+constexpr size_t btree_map<K, V, Alloc, Compare, NodeBytes>::kInnerCapacity;
+
+template <typename K, typename V, typename Alloc, typename Compare,
+          size_t NodeBytes>
+constexpr size_t btree_map<K, V, Alloc, Compare, NodeBytes>::kLeafMin;
+
+template <typename K, typename V, typename Alloc, typename Compare,
+          size_t NodeBytes>
+constexpr size_t btree_map<K, V, Alloc, Compare, NodeBytes>::kInnerMin;
+
+}  // namespace rtl
+
+#endif  // RTLCPP_BTREE_MAP_HPP
@@ -0,0 +1,361 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RTLCPP_DEQUE_HPP
+#define RTLCPP_DEQUE_HPP
+
+#include <new>
+#include <utility>
+
+#include "rtlcpp/allocator.hpp"
+#include "rtlcpp/utility.hpp"
+
+namespace rtl {
+
+/*!
+ * An allocator aware double ended queue.
+ *
+ * The elements are kept in a circular buffer whose capacity is a power of
+ * two, so pushing and popping at either end is O(1) and wrapping around
+ * is a mask instead of a division.  When the buffer is full it is doubled
+ * and the elements are moved to the new buffer in order, the same way
+ * rtl::vector grows.
+ *
+ * ***IMPORTANT*** Growing moves the elements, so references/pointers to
+ * elements may be invalidated by any push.  reserve() ahead of time and
+ * pushes never allocate.
+ *
+ * This class is not thread-safe.
+ *
+ * @tparam T the type held in the deque
+ * @tparam Alloc the allocator provided
+ */
+template <typename T, typename Alloc = RTDefaultAllocator>
+class deque {
+ private:
+  Alloc* m_alloc;
+
+  T* m_buf;
+
+  //! Zero or a power of two
+  size_t m_capacity;
+
+  //! The buffer index of the front element
+  size_t m_head;
+
+  //! The number of elements currently in the deque
+  size_t m_count;
+
+  void release() {
+    clear();
+    if (m_buf) {
+      m_alloc->deallocate(static_cast<void*>(m_buf));
+      m_buf = nullptr;
+    }
+    m_capacity = 0U;
+  }
+
+  // The largest power of two at or below c whose size in bytes fits in a
+  // size_t
+  static constexpr size_t max_capacity_below(size_t c) {
+    return c <= static_cast<size_t>(-1) / sizeof(T)
+               ? c
+               : max_capacity_below(c >> 1U);
+  }
+
+  size_t slot(size_t index) const {
+    return (m_head + index) & (m_capacity - 1U);
+  }
+
+  // Makes room for needed elements, doubling like rtl::vector
+  bool grow_for(size_t needed) {
+    if (needed <= m_capacity) {
+      return true;
+    }
+    if (m_capacity == kMaxCapacity) {
+      return false;
+    }
+    return reserve(m_capacity == 0U ? needed : 2U * m_capacity);
+  }
+
+ public:
+  //! The largest capacity reserve() can round up to
+  static constexpr size_t kMaxCapacity =
+      max_capacity_below((static_cast<size_t>(-1) >> 1U) + 1U);
+
+  /*!
+   * Construct a deque with a pointer to the allocator.
+   *
+   * The deque does not take ownership of the allocator and does not
+   * allocate until the first push or reserve().
+   *
+   * @param alloc  the allocator provided
+   */
+  explicit deque(Alloc* alloc)
+      : m_alloc(alloc),
+        m_buf(nullptr),
+        m_capacity(0U),
+        m_head(0U),
+        m_count(0U) {}
+
+  ~deque() { release(); }
+
+  deque(deque const&) = delete;
+  deque& operator=(deque const&) = delete;
+
+  deque(deque&& o) noexcept
+      : m_alloc(rtl::exchange(o.m_alloc, nullptr)),
+        m_buf(rtl::exchange(o.m_buf, nullptr)),
+        m_capacity(rtl::exchange(o.m_capacity, 0U)),
+        m_head(rtl::exchange(o.m_head, 0U)),
+        m_count(rtl::exchange(o.m_count, 0U)) {}
+
+  deque& operator=(deque&& o) noexcept {
+    if (this != &o) {
+      release();
+      m_alloc = rtl::exchange(o.m_alloc, nullptr);
+      m_buf = rtl::exchange(o.m_buf, nullptr);
+      m_capacity = rtl::exchange(o.m_capacity, 0U);
+      m_head = rtl::exchange(o.m_head, 0U);
+      m_count = rtl::exchange(o.m_count, 0U);
+    }
+    return *this;
+  }
+
+  /*!
+   * Attempts to make room for new_capacity elements, rounded up to a power
+   * of two.
+   *
+   * If new_capacity is less than or equal to current capacity, this
+   * function returns true.  If it is greater than kMaxCapacity, this
+   * function returns false without allocating.
+   *
+   * If this function returns false, no changes will be made to the deque
+   * and it will be in a valid state to use.
+   *
+   * @param new_capacity the new capacity requested
+   * @return  true if successful, otherwise false
+   */
+  bool reserve(size_t new_capacity) {
+    if (new_capacity <= m_capacity) {
+      return true;
+    }
+
+    if (new_capacity > kMaxCapacity) {
+      return false;
+    }
+
+    size_t rounded = 1U;
+    while (rounded < new_capacity) {
+      rounded <<= 1U;
+    }
+
+    T* new_buf = static_cast<T*>(m_alloc->allocate(rounded * sizeof(T)));
+    if (new_buf == nullptr) {
+      return false;
+    }
+
+    for (size_t i = 0U; i < m_count; i++) {
+      T* old = m_buf + slot(i);
+      new (static_cast<void*>(new_buf + i)) T(std::move(*old));
+      old->~T();
+    }
+
+    if (m_buf) {
+      m_alloc->deallocate(static_cast<void*>(m_buf));
+    }
+    m_buf = new_buf;
+    m_capacity = rounded;
+    m_head = 0U;
+    return true;
+  }
+
+  /*!
+   * Push an element to the back of the deque.
+   *
+   * If this function returns false, the deque could not grow and is not
+   * touched.
+   *
+   * @return true if added, otherwise false
+   */
+  bool push_back(T const& value) {
+    if (!grow_for(m_count + 1U)) {
+      return false;
+    }
+    new (static_cast<void*>(m_buf + slot(m_count))) T(value);
+    m_count++;
+    return true;
+  }
+
+  bool push_back(T&& value) {
+    if (!grow_for(m_count + 1U)) {
+      return false;
+    }
+    new (static_cast<void*>(m_buf + slot(m_count))) T(std::move(value));
+    m_count++;
+    return true;
+  }
+
+  /*!
+   * Push an element to the front of the deque.
+   *
+   * If this function returns false, the deque could not grow and is not
+   * touched.
+   *
+   * @return true if added, otherwise false
+   */
+  bool push_front(T const& value) {
+    if (!grow_for(m_count + 1U)) {
+      return false;
+    }
+    size_t head = (m_head - 1U) & (m_capacity - 1U);
+    new (static_cast<void*>(m_buf + head)) T(value);
+    m_head = head;
+    m_count++;
+    return true;
+  }
+
+  bool push_front(T&& value) {
+    if (!grow_for(m_count + 1U)) {
+      return false;
+    }
+    size_t head = (m_head - 1U) & (m_capacity - 1U);
+    new (static_cast<void*>(m_buf + head)) T(std::move(value));
+    m_head = head;
+    m_count++;
+    return true;
+  }
+
+  /*!
+   * Copies count elements from values to the back of the deque, in order.
+   *
+   * Either all of them are added or, if the deque could not grow, none of
+   * them and this function returns false.
+   *
+   * ***IMPORTANT*** values must not point into this deque.
+   *
+   * @return true if added, otherwise false
+   */
+  bool push_back(const T* values, size_t count) {
+    if (count > m_capacity - m_count) {
+      size_t needed = m_count + count;
+      if (!reserve(needed > 2U * m_capacity ? needed : 2U * m_capacity)) {
+        return false;
+      }
+    }
+    for (size_t i = 0U; i < count; i++) {
+      new (static_cast<void*>(m_buf + slot(m_count))) T(values[i]);
+      m_count++;
+    }
+    return true;
+  }
+
+  /*!
+   * Removes the front element.
+   *
+   * This function will not do anything if there are no elements in the
+   * deque.
+   */
+  void pop_front() {
+    if (m_count == 0U) {
+      return;
+    }
+    m_buf[m_head].~T();
+    m_head = (m_head + 1U) & (m_capacity - 1U);
+    m_count--;
+  }
+
+  /*!
+   * Removes the back element.
+   *
+   * This function will not do anything if there are no elements in the
+   * deque.
+   */
+  void pop_back() {
+    if (m_count == 0U) {
+      return;
+    }
+    m_buf[slot(m_count - 1U)].~T();
+    m_count--;
+  }
+
+  /*!
+   * Moves up to count elements from the front of the deque to out, in
+   * order, and removes them.
+   *
+   * @return the number of elements moved
+   */
+  size_t pop_front(T* out, size_t count) {
+    size_t n = count < m_count ? count : m_count;
+    for (size_t i = 0U; i < n; i++) {
+      T* front = m_buf + m_head;
+      out[i] = std::move(*front);
+      front->~T();
+      m_head = (m_head + 1U) & (m_capacity - 1U);
+    }
+    m_count -= n;
+    return n;
+  }
+
+  /*!
+   * Calls the destructor of every element, but doesn't perform any memory
+   * operations regarding resizing.
+   */
+  void clear() {
+    while (m_count > 0U) {
+      pop_back();
+    }
+    m_head = 0U;
+  }
+
+  /*!
+   * Returns a reference to the element index positions from the front.
+   *
+   * Behavior is undefined if index is out of bounds of the deque
+   */
+  T& operator[](size_t index) { return m_buf[slot(index)]; }
+  T const& operator[](size_t index) const { return m_buf[slot(index)]; }
+
+  /*!
+   * Returns a front reference.
+   *
+   * Undefined behavior if the deque is empty
+   */
+  T& front() { return m_buf[m_head]; }
+  T const& front() const { return m_buf[m_head]; }
+
+  /*!
+   * Returns a back reference.
+   *
+   * Undefined behavior if the deque is empty
+   */
+  T& back() { return m_buf[slot(m_count - 1U)]; }
+  T const& back() const { return m_buf[slot(m_count - 1U)]; }
+
+  //! Returns the number of elements in the deque
+  size_t size() const noexcept { return m_count; }
+
+  //! Returns true if the deque is empty, otherwise false
+  bool empty() const noexcept { return m_count == 0U; }
+
+  //! Returns the capacity of the deque, zero or a power of two
+  size_t capacity() const noexcept { return m_capacity; }
+};
+
+template <typename T, typename Alloc>
+constexpr size_t deque<T, Alloc>::kMaxCapacity;
+
+}  // namespace rtl
+
+#endif  // RTLCPP_DEQUE_HPP
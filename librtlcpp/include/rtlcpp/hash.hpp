@@ -83,12 +83,12 @@ struct hash {
 
 template <>
 struct hash<const char*> {
-  uint32_t operator()(const char* const s) { return fnv1a(s); }
+  uint32_t operator()(const char* const s) const { return fnv1a(s); }
 };
 
 template <>
 struct hash<std::string> {
-  uint32_t operator()(std::string const& s) { return fnv1a(s); }
+  uint32_t operator()(std::string const& s) const { return fnv1a(s); }
 };
 
 }  // namespace rtl
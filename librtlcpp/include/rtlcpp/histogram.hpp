@@ -0,0 +1,421 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RTLCPP_HISTOGRAM_HPP
+#define RTLCPP_HISTOGRAM_HPP
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+
+#include "rtl/pounds.h"
+#include "rtlcpp/allocator.hpp"
+#include "rtlcpp/utility.hpp"
+
+namespace rtl {
+
+/*!
+ * A log-linear (HDR style) histogram of unsigned integer values, meant for
+ * recording latencies on real time threads.
+ *
+ * Values below 2^SubBucketBits are counted exactly.  Above that every
+ * power of two range is split into 2^(SubBucketBits - 1) linear buckets, so
+ * any value is counted in a bucket no wider than 1/2^(SubBucketBits - 1) of
+ * the value (~1.6% with the default of 7 bits).
+ *
+ * The buckets are allocated once by init(), after that recording never
+ * allocates.  Values above the highest trackable value are counted in the
+ * last bucket and in overflow_count().
+ *
+ * Threading:
+ *
+ * - record() may only be called by a single writer thread at a time and is
+ *   wait-free (relaxed loads and stores, no read-modify-write)
+ *
+ * - Any number of readers may call the query functions or snapshot_to()
+ *   concurrently with the writer.  Each bucket is read atomically, but a
+ *   reader racing the writer may see some of the buckets of a sample but
+ *   not the others.  Take a snapshot_to() a histogram owned by the reader
+ *   to get a stable view to query.
+ *
+ * - reset() and merge() are writer operations
+ *
+ * @tparam Alloc the allocator provided
+ */
+template <typename Alloc = RTDefaultAllocator>
+class histogram final {
+ private:
+  Alloc* m_alloc;
+
+  std::atomic<uint64_t>* m_counts;
+  uint32_t m_num_buckets;
+  uint32_t m_sub_bucket_bits;
+  uint64_t m_highest_trackable_value;
+
+  std::atomic<uint64_t> m_total_count;
+  std::atomic<uint64_t> m_overflow_count;
+  std::atomic<uint64_t> m_sum;
+  std::atomic<uint64_t> m_min;
+  std::atomic<uint64_t> m_max;
+
+  // Single writer, so a load and store is enough and avoids the cost of a
+  // locked instruction
+  static void add_relaxed(std::atomic<uint64_t>& a, uint64_t v) {
+    a.store(a.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+  }
+
+  uint32_t sub_bucket_count() const { return 1U << m_sub_bucket_bits; }
+  uint32_t sub_bucket_half() const { return 1U << (m_sub_bucket_bits - 1U); }
+
+  uint32_t index_of(uint64_t v) const {
+    if (v < sub_bucket_count()) {
+      return static_cast<uint32_t>(v);
+    }
+    uint32_t shift = rtl_msb64(v) - (m_sub_bucket_bits - 1U);
+    uint32_t sub = static_cast<uint32_t>(v >> shift) - sub_bucket_half();
+    return sub_bucket_count() + (shift - 1U) * sub_bucket_half() + sub;
+  }
+
+  uint64_t lowest_of(uint32_t index) const {
+    if (index < sub_bucket_count()) {
+      return index;
+    }
+    uint32_t i = index - sub_bucket_count();
+    uint32_t shift = i / sub_bucket_half() + 1U;
+    uint64_t sub = i % sub_bucket_half() + sub_bucket_half();
+    return sub << shift;
+  }
+
+  uint64_t width_of(uint32_t index) const {
+    if (index < sub_bucket_count()) {
+      return 1U;
+    }
+    return 1ULL << ((index - sub_bucket_count()) / sub_bucket_half() + 1U);
+  }
+
+  bool same_layout(histogram const& o) const {
+    return m_counts != nullptr && o.m_counts != nullptr &&
+           m_num_buckets == o.m_num_buckets &&
+           m_sub_bucket_bits == o.m_sub_bucket_bits;
+  }
+
+  void release() {
+    if (m_counts) {
+      for (uint32_t i = 0U; i < m_num_buckets; i++) {
+        m_counts[i].~atomic();
+      }
+      m_alloc->deallocate(m_counts);
+      m_counts = nullptr;
+    }
+    m_num_buckets = 0U;
+  }
+
+ public:
+  /*!
+   * Creates an empty histogram, init() must be called before recording.
+   *
+   * This class does not take ownership of the allocator
+   *
+   * @param alloc the allocator provided
+   */
+  explicit histogram(Alloc* alloc)
+      : m_alloc(alloc),
+        m_counts(nullptr),
+        m_num_buckets(0U),
+        m_sub_bucket_bits(0U),
+        m_highest_trackable_value(0U),
+        m_total_count(0U),
+        m_overflow_count(0U),
+        m_sum(0U),
+        m_min(std::numeric_limits<uint64_t>::max()),
+        m_max(0U) {}
+
+  ~histogram() { release(); }
+
+  /*
+   * Readers may hold references to this object while the writer records
+   * so this class can be neither copied nor moved, use snapshot_to()
+   * instead.
+   */
+  histogram(histogram const&) = delete;
+  histogram& operator=(histogram const&) = delete;
+
+  histogram(histogram&&) noexcept = delete;
+  histogram& operator=(histogram&&) noexcept = delete;
+
+  /*!
+   * Allocates the buckets.  Can be called again to change the layout,
+   * which discards everything recorded so far.
+   *
+   * ***IMPORTANT***
+   *
+   * This allocates, call it during initialization and not on a real time
+   * path.
+   *
+   * @param highest_trackable_value the largest value that is counted
+   * precisely, must be at least 2^sub_bucket_bits
+   * @param sub_bucket_bits decides the precision, from 2 to 20 inclusive
+   * @return true if the buckets were allocated
+   */
+  bool init(uint64_t highest_trackable_value, uint32_t sub_bucket_bits = 7U) {
+    if (sub_bucket_bits < 2U || sub_bucket_bits > 20U ||
+        highest_trackable_value < (1ULL << sub_bucket_bits)) {
+      return false;
+    }
+
+    release();
+
+    m_sub_bucket_bits = sub_bucket_bits;
+    uint32_t n = index_of(highest_trackable_value) + 1U;
+
+    void* mem = m_alloc->allocate(sizeof(std::atomic<uint64_t>) * n);
+    if (mem == nullptr) {
+      m_sub_bucket_bits = 0U;
+      return false;
+    }
+
+    m_counts = static_cast<std::atomic<uint64_t>*>(mem);
+    for (uint32_t i = 0U; i < n; i++) {
+      new (&m_counts[i]) std::atomic<uint64_t>(0U);
+    }
+    m_num_buckets = n;
+    m_highest_trackable_value = highest_trackable_value;
+
+    reset();
+    return true;
+  }
+
+  //! True if init() succeeded
+  bool is_initialized() const { return m_counts != nullptr; }
+
+  /*!
+   * Records a value count times.  Wait-free, single writer only.
+   *
+   * @param value the value to record
+   * @param count how many times the value was seen
+   */
+  void record(uint64_t value, uint64_t count = 1U) {
+    assert(m_counts != nullptr);
+
+    uint64_t clamped = value;
+    if (value > m_highest_trackable_value) {
+      clamped = m_highest_trackable_value;
+      add_relaxed(m_overflow_count, count);
+    }
+
+    add_relaxed(m_counts[index_of(clamped)], count);
+    add_relaxed(m_total_count, count);
+    add_relaxed(m_sum, value * count);
+
+    if (value < m_min.load(std::memory_order_relaxed)) {
+      m_min.store(value, std::memory_order_relaxed);
+    }
+    if (value > m_max.load(std::memory_order_relaxed)) {
+      m_max.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  //! Clears everything recorded so far, writer only
+  void reset() {
+    for (uint32_t i = 0U; i < m_num_buckets; i++) {
+      m_counts[i].store(0U, std::memory_order_relaxed);
+    }
+    m_total_count.store(0U, std::memory_order_relaxed);
+    m_overflow_count.store(0U, std::memory_order_relaxed);
+    m_sum.store(0U, std::memory_order_relaxed);
+    m_min.store(std::numeric_limits<uint64_t>::max(),
+                std::memory_order_relaxed);
+    m_max.store(0U, std::memory_order_relaxed);
+  }
+
+  /*!
+   * Copies the current contents into dst.  Safe to call concurrently with
+   * the writer of this histogram, dst is written to so the caller must be
+   * its only writer.
+   *
+   * @param dst a histogram initialized with the same parameters
+   * @return false if the layouts of the histograms don't match
+   */
+  bool snapshot_to(histogram& dst) const {
+    if (&dst == this || !same_layout(dst)) {
+      return false;
+    }
+
+    // The total is recomputed from the buckets so it is consistent with
+    // what was copied even if the writer raced us
+    uint64_t total = 0U;
+    for (uint32_t i = 0U; i < m_num_buckets; i++) {
+      uint64_t c = m_counts[i].load(std::memory_order_relaxed);
+      dst.m_counts[i].store(c, std::memory_order_relaxed);
+      total += c;
+    }
+    dst.m_total_count.store(total, std::memory_order_relaxed);
+    dst.m_overflow_count.store(
+        m_overflow_count.load(std::memory_order_relaxed),
+        std::memory_order_relaxed);
+    dst.m_sum.store(m_sum.load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+    dst.m_min.store(m_min.load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+    dst.m_max.store(m_max.load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+    return true;
+  }
+
+  /*!
+   * Adds the contents of src to this histogram, writer only.  src may be
+   * recorded to concurrently.
+   *
+   * @param src a histogram initialized with the same parameters
+   * @return false if the layouts of the histograms don't match
+   */
+  bool merge(histogram const& src) {
+    if (&src == this || !same_layout(src)) {
+      return false;
+    }
+
+    uint64_t total = 0U;
+    for (uint32_t i = 0U; i < m_num_buckets; i++) {
+      uint64_t c = src.m_counts[i].load(std::memory_order_relaxed);
+      add_relaxed(m_counts[i], c);
+      total += c;
+    }
+    add_relaxed(m_total_count, total);
+    add_relaxed(m_overflow_count,
+                src.m_overflow_count.load(std::memory_order_relaxed));
+    add_relaxed(m_sum, src.m_sum.load(std::memory_order_relaxed));
+
+    uint64_t mn = src.m_min.load(std::memory_order_relaxed);
+    if (mn < m_min.load(std::memory_order_relaxed)) {
+      m_min.store(mn, std::memory_order_relaxed);
+    }
+    uint64_t mx = src.m_max.load(std::memory_order_relaxed);
+    if (mx > m_max.load(std::memory_order_relaxed)) {
+      m_max.store(mx, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  //! The number of values recorded
+  uint64_t count() const {
+    return m_total_count.load(std::memory_order_relaxed);
+  }
+
+  //! The number of values that were above the highest trackable value
+  uint64_t overflow_count() const {
+    return m_overflow_count.load(std::memory_order_relaxed);
+  }
+
+  //! The smallest value recorded, or zero if empty
+  uint64_t min() const {
+    return count() == 0U ? 0U : m_min.load(std::memory_order_relaxed);
+  }
+
+  //! The largest value recorded (exact, even if it overflowed)
+  uint64_t max() const { return m_max.load(std::memory_order_relaxed); }
+
+  //! The exact mean of the recorded values, or zero if empty
+  double mean() const {
+    uint64_t c = count();
+    if (c == 0U) {
+      return 0.0;
+    }
+    return static_cast<double>(m_sum.load(std::memory_order_relaxed)) /
+           static_cast<double>(c);
+  }
+
+  /*!
+   * Returns the value at the given percentile, i.e. the highest value
+   * counted in the same bucket as the sample at that rank.  The result is
+   * never larger than max().
+   *
+   * @param percentile from 0.0 to 100.0
+   * @return the value, or zero if nothing was recorded
+   */
+  uint64_t value_at_percentile(double percentile) const {
+    if (m_counts == nullptr) {
+      return 0U;
+    }
+
+    uint64_t total = 0U;
+    for (uint32_t i = 0U; i < m_num_buckets; i++) {
+      total += m_counts[i].load(std::memory_order_relaxed);
+    }
+    if (total == 0U) {
+      return 0U;
+    }
+
+    if (percentile < 0.0) {
+      percentile = 0.0;
+    } else if (percentile > 100.0) {
+      percentile = 100.0;
+    }
+
+    // The rank of the sample we want, at least the first one
+    double rank = percentile / 100.0 * static_cast<double>(total);
+    uint64_t target = static_cast<uint64_t>(rank);
+    if (static_cast<double>(target) < rank || target == 0U) {
+      target++;
+    }
+
+    uint64_t mx = max();
+    uint64_t seen = 0U;
+    for (uint32_t i = 0U; i < m_num_buckets; i++) {
+      seen += m_counts[i].load(std::memory_order_relaxed);
+      if (seen >= target) {
+        uint64_t v = highest_equivalent_value(lowest_of(i));
+        return v < mx ? v : mx;
+      }
+    }
+    return mx;
+  }
+
+  //! The smallest value counted in the same bucket as value
+  uint64_t lowest_equivalent_value(uint64_t value) const {
+    return lowest_of(index_of(value));
+  }
+
+  //! The largest value counted in the same bucket as value
+  uint64_t highest_equivalent_value(uint64_t value) const {
+    uint32_t i = index_of(value);
+    return lowest_of(i) + (width_of(i) - 1U);
+  }
+
+  //! The number of values counted in the bucket value falls into
+  uint64_t count_at_value(uint64_t value) const {
+    if (m_counts == nullptr) {
+      return 0U;
+    }
+    if (value > m_highest_trackable_value) {
+      value = m_highest_trackable_value;
+    }
+    return m_counts[index_of(value)].load(std::memory_order_relaxed);
+  }
+
+  uint64_t highest_trackable_value() const {
+    return m_highest_trackable_value;
+  }
+
+  uint32_t sub_bucket_bits() const { return m_sub_bucket_bits; }
+
+  //! The number of buckets (and 64 bit counters) allocated
+  size_t num_buckets() const { return m_num_buckets; }
+};
+
+}  // namespace rtl
+
+#endif  // RTLCPP_HISTOGRAM_HPP
@@ -162,6 +162,21 @@ class lru {
   //! Returns true if the cache is empty, otherwise false
   bool empty() const { return m_size == 0U; }
 
+  /*!
+   * Lets get() and contains() of keys that were never put stop without
+   * walking the map, see unordered_map::attach_filter().
+   *
+   * Every eviction leaves its key in the filter, so the false positive rate
+   * climbs as keys are evicted.  Size it for capacity() keys and every so
+   * often call this again with the same filter to rebuild it from the keys
+   * in the cache.
+   *
+   * @param filter an initialized filter or nullptr to detach
+   */
+  void attach_filter(bloom_filter<Key, Alloc>* filter) {
+    m_map.attach_filter(filter);
+  }
+
   //! Returns true if the key is in the cache, does not update usage position
   bool contains(Key const& key) { return m_map.contains(key); }
 
@@ -17,7 +17,9 @@
 
 #include <cassert>
 
+#include "rtlcpp/bloom_filter.hpp"
 #include "rtlcpp/hash.hpp"
+#include "rtlcpp/snapshot.hpp"
 #include "rtlcpp/vector.hpp"
 
 namespace rtl {
@@ -36,6 +38,7 @@ class unordered_map {
     T* const& val_val() const { return m_val; }
 
     explicit Entry(Key const& key) : m_key(key), m_val(nullptr) {}
+    explicit Entry(Key&& key) : m_key(std::move(key)), m_val(nullptr) {}
 
     ~Entry() { assert(m_val == nullptr); }
 
@@ -101,6 +104,8 @@ class unordered_map {
       m_val = nullptr;
     }
 
+    bool has_key(Key const& key) const { return m_key == key; }
+
     bool operator==(const Entry& rhs) const { return m_key == rhs.m_key; }
     bool operator!=(const Entry& rhs) const {
       bool rhs_eq_this = rhs == *this;
@@ -130,12 +135,11 @@ class unordered_map {
     Bucket(Bucket&&) noexcept = default;
     Bucket& operator=(Bucket&&) noexcept = default;
 
+    // Lookups compare keys in place, copying the key could allocate
     T* get(Key const& key) const {
-      Entry e(key);
-
       const Entry* entry{nullptr};
       for (size_t i = 0U; i < m_entries.size(); i++) {
-        if (m_entries[i] == e) {
+        if (m_entries[i].has_key(key)) {
           entry = &m_entries[i];
           break;
         }
@@ -172,38 +176,42 @@ class unordered_map {
       return true;
     }
 
-    Entry* bucket_get_entry(Key const& key) {
-      Entry e{key};
-
-      Entry* entry{nullptr};
+    bool bucket_remove_key(Key const& key, Alloc& a) {
       for (size_t i = 0U; i < m_entries.size(); i++) {
-        if (m_entries[i] == e) {
-          entry = &m_entries[i];
-          break;
+        if (m_entries[i].has_key(key)) {
+          m_entries[i].deconstruct(a);
+          m_entries.remove_fast(i);
+          return true;
         }
       }
-
-      return entry;
+      return false;
     }
 
-    // Returns number of nodes created (-1 on error) and inserted node
-    BucketGetOrCreateResult bucket_get_or_create_entry(Key const& key) {
-      Entry e{key};
-
+    Entry* bucket_get_entry(Key const& key) {
       Entry* entry{nullptr};
       for (size_t i = 0U; i < m_entries.size(); i++) {
-        if (m_entries[i] == e) {
+        if (m_entries[i].has_key(key)) {
           entry = &m_entries[i];
           break;
         }
       }
 
+      return entry;
+    }
+
+    // Returns number of nodes created (-1 on error) and inserted node.  The
+    // key is only copied (or moved) in when a node is created.
+    template <typename K>
+    BucketGetOrCreateResult bucket_get_or_create_entry(K&& key) {
+      Entry* entry = bucket_get_entry(key);
+
       if (entry) {
         return {0, entry};
       }
 
       // Create a node and insert
-      bool successful_push_back = m_entries.push_back(std::move(e));
+      bool successful_push_back =
+          m_entries.push_back(Entry(std::forward<K>(key)));
       if (!successful_push_back) {
         return {-1, nullptr};
       }
@@ -280,6 +288,16 @@ class unordered_map {
       }
     }
 
+    template <typename F>
+    void table_for_each_entry(F&& f) {
+      for (size_t i = 0U; i < m_buckets.size(); i++) {
+        rtl::vector<Entry, Alloc>& entries = m_buckets[i].entries();
+        for (size_t j = 0U; j < entries.size(); j++) {
+          f(entries[j]);
+        }
+      }
+    }
+
     void table_delete_all_entries(Alloc& a) {
       for (size_t i = 0U; i < m_buckets.size(); i++) {
         m_buckets[i].delete_all_entries(a);
@@ -306,7 +324,8 @@ class unordered_map {
     }
 
     // Either gets the entry or creates one
-    TableGetOrCreateResult table_get_or_create_entry(Key const& key) {
+    template <typename K>
+    TableGetOrCreateResult table_get_or_create_entry(K&& key) {
       if (m_num_buckets == 0U) {
         return {nullptr, nullptr, false};
       }
@@ -315,7 +334,8 @@ class unordered_map {
 
       BucketGetOrCreateResult res;
 
-      res = m_buckets[bucket_index].bucket_get_or_create_entry(key);
+      res = m_buckets[bucket_index].bucket_get_or_create_entry(
+          std::forward<K>(key));
 
       TableGetOrCreateResult rval;
       rval.entry = res.entry;
@@ -337,15 +357,28 @@ class unordered_map {
 
       uint32_t bucket_index = get_bucket_index(key);
 
-      // Make a temporary entry to compare keys
-      Entry e(key);
-      bool rval = m_buckets[bucket_index].bucket_remove(&e, a);
+      bool rval = m_buckets[bucket_index].bucket_remove_key(key, a);
       if (rval) {
         --m_total_entries;
       }
       return rval;
     }
 
+    // Moves in an entry whose key isn't in the table yet
+    bool table_insert_entry(Entry&& e) {
+      if (m_num_buckets == 0U) {
+        return false;
+      }
+
+      uint32_t bucket_index = get_bucket_index(e.key_val());
+      bool successful_push_back =
+          m_buckets[bucket_index].entries().push_back(std::move(e));
+      if (successful_push_back) {
+        ++m_total_entries;
+      }
+      return successful_push_back;
+    }
+
    private:
     size_t expand(size_t num) {
       // Try to add_to_pool num spaces ahead of time...
@@ -391,6 +424,7 @@ class unordered_map {
   size_t m_max_load_factor_percent;
   size_t m_current_bucket_to_transfer;
   bool m_locked;
+  bloom_filter<Key, Alloc>* m_filter;
 
  public:
   /*!
@@ -414,7 +448,8 @@ class unordered_map {
         m_max_load_factor_percent(
             static_cast<size_t>(max_load_factor * static_cast<float>(100))),
         m_current_bucket_to_transfer(0U),
-        m_locked(false) {
+        m_locked(false),
+        m_filter(nullptr) {
     m_main = static_cast<Table*>(m_alloc->allocate(sizeof(Table)));
 
     if (m_main) {
@@ -456,7 +491,8 @@ class unordered_map {
         m_max_load_factor_percent(o.m_max_load_factor_percent),
         m_current_bucket_to_transfer(
             rtl::exchange(o.m_current_bucket_to_transfer, 0)),
-        m_locked(o.m_locked) {}
+        m_locked(o.m_locked),
+        m_filter(rtl::exchange(o.m_filter, nullptr)) {}
 
   unordered_map& operator=(unordered_map&& o) noexcept {
     if (this != &o) {
@@ -482,11 +518,152 @@ class unordered_map {
       m_current_bucket_to_transfer =
           rtl::exchange(o.m_current_bucket_to_transfer, 0);
       m_locked = o.m_locked;
+      m_filter = rtl::exchange(o.m_filter, nullptr);
     }
 
     return *this;
   }
 
+  /*!
+   * Lets lookups of keys that were never put skip the table walk: get() and
+   * contains() check filter first and stop on a definite miss.  Pass
+   * nullptr to detach.
+   *
+   * The filter is cleared and every key in the map is inserted, after that
+   * the map inserts each new key itself.  del() can't remove keys from a
+   * Bloom filter, so after many deletes call this again with the same
+   * filter to rebuild it.  delete_all_keys() clears the filter.
+   *
+   * ***IMPORTANT***
+   * The map does not take ownership of the filter, which must be
+   * initialized and outlive the map (or be detached).  Incremental
+   * resizing still advances on lookups the filter short-circuits.
+   *
+   * @param filter an initialized filter or nullptr
+   */
+  void attach_filter(bloom_filter<Key, Alloc>* filter) {
+    m_filter = filter;
+    if (!m_filter) {
+      return;
+    }
+    m_filter->clear();
+    auto add = [this](Entry& e) { m_filter->insert(e.key_val()); };
+    if (m_main) {
+      m_main->table_for_each_entry(add);
+    }
+    if (m_secondary) {
+      m_secondary->table_for_each_entry(add);
+    }
+  }
+
+  /*!
+   * Writes every key and value to fd in the snapshot format described in
+   * rtlcpp/snapshot.hpp, which rtl::mapped_map maps and answers lookups
+   * from without loading anything.
+   *
+   * Keys and values go through KeySerializer and ValueSerializer, by
+   * default snapshot_serializer which stores trivially copyable types as
+   * they are.  Open the file with
+   * mapped_map<KeySerializer::stored_type, ValueSerializer::stored_type>.
+   *
+   * ***IMPORTANT***
+   * Finishes any resize in progress first.  fd must be open for reading
+   * and writing, its contents are replaced.  The body is synced to the
+   * file before the header is written, so a save that fails or crashes
+   * part way never opens as a snapshot.
+   *
+   * @param fd the file to write the snapshot to
+   * @return false if the map is in the error state, the file can't be
+   * sized or mapped, or a serializer fails
+   */
+  template <typename KeySerializer = snapshot_serializer<Key>,
+            typename ValueSerializer = snapshot_serializer<T>>
+  bool save_snapshot(int fd) {
+    using stored_key = typename KeySerializer::stored_type;
+    using stored_value = typename ValueSerializer::stored_type;
+    using entry_type = snapshot_entry<stored_key, stored_value>;
+
+    if (!finalize()) {
+      return false;
+    }
+
+    uint64_t num_entries = 0U;
+    m_main->table_for_each_entry([&num_entries](Entry& e) {
+      if (e.val_val()) {
+        num_entries++;
+      }
+    });
+
+    snapshot_header header;
+    detail::snapshot_layout(num_entries, sizeof(entry_type),
+                            sizeof(stored_key), sizeof(stored_value), &header);
+    if (header.m_file_size > static_cast<uint64_t>(SIZE_MAX)) {
+      return false;
+    }
+
+    MMapFile file;
+    if (!file.init_write(fd, static_cast<size_t>(header.m_file_size))) {
+      return false;
+    }
+    unsigned char* base = static_cast<unsigned char*>(file.get_buf());
+    uint64_t* starts = reinterpret_cast<uint64_t*>(base +
+                                                   header.m_buckets_offset);
+    entry_type* entries =
+        reinterpret_cast<entry_type*>(base + header.m_entries_offset);
+    uint64_t const num_buckets = header.m_num_buckets;
+    rtl::hash<stored_key> hasher;
+
+    // Count the entries of every bucket into starts[b + 1], the file
+    // starts out zeroed
+    bool ok = true;
+    m_main->table_for_each_entry([&](Entry& e) {
+      stored_key key;
+      if (ok && e.val_val()) {
+        ok = KeySerializer::store(e.key_val(), &key);
+        if (ok) {
+          starts[hasher(key) % num_buckets + 1U]++;
+        }
+      }
+    });
+    if (!ok) {
+      return false;
+    }
+    for (uint64_t b = 0U; b < num_buckets; b++) {
+      starts[b + 1U] += starts[b];
+    }
+
+    // Place every entry at starts[b]++, which leaves starts[b] holding the
+    // end of bucket b, i.e. the start of bucket b + 1
+    m_main->table_for_each_entry([&](Entry& e) {
+      if (ok && e.val_val()) {
+        // Cleared and copied bytewise, so padding reaches the file as
+        // zeroes instead of whatever was on the stack
+        entry_type out;
+        std::memset(static_cast<void*>(&out), 0, sizeof(out));
+        ok = KeySerializer::store(e.key_val(), &out.m_key) &&
+             ValueSerializer::store(*e.val_val(), &out.m_value);
+        if (ok) {
+          uint64_t b = hasher(out.m_key) % num_buckets;
+          std::memcpy(static_cast<void*>(&entries[starts[b]++]), &out,
+                      sizeof(out));
+        }
+      }
+    });
+    if (!ok) {
+      return false;
+    }
+    for (uint64_t b = num_buckets; b > 0U; b--) {
+      starts[b] = starts[b - 1U];
+    }
+    starts[0] = 0U;
+
+    if (!file.sync()) {
+      return false;
+    }
+    std::memcpy(base, &header, sizeof(header));
+    return file.sync();
+  }
+
   //! Stop table from resizing
   void lock_table_size() { m_locked = true; }
 
@@ -614,6 +791,9 @@ class unordered_map {
 
   //! Returns true if key is contained in the map
   bool contains(Key const& key) const {
+    if (definitely_missing(key)) {
+      return false;
+    }
     switch (m_state) {
       case MapState::ERROR:
         return false;
@@ -646,7 +826,7 @@ class unordered_map {
         return nullptr;
         break;
       case MapState::STABLE: {
-        T* rval = m_main->get(key);
+        T* rval = definitely_missing(key) ? nullptr : m_main->get(key);
 
         if (should_resize()) {
           // Could potentially put us in transfer mode
@@ -663,12 +843,16 @@ class unordered_map {
 
       } break;
       case MapState::TRANSFER: {
-        T* rval = m_secondary->get(key);
-        bool valid_rval = rval;
+        T* rval = nullptr;
 
-        if (!valid_rval) {
-          // Is it in main?
-          rval = m_main->get(key);
+        if (!definitely_missing(key)) {
+          rval = m_secondary->get(key);
+          bool valid_rval = rval;
+
+          if (!valid_rval) {
+            // Is it in main?
+            rval = m_main->get(key);
+          }
         }
 
         bool successful_partial_transfer = perform_partial_transfer();
@@ -692,7 +876,118 @@ class unordered_map {
   //! Puts value val in the hashmap referenced by key.  Will override entries.
   template <typename U>
   bool put(Key const& key, U&& val) {
-    // The U&& is a universal reference
+    return put_impl(key, std::forward<U>(val));
+  }
+
+  /*!
+   * Same as put(Key const&, U&&) but moves the key into the map when a new
+   * entry is created, so keys that allocate (e.g. rtl::basic_string) aren't
+   * copied.
+   *
+   * ***IMPORTANT***
+   * key is only left moved from if a new entry was created
+   */
+  template <typename U>
+  bool put(Key&& key, U&& val) {
+    return put_impl(std::move(key), std::forward<U>(val));
+  }
+
+  //! Deletes all keys held by the map
+  void delete_all_keys() {
+    switch (m_state) {
+      case MapState::ERROR:
+        return;  // Don't do anything
+        break;
+      case MapState::STABLE: {
+        m_main->table_delete_all_entries(*m_alloc);
+        if (m_filter) {
+          m_filter->clear();
+        }
+        return;
+      } break;
+      case MapState::TRANSFER: {
+        m_main->table_delete_all_entries(*m_alloc);
+        m_secondary->table_delete_all_entries(*m_alloc);
+        if (m_filter) {
+          m_filter->clear();
+        }
+        (void)finalize();
+        return;
+
+      } break;
+      default:
+        break;
+    }
+  }
+
+  //! Deletes value pointed to by key
+  bool del(Key const& key) {
+    switch (m_state) {
+      case MapState::ERROR:
+        return false;  // Don't do anything
+        break;
+      case MapState::STABLE: {
+        bool rval = m_main->del(key, *m_alloc);
+
+        if (should_resize()) {
+          // Could potentially put us in transfer mode
+          unsigned int new_power_of_2 = m_main->get_next_power_of_2();
+          bool valid_resize = begin_resize(new_power_of_2);
+          if (!valid_resize) {
+            m_state = MapState::ERROR;
+            return false;
+          }
+        }
+
+        return rval;
+      } break;
+      case MapState::TRANSFER: {
+        bool rval = m_main->del(key, *m_alloc);
+
+        if (!rval) {
+          // If we didn't delete in main, then delete in secondary
+          rval = m_secondary->del(key, *m_alloc);
+        }
+
+        bool successful_transfer = perform_partial_transfer();
+        if (!successful_transfer) {
+          m_state = MapState::ERROR;
+          return false;
+        }
+        if (is_transfer_complete()) {
+          end_resize();
+        }
+
+        return rval;
+
+      } break;
+      default:
+        return false;  // Don't do anything
+        break;
+    }
+
+    return false;
+  }
+
+  /*!
+   * Returns the number of buckets needed given the number of items one expects
+   * and the current load factor.
+   */
+  uint32_t approx_buckets_needed(uint32_t expected_item_count) const {
+    return ((expected_item_count * 100U) /
+            static_cast<uint32_t>(m_max_load_factor_percent)) +
+           1U;
+  }
+
+ private:
+  bool definitely_missing(Key const& key) const {
+    return m_filter && !m_filter->may_contain(key);
+  }
+
+  // K&& and U&& are universal references, the key is only copied or moved
+  // into a newly created entry
+  template <typename K, typename U>
+  bool put_impl(K&& key, U&& val) {
     switch (m_state) {
       case MapState::ERROR:
         return false;
@@ -703,7 +998,7 @@ class unordered_map {
         do {
           TableGetOrCreateResult res;
 
-          res = m_main->table_get_or_create_entry(key);
+          res = m_main->table_get_or_create_entry(std::forward<K>(key));
 
           bool valid_entry = res.entry;
           bool valid_bucket = res.bucket;
@@ -725,6 +1020,9 @@ class unordered_map {
               break;
             }
 
+            if (res.created && m_filter) {
+              m_filter->insert(res.entry->key_val());
+            }
             rval = true;
           }
 
@@ -747,7 +1045,7 @@ class unordered_map {
 
         do {
           TableGetOrCreateResult res;
-          res = m_secondary->table_get_or_create_entry(key);
+          res = m_secondary->table_get_or_create_entry(std::forward<K>(key));
 
           // We directly insert into the secondary table,
           // knowing that our partial transfer process won't override
@@ -759,14 +1057,17 @@ class unordered_map {
           if (valid_entry && valid_bucket) {
             if (res.created) {
               // If we created this then we want to transfer the old
-              // entry if there is one
-              // The move will set the original to have a nullptr,
-              // meaning we can deconstruct it without an issue.
+              // value if there is one
+              // Only the value is taken, leaving the original with a
+              // nullptr so we can deconstruct it without an issue.  Its key
+              // must stay intact, the partial transfer still looks it up.
 
-              Entry* main_entry = m_main->table_get_entry(key);
+              // key may have been moved into the entry, look up by its copy
+              Entry* main_entry = m_main->table_get_entry(res.entry->key_val());
 
               if (main_entry) {
-                *res.entry = std::move(*main_entry);
+                res.entry->val_val() =
+                    rtl::exchange(main_entry->val_val(), nullptr);
               }
             }
 
@@ -789,6 +1090,9 @@ class unordered_map {
               break;
             }
 
+            if (res.created && m_filter) {
+              m_filter->insert(res.entry->key_val());
+            }
             rval = true;
           }
 
@@ -813,88 +1117,6 @@ class unordered_map {
     }
   }
 
-  //! Deletes all keys held by the map
-  void delete_all_keys() {
-    switch (m_state) {
-      case MapState::ERROR:
-        return;  // Don't do anything
-        break;
-      case MapState::STABLE: {
-        m_main->table_delete_all_entries(*m_alloc);
-        return;
-      } break;
-      case MapState::TRANSFER: {
-        m_main->table_delete_all_entries(*m_alloc);
-        m_secondary->table_delete_all_entries(*m_alloc);
-        (void)finalize();
-        return;
-
-      } break;
-      default:
-        break;
-    }
-  }
-
-  //! Deletes value pointed to by key
-  bool del(Key const& key) {
-    switch (m_state) {
-      case MapState::ERROR:
-        return false;  // Don't do anything
-        break;
-      case MapState::STABLE: {
-        bool rval = m_main->del(key, *m_alloc);
-
-        if (should_resize()) {
-          // Could potentially put us in transfer mode
-          unsigned int new_power_of_2 = m_main->get_next_power_of_2();
-          bool valid_resize = begin_resize(new_power_of_2);
-          if (!valid_resize) {
-            m_state = MapState::ERROR;
-            return false;
-          }
-        }
-
-        return rval;
-      } break;
-      case MapState::TRANSFER: {
-        bool rval = m_main->del(key, *m_alloc);
-
-        if (!rval) {
-          // If we didn't delete in main, then delete in secondary
-          rval = m_secondary->del(key, *m_alloc);
-        }
-
-        bool successful_transfer = perform_partial_transfer();
-        if (!successful_transfer) {
-          m_state = MapState::ERROR;
-          return false;
-        }
-        if (is_transfer_complete()) {
-          end_resize();
-        }
-
-        return rval;
-
-      } break;
-      default:
-        return false;  // Don't do anything
-        break;
-    }
-
-    return false;
-  }
-
-  /*!
-   * Returns the number of buckets needed given the number of items one expects
-   * and the current load factor.
-   */
-  uint32_t approx_buckets_needed(uint32_t expected_item_count) const {
-    return ((expected_item_count * 100U) /
-            static_cast<uint32_t>(m_max_load_factor_percent)) +
-           1U;
-  }
-
- private:
   /*
    * In order to facilitate real-time behavior, we amortize any resizing
    * over the various operations.  This along with our O(1) allocator gives
@@ -985,31 +1207,21 @@ class unordered_map {
          * Gameplan:
          *
          * Find an entry from the original main bucket
-         * Call get_or_create_entry for the secondary table
-         * If the new table created a new entry, we can move the
-         * entry from main over.  Otherwise, we just want to
-         * remove the main entry since we don't want to overwrite
-         * anything
+         * Look its key up in the secondary table
+         * If the new table doesn't have it, we can move the whole
+         * entry (key included, so nothing is copied) from main over.
+         * Otherwise, we just want to remove the main entry since we
+         * don't want to overwrite anything
          */
 
         Entry& e = bucket.entries().back();
 
-        TableGetOrCreateResult res;
-
-        res = m_secondary->table_get_or_create_entry(e.key_val());
-
-        bool valid_entry = res.entry;
-        bool valid_bucket = res.bucket;
-
-        if (!valid_entry || !valid_bucket) {
-          return false;
-        }
-
-        if (res.created) {
-          // If we actually created a new entry, then we should move it in
-          // Otherwise we should just discard the old entry
-
-          *res.entry = std::move(e);
+        Entry* existing = m_secondary->table_get_entry(e.key_val());
+        if (existing == nullptr) {
+          bool valid_insert = m_secondary->table_insert_entry(std::move(e));
+          if (!valid_insert) {
+            return false;
+          }
         }
 
         // If we didn't create a new entry, then this should be already moved
@@ -34,8 +34,33 @@ namespace rtl {
  * Normally one should use make_shared instead of constructing these
  * by hand.
  *
+ * A control block can be followed (in the same allocation) by a
+ * detail::release_hook and marked with set_release_hook().  The last strong
+ * release then calls the hook instead of destroying the data inline, see
+ * make_shared_deferred() in rtlcpp/reclaimer.hpp.  The mark is a bit of the
+ * weak count so plain control blocks don't grow.
+ *
  */
 
+namespace detail {
+
+//! Called with the control block when its last strong pointer goes away
+struct release_hook {
+  void (*m_release)(void* blk);
+};
+
+//! Set in the weak count of control blocks that are followed by a hook
+constexpr uint32_t kReleaseHookBit = 0x80000000U;
+
+//! Where the release_hook following a control block of type Blk starts
+template <typename Blk>
+constexpr size_t release_hook_offset() {
+  return (sizeof(Blk) + alignof(release_hook) - 1U) / alignof(release_hook) *
+         alignof(release_hook);
+}
+
+}  // namespace detail
+
 template <typename T, typename Alloc>
 struct control_blk {
  private:
@@ -93,7 +118,9 @@ struct control_blk {
   }
 
   uint32_t strong_count() const noexcept { return m_strong_count.load(); };
-  uint32_t weak_count() const noexcept { return m_weak_count.load(); }
+  uint32_t weak_count() const noexcept {
+    return m_weak_count.load() & ~detail::kReleaseHookBit;
+  }
 
   T* get() const { return m_data; }
 
@@ -146,6 +173,12 @@ struct control_blk {
 
     // if prev_val was 1, that means it was the last strong pointer
     if (prev_val == 1U) {
+      if ((m_weak_count.load() & detail::kReleaseHookBit) != 0U) {
+        // The hook now owns the weak reference held on behalf of the
+        // strong pointers
+        get_release_hook()->m_release(this);
+        return false;
+      }
       // De-allocate the pointed to object
       deinit();
       // Then we can decrement the weak_pointer
@@ -162,9 +195,26 @@ struct control_blk {
   bool dec_weak() {
     uint32_t prev_val = m_weak_count.fetch_sub(1U);
 
-    assert(prev_val != 0);
+    assert((prev_val & ~detail::kReleaseHookBit) != 0);
+
+    return ((prev_val & ~detail::kReleaseHookBit) == 1U);
+  }
+
+  Alloc* get_alloc() const { return m_alloc; }
+
+  /*!
+   * Marks this control block as followed by a detail::release_hook.  Must be
+   * called before the block is handed to a shared_ptr.
+   */
+  void set_release_hook() {
+    (void)m_weak_count.fetch_or(detail::kReleaseHookBit);
+  }
 
-    return (prev_val == 1U);
+ private:
+  detail::release_hook* get_release_hook() {
+    return reinterpret_cast<detail::release_hook*>(
+        reinterpret_cast<unsigned char*>(this) +
+        detail::release_hook_offset<control_blk>());
   }
 };
 
@@ -201,7 +251,9 @@ class control_blk<T[], Alloc> {
         m_weak_count(0U) {}
 
   uint32_t strong_count() const noexcept { return m_strong_count.load(); };
-  uint32_t weak_count() const noexcept { return m_weak_count.load(); }
+  uint32_t weak_count() const noexcept {
+    return m_weak_count.load() & ~detail::kReleaseHookBit;
+  }
 
   T* get() const { return m_array; }
   size_t array_size() const { return m_array_count; }
@@ -255,6 +307,12 @@ class control_blk<T[], Alloc> {
 
     // if prev_val was 1, that means it was the last strong pointer
     if (prev_val == 1U) {
+      if ((m_weak_count.load() & detail::kReleaseHookBit) != 0U) {
+        // The hook now owns the weak reference held on behalf of the
+        // strong pointers
+        get_release_hook()->m_release(this);
+        return false;
+      }
       // De-allocate the pointed to object
       deinit();
       // Then we can decrement the weak_pointer
@@ -271,9 +329,26 @@ class control_blk<T[], Alloc> {
   bool dec_weak() {
     uint32_t prev_val = m_weak_count.fetch_sub(1U);
 
-    assert(prev_val != 0);
+    assert((prev_val & ~detail::kReleaseHookBit) != 0);
+
+    return ((prev_val & ~detail::kReleaseHookBit) == 1U);
+  }
+
+  Alloc* get_alloc() const { return m_alloc; }
+
+  /*!
+   * Marks this control block as followed by a detail::release_hook.  Must be
+   * called before the block is handed to a shared_ptr.
+   */
+  void set_release_hook() {
+    (void)m_weak_count.fetch_or(detail::kReleaseHookBit);
+  }
 
-    return (prev_val == 1U);
+ private:
+  detail::release_hook* get_release_hook() {
+    return reinterpret_cast<detail::release_hook*>(
+        reinterpret_cast<unsigned char*>(this) +
+        detail::release_hook_offset<control_blk>());
   }
 };
 
@@ -0,0 +1,506 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RTLCPP_PRIORITY_QUEUE_HPP
+#define RTLCPP_PRIORITY_QUEUE_HPP
+
+#include <functional>  // for std::less
+#include <utility>
+
+#include "rtlcpp/allocator.hpp"
+#include "rtlcpp/utility.hpp"
+#include "rtlcpp/vector.hpp"
+
+namespace rtl {
+
+/*!
+ * An allocator aware priority queue, implemented as a D-ary heap on an
+ * rtl::vector.
+ *
+ * Like std::priority_queue the top is the element that no other element
+ * ranks above according to Compare, so std::less gives a max-heap and
+ * std::greater a min-heap (e.g. the earliest deadline first).
+ *
+ * With D = 4 the heap is half as deep as a binary heap and the children
+ * of a node are next to each other in memory, so sifting down compares
+ * elements from one cache line per level.
+ *
+ * push() only allocates when the vector has to grow; reserve() ahead of
+ * time and push() never allocates.  pop() never allocates.
+ *
+ * This class is not thread-safe.
+ *
+ * @tparam T the type held in the queue
+ * @tparam Compare strict weak ordering, the top ranks highest
+ * @tparam Alloc the allocator provided
+ * @tparam D the number of children per node
+ */
+template <typename T, typename Compare = std::less<T>,
+          typename Alloc = RTDefaultAllocator, size_t D = 4U>
+class priority_queue {
+  static_assert(D >= 2U, "A heap needs at least two children per node");
+
+ private:
+  rtl::vector<T, Alloc> m_heap;
+  Compare m_cmp;
+
+ public:
+  /*!
+   * Construct an empty queue with a pointer to the allocator.
+   *
+   * The queue does not take ownership of the allocator.
+   *
+   * @param alloc  the allocator provided
+   */
+  explicit priority_queue(Alloc* alloc, Compare cmp = Compare())
+      : m_heap(alloc), m_cmp(cmp) {}
+
+  priority_queue(priority_queue const&) = delete;
+  priority_queue& operator=(priority_queue const&) = delete;
+
+  priority_queue(priority_queue&&) noexcept = default;
+  priority_queue& operator=(priority_queue&&) noexcept = default;
+
+  //! Makes room for new_capacity elements, see rtl::vector::reserve()
+  bool reserve(size_t new_capacity) { return m_heap.reserve(new_capacity); }
+
+  /*!
+   * Adds value to the queue.
+   *
+   * If this function returns false, the queue could not grow and is
+   * unchanged.
+   *
+   * @return true if added, otherwise false
+   */
+  bool push(T const& value) {
+    if (!m_heap.push_back(value)) {
+      return false;
+    }
+    sift_up(m_heap.size() - 1U);
+    return true;
+  }
+
+  bool push(T&& value) {
+    if (!m_heap.push_back(std::move(value))) {
+      return false;
+    }
+    sift_up(m_heap.size() - 1U);
+    return true;
+  }
+
+  /*!
+   * Returns the highest ranked element.
+   *
+   * Undefined behavior if the queue is empty
+   */
+  T const& top() const { return m_heap.front(); }
+
+  /*!
+   * Removes the highest ranked element.
+   *
+   * @return false if the queue was empty, otherwise true
+   */
+  bool pop() {
+    if (m_heap.empty()) {
+      return false;
+    }
+    if (m_heap.size() > 1U) {
+      m_heap.front() = std::move(m_heap.back());
+    }
+    m_heap.pop_back();
+    sift_down(0U);
+    return true;
+  }
+
+  /*!
+   * Moves the highest ranked element to out and removes it.
+   *
+   * @return false if the queue was empty (out is not modified), otherwise
+   * true
+   */
+  bool pop(T* out) {
+    if (m_heap.empty()) {
+      return false;
+    }
+    *out = std::move(m_heap.front());
+    return pop();
+  }
+
+  //! Removes every element, keeps the capacity
+  void clear() { m_heap.clear(); }
+
+  size_t size() const { return m_heap.size(); }
+  bool empty() const { return m_heap.empty(); }
+  size_t capacity() const { return m_heap.capacity(); }
+
+ private:
+  void sift_up(size_t i) {
+    if (i == 0U) {
+      return;
+    }
+    T* h = m_heap.get_buf();
+    T tmp(std::move(h[i]));
+    while (i > 0U) {
+      size_t parent = (i - 1U) / D;
+      if (!m_cmp(h[parent], tmp)) {
+        break;
+      }
+      h[i] = std::move(h[parent]);
+      i = parent;
+    }
+    h[i] = std::move(tmp);
+  }
+
+  void sift_down(size_t i) {
+    size_t n = m_heap.size();
+    if (D * i + 1U >= n) {
+      return;
+    }
+    T* h = m_heap.get_buf();
+    T tmp(std::move(h[i]));
+    for (;;) {
+      size_t first = D * i + 1U;
+      if (first >= n) {
+        break;
+      }
+      size_t last = first + D < n ? first + D : n;
+      size_t best = first;
+      for (size_t c = first + 1U; c < last; c++) {
+        if (m_cmp(h[best], h[c])) {
+          best = c;
+        }
+      }
+      if (!m_cmp(tmp, h[best])) {
+        break;
+      }
+      h[i] = std::move(h[best]);
+      i = best;
+    }
+    h[i] = std::move(tmp);
+  }
+};
+
+/*!
+ * A priority queue like rtl::priority_queue whose elements can be reached
+ * through a handle after they were pushed, to change their priority or
+ * remove them (e.g. a timeout that is re-armed or cancelled).
+ *
+ * push() hands out a handle that stays valid until the element is popped
+ * or removed, after which it may be reused by a later push().  update(),
+ * decrease_key() and remove() are O(log n).
+ *
+ * Handles live in a table next to the heap; reserve() sizes both so
+ * push() never allocates.  pop(), remove() and the key changes never
+ * allocate.
+ *
+ * This class is not thread-safe.
+ *
+ * @tparam T the type held in the queue
+ * @tparam Compare strict weak ordering, the top ranks highest
+ * @tparam Alloc the allocator provided
+ * @tparam D the number of children per node
+ */
+template <typename T, typename Compare = std::less<T>,
+          typename Alloc = RTDefaultAllocator, size_t D = 4U>
+class indexed_priority_queue {
+  static_assert(D >= 2U, "A heap needs at least two children per node");
+
+ private:
+  struct Entry {
+    T m_value;
+    size_t m_handle;
+  };
+
+  // A free handle stores the next free handle with this bit set, the
+  // free list ends with kNoHandle
+  static const size_t kFreeBit = ~(~static_cast<size_t>(0U) >> 1U);
+  static const size_t kNoHandle = ~kFreeBit;
+
+  rtl::vector<Entry, Alloc> m_heap;
+  //! The heap index of every handle, or the next free handle | kFreeBit
+  rtl::vector<size_t, Alloc> m_positions;
+  size_t m_free_head;
+  Compare m_cmp;
+
+ public:
+  /*!
+   * Construct an empty queue with a pointer to the allocator.
+   *
+   * The queue does not take ownership of the allocator.
+   *
+   * @param alloc  the allocator provided
+   */
+  explicit indexed_priority_queue(Alloc* alloc, Compare cmp = Compare())
+      : m_heap(alloc), m_positions(alloc), m_free_head(kNoHandle), m_cmp(cmp) {}
+
+  indexed_priority_queue(indexed_priority_queue const&) = delete;
+  indexed_priority_queue& operator=(indexed_priority_queue const&) = delete;
+
+  indexed_priority_queue(indexed_priority_queue&& o) noexcept
+      : m_heap(std::move(o.m_heap)),
+        m_positions(std::move(o.m_positions)),
+        m_free_head(rtl::exchange(o.m_free_head, kNoHandle)),
+        m_cmp(std::move(o.m_cmp)) {}
+
+  indexed_priority_queue& operator=(indexed_priority_queue&& o) noexcept {
+    if (this != &o) {
+      m_heap = std::move(o.m_heap);
+      m_positions = std::move(o.m_positions);
+      m_free_head = rtl::exchange(o.m_free_head, kNoHandle);
+      m_cmp = std::move(o.m_cmp);
+    }
+    return *this;
+  }
+
+  //! Makes room for new_capacity elements and their handles
+  bool reserve(size_t new_capacity) {
+    return m_heap.reserve(new_capacity) && m_positions.reserve(new_capacity);
+  }
+
+  /*!
+   * Adds value to the queue and stores its handle in handle.
+   *
+   * If this function returns false, the queue could not grow and is
+   * unchanged.
+   *
+   * @return true if added, otherwise false
+   */
+  template <typename U>
+  bool push(U&& value, size_t* handle) {
+    size_t h = m_free_head;
+    if (h == kNoHandle) {
+      h = m_positions.size();
+      if (!m_positions.push_back(kNoHandle)) {
+        return false;
+      }
+    }
+    if (!m_heap.push_back(Entry{T(std::forward<U>(value)), h})) {
+      if (h != m_free_head) {
+        m_positions.pop_back();
+      }
+      return false;
+    }
+    if (h == m_free_head) {
+      m_free_head = next_free(h);
+    }
+    m_positions[h] = m_heap.size() - 1U;
+    sift_up(m_heap.size() - 1U);
+    *handle = h;
+    return true;
+  }
+
+  /*!
+   * Returns the highest ranked element.
+   *
+   * Undefined behavior if the queue is empty
+   */
+  T const& top() const { return m_heap.front().m_value; }
+
+  /*!
+   * Returns the handle of the highest ranked element.
+   *
+   * Undefined behavior if the queue is empty
+   */
+  size_t top_handle() const { return m_heap.front().m_handle; }
+
+  /*!
+   * Removes the highest ranked element, its handle becomes invalid.
+   *
+   * @return false if the queue was empty, otherwise true
+   */
+  bool pop() {
+    if (m_heap.empty()) {
+      return false;
+    }
+    remove_at(0U);
+    return true;
+  }
+
+  /*!
+   * Moves the highest ranked element to out and removes it.
+   *
+   * @return false if the queue was empty (out is not modified), otherwise
+   * true
+   */
+  bool pop(T* out) {
+    if (m_heap.empty()) {
+      return false;
+    }
+    *out = std::move(m_heap.front().m_value);
+    remove_at(0U);
+    return true;
+  }
+
+  //! True if handle refers to an element in the queue
+  bool contains(size_t handle) const {
+    return handle < m_positions.size() &&
+           (m_positions.get_buf()[handle] & kFreeBit) == 0U;
+  }
+
+  //! Returns the element for handle or nullptr if handle is not valid
+  T const* get(size_t handle) const {
+    if (!contains(handle)) {
+      return nullptr;
+    }
+    return &m_heap.get_buf()[m_positions.get_buf()[handle]].m_value;
+  }
+
+  /*!
+   * Replaces the element for handle with value and restores the heap
+   * order, whichever way the priority changed.
+   *
+   * @return false if handle is not valid, otherwise true
+   */
+  template <typename U>
+  bool update(size_t handle, U&& value) {
+    if (!contains(handle)) {
+      return false;
+    }
+    size_t i = m_positions[handle];
+    bool up = m_cmp(m_heap[i].m_value, value);
+    m_heap[i].m_value = std::forward<U>(value);
+    if (up) {
+      sift_up(i);
+    } else {
+      sift_down(i);
+    }
+    return true;
+  }
+
+  /*!
+   * Replaces the element for handle with value that ranks at least as high,
+   * moving it towards the top.  With std::greater (a min-heap) this is the
+   * classic decrease key.
+   *
+   * @return false if handle is not valid or value ranks lower than the
+   * current element (nothing is changed), otherwise true
+   */
+  template <typename U>
+  bool decrease_key(size_t handle, U&& value) {
+    if (!contains(handle)) {
+      return false;
+    }
+    size_t i = m_positions[handle];
+    if (m_cmp(value, m_heap[i].m_value)) {
+      return false;
+    }
+    m_heap[i].m_value = std::forward<U>(value);
+    sift_up(i);
+    return true;
+  }
+
+  /*!
+   * Removes the element for handle, the handle becomes invalid.
+   *
+   * @return false if handle is not valid, otherwise true
+   */
+  bool remove(size_t handle) {
+    if (!contains(handle)) {
+      return false;
+    }
+    remove_at(m_positions[handle]);
+    return true;
+  }
+
+  //! Removes every element and invalidates every handle, keeps the capacity
+  void clear() {
+    m_heap.clear();
+    m_positions.clear();
+    m_free_head = kNoHandle;
+  }
+
+  size_t size() const { return m_heap.size(); }
+  bool empty() const { return m_heap.empty(); }
+
+ private:
+  size_t next_free(size_t handle) const {
+    return m_positions.get_buf()[handle] & ~kFreeBit;
+  }
+
+  void remove_at(size_t i) {
+    size_t handle = m_heap[i].m_handle;
+    size_t last = m_heap.size() - 1U;
+
+    if (i != last) {
+      m_heap[i] = std::move(m_heap[last]);
+      m_positions[m_heap[i].m_handle] = i;
+    }
+    m_heap.pop_back();
+
+    m_positions[handle] = m_free_head | kFreeBit;
+    m_free_head = handle;
+
+    if (i != last) {
+      if (i > 0U && m_cmp(m_heap[(i - 1U) / D].m_value, m_heap[i].m_value)) {
+        sift_up(i);
+      } else {
+        sift_down(i);
+      }
+    }
+  }
+
+  void place(size_t i, Entry&& e) {
+    m_positions[e.m_handle] = i;
+    m_heap[i] = std::move(e);
+  }
+
+  void sift_up(size_t i) {
+    Entry* h = m_heap.get_buf();
+    Entry tmp(std::move(h[i]));
+    while (i > 0U) {
+      size_t parent = (i - 1U) / D;
+      if (!m_cmp(h[parent].m_value, tmp.m_value)) {
+        break;
+      }
+      place(i, std::move(h[parent]));
+      i = parent;
+    }
+    place(i, std::move(tmp));
+  }
+
+  void sift_down(size_t i) {
+    size_t n = m_heap.size();
+    Entry* h = m_heap.get_buf();
+    Entry tmp(std::move(h[i]));
+    for (;;) {
+      size_t first = D * i + 1U;
+      if (first >= n) {
+        break;
+      }
+      size_t last = first + D < n ? first + D : n;
+      size_t best = first;
+      for (size_t c = first + 1U; c < last; c++) {
+        if (m_cmp(h[best].m_value, h[c].m_value)) {
+          best = c;
+        }
+      }
+      if (!m_cmp(tmp.m_value, h[best].m_value)) {
+        break;
+      }
+      place(i, std::move(h[best]));
+      i = best;
+    }
+    place(i, std::move(tmp));
+  }
+};
+
+template <typename T, typename Compare, typename Alloc, size_t D>
+const size_t indexed_priority_queue<T, Compare, Alloc, D>::kFreeBit;
+
+template <typename T, typename Compare, typename Alloc, size_t D>
+const size_t indexed_priority_queue<T, Compare, Alloc, D>::kNoHandle;
+
+}  // namespace rtl
+
+#endif  // RTLCPP_PRIORITY_QUEUE_HPP
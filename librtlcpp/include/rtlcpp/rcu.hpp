@@ -0,0 +1,355 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RTLCPP_RCU_HPP
+#define RTLCPP_RCU_HPP
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <utility>
+
+#include "rtlcpp/allocator.hpp"
+#include "rtlcpp/mutex.hpp"
+#include "rtlcpp/utility.hpp"
+
+namespace rtl {
+
+/*!
+ * A read-copy-update (RCU) pointer that publishes immutable snapshots of
+ * type T from writer threads to reader threads.
+ *
+ * Reclamation is quiescent-state based: every reader registers once and
+ * receives a reader id.  While a reader is online, read() is a single
+ * acquire load of the current snapshot and never blocks or retries.
+ * Readers periodically announce that they no longer hold any snapshot
+ * pointers by calling quiescent() (e.g. once per loop iteration of a real
+ * time thread).  A reader that will not read for a while (e.g. before
+ * sleeping) should call offline() so that it does not hold up reclamation.
+ *
+ * A writer calls publish() to swap in a new snapshot.  The old snapshot is
+ * put on a retired list and is only destroyed (and its memory given back to
+ * the allocator) once every online reader has passed a quiescent point after
+ * the swap.  Writers are serialized with the Mutex template parameter.
+ *
+ * ***IMPORTANT***
+ *
+ * Pointers returned by read() are only valid until the same reader calls
+ * quiescent() or offline().
+ *
+ * @tparam T the type of the snapshot
+ * @tparam Alloc  the allocator provided
+ * @tparam MaxReaders the maximum number of concurrently registered readers
+ * @tparam Mutex a class that satisfies the Lockable concept, used to
+ * serialize writers
+ */
+template <typename T, typename Alloc = RTDefaultAllocator,
+          size_t MaxReaders = 16U, typename Mutex = std::mutex>
+class rcu_ptr final {
+ private:
+  static_assert(MaxReaders > 0U, "rcu_ptr needs room for at least one reader");
+
+  struct Node {
+    T m_value;
+    uint64_t m_retire_epoch;
+    Node* m_next_retired;
+
+    template <typename... Args>
+    explicit Node(Args&&... args)
+        : m_value(std::forward<Args>(args)...),
+          m_retire_epoch(0U),
+          m_next_retired(nullptr) {}
+  };
+
+  struct ReaderSlot {
+    // Zero means the reader is offline, otherwise it is the last global
+    // epoch the reader observed at a quiescent point.
+    alignas(64) std::atomic<uint64_t> m_epoch;
+    std::atomic<bool> m_in_use;
+
+    ReaderSlot() : m_epoch(0U), m_in_use(false) {}
+  };
+
+  Alloc* m_alloc;
+
+  // Pads and alignas are to prevent false-sharing between the readers
+  // and the writer
+  alignas(64) std::atomic<Node*> m_current;
+  alignas(64) std::atomic<uint64_t> m_epoch;
+
+  ReaderSlot m_readers[MaxReaders];
+
+  // Owned by the writers and protected by m_writer_mtx
+  alignas(64) Mutex m_writer_mtx;
+  Node* m_retired_head;
+  size_t m_retired_count;
+
+ public:
+  /*!
+   * Creates an rcu_ptr with no snapshot published, read() will return
+   * nullptr until the first publish().
+   *
+   * This class does not take ownership of the allocator
+   *
+   * @param alloc the allocator provided
+   */
+  explicit rcu_ptr(Alloc* alloc)
+      : m_alloc(alloc),
+        m_current(nullptr),
+        m_epoch(1U),
+        m_readers(),
+        m_writer_mtx(),
+        m_retired_head(nullptr),
+        m_retired_count(0U) {}
+
+  /*!
+   * Destroys the current snapshot and every retired snapshot.
+   *
+   * ***IMPORTANT***
+   *
+   * No reader may be using this object when it is destroyed.
+   */
+  ~rcu_ptr() {
+    destroy_node(m_current.exchange(nullptr));
+
+    Node* n = m_retired_head;
+    while (n != nullptr) {
+      Node* next = n->m_next_retired;
+      destroy_node(n);
+      n = next;
+    }
+  }
+
+  /*
+   * Readers keep the addresses of the reader slots and snapshots, so
+   * this class can be neither copied nor moved.
+   */
+  rcu_ptr(rcu_ptr const&) = delete;
+  rcu_ptr& operator=(rcu_ptr const&) = delete;
+
+  rcu_ptr(rcu_ptr&&) noexcept = delete;
+  rcu_ptr& operator=(rcu_ptr&&) noexcept = delete;
+
+  /*!
+   * Registers the calling thread as a reader.  The reader starts online.
+   *
+   * Returns false if MaxReaders readers are already registered.
+   *
+   * @param reader_id set to the id to use with the other reader functions
+   * @return true if successful, otherwise false
+   */
+  bool register_reader(size_t* reader_id) {
+    if (reader_id == nullptr) {
+      return false;
+    }
+
+    for (size_t i = 0U; i < MaxReaders; i++) {
+      bool expected = false;
+      if (m_readers[i].m_in_use.compare_exchange_strong(expected, true)) {
+        *reader_id = i;
+        online(i);
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  //! Unregisters a reader, the reader id may be handed out again afterwards
+  void unregister_reader(size_t reader_id) {
+    assert(reader_id < MaxReaders);
+    offline(reader_id);
+    m_readers[reader_id].m_in_use.store(false, std::memory_order_release);
+  }
+
+  /*!
+   * Returns the current snapshot or nullptr if nothing has been published.
+   *
+   * This is wait-free and costs a single acquire load.  Only valid while
+   * the calling reader is online.
+   *
+   * @return a pointer to the current snapshot
+   */
+  T const* read() const {
+    Node* n = m_current.load(std::memory_order_acquire);
+    return (n == nullptr) ? nullptr : &n->m_value;
+  }
+
+  /*!
+   * Announces that the reader no longer holds any pointer returned by read().
+   *
+   * Wait-free, costs one load and one store to the reader's own cache line.
+   *
+   * @param reader_id the id given by register_reader()
+   */
+  void quiescent(size_t reader_id) {
+    assert(reader_id < MaxReaders);
+    m_readers[reader_id].m_epoch.store(m_epoch.load(std::memory_order_acquire),
+                                       std::memory_order_release);
+  }
+
+  /*!
+   * Marks the reader as offline.  An offline reader does not hold up
+   * reclamation but may not call read() until online() is called.
+   *
+   * @param reader_id the id given by register_reader()
+   */
+  void offline(size_t reader_id) {
+    assert(reader_id < MaxReaders);
+    m_readers[reader_id].m_epoch.store(0U, std::memory_order_release);
+  }
+
+  /*!
+   * Marks an offline reader as online again.
+   *
+   * @param reader_id the id given by register_reader()
+   */
+  void online(size_t reader_id) {
+    assert(reader_id < MaxReaders);
+    m_readers[reader_id].m_epoch.store(m_epoch.load(std::memory_order_seq_cst),
+                                       std::memory_order_seq_cst);
+    // Orders the store above against the first read() afterwards so a
+    // writer either sees this reader online or this reader sees the newest
+    // snapshot.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+
+  /*!
+   * Constructs a new snapshot with the provided arguments, makes it the
+   * current snapshot and retires the previous one.
+   *
+   * Afterwards, this attempts to reclaim retired snapshots that no reader
+   * can reference anymore.
+   *
+   * Returns false if memory could not be allocated, in which case the
+   * current snapshot is unchanged.
+   *
+   * @param args the arguments to construct T with
+   * @return true if successful, otherwise false
+   */
+  template <typename... Args>
+  bool publish(Args&&... args) {
+    void* mem = m_alloc->allocate(sizeof(Node));
+    if (mem == nullptr) {
+      return false;
+    }
+    Node* n = new (mem) Node(std::forward<Args>(args)...);
+
+    std::lock_guard<Mutex> lck(m_writer_mtx);
+
+    Node* old = m_current.exchange(n, std::memory_order_seq_cst);
+    if (old != nullptr) {
+      old->m_retire_epoch =
+          m_epoch.fetch_add(1U, std::memory_order_seq_cst) + 1U;
+      old->m_next_retired = m_retired_head;
+      m_retired_head = old;
+      m_retired_count++;
+    }
+
+    (void)priv_reclaim();
+    return true;
+  }
+
+  /*!
+   * Destroys every retired snapshot that all online readers have moved past.
+   *
+   * Never blocks on readers.
+   *
+   * @return the number of snapshots reclaimed
+   */
+  size_t reclaim() {
+    std::lock_guard<Mutex> lck(m_writer_mtx);
+    return priv_reclaim();
+  }
+
+  /*!
+   * Blocks until every retired snapshot has been reclaimed.
+   *
+   * ***IMPORTANT***
+   *
+   * This waits on readers and is NOT suitable for real time threads.  It
+   * will never return if an online reader stops calling quiescent().
+   */
+  template <typename Slumber = SlumberViaProgressive>
+  void synchronize() {
+    Slumber s;
+    while (true) {
+      {
+        std::lock_guard<Mutex> lck(m_writer_mtx);
+        (void)priv_reclaim();
+        if (m_retired_count == 0U) {
+          return;
+        }
+      }
+      s.wait();
+    }
+  }
+
+  //! The number of snapshots waiting to be reclaimed
+  size_t retired_count() {
+    std::lock_guard<Mutex> lck(m_writer_mtx);
+    return m_retired_count;
+  }
+
+ private:
+  void destroy_node(Node* n) {
+    if (n == nullptr) {
+      return;
+    }
+    n->~Node();
+    m_alloc->deallocate(n);
+  }
+
+  // Must be called with m_writer_mtx held
+  size_t priv_reclaim() {
+    if (m_retired_head == nullptr) {
+      return 0U;
+    }
+
+    // The oldest epoch any online reader could still be reading in.  If
+    // there are no online readers then everything can be reclaimed.
+    uint64_t min_epoch = UINT64_MAX;
+    for (size_t i = 0U; i < MaxReaders; i++) {
+      uint64_t e = m_readers[i].m_epoch.load(std::memory_order_seq_cst);
+      if (e != 0U && e < min_epoch) {
+        min_epoch = e;
+      }
+    }
+
+    size_t num_reclaimed = 0U;
+    Node** link = &m_retired_head;
+    while (*link != nullptr) {
+      Node* n = *link;
+      // A reader that observed the retire epoch did so after the swap, so
+      // it can only see newer snapshots from then on.
+      if (n->m_retire_epoch <= min_epoch) {
+        *link = n->m_next_retired;
+        destroy_node(n);
+        num_reclaimed++;
+      } else {
+        link = &n->m_next_retired;
+      }
+    }
+
+    m_retired_count -= num_reclaimed;
+    return num_reclaimed;
+  }
+};
+
+}  // namespace rtl
+
+#endif  // RTLCPP_RCU_HPP
@@ -0,0 +1,614 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RTLCPP_RECLAIM_HPP
+#define RTLCPP_RECLAIM_HPP
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include "rtlcpp/allocator.hpp"
+#include "rtlcpp/utility.hpp"
+
+namespace rtl {
+
+/*
+ * Safe memory reclamation for lock-free data structures.
+ *
+ * Both domains below follow the same pattern: a thread registers with the
+ * domain and receives a thread id, reads shared pointers only while they
+ * are protected (inside an epoch critical section or behind a hazard
+ * pointer), and hands unlinked objects to retire().  Retired objects are
+ * destroyed and given back to the allocator once no thread can still be
+ * reading them.
+ *
+ * Retire lists are bounded and allocated from the allocator the first time
+ * a thread id is handed out.  When a retire list is full and nothing can be
+ * reclaimed, retire() returns false and the caller still owns the object.
+ */
+
+namespace detail {
+
+template <typename Alloc>
+struct retired_ptr {
+  void* m_ptr;
+  void (*m_reclaim)(Alloc*, void*);
+};
+
+template <typename T, typename Alloc>
+void reclaim_with_alloc(Alloc* alloc, void* p) {
+  static_cast<T*>(p)->~T();
+  alloc->deallocate(p);
+}
+
+}  // namespace detail
+
+/*!
+ * Epoch-based reclamation (EBR).
+ *
+ * Readers call enter() before touching shared pointers and exit() when done
+ * (or use epoch_guard).  Both are wait-free.  An object retired during
+ * global epoch E is reclaimed once the global epoch reaches E + 2, which
+ * can only happen after every thread that was inside a critical section
+ * during E has left it.
+ *
+ * EBR has the cheapest read side but a thread that stalls inside a critical
+ * section stops all reclamation, so retire() will start failing once the
+ * retire lists fill up.  Use hazard_domain when that matters.
+ *
+ * @tparam Alloc  the allocator provided
+ * @tparam MaxThreads the maximum number of concurrently registered threads
+ * @tparam RetireCapacity the maximum number of objects a thread can retire
+ * per epoch, a thread holds at most 3 * RetireCapacity unreclaimed objects
+ */
+template <typename Alloc = RTDefaultAllocator, size_t MaxThreads = 16U,
+          size_t RetireCapacity = 128U>
+class epoch_domain final {
+ private:
+  static_assert(MaxThreads > 0U, "epoch_domain needs at least one thread");
+  static_assert(RetireCapacity > 0U, "RetireCapacity must be non-zero");
+
+  // Objects can only be retired in the current epoch and the two before it
+  static constexpr size_t kNumBuckets = 3U;
+
+  struct Bucket {
+    uint64_t m_epoch;
+    size_t m_size;
+    detail::retired_ptr<Alloc>* m_entries;
+  };
+
+  struct ThreadRecord {
+    // Zero when outside of a critical section, otherwise
+    // (epoch << 1) | 1 where epoch is the global epoch at enter()
+    alignas(64) std::atomic<uint64_t> m_state;
+    std::atomic<bool> m_in_use;
+
+    // Only touched by the owning thread (or by the destructor)
+    Bucket m_buckets[kNumBuckets];
+
+    ThreadRecord() : m_state(0U), m_in_use(false), m_buckets() {}
+  };
+
+  Alloc* m_alloc;
+  alignas(64) std::atomic<uint64_t> m_epoch;
+  ThreadRecord m_records[MaxThreads];
+
+ public:
+  /*!
+   * This class does not take ownership of the allocator
+   *
+   * @param alloc the allocator provided
+   */
+  explicit epoch_domain(Alloc* alloc)
+      : m_alloc(alloc), m_epoch(kNumBuckets), m_records() {}
+
+  /*!
+   * Reclaims every object that is still retired.
+   *
+   * ***IMPORTANT***
+   *
+   * No thread may be using this domain when it is destroyed.
+   */
+  ~epoch_domain() {
+    for (size_t i = 0U; i < MaxThreads; i++) {
+      for (size_t b = 0U; b < kNumBuckets; b++) {
+        Bucket& bucket = m_records[i].m_buckets[b];
+        reclaim_bucket(&bucket);
+        if (bucket.m_entries != nullptr) {
+          m_alloc->deallocate(bucket.m_entries);
+        }
+      }
+    }
+  }
+
+  // Threads keep pointers into this class so it can't be copied or moved
+  epoch_domain(epoch_domain const&) = delete;
+  epoch_domain& operator=(epoch_domain const&) = delete;
+
+  epoch_domain(epoch_domain&&) noexcept = delete;
+  epoch_domain& operator=(epoch_domain&&) noexcept = delete;
+
+  /*!
+   * Registers the calling thread with the domain.
+   *
+   * The first time a thread id is handed out its retire lists are
+   * allocated, so this is not suitable for real time threads.
+   *
+   * Returns false if there is no free thread id or memory could not be
+   * allocated.
+   *
+   * @param thread_id set to the id to use with the other functions
+   * @return true if successful, otherwise false
+   */
+  bool register_thread(size_t* thread_id) {
+    if (thread_id == nullptr) {
+      return false;
+    }
+
+    for (size_t i = 0U; i < MaxThreads; i++) {
+      ThreadRecord& rec = m_records[i];
+      bool expected = false;
+      if (!rec.m_in_use.compare_exchange_strong(expected, true)) {
+        continue;
+      }
+
+      for (size_t b = 0U; b < kNumBuckets; b++) {
+        Bucket& bucket = rec.m_buckets[b];
+        if (bucket.m_entries != nullptr) {
+          continue;
+        }
+        void* mem = m_alloc->allocate(sizeof(detail::retired_ptr<Alloc>) *
+                                      RetireCapacity);
+        if (mem == nullptr) {
+          rec.m_in_use.store(false);
+          return false;
+        }
+        bucket.m_entries = static_cast<detail::retired_ptr<Alloc>*>(mem);
+        bucket.m_size = 0U;
+      }
+
+      *thread_id = i;
+      return true;
+    }
+
+    return false;
+  }
+
+  /*!
+   * Unregisters a thread.  Objects it retired that could not be reclaimed
+   * yet stay with the thread id and are reclaimed by whichever thread
+   * registers with that id next (or by the destructor).
+   */
+  void unregister_thread(size_t thread_id) {
+    assert(thread_id < MaxThreads);
+    ThreadRecord& rec = m_records[thread_id];
+    rec.m_state.store(0U, std::memory_order_release);
+    (void)collect(thread_id);
+    rec.m_in_use.store(false, std::memory_order_release);
+  }
+
+  //! Enters a critical section, shared pointers may be read until exit()
+  void enter(size_t thread_id) {
+    assert(thread_id < MaxThreads);
+    uint64_t e = m_epoch.load(std::memory_order_relaxed);
+    m_records[thread_id].m_state.store((e << 1U) | 1U,
+                                       std::memory_order_relaxed);
+    // Makes the store above visible before any shared pointer is read,
+    // otherwise an advancing thread could miss us.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+
+  //! Leaves a critical section
+  void exit(size_t thread_id) {
+    assert(thread_id < MaxThreads);
+    m_records[thread_id].m_state.store(0U, std::memory_order_release);
+  }
+
+  /*!
+   * Retires an object that has been unlinked from the shared structure.
+   * Once it is safe, the destructor is called and the memory is given back
+   * to the allocator.
+   *
+   * Returns false if the retire list is full and nothing could be
+   * reclaimed, in which case the caller still owns p and should try again
+   * later.
+   *
+   * @param thread_id the id given by register_thread()
+   * @param p an object allocated with the domain's allocator
+   * @return true if successful, otherwise false
+   */
+  template <typename T>
+  bool retire(size_t thread_id, T* p) {
+    assert(thread_id < MaxThreads);
+    if (p == nullptr) {
+      return true;
+    }
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+      // Tagging with an epoch at least as new as the one p was unlinked in
+      uint64_t e = m_epoch.load(std::memory_order_seq_cst);
+      Bucket* bucket = priv_bucket_for(thread_id, e);
+
+      if (bucket->m_size < RetireCapacity) {
+        bucket->m_entries[bucket->m_size++] = {
+            static_cast<void*>(p), &detail::reclaim_with_alloc<T, Alloc>};
+        return true;
+      }
+
+      (void)try_advance();
+    }
+
+    return false;
+  }
+
+  /*!
+   * Tries to advance the global epoch and then reclaims everything the
+   * calling thread retired that is now safe to reclaim.
+   *
+   * @param thread_id the id given by register_thread()
+   * @return the number of objects reclaimed
+   */
+  size_t collect(size_t thread_id) {
+    assert(thread_id < MaxThreads);
+    (void)try_advance();
+
+    uint64_t e = m_epoch.load(std::memory_order_acquire);
+    size_t num_reclaimed = 0U;
+    for (size_t b = 0U; b < kNumBuckets; b++) {
+      Bucket& bucket = m_records[thread_id].m_buckets[b];
+      if (bucket.m_epoch + 2U <= e) {
+        num_reclaimed += reclaim_bucket(&bucket);
+      }
+    }
+    return num_reclaimed;
+  }
+
+  /*!
+   * Advances the global epoch if every thread inside a critical section
+   * has observed the current epoch.
+   *
+   * @return true if the epoch was advanced, otherwise false
+   */
+  bool try_advance() {
+    uint64_t e = m_epoch.load(std::memory_order_seq_cst);
+    for (size_t i = 0U; i < MaxThreads; i++) {
+      uint64_t s = m_records[i].m_state.load(std::memory_order_seq_cst);
+      if ((s & 1U) != 0U && (s >> 1U) != e) {
+        return false;
+      }
+    }
+    return m_epoch.compare_exchange_strong(e, e + 1U,
+                                           std::memory_order_seq_cst);
+  }
+
+  //! The number of objects retired by thread_id that are not reclaimed yet
+  size_t retired_count(size_t thread_id) const {
+    assert(thread_id < MaxThreads);
+    size_t sum = 0U;
+    for (size_t b = 0U; b < kNumBuckets; b++) {
+      sum += m_records[thread_id].m_buckets[b].m_size;
+    }
+    return sum;
+  }
+
+  //! The current global epoch
+  uint64_t epoch() const { return m_epoch.load(std::memory_order_acquire); }
+
+ private:
+  size_t reclaim_bucket(Bucket* bucket) {
+    size_t n = bucket->m_size;
+    for (size_t i = 0U; i < n; i++) {
+      bucket->m_entries[i].m_reclaim(m_alloc, bucket->m_entries[i].m_ptr);
+    }
+    bucket->m_size = 0U;
+    return n;
+  }
+
+  // Returns the bucket for epoch e, reclaiming its old contents if they
+  // were retired at least two epochs ago
+  Bucket* priv_bucket_for(size_t thread_id, uint64_t e) {
+    Bucket* bucket = &m_records[thread_id].m_buckets[e % kNumBuckets];
+    if (bucket->m_epoch != e) {
+      // The bucket was last used in epoch e - 3 (or before)
+      (void)reclaim_bucket(bucket);
+      bucket->m_epoch = e;
+    }
+    return bucket;
+  }
+};
+
+/*!
+ * Wait-free RAII wrapper around epoch_domain::enter()/exit()
+ */
+template <typename Domain>
+class epoch_guard final {
+ private:
+  Domain* m_domain;
+  size_t m_thread_id;
+
+ public:
+  epoch_guard(Domain* domain, size_t thread_id)
+      : m_domain(domain), m_thread_id(thread_id) {
+    m_domain->enter(m_thread_id);
+  }
+
+  ~epoch_guard() { m_domain->exit(m_thread_id); }
+
+  epoch_guard(epoch_guard const&) = delete;
+  epoch_guard& operator=(epoch_guard const&) = delete;
+
+  epoch_guard(epoch_guard&&) noexcept = delete;
+  epoch_guard& operator=(epoch_guard&&) noexcept = delete;
+};
+
+/*!
+ * Hazard pointer based reclamation.
+ *
+ * Before dereferencing a shared pointer, a thread publishes it in one of its
+ * hazard slots with protect().  Retired objects are only reclaimed when no
+ * hazard slot points at them, so a stalled thread can only keep
+ * SlotsPerThread objects alive.  Unreclaimed memory is bounded by
+ * MaxThreads * RetireCapacity objects regardless of what readers do.
+ *
+ * protect() is lock-free (it retries if the pointer changes underneath it)
+ * and costs a full fence, so it is more expensive than epoch_domain::enter().
+ *
+ * @tparam Alloc  the allocator provided
+ * @tparam MaxThreads the maximum number of concurrently registered threads
+ * @tparam SlotsPerThread the number of hazard pointers per thread
+ * @tparam RetireCapacity the maximum number of retired objects per thread
+ */
+template <typename Alloc = RTDefaultAllocator, size_t MaxThreads = 16U,
+          size_t SlotsPerThread = 2U, size_t RetireCapacity = 64U>
+class hazard_domain final {
+ private:
+  static_assert(MaxThreads > 0U, "hazard_domain needs at least one thread");
+  static_assert(SlotsPerThread > 0U, "SlotsPerThread must be non-zero");
+  static_assert(RetireCapacity > 0U, "RetireCapacity must be non-zero");
+
+  struct ThreadRecord {
+    alignas(64) std::atomic<void*> m_hazards[SlotsPerThread];
+    std::atomic<bool> m_in_use;
+
+    // Only touched by the owning thread (or by the destructor)
+    size_t m_retired_size;
+    detail::retired_ptr<Alloc>* m_retired;
+
+    ThreadRecord()
+        : m_hazards(), m_in_use(false), m_retired_size(0U), m_retired(nullptr) {
+      for (size_t i = 0U; i < SlotsPerThread; i++) {
+        m_hazards[i].store(nullptr, std::memory_order_relaxed);
+      }
+    }
+  };
+
+  Alloc* m_alloc;
+  ThreadRecord m_records[MaxThreads];
+
+ public:
+  /*!
+   * This class does not take ownership of the allocator
+   *
+   * @param alloc the allocator provided
+   */
+  explicit hazard_domain(Alloc* alloc) : m_alloc(alloc), m_records() {}
+
+  /*!
+   * Reclaims every object that is still retired.
+   *
+   * ***IMPORTANT***
+   *
+   * No thread may be using this domain when it is destroyed.
+   */
+  ~hazard_domain() {
+    for (size_t i = 0U; i < MaxThreads; i++) {
+      ThreadRecord& rec = m_records[i];
+      for (size_t r = 0U; r < rec.m_retired_size; r++) {
+        rec.m_retired[r].m_reclaim(m_alloc, rec.m_retired[r].m_ptr);
+      }
+      if (rec.m_retired != nullptr) {
+        m_alloc->deallocate(rec.m_retired);
+      }
+    }
+  }
+
+  // Threads keep pointers into this class so it can't be copied or moved
+  hazard_domain(hazard_domain const&) = delete;
+  hazard_domain& operator=(hazard_domain const&) = delete;
+
+  hazard_domain(hazard_domain&&) noexcept = delete;
+  hazard_domain& operator=(hazard_domain&&) noexcept = delete;
+
+  /*!
+   * Registers the calling thread with the domain.
+   *
+   * The first time a thread id is handed out its retire list is allocated,
+   * so this is not suitable for real time threads.
+   *
+   * Returns false if there is no free thread id or memory could not be
+   * allocated.
+   *
+   * @param thread_id set to the id to use with the other functions
+   * @return true if successful, otherwise false
+   */
+  bool register_thread(size_t* thread_id) {
+    if (thread_id == nullptr) {
+      return false;
+    }
+
+    for (size_t i = 0U; i < MaxThreads; i++) {
+      ThreadRecord& rec = m_records[i];
+      bool expected = false;
+      if (!rec.m_in_use.compare_exchange_strong(expected, true)) {
+        continue;
+      }
+
+      if (rec.m_retired == nullptr) {
+        void* mem = m_alloc->allocate(sizeof(detail::retired_ptr<Alloc>) *
+                                      RetireCapacity);
+        if (mem == nullptr) {
+          rec.m_in_use.store(false);
+          return false;
+        }
+        rec.m_retired = static_cast<detail::retired_ptr<Alloc>*>(mem);
+        rec.m_retired_size = 0U;
+      }
+
+      *thread_id = i;
+      return true;
+    }
+
+    return false;
+  }
+
+  /*!
+   * Clears the thread's hazard pointers and unregisters it.  Objects it
+   * retired that could not be reclaimed yet stay with the thread id and are
+   * reclaimed by whichever thread registers with that id next (or by the
+   * destructor).
+   */
+  void unregister_thread(size_t thread_id) {
+    assert(thread_id < MaxThreads);
+    for (size_t i = 0U; i < SlotsPerThread; i++) {
+      clear(thread_id, i);
+    }
+    (void)collect(thread_id);
+    m_records[thread_id].m_in_use.store(false, std::memory_order_release);
+  }
+
+  /*!
+   * Loads src and protects the loaded pointer in hazard slot "slot".  The
+   * returned pointer can be dereferenced until the slot is cleared or
+   * reused.
+   *
+   * @param thread_id the id given by register_thread()
+   * @param slot the hazard slot to use, less than SlotsPerThread
+   * @param src the shared pointer to load
+   * @return the protected pointer (may be nullptr)
+   */
+  template <typename T>
+  T* protect(size_t thread_id, size_t slot, std::atomic<T*> const& src) {
+    assert(thread_id < MaxThreads);
+    assert(slot < SlotsPerThread);
+    std::atomic<void*>& hazard = m_records[thread_id].m_hazards[slot];
+
+    T* p = src.load(std::memory_order_acquire);
+    while (true) {
+      hazard.store(static_cast<void*>(p), std::memory_order_seq_cst);
+      // Whoever unlinks p after this point will see the hazard when
+      // scanning.  If src changed, p may already be retired so try again.
+      T* again = src.load(std::memory_order_seq_cst);
+      if (again == p) {
+        return p;
+      }
+      p = again;
+    }
+  }
+
+  //! Clears hazard slot "slot" of the thread
+  void clear(size_t thread_id, size_t slot) {
+    assert(thread_id < MaxThreads);
+    assert(slot < SlotsPerThread);
+    m_records[thread_id].m_hazards[slot].store(nullptr,
+                                               std::memory_order_release);
+  }
+
+  /*!
+   * Retires an object that has been unlinked from the shared structure.
+   * Once no hazard pointer refers to it, the destructor is called and the
+   * memory is given back to the allocator.
+   *
+   * When the retire list fills up, the hazard pointers of all threads are
+   * scanned.  Returns false if the retire list is full and every retired
+   * object is still protected, in which case the caller still owns p.
+   *
+   * @param thread_id the id given by register_thread()
+   * @param p an object allocated with the domain's allocator
+   * @return true if successful, otherwise false
+   */
+  template <typename T>
+  bool retire(size_t thread_id, T* p) {
+    assert(thread_id < MaxThreads);
+    if (p == nullptr) {
+      return true;
+    }
+
+    ThreadRecord& rec = m_records[thread_id];
+    if (rec.m_retired_size == RetireCapacity) {
+      (void)collect(thread_id);
+      if (rec.m_retired_size == RetireCapacity) {
+        return false;
+      }
+    }
+
+    rec.m_retired[rec.m_retired_size++] = {
+        static_cast<void*>(p), &detail::reclaim_with_alloc<T, Alloc>};
+    return true;
+  }
+
+  /*!
+   * Scans every hazard pointer and reclaims the objects retired by the
+   * calling thread that are not protected.
+   *
+   * Takes O(RetireCapacity * MaxThreads * SlotsPerThread) time.
+   *
+   * @param thread_id the id given by register_thread()
+   * @return the number of objects reclaimed
+   */
+  size_t collect(size_t thread_id) {
+    assert(thread_id < MaxThreads);
+    ThreadRecord& rec = m_records[thread_id];
+
+    // Pairs with the seq_cst store in protect()
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    size_t kept = 0U;
+    size_t num_reclaimed = 0U;
+    for (size_t r = 0U; r < rec.m_retired_size; r++) {
+      detail::retired_ptr<Alloc> retired = rec.m_retired[r];
+      if (is_protected(retired.m_ptr)) {
+        rec.m_retired[kept++] = retired;
+      } else {
+        retired.m_reclaim(m_alloc, retired.m_ptr);
+        num_reclaimed++;
+      }
+    }
+    rec.m_retired_size = kept;
+    return num_reclaimed;
+  }
+
+  //! The number of objects retired by thread_id that are not reclaimed yet
+  size_t retired_count(size_t thread_id) const {
+    assert(thread_id < MaxThreads);
+    return m_records[thread_id].m_retired_size;
+  }
+
+ private:
+  bool is_protected(void* p) const {
+    for (size_t i = 0U; i < MaxThreads; i++) {
+      for (size_t s = 0U; s < SlotsPerThread; s++) {
+        if (m_records[i].m_hazards[s].load(std::memory_order_seq_cst) == p) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+};
+
+}  // namespace rtl
+
+#endif  // RTLCPP_RECLAIM_HPP
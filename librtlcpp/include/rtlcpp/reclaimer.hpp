@@ -0,0 +1,303 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RTLCPP_RECLAIMER_HPP
+#define RTLCPP_RECLAIMER_HPP
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "rtlcpp/memory.hpp"
+#include "rtlcpp/task.hpp"
+#include "rtlcpp/utility.hpp"
+
+namespace rtl {
+
+/*!
+ * An intrusive node for work handed to a Reclaimer.
+ *
+ * m_release is called on the reclaiming thread with the node itself and is
+ * expected to destroy/free whatever object the node is embedded in.
+ */
+struct deferred_release_node {
+  deferred_release_node* m_next;
+  void (*m_release)(deferred_release_node*);
+};
+
+/*!
+ * Moves destruction and deallocation off of real time threads.
+ *
+ * Real time threads enqueue() objects that need to be released which is a
+ * single lock-free push onto an intrusive list (no allocation, no system
+ * calls).  The actual release happens whenever drain() is called, either
+ * explicitly by a non real time thread or by the background thread started
+ * with start().
+ *
+ * enqueue() may be called from any number of threads, drain() may be
+ * called from any thread but only one at a time should be draining.
+ *
+ * rtl::shared_ptr can opt into this with make_shared_deferred().
+ */
+class Reclaimer final {
+ private:
+  struct DrainTask {
+    Reclaimer* m_reclaimer;
+
+    // Returning false keeps the periodic task running
+    bool operator()() {
+      (void)m_reclaimer->drain();
+      return false;
+    }
+  };
+
+  alignas(64) std::atomic<deferred_release_node*> m_head;
+  alignas(64) std::atomic<size_t> m_num_released;
+  PeriodicTask<DrainTask> m_task;
+
+ public:
+  Reclaimer() : m_head(nullptr), m_num_released(0U), m_task(DrainTask{this}) {}
+
+  //! Stops the background thread (if any) and drains everything left
+  ~Reclaimer() {
+    stop();
+    (void)drain();
+  }
+
+  /*
+   * Enqueued nodes and the background thread point back to this object so
+   * it can't be copied or moved.
+   */
+  Reclaimer(Reclaimer const&) = delete;
+  Reclaimer& operator=(Reclaimer const&) = delete;
+
+  Reclaimer(Reclaimer&&) noexcept = delete;
+  Reclaimer& operator=(Reclaimer&&) noexcept = delete;
+
+  /*!
+   * Hands a node to the reclaimer.  Lock-free and never blocks, suitable
+   * for real time threads.
+   *
+   * @param node the node to release later, must stay valid until released
+   */
+  void enqueue(deferred_release_node* node) {
+    deferred_release_node* head = m_head.load(std::memory_order_relaxed);
+    do {
+      node->m_next = head;
+    } while (!m_head.compare_exchange_weak(head, node,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed));
+  }
+
+  /*!
+   * Releases everything enqueued so far, oldest first.
+   *
+   * ***IMPORTANT***
+   *
+   * This runs destructors and frees memory and is NOT meant to be called
+   * from a real time thread.
+   *
+   * @return the number of nodes released
+   */
+  size_t drain() {
+    deferred_release_node* n = m_head.exchange(nullptr,
+                                               std::memory_order_acquire);
+
+    // The list is in LIFO order, reverse it so objects are released in the
+    // order they were enqueued
+    deferred_release_node* fifo = nullptr;
+    while (n != nullptr) {
+      deferred_release_node* next = n->m_next;
+      n->m_next = fifo;
+      fifo = n;
+      n = next;
+    }
+
+    size_t count = 0U;
+    while (fifo != nullptr) {
+      deferred_release_node* next = fifo->m_next;
+      fifo->m_release(fifo);
+      fifo = next;
+      count++;
+    }
+
+    (void)m_num_released.fetch_add(count, std::memory_order_relaxed);
+    return count;
+  }
+
+  //! True if nothing is waiting to be released
+  bool empty() const {
+    return m_head.load(std::memory_order_acquire) == nullptr;
+  }
+
+  //! The total number of nodes released over the life of this object
+  size_t num_released() const {
+    return m_num_released.load(std::memory_order_relaxed);
+  }
+
+  /*!
+   * Starts a background thread that calls drain() every period.  Can only
+   * be started once.
+   *
+   * The scheduling parameters are usually left at the default (non real
+   * time) policy since the whole point is to keep this work away from real
+   * time threads.
+   *
+   * @param period how often to drain, must be non-zero
+   */
+  void start(
+      std::chrono::microseconds period = std::chrono::microseconds(1000)) {
+    assert(period != std::chrono::microseconds(0));
+    m_task.start(PeriodicTaskOptions(period));
+  }
+
+  /*!
+   * Starts a background thread with the provided options.  Can only be
+   * started once.
+   *
+   * The timeout of the options decides how often drain() is called, if it
+   * is zero the thread only drains when notify() is called.
+   *
+   * @param options the options for the background thread
+   */
+  void start(PeriodicTaskOptions options) { m_task.start(std::move(options)); }
+
+  //! Wakes up the background thread early, NOT suitable for real time threads
+  void notify() { m_task.notify_one(); }
+
+  //! Stops and joins the background thread (if it was started)
+  void stop() {
+    m_task.signal_shutdown();
+    m_task.join();
+  }
+};
+
+/*!
+ * The control block used by make_shared_deferred(): a regular control_blk
+ * followed by the release hook and what the Reclaimer needs.  Only objects
+ * created through make_shared_deferred() pay for these.
+ */
+template <typename T, typename Alloc>
+struct deferred_control_blk {
+  // First so that it starts the allocation, shared_ptr frees it by this
+  control_blk<T, Alloc> m_blk;
+  detail::release_hook m_hook;
+  deferred_release_node m_node;
+  Reclaimer* m_reclaimer;
+
+  template <typename... BlkArgs>
+  deferred_control_blk(Reclaimer* reclaimer, BlkArgs&&... args)
+      : m_blk(std::forward<BlkArgs>(args)...),
+        m_hook{&deferred_control_blk::enqueue},
+        m_node{nullptr, &deferred_control_blk::release},
+        m_reclaimer(reclaimer) {
+    m_blk.set_release_hook();
+  }
+
+  // Called on the thread dropping the last strong pointer
+  static void enqueue(void* blk) {
+    static_assert(std::is_standard_layout<deferred_control_blk>::value,
+                  "m_blk must be at the start of the allocation");
+    static_assert(offsetof(deferred_control_blk, m_hook) ==
+                      detail::release_hook_offset<control_blk<T, Alloc>>(),
+                  "control_blk looks for the hook right after itself");
+
+    deferred_control_blk* d = static_cast<deferred_control_blk*>(blk);
+    d->m_node.m_next = nullptr;
+    d->m_reclaimer->enqueue(&d->m_node);
+  }
+
+  // Called by the Reclaimer when draining
+  static void release(deferred_release_node* node) {
+    deferred_control_blk* d = reinterpret_cast<deferred_control_blk*>(
+        reinterpret_cast<unsigned char*>(node) -
+        offsetof(deferred_control_blk, m_node));
+    Alloc* alloc = d->m_blk.get_alloc();
+    d->m_blk.deinit();
+    if (d->m_blk.dec_weak() && alloc != nullptr) {
+      alloc->deallocate(static_cast<void*>(d));
+    }
+  }
+};
+
+/*!
+ * Same as make_shared() except the object is not destroyed on the thread
+ * dropping the last shared_ptr to it.  That thread only does a lock-free
+ * enqueue onto reclaimer and the destructor and deallocation run when the
+ * reclaimer drains.  weak_ptrs stay valid until then.
+ *
+ * The reclaimer must outlive the object.
+ *
+ * @param alloc the allocator for the object and its control block
+ * @param reclaimer the reclaimer that will release the object
+ * @param args the arguments to construct the object with
+ * @return the shared_ptr, empty if the allocation failed
+ */
+template <typename T, typename Alloc, typename... Args>
+typename std::enable_if<!std::is_array<T>::value, shared_ptr<T, Alloc>>::type
+make_shared_deferred(Alloc* alloc, Reclaimer* reclaimer, Args&&... args) {
+  using blk_type = deferred_control_blk<T, Alloc>;
+  blk_type* tmp = static_cast<blk_type*>(alloc->allocate(sizeof(blk_type)));
+  if (tmp == nullptr) {
+    return shared_ptr<T, Alloc>();
+  }
+
+  T* data_tmp = static_cast<T*>(alloc->allocate(sizeof(T)));
+  if (data_tmp == nullptr) {
+    alloc->deallocate(static_cast<void*>(tmp));
+    return shared_ptr<T, Alloc>();
+  }
+
+  new (data_tmp) T(std::forward<Args>(args)...);
+
+  new (tmp) blk_type(reclaimer, alloc, data_tmp);
+
+  return shared_ptr<T, Alloc>(alloc, &tmp->m_blk);
+}
+
+//! The array version of make_shared_deferred(), count elements
+template <typename T, typename Alloc, typename... Args>
+typename std::enable_if<std::is_array<T>::value, shared_ptr<T, Alloc>>::type
+make_shared_deferred(Alloc* alloc, Reclaimer* reclaimer, size_t count,
+                     Args&&... args) {
+  using blk_type = deferred_control_blk<T, Alloc>;
+  blk_type* tmp = static_cast<blk_type*>(alloc->allocate(sizeof(blk_type)));
+  if (tmp == nullptr) {
+    return shared_ptr<T, Alloc>();
+  }
+
+  using type = typename std::remove_extent<T>::type;
+
+  type* array_tmp = static_cast<type*>(alloc->allocate(sizeof(type) * count));
+  if (array_tmp == nullptr) {
+    alloc->deallocate(static_cast<void*>(tmp));
+    return shared_ptr<T, Alloc>();
+  }
+
+  for (size_t i = 0U; i < count; i++) {
+    new (&array_tmp[i]) type(std::forward<Args>(args)...);
+  }
+
+  new (tmp) blk_type(reclaimer, alloc, count, array_tmp);
+
+  return shared_ptr<T, Alloc>(alloc, &tmp->m_blk);
+}
+
+}  // namespace rtl
+
+#endif  // RTLCPP_RECLAIMER_HPP
@@ -16,13 +16,25 @@
 #define RTLCPP_RTL_CPP_HPP
 
 #include "allocator.hpp"
+#include "bloom_filter.hpp"
+#include "btree_map.hpp"
+#include "deque.hpp"
 #include "hash.hpp"
+#include "histogram.hpp"
 #include "lru.hpp"
 #include "map.hpp"
 #include "memory.hpp"
 #include "mutex.hpp"
 #include "object_pool.hpp"
+#include "priority_queue.hpp"
+#include "rcu.hpp"
+#include "reclaim.hpp"
+#include "reclaimer.hpp"
 #include "ring_buffer.hpp"
+#include "snapshot.hpp"
+#include "static_map.hpp"
+#include "string.hpp"
+#include "trace.hpp"
 #include "utility.hpp"
 #include "vector.hpp"
 
@@ -0,0 +1,274 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RTLCPP_SNAPSHOT_HPP
+#define RTLCPP_SNAPSHOT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "rtlcpp/hash.hpp"
+
+namespace rtl {
+
+/*
+ * Snapshot file layout, written by unordered_map::save_snapshot() and read
+ * in place by mapped_map.  Everything is an offset from the start of the
+ * file so it can be mapped at any address, and every section starts on a
+ * page boundary:
+ *
+ *    offset 0                 snapshot_header
+ *    m_buckets_offset         uint64_t starts[m_num_buckets + 1], the
+ *                             entries of bucket b are
+ *                             [starts[b], starts[b + 1])
+ *    m_entries_offset         snapshot_entry<K, V>[m_num_entries]
+ *
+ * Keys go to bucket rtl::hash<K>()(key) % m_num_buckets.  The file is
+ * meant to be read on the machine (or at least the architecture) that
+ * wrote it; the header records enough to refuse anything else.
+ */
+
+//! "RTLSNP1" and a zero byte in memory order on a little endian machine,
+//! so it reads differently on the other endianness
+static const uint64_t kSnapshotMagic = 0x31504E534C5452ULL;
+static const uint32_t kSnapshotVersion = 1U;
+static const uint64_t kSnapshotPageSize = 4096U;
+
+struct snapshot_header {
+  uint64_t m_magic;
+  uint32_t m_version;
+  uint32_t m_entry_size;
+  uint32_t m_key_size;
+  uint32_t m_value_size;
+  uint64_t m_num_entries;
+  uint64_t m_num_buckets;
+  uint64_t m_buckets_offset;
+  uint64_t m_entries_offset;
+  uint64_t m_file_size;
+};
+
+template <typename K, typename V>
+struct snapshot_entry {
+  K m_key;
+  V m_value;
+};
+
+/*!
+ * How a key or value type is written to a snapshot.  A snapshot holds
+ * stored_type, which must be trivially copyable, and store() converts to
+ * it.  Trivially copyable types are stored as is.
+ *
+ * For anything else specialize this, e.g. to store an rtl::basic_string
+ * key as a fixed size char array:
+ *
+ *    template <>
+ *    struct snapshot_serializer<rtl::string> {
+ *      struct stored_type { char m_chars[32]; bool operator==(...) };
+ *      static bool store(rtl::string const& in, stored_type* out);
+ *    };
+ *
+ * and look it up with a mapped_map<stored_type, ...> (stored_type also
+ * needs operator== and an rtl::hash that reads it the same way).  store()
+ * returns false if the object can't be represented, which fails the save.
+ */
+template <typename T>
+struct snapshot_serializer {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "Specialize rtl::snapshot_serializer for this type");
+
+  using stored_type = T;
+
+  static bool store(T const& in, stored_type* out) {
+    *out = in;
+    return true;
+  }
+};
+
+/*!
+ * A whole file memory mapped, for writing snapshots or reading them in
+ * place.  Pages are read from the file the first time they are touched.
+ *
+ * Like MMapMemoryResource, nothing is mapped until an init function
+ * succeeds and uninit() (or the destructor) unmaps it.
+ */
+class MMapFile final {
+ private:
+  void* m_buf;
+  size_t m_capacity;
+
+ public:
+  MMapFile() : m_buf(nullptr), m_capacity(0U) {}
+  ~MMapFile() { uninit(); }
+
+  MMapFile(MMapFile const&) = delete;
+  MMapFile& operator=(MMapFile const&) = delete;
+
+  MMapFile(MMapFile&& o) noexcept;
+  MMapFile& operator=(MMapFile&& o) noexcept;
+
+  void* get_buf() const { return m_buf; }
+  size_t get_capacity() const { return m_capacity; }
+  bool is_mapped() const { return m_buf != nullptr; }
+
+  //! Maps all of the file at path read only, the file is closed again
+  //! right away
+  bool init_read(const char* path);
+
+  //! Maps all of the open file fd read only
+  bool init_read(int fd);
+
+  //! Empties fd, refills it with size zero bytes and maps it for writing
+  bool init_write(int fd, size_t size);
+
+  //! Writes the mapped pages back to the file
+  bool sync();
+
+  //! Unmaps the file
+  void uninit();
+};
+
+namespace detail {
+
+//! Fills in the layout of a snapshot with num_entries entries
+void snapshot_layout(uint64_t num_entries, uint32_t entry_size,
+                     uint32_t key_size, uint32_t value_size,
+                     snapshot_header* header);
+
+//! Checks that buf holds a complete snapshot with the given sizes
+bool snapshot_valid(const void* buf, size_t size, uint32_t entry_size,
+                    uint32_t key_size, uint32_t value_size);
+
+}  // namespace detail
+
+/*!
+ * A read only map over a snapshot written by
+ * unordered_map::save_snapshot().
+ *
+ * open() maps the file and checks its header, there is no load step: get()
+ * hashes the key and reads the bucket and its entries straight from the
+ * mapping, so only the pages a lookup touches are ever read from disk.
+ *
+ * K and V are the stored types of the snapshot, which are the key and
+ * value types of the map unless a snapshot_serializer changed them.
+ *
+ * Lookups don't modify anything, so any number of threads may call get()
+ * concurrently.
+ *
+ * @tparam K the stored key type
+ * @tparam V the stored value type
+ */
+template <typename K, typename V>
+class mapped_map {
+  static_assert(std::is_trivially_copyable<K>::value &&
+                    std::is_trivially_copyable<V>::value,
+                "Snapshots hold trivially copyable types only");
+
+ private:
+  using entry_type = snapshot_entry<K, V>;
+
+  MMapFile m_file;
+  const uint64_t* m_starts;
+  const entry_type* m_entries;
+  uint64_t m_num_buckets;
+  uint64_t m_num_entries;
+
+  bool attach() {
+    if (!detail::snapshot_valid(m_file.get_buf(), m_file.get_capacity(),
+                                sizeof(entry_type), sizeof(K), sizeof(V))) {
+      m_file.uninit();
+      return false;
+    }
+    snapshot_header header;
+    std::memcpy(&header, m_file.get_buf(), sizeof(header));
+    const unsigned char* base =
+        static_cast<const unsigned char*>(m_file.get_buf());
+    m_starts =
+        reinterpret_cast<const uint64_t*>(base + header.m_buckets_offset);
+    m_entries =
+        reinterpret_cast<const entry_type*>(base + header.m_entries_offset);
+    m_num_buckets = header.m_num_buckets;
+    m_num_entries = header.m_num_entries;
+    return true;
+  }
+
+ public:
+  mapped_map()
+      : m_file(),
+        m_starts(nullptr),
+        m_entries(nullptr),
+        m_num_buckets(0U),
+        m_num_entries(0U) {}
+
+  mapped_map(mapped_map const&) = delete;
+  mapped_map& operator=(mapped_map const&) = delete;
+
+  /*!
+   * Maps the snapshot at path.
+   *
+   * @return false if the file can't be mapped or isn't a complete snapshot
+   * of this key and value type
+   */
+  bool open(const char* path) {
+    close();
+    return m_file.init_read(path) && attach();
+  }
+
+  //! Same as open(const char*) for an open file
+  bool open(int fd) {
+    close();
+    return m_file.init_read(fd) && attach();
+  }
+
+  //! Unmaps the snapshot, pointers returned by get() become invalid
+  void close() {
+    m_file.uninit();
+    m_starts = nullptr;
+    m_entries = nullptr;
+    m_num_buckets = 0U;
+    m_num_entries = 0U;
+  }
+
+  bool is_open() const { return m_file.is_mapped(); }
+
+  //! Returns a pointer to the value for key or nullptr if there is none
+  V const* get(K const& key) const {
+    if (m_num_buckets == 0U) {
+      return nullptr;
+    }
+    rtl::hash<K> hasher;
+    uint64_t b = hasher(key) % m_num_buckets;
+    uint64_t end = m_starts[b + 1U];
+    if (end > m_num_entries) {
+      return nullptr;
+    }
+    for (uint64_t i = m_starts[b]; i < end; i++) {
+      if (m_entries[i].m_key == key) {
+        return &m_entries[i].m_value;
+      }
+    }
+    return nullptr;
+  }
+
+  bool contains(K const& key) const { return get(key) != nullptr; }
+
+  size_t size() const { return static_cast<size_t>(m_num_entries); }
+  bool empty() const { return m_num_entries == 0U; }
+  size_t get_num_buckets() const { return static_cast<size_t>(m_num_buckets); }
+};
+
+}  // namespace rtl
+
+#endif  // RTLCPP_SNAPSHOT_HPP
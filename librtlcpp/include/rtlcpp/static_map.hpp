@@ -0,0 +1,214 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RTLCPP_STATIC_MAP_HPP
+#define RTLCPP_STATIC_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "rtlcpp/hash.hpp"
+
+namespace rtl {
+
+/*!
+ * A hash map with a fixed number of slots stored inline, for loops that
+ * can't allocate.
+ *
+ * Open addressing with linear probing.  No key is ever more than
+ * MaxProbe - 1 slots past its home slot: put() refuses a key that would
+ * land further away, and del() moves later keys back into the hole
+ * instead of leaving tombstones.  So a lookup reads at most MaxProbe
+ * slots, whatever was put or deleted before.  The probe distance of every
+ * slot is kept in a separate byte array, so a miss mostly scans that.
+ *
+ * There is no allocator and nothing points into the map itself.  A zero
+ * filled static_map is an empty map and the default constructor is
+ * constexpr, so it can live in static storage without a run time
+ * initializer, or in shared memory (as long as every process uses the
+ * same rtl::hash).
+ *
+ * This class is not thread-safe.
+ *
+ * ***IMPORTANT***
+ * K and V must be trivially copyable.  Keep the load low (well under 3/4
+ * of N) or put() starts failing on long probe runs before the map is
+ * full.
+ *
+ * @tparam K the key type
+ * @tparam V the value type
+ * @tparam N the number of slots, a power of two
+ * @tparam MaxProbe the most slots a lookup reads, from 1 to 255
+ */
+template <typename K, typename V, size_t N, size_t MaxProbe = 16U>
+class static_map {
+  static_assert(N > 0U && (N & (N - 1U)) == 0U,
+                "N must be a power of two");
+  static_assert(MaxProbe > 0U && MaxProbe < 256U,
+                "MaxProbe must be from 1 to 255");
+  static_assert(std::is_trivially_copyable<K>::value &&
+                    std::is_trivially_copyable<V>::value,
+                "static_map holds trivially copyable types only");
+
+ private:
+  struct Slot {
+    K m_key;
+    V m_value;
+  };
+
+  static const size_t kMask = N - 1U;
+  static const size_t kMaxProbe = MaxProbe < N ? MaxProbe : N;
+
+  //! 0 if the slot is empty, otherwise the distance from home plus one
+  uint8_t m_dist[N];
+  Slot m_slots[N];
+  size_t m_size;
+
+  static size_t home_of(K const& key) {
+    rtl::hash<K> hasher;
+    return static_cast<size_t>(hasher(key)) & kMask;
+  }
+
+  //! Returns the slot holding key or N
+  size_t find(K const& key) const {
+    size_t i = home_of(key);
+    for (size_t d = 1U; d <= kMaxProbe; d++) {
+      if (m_dist[i] == 0U) {
+        return N;
+      }
+      if (m_dist[i] == d && m_slots[i].m_key == key) {
+        return i;
+      }
+      i = (i + 1U) & kMask;
+    }
+    return N;
+  }
+
+ public:
+  constexpr static_map() : m_dist(), m_slots(), m_size(0U) {}
+
+  /*!
+   * Puts val under key, overwriting the value if key is already there.
+   *
+   * @return false if key isn't in the map and there is no empty slot
+   * within MaxProbe slots of its home
+   */
+  bool put(K const& key, V const& val) {
+    size_t i = home_of(key);
+    size_t empty = N;
+    uint8_t empty_dist = 0U;
+    for (size_t d = 1U; d <= kMaxProbe; d++) {
+      if (m_dist[i] == 0U) {
+        // Keys are only ever found before the first empty slot
+        empty = i;
+        empty_dist = static_cast<uint8_t>(d);
+        break;
+      }
+      if (m_dist[i] == d && m_slots[i].m_key == key) {
+        m_slots[i].m_value = val;
+        return true;
+      }
+      i = (i + 1U) & kMask;
+    }
+
+    if (empty == N) {
+      return false;
+    }
+    m_slots[empty].m_key = key;
+    m_slots[empty].m_value = val;
+    m_dist[empty] = empty_dist;
+    m_size++;
+    return true;
+  }
+
+  //! Returns a pointer to the value for key or nullptr if there is none
+  V* get(K const& key) {
+    size_t i = find(key);
+    return i == N ? nullptr : &m_slots[i].m_value;
+  }
+
+  V const* get(K const& key) const {
+    size_t i = find(key);
+    return i == N ? nullptr : &m_slots[i].m_value;
+  }
+
+  bool contains(K const& key) const { return find(key) != N; }
+
+  //! Returns true if key was in the map
+  bool del(K const& key) {
+    size_t hole = find(key);
+    if (hole == N) {
+      return false;
+    }
+
+    // Move later keys of the run that may live in the hole back into it,
+    // which only shortens their probes.  A key gap slots after the hole
+    // may if its home is at or before the hole, i.e. its distance is more
+    // than gap, and that can't be true MaxProbe or more slots on.
+    size_t next = hole;
+    size_t gap = 0U;
+    while (++gap < kMaxProbe) {
+      next = (next + 1U) & kMask;
+      if (m_dist[next] == 0U) {
+        break;
+      }
+      if (m_dist[next] > gap) {
+        m_slots[hole] = m_slots[next];
+        m_dist[hole] = static_cast<uint8_t>(m_dist[next] - gap);
+        hole = next;
+        gap = 0U;
+      }
+    }
+    m_dist[hole] = 0U;
+    m_size--;
+    return true;
+  }
+
+  //! Deletes all keys held by the map
+  void delete_all_keys() {
+    for (size_t i = 0U; i < N; i++) {
+      m_dist[i] = 0U;
+    }
+    m_size = 0U;
+  }
+
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0U; }
+  constexpr size_t capacity() const { return N; }
+  constexpr size_t max_probe() const { return kMaxProbe; }
+
+  /*!
+   * Calls f(key, value) for every entry, in slot order.  f must not put or
+   * delete keys.
+   */
+  template <typename F>
+  void for_each(F&& f) {
+    for (size_t i = 0U; i < N; i++) {
+      if (m_dist[i] != 0U) {
+        f(m_slots[i].m_key, m_slots[i].m_value);
+      }
+    }
+  }
+};
+
+template <typename K, typename V, size_t N, size_t MaxProbe>
+const size_t static_map<K, V, N, MaxProbe>::kMask;
+
+template <typename K, typename V, size_t N, size_t MaxProbe>
+const size_t static_map<K, V, N, MaxProbe>::kMaxProbe;
+
+}  // namespace rtl
+
+#endif  // RTLCPP_STATIC_MAP_HPP
@@ -0,0 +1,326 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RTLCPP_STRING_HPP
+#define RTLCPP_STRING_HPP
+
+#include <cstring>
+
+#include "rtlcpp/allocator.hpp"
+#include "rtlcpp/hash.hpp"
+#include "rtlcpp/utility.hpp"
+
+namespace rtl {
+
+/*!
+ * An allocator aware string with small string optimization.
+ *
+ * Strings of up to kInlineCapacity characters are stored inside the object
+ * and never touch the allocator.  Longer strings are stored in a buffer
+ * from the allocator which grows geometrically, so building a string one
+ * character at a time costs an amortized constant number of allocations.
+ *
+ * The contents are always null terminated, so c_str() can be handed to C
+ * APIs directly.  Embedded null characters are allowed when using the
+ * (pointer, length) overloads.
+ *
+ * This class is not thread-safe.
+ *
+ * @tparam Alloc the allocator provided
+ */
+template <typename Alloc = RTDefaultAllocator>
+class basic_string {
+ public:
+  //! The longest string held without allocating
+  static const size_t kInlineCapacity = 22U;
+
+ private:
+  Alloc* m_alloc;
+
+  //! The number of characters, not counting the null terminator
+  size_t m_size;
+
+  //! The number of characters held without allocating, kInlineCapacity
+  //! while the contents are stored inline
+  size_t m_capacity;
+
+  union {
+    char* m_heap;
+    char m_inline[kInlineCapacity + 1U];
+  };
+
+  char* buf() { return is_inline() ? m_inline : m_heap; }
+
+  // Moves the contents to a buffer of new_capacity characters
+  bool reallocate(size_t new_capacity) {
+    char* new_buf = static_cast<char*>(m_alloc->allocate(new_capacity + 1U));
+    if (new_buf == nullptr) {
+      return false;
+    }
+
+    std::memcpy(new_buf, data(), m_size + 1U);
+    if (!is_inline()) {
+      m_alloc->deallocate(static_cast<void*>(m_heap));
+    }
+    m_heap = new_buf;
+    m_capacity = new_capacity;
+    return true;
+  }
+
+  // Grows the buffer geometrically to hold at least needed characters
+  bool grow(size_t needed) {
+    if (needed <= m_capacity) {
+      return true;
+    }
+
+    size_t new_capacity = m_capacity * 2U;
+    if (new_capacity < needed) {
+      new_capacity = needed;
+    }
+    return reallocate(new_capacity);
+  }
+
+  void release() {
+    if (!is_inline()) {
+      m_alloc->deallocate(static_cast<void*>(m_heap));
+    }
+    m_size = 0U;
+    m_capacity = kInlineCapacity;
+    m_inline[0] = '\0';
+  }
+
+  void move_from(basic_string& o) {
+    m_alloc = o.m_alloc;
+    m_size = o.m_size;
+    m_capacity = o.m_capacity;
+    if (o.is_inline()) {
+      std::memcpy(m_inline, o.m_inline, o.m_size + 1U);
+    } else {
+      m_heap = o.m_heap;
+    }
+    o.m_size = 0U;
+    o.m_capacity = kInlineCapacity;
+    o.m_inline[0] = '\0';
+  }
+
+ public:
+  /*!
+   * Construct an empty string with a pointer to the allocator.
+   *
+   * The string does not take ownership of the allocator and does not
+   * allocate until it grows past kInlineCapacity characters.
+   *
+   * @param alloc  the allocator provided
+   */
+  explicit basic_string(Alloc* alloc)
+      : m_alloc(alloc), m_size(0U), m_capacity(kInlineCapacity) {
+    m_inline[0] = '\0';
+  }
+
+  ~basic_string() { release(); }
+
+  basic_string(basic_string const&) = delete;
+  basic_string& operator=(basic_string const&) = delete;
+
+  basic_string(basic_string&& o) noexcept { move_from(o); }
+
+  basic_string& operator=(basic_string&& o) noexcept {
+    if (this != &o) {
+      release();
+      move_from(o);
+    }
+    return *this;
+  }
+
+  /*!
+   * Replaces the contents with the first len characters at s.
+   *
+   * If this function returns false, the string is left unchanged.
+   *
+   * ***IMPORTANT*** s must not point into this string.
+   *
+   * @param s the characters to copy
+   * @param len the number of characters to copy
+   * @return true if successful, otherwise false
+   */
+  bool assign(const char* s, size_t len) {
+    if (!grow(len)) {
+      return false;
+    }
+    char* b = buf();
+    std::memcpy(b, s, len);
+    b[len] = '\0';
+    m_size = len;
+    return true;
+  }
+
+  //! Replaces the contents with the null terminated string s
+  bool assign(const char* s) { return assign(s, std::strlen(s)); }
+
+  //! Replaces the contents with a copy of other, which may use a different
+  //! allocator.  Copying is explicit since it may need to allocate.
+  template <typename OtherAlloc>
+  bool assign(basic_string<OtherAlloc> const& other) {
+    if (static_cast<const void*>(&other) == static_cast<const void*>(this)) {
+      return true;
+    }
+    return assign(other.data(), other.size());
+  }
+
+  /*!
+   * Appends the first len characters at s.
+   *
+   * If this function returns false, the string is left unchanged.
+   *
+   * ***IMPORTANT*** s must not point into this string.
+   *
+   * @param s the characters to append
+   * @param len the number of characters to append
+   * @return true if successful, otherwise false
+   */
+  bool append(const char* s, size_t len) {
+    if (!grow(m_size + len)) {
+      return false;
+    }
+    char* b = buf();
+    std::memcpy(b + m_size, s, len);
+    m_size += len;
+    b[m_size] = '\0';
+    return true;
+  }
+
+  //! Appends the null terminated string s
+  bool append(const char* s) { return append(s, std::strlen(s)); }
+
+  //! Appends the character c, returns false if the string could not grow
+  bool push_back(char c) {
+    if (!grow(m_size + 1U)) {
+      return false;
+    }
+    char* b = buf();
+    b[m_size] = c;
+    m_size++;
+    b[m_size] = '\0';
+    return true;
+  }
+
+  /*!
+   * Makes room for new_capacity characters without further allocation.
+   *
+   * If new_capacity is less than or equal to the current capacity, this
+   * function returns true and does nothing.
+   *
+   * This function may invalidate pointers returned by data() and c_str()
+   * if it returns true.  If it returns false, the string is unchanged.
+   *
+   * @param new_capacity the number of characters requested
+   * @return true if successful, otherwise false
+   */
+  bool reserve(size_t new_capacity) {
+    if (new_capacity <= m_capacity) {
+      return true;
+    }
+    return reallocate(new_capacity);
+  }
+
+  //! Empties the string but keeps any allocated buffer for reuse
+  void clear() {
+    m_size = 0U;
+    buf()[0] = '\0';
+  }
+
+  size_t size() const { return m_size; }
+  size_t length() const { return m_size; }
+  bool empty() const { return m_size == 0U; }
+  size_t capacity() const { return m_capacity; }
+
+  //! True while the contents are stored inside the object
+  bool is_inline() const { return m_capacity == kInlineCapacity; }
+
+  const char* data() const { return is_inline() ? m_inline : m_heap; }
+  const char* c_str() const { return data(); }
+
+  /*!
+   * Returns a reference to the character at the specified index.
+   *
+   * Behavior is undefined if index is not less than size()
+   */
+  char& operator[](size_t index) { return buf()[index]; }
+  char const& operator[](size_t index) const { return data()[index]; }
+
+  /*!
+   * Compares the first len characters at s with this string the way
+   * std::string::compare does.
+   *
+   * @return negative, zero or positive if this string orders before, the
+   * same as or after s
+   */
+  int compare(const char* s, size_t len) const {
+    size_t n = m_size < len ? m_size : len;
+    int rval = n == 0U ? 0 : std::memcmp(data(), s, n);
+    if (rval != 0) {
+      return rval;
+    }
+    if (m_size == len) {
+      return 0;
+    }
+    return m_size < len ? -1 : 1;
+  }
+
+  template <typename OtherAlloc>
+  int compare(basic_string<OtherAlloc> const& rhs) const {
+    return compare(rhs.data(), rhs.size());
+  }
+
+  int compare(const char* s) const { return compare(s, std::strlen(s)); }
+
+  template <typename OtherAlloc>
+  bool operator==(basic_string<OtherAlloc> const& rhs) const {
+    return m_size == rhs.size() && compare(rhs) == 0;
+  }
+
+  template <typename OtherAlloc>
+  bool operator!=(basic_string<OtherAlloc> const& rhs) const {
+    bool rhs_eq_lhs = *this == rhs;
+    return !rhs_eq_lhs;
+  }
+
+  template <typename OtherAlloc>
+  bool operator<(basic_string<OtherAlloc> const& rhs) const {
+    return compare(rhs) < 0;
+  }
+
+  bool operator==(const char* rhs) const { return compare(rhs) == 0; }
+
+  bool operator!=(const char* rhs) const {
+    bool rhs_eq_lhs = *this == rhs;
+    return !rhs_eq_lhs;
+  }
+};
+
+template <typename Alloc>
+const size_t basic_string<Alloc>::kInlineCapacity;
+
+using string = basic_string<RTDefaultAllocator>;
+
+template <typename Alloc>
+struct hash<basic_string<Alloc>> {
+  uint32_t operator()(basic_string<Alloc> const& s) const noexcept {
+    return fnv1a(s.data(), s.size());
+  }
+};
+
+}  // namespace rtl
+
+#endif  // RTLCPP_STRING_HPP
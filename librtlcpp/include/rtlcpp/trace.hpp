@@ -0,0 +1,387 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RTLCPP_TRACE_HPP
+#define RTLCPP_TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+#include "rtlcpp/allocator.hpp"
+#include "rtlcpp/ring_buffer.hpp"
+#include "rtlcpp/task.hpp"
+#include "rtlcpp/utility.hpp"
+
+/*
+ * A low overhead event tracer.
+ *
+ * Threads record fixed size events (cycle_clock timestamp, thread id, event
+ * id, argument) into their own spsc_ringbuffer, which is a handful of stores
+ * and no locks, allocation or system calls.  A background thread drains the
+ * buffers into a binary trace file which can be converted offline to the
+ * Chrome trace event JSON format (chrome://tracing or ui.perfetto.dev) with
+ * trace_to_chrome_json() or the rtl_trace2json tool.
+ *
+ * Typical use:
+ *
+ *    rtl::trace::Tracer tracer(&alloc);
+ *    tracer.open("cycle.rtltrace");
+ *    tracer.start();
+ *    rtl::trace::set_global_tracer(&tracer);
+ *
+ *    // In the traced threads
+ *    rtl::trace::register_current_thread("control");
+ *    ...
+ *    void step() {
+ *      RTL_TRACE_SCOPE("step");
+ *      ...
+ *      RTL_TRACE_COUNTER("queue_depth", depth);
+ *    }
+ *
+ *    rtl::trace::set_global_tracer(nullptr);
+ *    tracer.close();
+ *
+ * When no global tracer is set the macros cost a load and a branch.
+ */
+
+namespace rtl {
+namespace trace {
+
+enum class event_type : uint8_t {
+  kBegin = 0U,
+  kEnd = 1U,
+  kInstant = 2U,
+  kCounter = 3U,
+};
+
+//! The event as it is stored in the ring buffers and in the trace file
+struct event {
+  uint64_t m_timestamp;
+  uint64_t m_arg;
+  uint32_t m_thread_id;
+  uint16_t m_event_id;
+  uint8_t m_type;
+  uint8_t m_reserved;
+};
+
+static_assert(sizeof(event) == 24U, "The trace file relies on the event size");
+
+//! The maximum number of distinct event names in a process
+static const uint16_t kMaxEvents = 1024U;
+
+//! Returned by register_event() when the name table is full
+static const uint16_t kInvalidEvent = 0xFFFFU;
+
+//! Event and thread names longer than this are truncated in the trace file
+static const size_t kMaxNameLength = 47U;
+
+/*!
+ * Registers an event name for the whole process and returns its id.
+ * Registering the same pointer twice returns the same id.
+ *
+ * ***IMPORTANT***
+ *
+ * The name is not copied, use string literals.  The macros call this once
+ * per call site.
+ *
+ * @param name the name of the event
+ * @return the id of the event or kInvalidEvent if the table is full
+ */
+uint16_t register_event(const char* name);
+
+/*!
+ * Records events from any number of threads and drains them to a file.
+ *
+ * Every thread that records needs a slot, see register_thread().  Each slot
+ * gets its own ring buffer allocated from the allocator when the thread
+ * registers.  When a ring buffer is full, events are dropped (and counted)
+ * rather than blocking the recording thread.
+ */
+class Tracer final {
+ public:
+  //! The maximum number of threads registered at the same time
+  static const size_t kMaxThreads = 64U;
+
+ private:
+  enum SlotState : uint8_t {
+    kFree = 0U,
+    kActive = 1U,
+    // Unregistered, waiting for the drain to release the buffer
+    kClosing = 2U,
+    // Being set up by register_thread()
+    kClaimed = 3U,
+  };
+
+  struct Slot {
+    spsc_ringbuffer m_rb;
+    unsigned char* m_buf;
+    uint32_t m_thread_id;
+    bool m_name_written;
+    char m_name[kMaxNameLength + 1U];
+    std::atomic<uint8_t> m_state;
+    std::atomic<uint64_t> m_dropped;
+
+    Slot()
+        : m_rb(),
+          m_buf(nullptr),
+          m_thread_id(0U),
+          m_name_written(false),
+          m_name(),
+          m_state(kFree),
+          m_dropped(0U) {}
+  };
+
+  RTDefaultAllocator* m_alloc;
+  uint32_t m_buffer_size;
+
+  Slot m_slots[kMaxThreads];
+
+  // Events from threads that could not get a slot
+  std::atomic<uint64_t> m_unregistered_dropped;
+
+  // Everything below is owned by the draining thread
+  std::mutex m_drain_mtx;
+  FILE* m_file;
+  uint16_t m_names_written;
+  std::atomic<uint64_t> m_events_written;
+  uint64_t m_clock_timestamp;
+  uint64_t m_clock_ns;
+
+  // The drain thread, a new one is created by every start() so the tracer
+  // can be started again after stop() or close()
+  std::thread m_thread;
+  std::mutex m_thread_mtx;
+  std::condition_variable m_thread_cv;
+  bool m_shutdown;
+  PeriodicTaskOptions m_options;
+
+  void drain_loop();
+  bool write_chunk(uint32_t type, const void* data, uint32_t size);
+  bool write_clock();
+  void write_names();
+  size_t drain_slot(Slot& s);
+  void release_slot(Slot& s);
+
+ public:
+  /*!
+   * This class does not take ownership of the allocator
+   *
+   * @param alloc the allocator for the per thread buffers
+   * @param events_per_thread the number of events each thread can buffer
+   * before the drain catches up
+   */
+  explicit Tracer(RTDefaultAllocator* alloc,
+                  uint32_t events_per_thread = 4096U);
+
+  //! Closes the trace file and releases all buffers
+  ~Tracer();
+
+  /*
+   * Threads and the drain thread point back to this object so it can't be
+   * copied or moved.
+   */
+  Tracer(Tracer const&) = delete;
+  Tracer& operator=(Tracer const&) = delete;
+
+  Tracer(Tracer&&) noexcept = delete;
+  Tracer& operator=(Tracer&&) noexcept = delete;
+
+  /*!
+   * Creates the trace file and writes its header.  This calibrates the
+   * timestamp counter against the steady clock which takes ~10 ms.
+   *
+   * @param path the path of the trace file
+   * @return true if the file was created
+   */
+  bool open(const char* path);
+
+  /*!
+   * Stops the background thread, drains everything left and closes the
+   * file.  The tracer can be opened and started again afterwards.
+   */
+  void close();
+
+  /*!
+   * Starts a background thread that calls drain() every period.  Does
+   * nothing if it is already running.
+   */
+  void start(
+      std::chrono::microseconds period = std::chrono::microseconds(10000));
+
+  //! Starts the background thread with the provided options
+  void start(PeriodicTaskOptions options);
+
+  //! Stops and joins the background thread (if it was started)
+  void stop();
+
+  /*!
+   * Writes all buffered events to the file and releases the buffers of
+   * unregistered threads.  Not meant for real time threads.
+   *
+   * @return the number of events written
+   */
+  size_t drain();
+
+  /*!
+   * Claims a slot and allocates its ring buffer.
+   *
+   * ***IMPORTANT***
+   *
+   * This allocates, call it when a thread starts rather than on its real
+   * time path.
+   *
+   * @param name the name shown for the thread in the trace
+   * @param id the slot id to use with record() on success
+   * @return false if all slots are taken or the allocation failed
+   */
+  bool register_thread(const char* name, size_t* id);
+
+  //! Releases a slot once its remaining events are drained
+  void unregister_thread(size_t id);
+
+  /*!
+   * Records an event, only the thread that registered the slot may call
+   * this.  Lock-free and never blocks.
+   *
+   * @return false if the event was dropped because the buffer is full
+   */
+  bool record(size_t id, uint16_t event_id, event_type type, uint64_t arg) {
+    Slot& s = m_slots[id];
+    event e{cycle_clock::now(), arg, s.m_thread_id, event_id,
+            static_cast<uint8_t>(type), 0U};
+    if (!s.m_rb.write(reinterpret_cast<const unsigned char*>(&e), sizeof(e))) {
+      s.m_dropped.store(s.m_dropped.load(std::memory_order_relaxed) + 1U,
+                        std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+  /*!
+   * Counts an event from a thread without a slot as dropped, used by the
+   * macros when the thread could not be registered
+   */
+  void drop_unregistered() {
+    (void)m_unregistered_dropped.fetch_add(1U, std::memory_order_relaxed);
+  }
+
+  //! The number of events dropped over the life of this object
+  uint64_t dropped() const;
+
+  //! The number of events written to the file so far
+  uint64_t events_written() const {
+    return m_events_written.load(std::memory_order_relaxed);
+  }
+};
+
+//! The tracer used by the macros, nullptr (the default) disables them
+Tracer* global_tracer();
+
+/*!
+ * Sets the tracer used by the macros.
+ *
+ * ***IMPORTANT***
+ *
+ * The tracer must outlive every thread that recorded into it through the
+ * macros, or set_global_tracer(nullptr) must be called before it is
+ * destroyed.
+ */
+void set_global_tracer(Tracer* tracer);
+
+/*!
+ * Registers the calling thread with the global tracer under a name.
+ * Threads that don't call this are registered the first time they record,
+ * which allocates.  If that fails the thread is not retried, its events are
+ * counted as dropped until it calls this.
+ *
+ * @return false if there is no global tracer or registration failed
+ */
+bool register_current_thread(const char* name);
+
+namespace detail {
+
+//! Records into the global tracer for the calling thread
+void record_global(uint16_t event_id, event_type type, uint64_t arg);
+
+inline void record(uint16_t event_id, event_type type, uint64_t arg) {
+  if (global_tracer() != nullptr) {
+    record_global(event_id, type, arg);
+  }
+}
+
+class scope final {
+ private:
+  uint16_t m_event_id;
+
+ public:
+  scope(uint16_t event_id, uint64_t arg) : m_event_id(event_id) {
+    record(m_event_id, event_type::kBegin, arg);
+  }
+
+  ~scope() { record(m_event_id, event_type::kEnd, 0U); }
+
+  scope(scope const&) = delete;
+  scope& operator=(scope const&) = delete;
+};
+
+}  // namespace detail
+
+/*!
+ * Converts a trace file to the Chrome trace event JSON format.
+ *
+ * @param in_path the trace file written by a Tracer
+ * @param out_path where to write the JSON
+ * @return false if the input is not a valid trace file or on I/O errors
+ */
+bool trace_to_chrome_json(const char* in_path, const char* out_path);
+
+}  // namespace trace
+}  // namespace rtl
+
+#define RTL_TRACE_EVENT_ID(name)                             \
+  []() {                                                     \
+    static const uint16_t rtl_trace_id =                     \
+        ::rtl::trace::register_event(name);                  \
+    return rtl_trace_id;                                     \
+  }()
+
+//! Records a begin event now and an end event when the scope exits
+#define RTL_TRACE_SCOPE(name)                                        \
+  ::rtl::trace::detail::scope RTL_CONCAT(rtl_trace_scope_, __LINE__)( \
+      RTL_TRACE_EVENT_ID(name), 0U)
+
+//! Like RTL_TRACE_SCOPE() with an argument attached to the begin event
+#define RTL_TRACE_SCOPE_ARG(name, arg)                               \
+  ::rtl::trace::detail::scope RTL_CONCAT(rtl_trace_scope_, __LINE__)( \
+      RTL_TRACE_EVENT_ID(name), static_cast<uint64_t>(arg))
+
+//! Records a single point in time with an argument
+#define RTL_TRACE_INSTANT(name, arg)                                      \
+  ::rtl::trace::detail::record(RTL_TRACE_EVENT_ID(name),                  \
+                               ::rtl::trace::event_type::kInstant,        \
+                               static_cast<uint64_t>(arg))
+
+//! Records the value of a counter, shown as a graph in the trace viewer
+#define RTL_TRACE_COUNTER(name, value)                                    \
+  ::rtl::trace::detail::record(RTL_TRACE_EVENT_ID(name),                  \
+                               ::rtl::trace::event_type::kCounter,        \
+                               static_cast<uint64_t>(value))
+
+#endif  // RTLCPP_TRACE_HPP
@@ -15,11 +15,22 @@
 #ifndef RTLCPP_UTILITY_HPP
 #define RTLCPP_UTILITY_HPP
 
+#include <time.h>
+
+#include <chrono>
 #include <cstdint>
 #include <utility>
 
 #include "rtl/pounds.h"
 
+#if defined(RTL_ARCH_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
 #ifndef RTL_TARGET_WORD_SIZE_BITS
 #error \
     "Please define RTL_TARGET_WORD_SIZE_BITS (the word size of your **TARGET** platform in bits) to compile this library"
@@ -98,6 +109,139 @@ inline void asm_cpu_relax() {
 #endif
 }
 
+/*!
+ * A cheap, monotonic tick counter for timing instrumentation.
+ *
+ * On x86 this reads the TSC, on AArch64 the virtual counter (cntvct_el0)
+ * and elsewhere CLOCK_MONOTONIC_RAW (or the steady clock) in nanoseconds.
+ * Reading it is a single instruction on the first two, no system call.
+ *
+ * now() is the cheapest read and may be reordered with the surrounding
+ * instructions, which is fine for timestamps.  Use start() and stop() around
+ * the code being measured so it can't leak out of the measured interval.
+ *
+ * Tick to nanosecond conversions use frequency(), which on x86 is calibrated
+ * against the reference clock the first time it is needed.
+ *
+ * ***IMPORTANT***
+ *
+ * Calibration busy waits for ~10 ms.  Call calibrate() during startup so the
+ * first conversion doesn't happen on a real time path.  The TSC is only
+ * usable when it is invariant (constant_tsc and nonstop_tsc in
+ * /proc/cpuinfo), which is the case on any x86 CPU from the last decade.
+ */
+class cycle_clock final {
+ public:
+  //! True if the ticks come from a hardware counter rather than the OS clock
+  static constexpr bool is_hardware() {
+#if defined(RTL_ARCH_X86) || defined(__aarch64__)
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  //! Reads the counter
+  static uint64_t now() {
+#if defined(RTL_ARCH_X86)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t v;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+    return v;
+#else
+    return reference_ns();
+#endif
+  }
+
+  //! Reads the counter once every earlier instruction has completed
+  static uint64_t start() {
+#if defined(RTL_ARCH_X86)
+    _mm_lfence();
+    uint64_t v = __rdtsc();
+    _mm_lfence();
+    return v;
+#elif defined(__aarch64__)
+    uint64_t v;
+    asm volatile("isb\n\tmrs %0, cntvct_el0" : "=r"(v)::"memory");
+    return v;
+#else
+    return reference_ns();
+#endif
+  }
+
+  //! Reads the counter before any later instruction starts
+  static uint64_t stop() {
+#if defined(RTL_ARCH_X86)
+    unsigned int aux;
+    uint64_t v = __rdtscp(&aux);
+    _mm_lfence();
+    return v;
+#elif defined(__aarch64__)
+    uint64_t v;
+    asm volatile("isb\n\tmrs %0, cntvct_el0\n\tisb" : "=r"(v)::"memory");
+    return v;
+#else
+    return reference_ns();
+#endif
+  }
+
+  //! The clock ticks are calibrated against, in nanoseconds
+  static uint64_t reference_ns() {
+#if defined(CLOCK_MONOTONIC_RAW)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL +
+           static_cast<uint64_t>(ts.tv_nsec);
+#else
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+#endif
+  }
+
+  //! Ticks per second, calibrated on the first call
+  static double frequency() {
+    static const double freq = measure_frequency();
+    return freq;
+  }
+
+  //! Performs the calibration now rather than on the first conversion
+  static void calibrate() { (void)frequency(); }
+
+  static double to_ns(uint64_t ticks) {
+    return static_cast<double>(ticks) * (1e9 / frequency());
+  }
+
+  static uint64_t from_ns(double ns) {
+    return static_cast<uint64_t>(ns * (frequency() / 1e9));
+  }
+
+ private:
+  static double measure_frequency() {
+#if defined(RTL_ARCH_X86)
+    const uint64_t kCalibrationNs = 10000000U;
+    uint64_t ref0 = reference_ns();
+    uint64_t t0 = start();
+    uint64_t ref1 = ref0;
+    while (ref1 - ref0 < kCalibrationNs) {
+      ref1 = reference_ns();
+    }
+    uint64_t t1 = stop();
+    return static_cast<double>(t1 - t0) * 1e9 /
+           static_cast<double>(ref1 - ref0);
+#elif defined(__aarch64__)
+    // The frequency of the generic timer is published by the firmware
+    uint64_t v;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(v));
+    return static_cast<double>(v);
+#else
+    return 1e9;
+#endif
+  }
+};
+
 }  // namespace rtl
 
 #endif  // RTLCPP_UTILITY_HPP
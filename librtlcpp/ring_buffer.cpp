@@ -97,7 +97,7 @@ uint32_t spsc_ringbuffer::write_bytes(const unsigned char *input, uint32_t sz) {
 
   priv_write(input, amt_bytes_to_write, write_index, read_index);
 
-  m_write_index.store((write_index + sz) % m_capacity,
+  m_write_index.store((write_index + amt_bytes_to_write) % m_capacity,
                       std::memory_order_release);
 
   return amt_bytes_to_write;
@@ -164,6 +164,9 @@ uint32_t spsc_ringbuffer::read(unsigned char *output, uint32_t max_read) {
             ? 0U
             : amt_bytes_to_read - until_end_of_buffer;
 
+    // Don't write past max_read bytes of output
+    until_end_of_buffer = std::min(until_end_of_buffer, amt_bytes_to_read);
+
     (void)std::memcpy(output, &m_buf[read_index], until_end_of_buffer);
     (void)std::memcpy(output + until_end_of_buffer, &m_buf[0],
                       from_beginning_of_buffer);
@@ -330,6 +333,9 @@ void spsc_ringbuffer::priv_write(const unsigned char *input,
             ? 0U
             : amt_bytes_to_write - until_end_of_buffer;
 
+    // Don't read past the end of input when it fits before the end
+    until_end_of_buffer = std::min(until_end_of_buffer, amt_bytes_to_write);
+
     (void)std::memcpy(&m_buf[write_index], input, until_end_of_buffer);
     (void)std::memcpy(&m_buf[0], input + until_end_of_buffer,
                       from_beginning_of_buffer);
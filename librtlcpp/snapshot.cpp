@@ -0,0 +1,167 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rtlcpp/snapshot.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "rtlcpp/utility.hpp"
+
+namespace rtl {
+
+namespace {
+
+uint64_t round_to_page(uint64_t v) {
+  return (v + kSnapshotPageSize - 1U) & ~(kSnapshotPageSize - 1U);
+}
+
+}  // namespace
+
+MMapFile::MMapFile(MMapFile&& o) noexcept
+    : m_buf(rtl::exchange(o.m_buf, nullptr)),
+      m_capacity(rtl::exchange(o.m_capacity, 0U)) {}
+
+MMapFile& MMapFile::operator=(MMapFile&& o) noexcept {
+  if (this != &o) {
+    uninit();
+    m_buf = rtl::exchange(o.m_buf, nullptr);
+    m_capacity = rtl::exchange(o.m_capacity, 0U);
+  }
+  return *this;
+}
+
+bool MMapFile::init_read(const char* path) {
+  int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  bool rval = init_read(fd);
+  // The mapping keeps the file alive
+  (void)::close(fd);
+  return rval;
+}
+
+bool MMapFile::init_read(int fd) {
+  uninit();
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    return false;
+  }
+
+  size_t size = static_cast<size_t>(st.st_size);
+  void* buf = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  // A map failed value that works with the MISRA standard
+  void* MISRA_MAP_FAILED = reinterpret_cast<void*>(-1);
+  if (buf == MISRA_MAP_FAILED) {
+    return false;
+  }
+
+  m_buf = buf;
+  m_capacity = size;
+  return true;
+}
+
+bool MMapFile::init_write(int fd, size_t size) {
+  uninit();
+
+  if (size == 0U || ftruncate(fd, 0) != 0 ||
+      ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    return false;
+  }
+
+  void* buf = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+  void* MISRA_MAP_FAILED = reinterpret_cast<void*>(-1);
+  if (buf == MISRA_MAP_FAILED) {
+    return false;
+  }
+
+  m_buf = buf;
+  m_capacity = size;
+  return true;
+}
+
+bool MMapFile::sync() {
+  if (m_buf == nullptr) {
+    return false;
+  }
+  return msync(m_buf, m_capacity, MS_SYNC) == 0;
+}
+
+void MMapFile::uninit() {
+  if (m_buf == nullptr) {
+    return;
+  }
+  (void)munmap(m_buf, m_capacity);
+  m_buf = nullptr;
+  m_capacity = 0U;
+}
+
+namespace detail {
+
+void snapshot_layout(uint64_t num_entries, uint32_t entry_size,
+                     uint32_t key_size, uint32_t value_size,
+                     snapshot_header* header) {
+  // A load factor of one, at least one bucket so lookups never divide by 0
+  uint64_t num_buckets = num_entries > 0U ? num_entries : 1U;
+
+  header->m_magic = kSnapshotMagic;
+  header->m_version = kSnapshotVersion;
+  header->m_entry_size = entry_size;
+  header->m_key_size = key_size;
+  header->m_value_size = value_size;
+  header->m_num_entries = num_entries;
+  header->m_num_buckets = num_buckets;
+  header->m_buckets_offset = round_to_page(sizeof(snapshot_header));
+  header->m_entries_offset = round_to_page(
+      header->m_buckets_offset + (num_buckets + 1U) * sizeof(uint64_t));
+  header->m_file_size = header->m_entries_offset +
+                        num_entries * static_cast<uint64_t>(entry_size);
+}
+
+bool snapshot_valid(const void* buf, size_t size, uint32_t entry_size,
+                    uint32_t key_size, uint32_t value_size) {
+  if (buf == nullptr || size < sizeof(snapshot_header)) {
+    return false;
+  }
+
+  snapshot_header header;
+  std::memcpy(&header, buf, sizeof(header));
+
+  if (header.m_magic != kSnapshotMagic ||
+      header.m_version != kSnapshotVersion ||
+      header.m_entry_size != entry_size || header.m_key_size != key_size ||
+      header.m_value_size != value_size) {
+    return false;
+  }
+
+  // Recompute the layout rather than trusting the offsets
+  snapshot_header expected;
+  snapshot_layout(header.m_num_entries, entry_size, key_size, value_size,
+                  &expected);
+  return header.m_num_buckets == expected.m_num_buckets &&
+         header.m_buckets_offset == expected.m_buckets_offset &&
+         header.m_entries_offset == expected.m_entries_offset &&
+         header.m_file_size == expected.m_file_size &&
+         expected.m_file_size <= size;
+}
+
+}  // namespace detail
+
+}  // namespace rtl
@@ -0,0 +1,221 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rtlcpp/bloom_filter.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "rtlcpp/lru.hpp"
+#include "rtlcpp/map.hpp"
+#include "test_allocators.hpp"
+
+class BloomFilterTest : public ::testing::Test {
+ protected:
+  rtl::MMapMemoryResource mr;
+  rtl::RTAllocatorMT allocMT;
+
+  BloomFilterTest() {
+    // You can do set-up work for each test here.
+  }
+
+  ~BloomFilterTest() override {
+    // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+    // Code here will be called immediately after the constructor (right
+    // before each test).
+
+    ASSERT_TRUE(mr.init(std::min(static_cast<size_t>(50 * 1024 * 1024),
+                                 rtl_tlsf_maximum_arena_size())));
+
+    ASSERT_TRUE(allocMT.init(mr.get_buf(), mr.get_capacity()));
+  }
+
+  void TearDown() override {
+    // Code here will be called immediately after each test (right
+    // before the destructor).
+
+    allocMT.uninit();
+
+    mr.uninit();
+  }
+};
+
+TEST_F(BloomFilterTest, NoFalseNegativesTest) {
+  rtl::bloom_filter<uint64_t, rtl::RTAllocatorMT> f(&allocMT);
+  ASSERT_FALSE(f.is_initialized());
+  // Nothing can be ruled out before init()
+  ASSERT_TRUE(f.may_contain(1U));
+
+  ASSERT_TRUE(f.init(10000U));
+  ASSERT_TRUE(f.is_initialized());
+  ASSERT_EQ(625U, f.num_blocks());
+  ASSERT_EQ(625U * 32U, f.size_bytes());
+
+  for (uint64_t i = 0U; i < 10000U; i++) {
+    f.insert(i * 7919U);
+  }
+  for (uint64_t i = 0U; i < 10000U; i++) {
+    ASSERT_TRUE(f.may_contain(i * 7919U));
+  }
+
+  f.clear();
+  size_t maybe = 0U;
+  for (uint64_t i = 0U; i < 10000U; i++) {
+    maybe += f.may_contain(i * 7919U) ? 1U : 0U;
+  }
+  ASSERT_EQ(0U, maybe);
+}
+
+TEST_F(BloomFilterTest, FalsePositiveRateTest) {
+  rtl::bloom_filter<uint32_t, rtl::RTAllocatorMT> f(&allocMT);
+  ASSERT_TRUE(f.init(100000U));
+  for (uint32_t i = 0U; i < 100000U; i++) {
+    f.insert(i);
+  }
+
+  size_t false_positives = 0U;
+  for (uint32_t i = 100000U; i < 1100000U; i++) {
+    false_positives += f.may_contain(i) ? 1U : 0U;
+  }
+  // About 0.15% at 16 bits per key, allow some slack
+  ASSERT_LT(false_positives, 3000U);
+
+  // Fewer bits, more false positives
+  ASSERT_TRUE(f.init(100000U, 4U));
+  for (uint32_t i = 0U; i < 100000U; i++) {
+    f.insert(i);
+  }
+  size_t more = 0U;
+  for (uint32_t i = 100000U; i < 1100000U; i++) {
+    more += f.may_contain(i) ? 1U : 0U;
+  }
+  ASSERT_GT(more, false_positives);
+}
+
+TEST_F(BloomFilterTest, BatchTest) {
+  rtl::bloom_filter<std::string, rtl::RTAllocatorMT> single(&allocMT);
+  rtl::bloom_filter<std::string, rtl::RTAllocatorMT> batched(&allocMT);
+  ASSERT_TRUE(single.init(1000U, 8U));
+  ASSERT_TRUE(batched.init(1000U, 8U));
+
+  std::vector<std::string> keys;
+  for (int i = 0; i < 1000; i++) keys.push_back("key" + std::to_string(i));
+  for (std::string const& k : keys) single.insert(k);
+  batched.insert(keys.data(), keys.size());
+
+  std::vector<std::string> probes;
+  for (int i = 0; i < 2037; i++) probes.push_back("key" + std::to_string(i));
+  std::unique_ptr<bool[]> results(new bool[probes.size()]);
+  size_t maybe = batched.may_contain(probes.data(), probes.size(),
+                                     results.get());
+
+  size_t expected_maybe = 0U;
+  for (size_t i = 0U; i < probes.size(); i++) {
+    ASSERT_EQ(single.may_contain(probes[i]), results[i]);
+    expected_maybe += results[i] ? 1U : 0U;
+  }
+  ASSERT_EQ(expected_maybe, maybe);
+  ASSERT_GE(maybe, 1000U);
+  ASSERT_LT(maybe, probes.size());
+}
+
+TEST_F(BloomFilterTest, AllocationFailureTest) {
+  rtl_test::FailingAllocator a;
+  rtl::bloom_filter<int, rtl_test::FailingAllocator> f(&a);
+  ASSERT_FALSE(f.init(100U));
+  ASSERT_FALSE(f.is_initialized());
+  f.insert(1);
+  ASSERT_TRUE(f.may_contain(2));
+
+  int keys[3] = {1, 2, 3};
+  bool results[3] = {false, false, false};
+  ASSERT_EQ(3U, f.may_contain(keys, 3U, results));
+  ASSERT_TRUE(results[2]);
+}
+
+TEST_F(BloomFilterTest, MapIntegrationTest) {
+  rtl::bloom_filter<int, rtl::RTAllocatorMT> f(&allocMT);
+  ASSERT_TRUE(f.init(10000U));
+
+  rtl::unordered_map<int, int, rtl::RTAllocatorMT> m(&allocMT);
+  // Keys put before attaching are added to the filter
+  for (int i = 0; i < 500; i++) {
+    ASSERT_TRUE(m.put(i, i));
+  }
+  m.attach_filter(&f);
+  // Enough puts to go through several incremental resizes
+  for (int i = 500; i < 5000; i++) {
+    ASSERT_TRUE(m.put(i, i));
+  }
+
+  for (int i = 0; i < 5000; i++) {
+    ASSERT_TRUE(f.may_contain(i));
+    int* v = m.get(i);
+    ASSERT_NE(nullptr, v);
+    ASSERT_EQ(i, *v);
+    ASSERT_TRUE(m.contains(i));
+  }
+  for (int i = 5000; i < 6000; i++) {
+    ASSERT_EQ(nullptr, m.get(i));
+    ASSERT_FALSE(m.contains(i));
+  }
+
+  // Deleted keys stay in the filter until it is rebuilt
+  for (int i = 0; i < 2500; i++) {
+    ASSERT_TRUE(m.del(i));
+  }
+  ASSERT_TRUE(f.may_contain(0));
+  m.attach_filter(&f);
+  size_t stale = 0U;
+  for (int i = 0; i < 2500; i++) {
+    stale += f.may_contain(i) ? 1U : 0U;
+  }
+  ASSERT_LT(stale, 25U);
+  ASSERT_EQ(2500, *m.get(2500));
+
+  m.delete_all_keys();
+  ASSERT_FALSE(f.may_contain(4999));
+  ASSERT_TRUE(m.put(7, 7));
+  ASSERT_EQ(7, *m.get(7));
+
+  m.attach_filter(nullptr);
+  ASSERT_EQ(7, *m.get(7));
+}
+
+TEST_F(BloomFilterTest, LRUIntegrationTest) {
+  rtl::bloom_filter<int, rtl::RTAllocatorMT> f(&allocMT);
+  ASSERT_TRUE(f.init(64U));
+
+  rtl::lru<int, int, rtl::RTAllocatorMT> cache(&allocMT, 64U);
+  cache.attach_filter(&f);
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(cache.put(i, i));
+  }
+
+  int v = 0;
+  for (int i = 936; i < 1000; i++) {
+    ASSERT_TRUE(cache.get(i, &v));
+    ASSERT_EQ(i, v);
+  }
+  ASSERT_FALSE(cache.get(0, &v));
+  ASSERT_FALSE(cache.get(5000, &v));
+}
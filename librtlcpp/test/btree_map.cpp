@@ -0,0 +1,230 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rtlcpp/btree_map.hpp"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <string>
+
+#include "test_allocators.hpp"
+
+class BTreeMapTest : public ::testing::Test {
+ protected:
+  rtl::MMapMemoryResource mr;
+  rtl::RTAllocatorMT allocMT;
+
+  BTreeMapTest() {
+    // You can do set-up work for each test here.
+  }
+
+  ~BTreeMapTest() override {
+    // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+    // Code here will be called immediately after the constructor (right
+    // before each test).
+
+    ASSERT_TRUE(mr.init(std::min(static_cast<size_t>(50 * 1024 * 1024),
+                                 rtl_tlsf_maximum_arena_size())));
+
+    ASSERT_TRUE(allocMT.init(mr.get_buf(), mr.get_capacity()));
+  }
+
+  void TearDown() override {
+    // Code here will be called immediately after each test (right
+    // before the destructor).
+
+    allocMT.uninit();
+
+    mr.uninit();
+  }
+};
+
+// Small nodes so the tree gets deep quickly
+using SmallTree = rtl::btree_map<int, std::string, rtl_test::CountingAllocator,
+                                 std::less<int>, 192U>;
+
+template <typename Tree>
+void ExpectSameContents(std::map<int, std::string> const& expected,
+                        Tree const& tree) {
+  ASSERT_EQ(expected.size(), tree.size());
+  auto it = tree.begin();
+  for (auto const& kv : expected) {
+    ASSERT_TRUE(it.valid());
+    ASSERT_EQ(kv.first, it.key());
+    ASSERT_EQ(kv.second, it.value());
+    it.next();
+  }
+  ASSERT_FALSE(it.valid());
+}
+
+TEST_F(BTreeMapTest, NodeSizeTest) {
+  using Tree = rtl::btree_map<uint64_t, uint64_t, rtl_test::CountingAllocator>;
+  // 16 byte entries in a 256 byte node, minus the header
+  ASSERT_GE(Tree::kLeafCapacity, 12U);
+  ASSERT_GE(Tree::kInnerCapacity, 12U);
+  ASSERT_GE(SmallTree::kLeafCapacity, 4U);
+  ASSERT_LE(SmallTree::kLeafCapacity, 6U);
+
+  // Padding between the keys and the values counts against the node
+  using Padded = rtl::btree_map<char, uint64_t, rtl_test::CountingAllocator>;
+  ASSERT_LE(2U * sizeof(void*) + sizeof(uint64_t) +
+                Padded::kLeafCapacity * (sizeof(char) + sizeof(uint64_t)),
+            256U);
+}
+
+TEST_F(BTreeMapTest, BasicTest) {
+  rtl_test::CountingAllocator a;
+  {
+    SmallTree t(&a);
+    ASSERT_TRUE(t.empty());
+    ASSERT_EQ(nullptr, t.get(1));
+    ASSERT_FALSE(t.begin().valid());
+    ASSERT_FALSE(t.lower_bound(1).valid());
+    ASSERT_FALSE(t.erase(1));
+    ASSERT_EQ(0U, a.live);
+
+    ASSERT_TRUE(t.put(2, "two"));
+    ASSERT_TRUE(t.put(1, "one"));
+    ASSERT_TRUE(t.put(3, "three"));
+    ASSERT_EQ(3U, t.size());
+    ASSERT_EQ("one", *t.get(1));
+
+    ASSERT_TRUE(t.put(1, "uno"));
+    ASSERT_EQ(3U, t.size());
+    ASSERT_EQ("uno", *t.get(1));
+
+    ASSERT_TRUE(t.erase(2));
+    ASSERT_FALSE(t.contains(2));
+    ASSERT_EQ(2U, t.size());
+  }
+  ASSERT_EQ(0U, a.live);
+}
+
+TEST_F(BTreeMapTest, RandomAgainstStdMapTest) {
+  rtl_test::CountingAllocator a;
+  std::map<int, std::string> expected;
+  std::mt19937 gen(1234);
+  {
+    SmallTree t(&a);
+    for (int round = 0; round < 20000; round++) {
+      int key = static_cast<int>(gen() % 2000U);
+      if (gen() % 3U != 0U) {
+        std::string val = std::to_string(round);
+        ASSERT_TRUE(t.put(key, val));
+        expected[key] = val;
+      } else {
+        ASSERT_EQ(expected.erase(key) == 1U, t.erase(key));
+      }
+      if (round % 1000 == 0) {
+        ExpectSameContents(expected, t);
+      }
+    }
+    ExpectSameContents(expected, t);
+    ASSERT_GT(t.height(), 3U);
+
+    // Drain it completely, the tree shrinks back to a single leaf
+    while (!expected.empty()) {
+      int key = expected.begin()->first;
+      expected.erase(expected.begin());
+      ASSERT_TRUE(t.erase(key));
+    }
+    ASSERT_TRUE(t.empty());
+    ASSERT_EQ(1U, t.height());
+    ASSERT_EQ(1U, a.live);
+  }
+  ASSERT_EQ(0U, a.live);
+}
+
+TEST_F(BTreeMapTest, RangeScanTest) {
+  rtl::btree_map<int, int, rtl::RTAllocatorMT> t(&allocMT);
+  for (int i = 0; i < 10000; i += 2) {
+    ASSERT_TRUE(t.put(i, i * 10));
+  }
+
+  // [101, 201) holds the even keys 102 to 200
+  int expected = 102;
+  for (auto it = t.lower_bound(101); it.valid() && it.key() < 201; it.next()) {
+    ASSERT_EQ(expected, it.key());
+    ASSERT_EQ(expected * 10, it.value());
+    it.value() = 0;
+    expected += 2;
+  }
+  ASSERT_EQ(202, expected);
+  ASSERT_EQ(0, *t.get(150));
+
+  ASSERT_EQ(100, t.lower_bound(100).key());
+  ASSERT_EQ(0, t.lower_bound(-5).key());
+  ASSERT_FALSE(t.lower_bound(9999).valid());
+}
+
+TEST_F(BTreeMapTest, AllocationFailureTest) {
+  rtl_test::CountingAllocator a;
+  std::map<int, std::string> expected;
+  SmallTree t(&a);
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(t.put(i, std::to_string(i)));
+    expected[i] = std::to_string(i);
+  }
+
+  // Keep inserting until a split fails part way down
+  a.budget = 3U;
+  int i = 1000;
+  while (t.put(i, std::to_string(i))) {
+    expected[i] = std::to_string(i);
+    i++;
+  }
+  ASSERT_FALSE(t.contains(i));
+  ExpectSameContents(expected, t);
+
+  // Overwriting and erasing don't need to allocate
+  ASSERT_TRUE(t.put(5, "five"));
+  expected[5] = "five";
+  ASSERT_TRUE(t.erase(6));
+  expected.erase(6);
+  ExpectSameContents(expected, t);
+
+  a.budget = static_cast<size_t>(-1);
+  ASSERT_TRUE(t.put(i, std::to_string(i)));
+  expected[i] = std::to_string(i);
+  ExpectSameContents(expected, t);
+}
+
+TEST_F(BTreeMapTest, MoveTest) {
+  rtl_test::CountingAllocator a;
+  {
+    SmallTree t(&a);
+    for (int i = 0; i < 100; i++) {
+      ASSERT_TRUE(t.put(i, std::to_string(i)));
+    }
+    SmallTree t2(std::move(t));
+    ASSERT_TRUE(t.empty());
+    ASSERT_EQ(100U, t2.size());
+    ASSERT_EQ("42", *t2.get(42));
+
+    SmallTree t3(&a);
+    ASSERT_TRUE(t3.put(1, "one"));
+    t3 = std::move(t2);
+    ASSERT_EQ(100U, t3.size());
+    ASSERT_EQ("99", *t3.get(99));
+  }
+  ASSERT_EQ(0U, a.live);
+}
@@ -0,0 +1,227 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rtlcpp/deque.hpp"
+
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "test_allocators.hpp"
+
+class DequeTest : public ::testing::Test {
+ protected:
+  rtl::MMapMemoryResource mr;
+  rtl::RTAllocatorMT allocMT;
+
+  DequeTest() {
+    // You can do set-up work for each test here.
+  }
+
+  ~DequeTest() override {
+    // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+    // Code here will be called immediately after the constructor (right
+    // before each test).
+
+    ASSERT_TRUE(mr.init(std::min(static_cast<size_t>(50 * 1024 * 1024),
+                                 rtl_tlsf_maximum_arena_size())));
+
+    ASSERT_TRUE(allocMT.init(mr.get_buf(), mr.get_capacity()));
+  }
+
+  void TearDown() override {
+    // Code here will be called immediately after each test (right
+    // before the destructor).
+
+    allocMT.uninit();
+
+    mr.uninit();
+  }
+};
+
+TEST_F(DequeTest, BasicTest) {
+  rtl::deque<int, rtl::RTAllocatorMT> d(&allocMT);
+  ASSERT_TRUE(d.empty());
+  ASSERT_EQ(0U, d.capacity());
+  d.pop_front();
+  d.pop_back();
+
+  ASSERT_TRUE(d.push_back(2));
+  ASSERT_TRUE(d.push_front(1));
+  ASSERT_TRUE(d.push_back(3));
+  ASSERT_EQ(3U, d.size());
+  ASSERT_EQ(4U, d.capacity());
+  ASSERT_EQ(1, d.front());
+  ASSERT_EQ(3, d.back());
+  ASSERT_EQ(2, d[1]);
+
+  d.pop_front();
+  ASSERT_EQ(2, d.front());
+  d.pop_back();
+  ASSERT_EQ(2, d.back());
+  ASSERT_EQ(1U, d.size());
+
+  ASSERT_TRUE(d.reserve(5U));
+  ASSERT_EQ(8U, d.capacity());
+  ASSERT_EQ(2, d.front());
+}
+
+TEST_F(DequeTest, WrapAroundTest) {
+  rtl::deque<int, rtl::RTAllocatorMT> d(&allocMT);
+  ASSERT_TRUE(d.reserve(8U));
+
+  // Cycle through the buffer many times as a FIFO without growing
+  int next_in = 0;
+  int next_out = 0;
+  for (int round = 0; round < 100; round++) {
+    while (d.size() < 8U) {
+      ASSERT_TRUE(d.push_back(next_in++));
+    }
+    for (int i = 0; i < 5; i++) {
+      ASSERT_EQ(next_out++, d.front());
+      d.pop_front();
+    }
+  }
+  ASSERT_EQ(8U, d.capacity());
+
+  // Growing while wrapped keeps the order
+  while (d.size() < 8U) {
+    ASSERT_TRUE(d.push_back(next_in++));
+  }
+  ASSERT_TRUE(d.push_back(next_in++));
+  ASSERT_EQ(16U, d.capacity());
+  for (size_t i = 0U; i < d.size(); i++) {
+    ASSERT_EQ(next_out + static_cast<int>(i), d[i]);
+  }
+}
+
+TEST_F(DequeTest, RandomAgainstStdTest) {
+  std::deque<std::string> expected;
+  std::mt19937 gen(99U);
+  {
+    rtl::deque<std::string, rtl::RTAllocatorMT> d(&allocMT);
+    for (int i = 0; i < 20000; i++) {
+      std::string v = std::to_string(i);
+      switch (gen() % 4U) {
+        case 0U:
+          ASSERT_TRUE(d.push_back(v));
+          expected.push_back(v);
+          break;
+        case 1U:
+          ASSERT_TRUE(d.push_front(std::move(v)));
+          expected.push_front(std::to_string(i));
+          break;
+        case 2U:
+          d.pop_front();
+          if (!expected.empty()) expected.pop_front();
+          break;
+        default:
+          d.pop_back();
+          if (!expected.empty()) expected.pop_back();
+          break;
+      }
+      ASSERT_EQ(expected.size(), d.size());
+      if (!expected.empty()) {
+        ASSERT_EQ(expected.front(), d.front());
+        ASSERT_EQ(expected.back(), d.back());
+      }
+    }
+    for (size_t i = 0U; i < expected.size(); i++) {
+      ASSERT_EQ(expected[i], d[i]);
+    }
+  }
+}
+
+TEST_F(DequeTest, BulkTest) {
+  rtl::deque<int, rtl::RTAllocatorMT> d(&allocMT);
+  std::vector<int> in(100);
+  for (int i = 0; i < 100; i++) in[static_cast<size_t>(i)] = i;
+
+  ASSERT_TRUE(d.push_back(in.data(), 10U));
+  ASSERT_TRUE(d.push_back(in.data() + 10U, 90U));
+  ASSERT_EQ(100U, d.size());
+  ASSERT_EQ(128U, d.capacity());
+
+  std::vector<int> out(64);
+  ASSERT_EQ(64U, d.pop_front(out.data(), 64U));
+  for (int i = 0; i < 64; i++) ASSERT_EQ(i, out[static_cast<size_t>(i)]);
+  ASSERT_EQ(64, d.front());
+
+  ASSERT_EQ(36U, d.pop_front(out.data(), 64U));
+  ASSERT_EQ(99, out[35]);
+  ASSERT_TRUE(d.empty());
+  ASSERT_EQ(0U, d.pop_front(out.data(), 64U));
+}
+
+TEST_F(DequeTest, AllocationFailureTest) {
+  rtl_test::FailingAllocator a;
+  rtl::deque<int, rtl_test::FailingAllocator> d(&a);
+  int values[3] = {1, 2, 3};
+  ASSERT_FALSE(d.push_back(1));
+  ASSERT_FALSE(d.push_front(1));
+  ASSERT_FALSE(d.push_back(values, 3U));
+  ASSERT_FALSE(d.reserve(1U));
+  ASSERT_TRUE(d.empty());
+  // Nothing to add needs no room
+  ASSERT_TRUE(d.push_back(values, 0U));
+}
+
+TEST_F(DequeTest, ReserveOverflowTest) {
+  rtl_test::CountingAllocator a;
+  rtl::deque<uint64_t, rtl_test::CountingAllocator> d(&a);
+  size_t max = static_cast<size_t>(-1);
+  ASSERT_LE(decltype(d)::kMaxCapacity, max / sizeof(uint64_t));
+
+  // Rounding these up to a power of two, or sizing them in bytes, would
+  // wrap around
+  ASSERT_FALSE(d.reserve(max));
+  ASSERT_FALSE(d.reserve(max / 2U + 2U));
+  ASSERT_FALSE(d.reserve(decltype(d)::kMaxCapacity + 1U));
+  ASSERT_EQ(0U, a.allocations);
+  ASSERT_EQ(0U, d.capacity());
+
+  rtl::deque<char, rtl_test::CountingAllocator> c(&a);
+  ASSERT_EQ(max / 2U + 1U, decltype(c)::kMaxCapacity);
+  ASSERT_FALSE(c.reserve(max));
+  ASSERT_EQ(0U, a.allocations);
+
+  ASSERT_TRUE(d.push_back(1U));
+  ASSERT_EQ(1U, d.front());
+}
+
+TEST_F(DequeTest, MoveTest) {
+  rtl::deque<std::string, rtl::RTAllocatorMT> d(&allocMT);
+  ASSERT_TRUE(d.push_back("a"));
+  ASSERT_TRUE(d.push_front("b"));
+
+  rtl::deque<std::string, rtl::RTAllocatorMT> d2(std::move(d));
+  ASSERT_TRUE(d.empty());
+  ASSERT_EQ(0U, d.capacity());
+  ASSERT_EQ("b", d2.front());
+
+  rtl::deque<std::string, rtl::RTAllocatorMT> d3(&allocMT);
+  ASSERT_TRUE(d3.push_back("c"));
+  d3 = std::move(d2);
+  ASSERT_EQ(2U, d3.size());
+  ASSERT_EQ("a", d3.back());
+}
@@ -0,0 +1,250 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rtlcpp/histogram.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <limits>
+#include <thread>
+
+#include "test_allocators.hpp"
+
+class HistogramTest : public ::testing::Test {
+ protected:
+  rtl::MMapMemoryResource mr;
+  rtl::RTAllocatorMT allocMT;
+
+  HistogramTest() {
+    // You can do set-up work for each test here.
+  }
+
+  ~HistogramTest() override {
+    // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+    // Code here will be called immediately after the constructor (right
+    // before each test).
+
+    ASSERT_TRUE(mr.init(std::min(static_cast<size_t>(50 * 1024 * 1024),
+                                 rtl_tlsf_maximum_arena_size())));
+
+    ASSERT_TRUE(allocMT.init(mr.get_buf(), mr.get_capacity()));
+  }
+
+  void TearDown() override {
+    // Code here will be called immediately after each test (right
+    // before the destructor).
+
+    allocMT.uninit();
+
+    mr.uninit();
+  }
+};
+
+TEST_F(HistogramTest, SmokeTest) {
+  rtl::histogram<rtl::RTAllocatorMT> h(&allocMT);
+  ASSERT_FALSE(h.is_initialized());
+  ASSERT_EQ(0U, h.value_at_percentile(50.0));
+
+  // Bad parameters
+  ASSERT_FALSE(h.init(1000U, 1U));
+  ASSERT_FALSE(h.init(1000U, 21U));
+  ASSERT_FALSE(h.init(100U, 7U));
+
+  ASSERT_TRUE(h.init(1000000U));
+  ASSERT_TRUE(h.is_initialized());
+  ASSERT_EQ(0U, h.count());
+  ASSERT_EQ(0U, h.min());
+  ASSERT_EQ(0U, h.max());
+  ASSERT_EQ(0.0, h.mean());
+  ASSERT_EQ(0U, h.value_at_percentile(99.0));
+
+  // Small values are exact
+  for (uint64_t i = 1U; i <= 100U; i++) {
+    h.record(i);
+  }
+
+  ASSERT_EQ(100U, h.count());
+  ASSERT_EQ(1U, h.min());
+  ASSERT_EQ(100U, h.max());
+  ASSERT_DOUBLE_EQ(50.5, h.mean());
+  ASSERT_EQ(1U, h.value_at_percentile(0.0));
+  ASSERT_EQ(50U, h.value_at_percentile(50.0));
+  ASSERT_EQ(99U, h.value_at_percentile(99.0));
+  ASSERT_EQ(100U, h.value_at_percentile(100.0));
+  ASSERT_EQ(1U, h.count_at_value(42U));
+
+  h.record(7U, 10U);
+  ASSERT_EQ(110U, h.count());
+  ASSERT_EQ(11U, h.count_at_value(7U));
+
+  h.reset();
+  ASSERT_EQ(0U, h.count());
+  ASSERT_EQ(0U, h.count_at_value(7U));
+  ASSERT_EQ(0U, h.value_at_percentile(50.0));
+}
+
+TEST_F(HistogramTest, PrecisionTest) {
+  for (uint32_t bits = 2U; bits <= 12U; bits++) {
+    rtl::histogram<rtl::RTAllocatorMT> h(&allocMT);
+    ASSERT_TRUE(h.init(1ULL << 40U, bits));
+
+    double max_error = 1.0 / static_cast<double>(1U << (bits - 1U));
+
+    for (uint64_t v = 1U; v < (1ULL << 40U); v = v * 3U + 1U) {
+      uint64_t lo = h.lowest_equivalent_value(v);
+      uint64_t hi = h.highest_equivalent_value(v);
+      ASSERT_LE(lo, v);
+      ASSERT_GE(hi, v);
+      ASSERT_LE(static_cast<double>(hi - lo),
+                static_cast<double>(v) * max_error);
+
+      // Neighbouring buckets don't overlap
+      ASSERT_EQ(hi + 1U, h.lowest_equivalent_value(hi + 1U));
+    }
+  }
+
+  rtl::histogram<rtl::RTAllocatorMT> h(&allocMT);
+  ASSERT_TRUE(h.init(3600ULL * 1000000000ULL));
+  for (uint64_t v = 1000U; v <= 1000000U; v += 1000U) {
+    h.record(v);
+  }
+
+  uint64_t p50 = h.value_at_percentile(50.0);
+  uint64_t p99 = h.value_at_percentile(99.0);
+  ASSERT_NEAR(500000.0, static_cast<double>(p50), 500000.0 / 64.0);
+  ASSERT_NEAR(990000.0, static_cast<double>(p99), 990000.0 / 64.0);
+  ASSERT_EQ(1000000U, h.value_at_percentile(100.0));
+}
+
+TEST_F(HistogramTest, OverflowTest) {
+  rtl::histogram<rtl::RTAllocatorMT> h(&allocMT);
+  ASSERT_TRUE(h.init(1000U));
+
+  h.record(10U);
+  h.record(5000U);
+  h.record(std::numeric_limits<uint64_t>::max());
+
+  ASSERT_EQ(3U, h.count());
+  ASSERT_EQ(2U, h.overflow_count());
+  ASSERT_EQ(std::numeric_limits<uint64_t>::max(), h.max());
+  ASSERT_EQ(2U, h.count_at_value(1000U));
+  ASSERT_EQ(10U, h.value_at_percentile(10.0));
+  ASSERT_GE(h.value_at_percentile(100.0), 1000U);
+}
+
+TEST_F(HistogramTest, SnapshotMergeTest) {
+  rtl::histogram<rtl::RTAllocatorMT> a(&allocMT);
+  rtl::histogram<rtl::RTAllocatorMT> b(&allocMT);
+  rtl::histogram<rtl::RTAllocatorMT> other(&allocMT);
+
+  // Not initialized yet
+  ASSERT_FALSE(a.snapshot_to(b));
+  ASSERT_FALSE(b.merge(a));
+
+  ASSERT_TRUE(a.init(100000U));
+  ASSERT_TRUE(b.init(100000U));
+  ASSERT_TRUE(other.init(100000U, 8U));
+
+  ASSERT_FALSE(a.snapshot_to(a));
+  ASSERT_FALSE(a.merge(a));
+  ASSERT_FALSE(a.snapshot_to(other));
+  ASSERT_FALSE(other.merge(a));
+
+  for (uint64_t i = 1U; i <= 1000U; i++) {
+    a.record(i);
+  }
+  b.record(123456U);
+
+  ASSERT_TRUE(a.snapshot_to(b));
+  ASSERT_EQ(1000U, b.count());
+  ASSERT_EQ(0U, b.overflow_count());
+  ASSERT_EQ(1U, b.min());
+  ASSERT_EQ(1000U, b.max());
+  ASSERT_EQ(a.value_at_percentile(90.0), b.value_at_percentile(90.0));
+
+  ASSERT_TRUE(b.merge(a));
+  ASSERT_EQ(2000U, b.count());
+  ASSERT_DOUBLE_EQ(a.mean(), b.mean());
+  ASSERT_EQ(2U, b.count_at_value(1U));
+
+  a.reset();
+  a.record(200000U);
+  ASSERT_TRUE(b.merge(a));
+  ASSERT_EQ(2001U, b.count());
+  ASSERT_EQ(1U, b.overflow_count());
+  ASSERT_EQ(200000U, b.max());
+}
+
+TEST_F(HistogramTest, AllocationFailureTest) {
+  rtl_test::FailingAllocator alloc;
+  rtl::histogram<rtl_test::FailingAllocator> h(&alloc);
+  ASSERT_FALSE(h.init(1000000U));
+  ASSERT_FALSE(h.is_initialized());
+  ASSERT_EQ(0U, h.num_buckets());
+
+  // Re-initializing frees the old buckets
+  rtl::histogram<rtl::RTAllocatorMT> g(&allocMT);
+  ASSERT_TRUE(g.init(1000U));
+  size_t small = g.num_buckets();
+  ASSERT_TRUE(g.init(1000000U));
+  ASSERT_LT(small, g.num_buckets());
+}
+
+TEST_F(HistogramTest, ThreadedTest) {
+  constexpr uint64_t kNumRecords = 200000U;
+
+  rtl::histogram<rtl::RTAllocatorMT> h(&allocMT);
+  ASSERT_TRUE(h.init(1000000U));
+
+  std::atomic<bool> done(false);
+  std::atomic<uint64_t> failures(0U);
+
+  std::thread reader([&]() {
+    rtl::histogram<rtl::RTAllocatorMT> snap(&allocMT);
+    if (!snap.init(1000000U)) {
+      failures++;
+      return;
+    }
+
+    uint64_t last = 0U;
+    while (!done.load()) {
+      if (!h.snapshot_to(snap)) {
+        failures++;
+      }
+      // A single writer only ever adds
+      if (snap.count() < last || snap.max() > 1000U) {
+        failures++;
+      }
+      last = snap.count();
+    }
+  });
+
+  for (uint64_t i = 0U; i < kNumRecords; i++) {
+    h.record(i % 1000U + 1U);
+  }
+  done = true;
+  reader.join();
+
+  ASSERT_EQ(0U, failures.load());
+  ASSERT_EQ(kNumRecords, h.count());
+  ASSERT_EQ(1000U, h.max());
+  ASSERT_EQ(kNumRecords / 1000U, h.count_at_value(100U));
+}
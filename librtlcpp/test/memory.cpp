@@ -747,3 +747,75 @@ TEST_F(SharedPointerTests, ExtensionTests) {
   }
   ASSERT_TRUE(change);
 }
+
+TEST_F(SharedPointerTests, DeferredReleaseTest) {
+  rtl::Reclaimer reclaimer;
+  bool change{false};
+
+  // Objects that don't opt in keep the plain control block
+  ASSERT_EQ(2U * sizeof(void*) + 2U * sizeof(uint32_t),
+            sizeof(rtl::control_blk<int, rtl::RTAllocatorMT>));
+
+  {
+    rtl::weak_ptr<DerivedDestructorCheck> w;
+    {
+      auto r1 = rtl::make_shared_deferred<DerivedDestructorCheck>(
+          &allocMT, &reclaimer, &change);
+      ASSERT_TRUE(r1);
+      auto r2 = r1;
+      w = r1;
+      ASSERT_EQ(2U, r1.get_control_blk()->weak_count());
+      ASSERT_TRUE(reclaimer.empty());
+    }
+
+    // The last strong pointer is gone but nothing was destroyed yet
+    ASSERT_FALSE(change);
+    ASSERT_FALSE(reclaimer.empty());
+    ASSERT_TRUE(w.expired());
+    ASSERT_FALSE(w.lock());
+
+    ASSERT_EQ(1U, reclaimer.drain());
+    ASSERT_TRUE(change);
+    ASSERT_TRUE(reclaimer.empty());
+    ASSERT_EQ(0U, reclaimer.drain());
+  }
+
+  // Arrays work the same way and the control block is freed by the
+  // reclaimer when there are no weak pointers left
+  {
+    auto arr = rtl::make_shared_deferred<int[]>(&allocMT, &reclaimer, 16, 7);
+    ASSERT_EQ(16U, arr.array_size());
+    ASSERT_EQ(7, arr[15]);
+  }
+  ASSERT_EQ(1U, reclaimer.drain());
+  ASSERT_EQ(2U, reclaimer.num_released());
+}
+
+TEST_F(SharedPointerTests, DeferredReleaseThreadTest) {
+  constexpr size_t kNumObjects = 1000U;
+  bool changes[kNumObjects] = {};
+
+  {
+    rtl::Reclaimer reclaimer;
+    reclaimer.start(std::chrono::microseconds(100));
+
+    std::thread rt_thread([&]() {
+      for (size_t i = 0U; i < kNumObjects; i++) {
+        auto p = rtl::make_shared_deferred<DerivedDestructorCheck>(
+            &allocMT, &reclaimer, &changes[i]);
+        ASSERT_TRUE(p);
+      }
+    });
+    rt_thread.join();
+
+    rtl::SlumberViaSleep s(std::chrono::microseconds(100));
+    while (reclaimer.num_released() != kNumObjects) {
+      s.wait();
+    }
+    reclaimer.stop();
+  }
+
+  for (size_t i = 0U; i < kNumObjects; i++) {
+    ASSERT_TRUE(changes[i]);
+  }
+}
@@ -0,0 +1,235 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rtlcpp/priority_queue.hpp"
+
+#include <gtest/gtest.h>
+
+#include <functional>
+#include <map>
+#include <queue>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "test_allocators.hpp"
+
+class PriorityQueueTest : public ::testing::Test {
+ protected:
+  rtl::MMapMemoryResource mr;
+  rtl::RTAllocatorMT allocMT;
+
+  PriorityQueueTest() {
+    // You can do set-up work for each test here.
+  }
+
+  ~PriorityQueueTest() override {
+    // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+    // Code here will be called immediately after the constructor (right
+    // before each test).
+
+    ASSERT_TRUE(mr.init(std::min(static_cast<size_t>(50 * 1024 * 1024),
+                                 rtl_tlsf_maximum_arena_size())));
+
+    ASSERT_TRUE(allocMT.init(mr.get_buf(), mr.get_capacity()));
+  }
+
+  void TearDown() override {
+    // Code here will be called immediately after each test (right
+    // before the destructor).
+
+    allocMT.uninit();
+
+    mr.uninit();
+  }
+};
+
+template <size_t D>
+void RandomAgainstStd(rtl::RTAllocatorMT* alloc) {
+  rtl::priority_queue<int, std::less<int>, rtl::RTAllocatorMT, D> q(alloc);
+  std::priority_queue<int> expected;
+  std::mt19937 gen(D);
+
+  for (int i = 0; i < 20000; i++) {
+    if (gen() % 3U != 0U) {
+      int v = static_cast<int>(gen() % 1000U);
+      ASSERT_TRUE(q.push(v));
+      expected.push(v);
+    } else {
+      ASSERT_EQ(!expected.empty(), q.pop());
+      if (!expected.empty()) expected.pop();
+    }
+    ASSERT_EQ(expected.size(), q.size());
+    if (!expected.empty()) {
+      ASSERT_EQ(expected.top(), q.top());
+    }
+  }
+}
+
+TEST_F(PriorityQueueTest, RandomAgainstStdTest) {
+  RandomAgainstStd<2U>(&allocMT);
+  RandomAgainstStd<4U>(&allocMT);
+  RandomAgainstStd<8U>(&allocMT);
+}
+
+TEST_F(PriorityQueueTest, MinHeapTest) {
+  rtl::priority_queue<std::string, std::greater<std::string>,
+                      rtl::RTAllocatorMT>
+      q(&allocMT);
+  ASSERT_TRUE(q.reserve(4U));
+  ASSERT_EQ(4U, q.capacity());
+  ASSERT_TRUE(q.push("pear"));
+  ASSERT_TRUE(q.push("apple"));
+  ASSERT_TRUE(q.push(std::string("zucchini")));
+  ASSERT_TRUE(q.push("fig"));
+  ASSERT_EQ(4U, q.capacity());
+
+  std::string out;
+  ASSERT_TRUE(q.pop(&out));
+  ASSERT_EQ("apple", out);
+  ASSERT_TRUE(q.pop(&out));
+  ASSERT_EQ("fig", out);
+  ASSERT_EQ("pear", q.top());
+
+  q.clear();
+  ASSERT_TRUE(q.empty());
+  ASSERT_FALSE(q.pop());
+  ASSERT_FALSE(q.pop(&out));
+  ASSERT_EQ("fig", out);
+}
+
+TEST_F(PriorityQueueTest, AllocationFailureTest) {
+  rtl_test::FailingAllocator a;
+  rtl::priority_queue<int, std::less<int>, rtl_test::FailingAllocator> q(&a);
+  ASSERT_FALSE(q.reserve(10U));
+  ASSERT_FALSE(q.push(1));
+  ASSERT_TRUE(q.empty());
+
+  rtl::indexed_priority_queue<int, std::less<int>, rtl_test::FailingAllocator>
+      iq(&a);
+  size_t h = 0U;
+  ASSERT_FALSE(iq.push(1, &h));
+  ASSERT_TRUE(iq.empty());
+  ASSERT_FALSE(iq.contains(0U));
+}
+
+TEST_F(PriorityQueueTest, IndexedBasicTest) {
+  // Earliest deadline first
+  rtl::indexed_priority_queue<int, std::greater<int>, rtl::RTAllocatorMT> q(
+      &allocMT);
+  size_t h10, h20, h30;
+  ASSERT_TRUE(q.push(10, &h10));
+  ASSERT_TRUE(q.push(20, &h20));
+  ASSERT_TRUE(q.push(30, &h30));
+  ASSERT_EQ(10, q.top());
+  ASSERT_EQ(h10, q.top_handle());
+
+  // Moving towards the top only
+  ASSERT_FALSE(q.decrease_key(h30, 40));
+  ASSERT_EQ(30, *q.get(h30));
+  ASSERT_TRUE(q.decrease_key(h30, 5));
+  ASSERT_EQ(h30, q.top_handle());
+
+  // Either way
+  ASSERT_TRUE(q.update(h30, 25));
+  ASSERT_EQ(h10, q.top_handle());
+
+  ASSERT_TRUE(q.remove(h10));
+  ASSERT_FALSE(q.contains(h10));
+  ASSERT_EQ(nullptr, q.get(h10));
+  ASSERT_FALSE(q.remove(h10));
+  ASSERT_FALSE(q.update(h10, 1));
+  ASSERT_EQ(20, q.top());
+
+  // Freed handles are reused
+  size_t h1;
+  ASSERT_TRUE(q.push(1, &h1));
+  ASSERT_EQ(h10, h1);
+  ASSERT_EQ(3U, q.size());
+
+  int out = 0;
+  ASSERT_TRUE(q.pop(&out));
+  ASSERT_EQ(1, out);
+  ASSERT_TRUE(q.pop(&out));
+  ASSERT_EQ(20, out);
+  ASSERT_TRUE(q.pop(&out));
+  ASSERT_EQ(25, out);
+  ASSERT_FALSE(q.pop(&out));
+}
+
+TEST_F(PriorityQueueTest, IndexedRandomTest) {
+  rtl::indexed_priority_queue<int, std::less<int>, rtl::RTAllocatorMT> q(
+      &allocMT);
+  ASSERT_TRUE(q.reserve(1000U));
+  std::map<size_t, int> values;
+  std::multiset<int> ordered;
+  std::mt19937 gen(7U);
+
+  for (int i = 0; i < 20000; i++) {
+    uint32_t op = gen() % 5U;
+    if (op <= 1U || values.empty()) {
+      int v = static_cast<int>(gen() % 10000U);
+      size_t h;
+      ASSERT_TRUE(q.push(v, &h));
+      ASSERT_EQ(0U, values.count(h));
+      values[h] = v;
+      ordered.insert(v);
+    } else {
+      auto it = values.begin();
+      std::advance(it, gen() % values.size());
+      size_t h = it->first;
+      ASSERT_EQ(it->second, *q.get(h));
+      ordered.erase(ordered.find(it->second));
+      if (op == 2U) {
+        int v = static_cast<int>(gen() % 10000U);
+        ASSERT_TRUE(q.update(h, v));
+        it->second = v;
+        ordered.insert(v);
+      } else if (op == 3U) {
+        ASSERT_TRUE(q.remove(h));
+        values.erase(it);
+      } else {
+        // Past every other element, so it becomes the top
+        int v = it->second;
+        if (!ordered.empty() && *ordered.rbegin() >= v) {
+          v = *ordered.rbegin() + 1;
+        }
+        ASSERT_TRUE(q.decrease_key(h, v));
+        it->second = v;
+        ordered.insert(v);
+        ASSERT_EQ(h, q.top_handle());
+      }
+    }
+    ASSERT_EQ(values.size(), q.size());
+    if (!ordered.empty()) {
+      ASSERT_EQ(*ordered.rbegin(), q.top());
+      ASSERT_EQ(values[q.top_handle()], q.top());
+    }
+  }
+
+  while (!values.empty()) {
+    size_t h = q.top_handle();
+    ASSERT_TRUE(q.pop());
+    ASSERT_FALSE(q.contains(h));
+    values.erase(h);
+    ASSERT_EQ(values.size(), q.size());
+  }
+}
@@ -0,0 +1,257 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rtlcpp/rcu.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "test_allocators.hpp"
+
+class RCUTest : public ::testing::Test {
+ protected:
+  rtl::MMapMemoryResource mr;
+  rtl::RTAllocatorMT allocMT;
+
+  RCUTest() {
+    // You can do set-up work for each test here.
+  }
+
+  ~RCUTest() override {
+    // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+    // Code here will be called immediately after the constructor (right
+    // before each test).
+
+    ASSERT_TRUE(mr.init(std::min(static_cast<size_t>(50 * 1024 * 1024),
+                                 rtl_tlsf_maximum_arena_size())));
+
+    ASSERT_TRUE(allocMT.init(mr.get_buf(), mr.get_capacity()));
+  }
+
+  void TearDown() override {
+    // Code here will be called immediately after each test (right
+    // before the destructor).
+
+    allocMT.uninit();
+
+    mr.uninit();
+  }
+};
+
+struct RCUCountingStruct {
+  std::atomic<int>* m_alive;
+  uint64_t m_a;
+  uint64_t m_b;
+
+  RCUCountingStruct(std::atomic<int>* alive, uint64_t a)
+      : m_alive(alive), m_a(a), m_b(a * 2U) {
+    m_alive->fetch_add(1);
+  }
+
+  ~RCUCountingStruct() { m_alive->fetch_sub(1); }
+
+  RCUCountingStruct(RCUCountingStruct const&) = delete;
+  RCUCountingStruct& operator=(RCUCountingStruct const&) = delete;
+};
+
+TEST_F(RCUTest, SmokeTest) {
+  rtl::rcu_ptr<int, rtl::RTAllocatorMT> p(&allocMT);
+
+  ASSERT_EQ(nullptr, p.read());
+
+  size_t id = 0U;
+  ASSERT_TRUE(p.register_reader(&id));
+
+  ASSERT_TRUE(p.publish(1));
+  ASSERT_EQ(1, *p.read());
+  // Nothing was replaced yet
+  ASSERT_EQ(0U, p.retired_count());
+
+  int const* old = p.read();
+  ASSERT_TRUE(p.publish(2));
+  ASSERT_EQ(2, *p.read());
+
+  // The reader hasn't passed a quiescent point so the old value must
+  // still be around
+  ASSERT_EQ(1U, p.retired_count());
+  ASSERT_EQ(1, *old);
+  ASSERT_EQ(0U, p.reclaim());
+
+  p.quiescent(id);
+  ASSERT_EQ(1U, p.reclaim());
+  ASSERT_EQ(0U, p.retired_count());
+  ASSERT_EQ(2, *p.read());
+
+  p.unregister_reader(id);
+}
+
+TEST_F(RCUTest, OfflineReaderTest) {
+  rtl::rcu_ptr<int, rtl::RTAllocatorMT> p(&allocMT);
+
+  size_t online_id = 0U;
+  size_t offline_id = 0U;
+  ASSERT_TRUE(p.register_reader(&online_id));
+  ASSERT_TRUE(p.register_reader(&offline_id));
+  ASSERT_NE(online_id, offline_id);
+
+  ASSERT_TRUE(p.publish(1));
+  ASSERT_TRUE(p.publish(2));
+  ASSERT_EQ(1U, p.retired_count());
+
+  p.offline(offline_id);
+  ASSERT_EQ(1U, p.retired_count());
+  p.quiescent(online_id);
+
+  // The offline reader shouldn't hold up reclamation
+  ASSERT_EQ(1U, p.reclaim());
+
+  p.online(offline_id);
+  ASSERT_TRUE(p.publish(3));
+  ASSERT_EQ(1U, p.retired_count());
+
+  p.quiescent(online_id);
+  ASSERT_EQ(0U, p.reclaim());
+  p.quiescent(offline_id);
+  ASSERT_EQ(1U, p.reclaim());
+  ASSERT_EQ(3, *p.read());
+
+  p.unregister_reader(online_id);
+  p.unregister_reader(offline_id);
+
+  // No readers means everything is reclaimed immediately
+  ASSERT_TRUE(p.publish(4));
+  ASSERT_EQ(0U, p.retired_count());
+}
+
+TEST_F(RCUTest, MaxReadersTest) {
+  rtl::rcu_ptr<int, rtl::RTAllocatorMT, 2U> p(&allocMT);
+
+  size_t id0 = 0U;
+  size_t id1 = 0U;
+  size_t id2 = 0U;
+
+  ASSERT_FALSE(p.register_reader(nullptr));
+  ASSERT_TRUE(p.register_reader(&id0));
+  ASSERT_TRUE(p.register_reader(&id1));
+  ASSERT_FALSE(p.register_reader(&id2));
+
+  p.unregister_reader(id0);
+  ASSERT_TRUE(p.register_reader(&id2));
+  ASSERT_EQ(id0, id2);
+}
+
+TEST_F(RCUTest, AllocationFailureTest) {
+  rtl_test::FailingAllocator alloc;
+  rtl::rcu_ptr<int, rtl_test::FailingAllocator> p(&alloc);
+
+  ASSERT_FALSE(p.publish(1));
+  ASSERT_EQ(nullptr, p.read());
+  ASSERT_EQ(0U, p.retired_count());
+}
+
+TEST_F(RCUTest, DestructorTest) {
+  std::atomic<int> alive(0);
+
+  {
+    rtl::rcu_ptr<RCUCountingStruct, rtl::RTAllocatorMT> p(&allocMT);
+
+    size_t id = 0U;
+    ASSERT_TRUE(p.register_reader(&id));
+
+    for (uint64_t i = 0U; i < 10U; i++) {
+      ASSERT_TRUE(p.publish(&alive, i));
+    }
+
+    ASSERT_EQ(10, alive.load());
+    ASSERT_EQ(9U, p.retired_count());
+
+    p.quiescent(id);
+    p.synchronize();
+    ASSERT_EQ(1, alive.load());
+    ASSERT_EQ(9U, p.read()->m_a);
+
+    ASSERT_TRUE(p.publish(&alive, 10U));
+    ASSERT_EQ(2, alive.load());
+  }
+
+  ASSERT_EQ(0, alive.load());
+}
+
+TEST_F(RCUTest, ThreadedTest) {
+  constexpr uint64_t kNumPublishes = 20000U;
+  constexpr size_t kNumReaders = 4U;
+
+  std::atomic<int> alive(0);
+  std::atomic<bool> done(false);
+  std::atomic<uint64_t> failures(0U);
+
+  {
+    rtl::rcu_ptr<RCUCountingStruct, rtl::RTAllocatorMT> p(&allocMT);
+    ASSERT_TRUE(p.publish(&alive, 0U));
+
+    std::vector<std::thread> readers;
+    for (size_t i = 0U; i < kNumReaders; i++) {
+      readers.emplace_back([&]() {
+        size_t id = 0U;
+        if (!p.register_reader(&id)) {
+          failures++;
+          return;
+        }
+
+        uint64_t last = 0U;
+        while (!done.load()) {
+          RCUCountingStruct const* s = p.read();
+          // Snapshots are immutable and only move forward
+          if (s->m_b != s->m_a * 2U || s->m_a < last) {
+            failures++;
+          }
+          last = s->m_a;
+          p.quiescent(id);
+        }
+
+        p.unregister_reader(id);
+      });
+    }
+
+    for (uint64_t i = 1U; i <= kNumPublishes; i++) {
+      while (!p.publish(&alive, i)) {
+        // Let the readers catch up if we ran out of memory
+        p.reclaim();
+      }
+    }
+
+    done = true;
+    for (auto& t : readers) {
+      t.join();
+    }
+
+    ASSERT_EQ(0U, failures.load());
+    ASSERT_EQ(kNumPublishes, p.read()->m_a);
+
+    // All readers are gone, so everything but the current value goes away
+    p.synchronize();
+    ASSERT_EQ(1, alive.load());
+  }
+
+  ASSERT_EQ(0, alive.load());
+}
@@ -0,0 +1,335 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rtlcpp/reclaim.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "test_allocators.hpp"
+
+class ReclaimTest : public ::testing::Test {
+ protected:
+  rtl::MMapMemoryResource mr;
+  rtl::RTAllocatorMT allocMT;
+
+  ReclaimTest() {
+    // You can do set-up work for each test here.
+  }
+
+  ~ReclaimTest() override {
+    // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+    // Code here will be called immediately after the constructor (right
+    // before each test).
+
+    ASSERT_TRUE(mr.init(std::min(static_cast<size_t>(50 * 1024 * 1024),
+                                 rtl_tlsf_maximum_arena_size())));
+
+    ASSERT_TRUE(allocMT.init(mr.get_buf(), mr.get_capacity()));
+  }
+
+  void TearDown() override {
+    // Code here will be called immediately after each test (right
+    // before the destructor).
+
+    allocMT.uninit();
+
+    mr.uninit();
+  }
+};
+
+static const uint32_t kLiveMagic = 0xC0FFEEU;
+static const uint32_t kDeadMagic = 0xDEADU;
+
+struct ReclaimNode {
+  std::atomic<int>* m_alive;
+  uint32_t m_magic;
+  uint64_t m_value;
+  ReclaimNode* m_next;
+
+  ReclaimNode(std::atomic<int>* alive, uint64_t value)
+      : m_alive(alive), m_magic(kLiveMagic), m_value(value), m_next(nullptr) {
+    m_alive->fetch_add(1);
+  }
+
+  ~ReclaimNode() {
+    m_magic = kDeadMagic;
+    m_alive->fetch_sub(1);
+  }
+};
+
+template <typename Alloc>
+ReclaimNode* make_node(Alloc* alloc, std::atomic<int>* alive, uint64_t v) {
+  void* mem = alloc->allocate(sizeof(ReclaimNode));
+  if (mem == nullptr) {
+    return nullptr;
+  }
+  return new (mem) ReclaimNode(alive, v);
+}
+
+TEST_F(ReclaimTest, EpochSmokeTest) {
+  std::atomic<int> alive(0);
+  {
+    rtl::epoch_domain<rtl::RTAllocatorMT, 2U, 4U> d(&allocMT);
+
+    size_t writer = 0U;
+    size_t reader = 0U;
+    size_t extra = 0U;
+    ASSERT_FALSE(d.register_thread(nullptr));
+    ASSERT_TRUE(d.register_thread(&writer));
+    ASSERT_TRUE(d.register_thread(&reader));
+    ASSERT_FALSE(d.register_thread(&extra));
+
+    // A reader in an old epoch holds up reclamation
+    d.enter(reader);
+    ASSERT_TRUE(d.retire(writer, make_node(&allocMT, &alive, 1U)));
+    ASSERT_TRUE(d.try_advance());
+    ASSERT_FALSE(d.try_advance());
+    ASSERT_EQ(0U, d.collect(writer));
+    ASSERT_EQ(1, alive.load());
+    ASSERT_EQ(1U, d.retired_count(writer));
+
+    // Bounded retire list, the epoch can't advance past the reader
+    for (uint64_t i = 0U; i < 4U; i++) {
+      ASSERT_TRUE(d.retire(writer, make_node(&allocMT, &alive, i)));
+    }
+    ReclaimNode* n = make_node(&allocMT, &alive, 5U);
+    ASSERT_FALSE(d.retire(writer, n));
+    ASSERT_EQ(6, alive.load());
+
+    d.exit(reader);
+    ASSERT_TRUE(d.retire(writer, n));
+    ASSERT_EQ(6U, d.retired_count(writer));
+
+    // Two epochs after retiring an object it is reclaimed
+    ASSERT_EQ(5U, d.collect(writer));
+    ASSERT_EQ(1U, d.collect(writer));
+    ASSERT_EQ(0U, d.retired_count(writer));
+    ASSERT_EQ(0, alive.load());
+
+    ASSERT_TRUE(d.retire(writer, make_node(&allocMT, &alive, 6U)));
+    d.unregister_thread(writer);
+    d.unregister_thread(reader);
+    ASSERT_TRUE(d.register_thread(&extra));
+  }
+  // The destructor reclaims everything still retired
+  ASSERT_EQ(0, alive.load());
+}
+
+TEST_F(ReclaimTest, HazardSmokeTest) {
+  std::atomic<int> alive(0);
+  {
+    rtl::hazard_domain<rtl::RTAllocatorMT, 2U, 1U, 2U> d(&allocMT);
+
+    size_t writer = 0U;
+    size_t reader = 0U;
+    size_t extra = 0U;
+    ASSERT_TRUE(d.register_thread(&writer));
+    ASSERT_TRUE(d.register_thread(&reader));
+    ASSERT_FALSE(d.register_thread(&extra));
+
+    std::atomic<ReclaimNode*> shared(make_node(&allocMT, &alive, 1U));
+
+    ReclaimNode* p = d.protect(reader, 0U, shared);
+    ASSERT_EQ(1U, p->m_value);
+
+    ReclaimNode* old = shared.exchange(make_node(&allocMT, &alive, 2U));
+    ASSERT_TRUE(d.retire(writer, old));
+    ASSERT_EQ(0U, d.collect(writer));
+    ASSERT_EQ(kLiveMagic, p->m_magic);
+
+    // The retire list holds two, the protected node can't be reclaimed
+    ASSERT_TRUE(d.retire(writer, make_node(&allocMT, &alive, 3U)));
+    ReclaimNode* n = make_node(&allocMT, &alive, 4U);
+    ASSERT_TRUE(d.retire(writer, n));
+    ASSERT_EQ(2U, d.retired_count(writer));
+    ASSERT_EQ(3, alive.load());
+
+    d.clear(reader, 0U);
+    ASSERT_EQ(2U, d.collect(writer));
+    ASSERT_EQ(1, alive.load());
+
+    ReclaimNode* last = shared.exchange(nullptr);
+    ASSERT_EQ(nullptr, d.protect(reader, 0U, shared));
+    ASSERT_TRUE(d.retire(writer, last));
+  }
+  ASSERT_EQ(0, alive.load());
+}
+
+TEST_F(ReclaimTest, EpochAllocationFailureTest) {
+  rtl_test::FailingAllocator alloc;
+  rtl::epoch_domain<rtl_test::FailingAllocator, 2U> ed(&alloc);
+  rtl::hazard_domain<rtl_test::FailingAllocator, 2U> hd(&alloc);
+
+  size_t id = 0U;
+  ASSERT_FALSE(ed.register_thread(&id));
+  ASSERT_FALSE(hd.register_thread(&id));
+}
+
+// A Treiber stack shared by all threads, each thread pushes and pops
+// nodes and retires what it pops.  Reclaimed nodes are marked dead so
+// a use after free shows up as a bad magic value.
+
+static void stack_push(std::atomic<ReclaimNode*>* head, ReclaimNode* n) {
+  ReclaimNode* h = head->load();
+  do {
+    n->m_next = h;
+  } while (!head->compare_exchange_weak(h, n));
+}
+
+TEST_F(ReclaimTest, EpochStressTest) {
+  constexpr size_t kNumThreads = 4U;
+  constexpr uint64_t kNumOps = 20000U;
+
+  std::atomic<int> alive(0);
+  std::atomic<uint64_t> failures(0U);
+
+  {
+    rtl::epoch_domain<rtl::RTAllocatorMT, kNumThreads> d(&allocMT);
+    std::atomic<ReclaimNode*> head(nullptr);
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0U; t < kNumThreads; t++) {
+      threads.emplace_back([&]() {
+        size_t id = 0U;
+        if (!d.register_thread(&id)) {
+          failures++;
+          return;
+        }
+
+        for (uint64_t i = 0U; i < kNumOps; i++) {
+          ReclaimNode* n = make_node(&allocMT, &alive, i);
+          if (n == nullptr) {
+            failures++;
+            break;
+          }
+          stack_push(&head, n);
+
+          ReclaimNode* popped = nullptr;
+          {
+            rtl::epoch_guard<decltype(d)> g(&d, id);
+            ReclaimNode* h = head.load();
+            while (h != nullptr) {
+              if (h->m_magic != kLiveMagic) {
+                failures++;
+              }
+              if (head.compare_exchange_weak(h, h->m_next)) {
+                popped = h;
+                break;
+              }
+            }
+          }
+
+          if (popped != nullptr) {
+            while (!d.retire(id, popped)) {
+              (void)d.collect(id);
+            }
+          }
+        }
+
+        d.unregister_thread(id);
+      });
+    }
+
+    for (auto& t : threads) {
+      t.join();
+    }
+
+    ASSERT_EQ(0U, failures.load());
+    ASSERT_EQ(nullptr, head.load());
+  }
+
+  ASSERT_EQ(0, alive.load());
+}
+
+TEST_F(ReclaimTest, HazardStressTest) {
+  constexpr size_t kNumThreads = 4U;
+  constexpr uint64_t kNumOps = 20000U;
+
+  std::atomic<int> alive(0);
+  std::atomic<uint64_t> failures(0U);
+
+  {
+    rtl::hazard_domain<rtl::RTAllocatorMT, kNumThreads, 1U, 16U> d(&allocMT);
+    std::atomic<ReclaimNode*> head(nullptr);
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0U; t < kNumThreads; t++) {
+      threads.emplace_back([&]() {
+        size_t id = 0U;
+        if (!d.register_thread(&id)) {
+          failures++;
+          return;
+        }
+
+        for (uint64_t i = 0U; i < kNumOps; i++) {
+          ReclaimNode* n = make_node(&allocMT, &alive, i);
+          if (n == nullptr) {
+            failures++;
+            break;
+          }
+          stack_push(&head, n);
+
+          ReclaimNode* popped = nullptr;
+          while (true) {
+            ReclaimNode* h = d.protect(id, 0U, head);
+            if (h == nullptr) {
+              break;
+            }
+            if (h->m_magic != kLiveMagic) {
+              failures++;
+            }
+            ReclaimNode* next = h->m_next;
+            if (head.compare_exchange_strong(h, next)) {
+              popped = h;
+              break;
+            }
+          }
+          d.clear(id, 0U);
+
+          if (popped != nullptr) {
+            while (!d.retire(id, popped)) {
+              std::this_thread::yield();
+            }
+          }
+
+          // Bounded: never more than RetireCapacity unreclaimed per thread
+          if (d.retired_count(id) > 16U) {
+            failures++;
+          }
+        }
+
+        d.unregister_thread(id);
+      });
+    }
+
+    for (auto& t : threads) {
+      t.join();
+    }
+
+    ASSERT_EQ(0U, failures.load());
+    ASSERT_EQ(nullptr, head.load());
+  }
+
+  ASSERT_EQ(0, alive.load());
+}
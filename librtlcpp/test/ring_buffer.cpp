@@ -16,6 +16,7 @@
 
 #include <gtest/gtest.h>
 
+#include <cstring>
 #include <random>
 #include <thread>
 
@@ -564,3 +565,36 @@ TEST_F(RingBufferTest, SmokeTest) {
   rb.commit_read(sz);
   ASSERT_TRUE(rb.empty());
 }
+
+TEST_F(RingBufferTest, WrapCopyTest) {
+  unsigned char buf[8];
+  rtl::spsc_ringbuffer rb(buf, 8);
+
+  unsigned char in[7] = {1, 2, 3, 4, 5, 6, 7};
+  unsigned char out[8];
+
+  // Move both indices near the end of the buffer
+  ASSERT_TRUE(rb.write(in, 5));
+  ASSERT_EQ(rb.read(out, 5), 5U);
+  ASSERT_TRUE(rb.empty());
+
+  // Less than what is left before the end, nothing may spill past sz
+  ASSERT_EQ(rb.write_bytes(in, 2), 2U);
+  std::memset(out, 0xAA, sizeof(out));
+  ASSERT_EQ(rb.read(out, 1), 1U);
+  ASSERT_EQ(out[0], 1U);
+  ASSERT_EQ(out[1], 0xAA);
+  ASSERT_EQ(rb.read(out, 8), 1U);
+  ASSERT_EQ(out[0], 2U);
+  ASSERT_TRUE(rb.empty());
+
+  // More than is free, only the free space is written and accounted for
+  ASSERT_TRUE(rb.write(in, 4));
+  ASSERT_EQ(rb.write_bytes(in + 4, 3), 3U);
+  ASSERT_EQ(rb.write_bytes(in, 3), 0U);
+  std::memset(out, 0xAA, sizeof(out));
+  ASSERT_EQ(rb.read(out, 8), 7U);
+  for (uint32_t i = 0; i < 7; i++) ASSERT_EQ(out[i], in[i]);
+  ASSERT_EQ(out[7], 0xAA);
+  ASSERT_TRUE(rb.empty());
+}
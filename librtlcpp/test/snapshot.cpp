@@ -0,0 +1,279 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rtlcpp/snapshot.hpp"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "rtlcpp/map.hpp"
+
+class SnapshotTest : public ::testing::Test {
+ protected:
+  rtl::MMapMemoryResource mr;
+  rtl::RTAllocatorMT allocMT;
+
+  SnapshotTest() {
+    // You can do set-up work for each test here.
+  }
+
+  ~SnapshotTest() override {
+    // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+    // Code here will be called immediately after the constructor (right
+    // before each test).
+
+    ASSERT_TRUE(mr.init(std::min(static_cast<size_t>(50 * 1024 * 1024),
+                                 rtl_tlsf_maximum_arena_size())));
+
+    ASSERT_TRUE(allocMT.init(mr.get_buf(), mr.get_capacity()));
+  }
+
+  void TearDown() override {
+    // Code here will be called immediately after each test (right
+    // before the destructor).
+
+    allocMT.uninit();
+
+    mr.uninit();
+  }
+};
+
+struct SnapshotPoint {
+  int32_t m_x;
+  int32_t m_y;
+};
+
+struct SnapshotName {
+  char m_chars[8];
+};
+
+struct SnapshotStoredName {
+  char m_chars[8];
+  bool operator==(SnapshotStoredName const& o) const {
+    return std::memcmp(m_chars, o.m_chars, sizeof(m_chars)) == 0;
+  }
+};
+
+namespace rtl {
+
+// Stores a non-trivial key type as a fixed size array
+template <>
+struct snapshot_serializer<std::string> {
+  using stored_type = SnapshotStoredName;
+
+  static bool store(std::string const& in, stored_type* out) {
+    if (in.size() >= sizeof(out->m_chars)) {
+      return false;
+    }
+    std::memset(out->m_chars, 0, sizeof(out->m_chars));
+    std::memcpy(out->m_chars, in.data(), in.size());
+    return true;
+  }
+};
+
+}  // namespace rtl
+
+// A temporary file that is removed again when the test ends
+class SnapshotFile {
+ private:
+  char m_path[32];
+  int m_fd;
+
+ public:
+  SnapshotFile() : m_fd(-1) {
+    std::strcpy(m_path, "/tmp/rtl_snapshotXXXXXX");
+    m_fd = mkstemp(m_path);
+  }
+  ~SnapshotFile() {
+    if (m_fd >= 0) {
+      close(m_fd);
+      unlink(m_path);
+    }
+  }
+
+  int fd() const { return m_fd; }
+  const char* path() const { return m_path; }
+};
+
+TEST_F(SnapshotTest, RoundTripTest) {
+  rtl::unordered_map<uint32_t, SnapshotPoint, rtl::RTAllocatorMT> m(&allocMT);
+  // Enough to resize several times
+  for (uint32_t i = 0U; i < 5000U; i++) {
+    int32_t v = static_cast<int32_t>(i);
+    ASSERT_TRUE(m.put(i * 3U, SnapshotPoint{v, -v}));
+  }
+  for (uint32_t i = 0U; i < 5000U; i += 5U) {
+    m.del(i * 3U);
+  }
+
+  SnapshotFile file;
+  ASSERT_GE(file.fd(), 0);
+  ASSERT_TRUE(m.save_snapshot(file.fd()));
+  ASSERT_TRUE(m.get_state() == decltype(m)::MapState::STABLE);
+
+  rtl::mapped_map<uint32_t, SnapshotPoint> snap;
+  ASSERT_FALSE(snap.is_open());
+  ASSERT_EQ(nullptr, snap.get(3U));
+  ASSERT_TRUE(snap.open(file.path()));
+  ASSERT_TRUE(snap.is_open());
+  ASSERT_EQ(4000U, snap.size());
+  ASSERT_EQ(4000U, snap.get_num_buckets());
+
+  for (uint32_t i = 0U; i < 5000U; i++) {
+    SnapshotPoint const* p = snap.get(i * 3U);
+    if (i % 5U == 0U) {
+      ASSERT_EQ(nullptr, p);
+      continue;
+    }
+    ASSERT_NE(nullptr, p);
+    ASSERT_EQ(static_cast<int32_t>(i), p->m_x);
+    ASSERT_EQ(-static_cast<int32_t>(i), p->m_y);
+    // Not multiples of 3 were never put
+    ASSERT_FALSE(snap.contains(i * 3U + 1U));
+  }
+
+  // Sections start on pages so they can be mapped on their own
+  rtl::snapshot_header header;
+  ASSERT_EQ(static_cast<ssize_t>(sizeof(header)),
+            pread(file.fd(), &header, sizeof(header), 0));
+  ASSERT_EQ(0U, header.m_buckets_offset % rtl::kSnapshotPageSize);
+  ASSERT_EQ(0U, header.m_entries_offset % rtl::kSnapshotPageSize);
+
+  snap.close();
+  ASSERT_FALSE(snap.is_open());
+  ASSERT_EQ(0U, snap.size());
+}
+
+TEST_F(SnapshotTest, PaddingTest) {
+  rtl::unordered_map<uint32_t, uint64_t, rtl::RTAllocatorMT> m(&allocMT);
+  for (uint32_t i = 0U; i < 100U; i++) {
+    ASSERT_TRUE(m.put(i, 0xFFFFFFFFFFFFFFFFULL));
+  }
+
+  SnapshotFile file;
+  ASSERT_TRUE(m.save_snapshot(file.fd()));
+
+  // The bytes between the key and the value are zeroes, not whatever was
+  // on the stack
+  using entry_type = rtl::snapshot_entry<uint32_t, uint64_t>;
+  size_t pad_begin = sizeof(uint32_t);
+  size_t pad_end = offsetof(entry_type, m_value);
+  rtl::snapshot_header header;
+  ASSERT_EQ(static_cast<ssize_t>(sizeof(header)),
+            pread(file.fd(), &header, sizeof(header), 0));
+  for (uint64_t i = 0U; i < header.m_num_entries; i++) {
+    unsigned char raw[sizeof(entry_type)];
+    off_t at = static_cast<off_t>(header.m_entries_offset + i * sizeof(raw));
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(raw)),
+              pread(file.fd(), raw, sizeof(raw), at));
+    for (size_t b = pad_begin; b < pad_end; b++) {
+      ASSERT_EQ(0U, raw[b]);
+    }
+  }
+}
+
+TEST_F(SnapshotTest, EmptyMapTest) {
+  rtl::unordered_map<uint64_t, uint64_t, rtl::RTAllocatorMT> m(&allocMT);
+
+  SnapshotFile file;
+  ASSERT_TRUE(m.save_snapshot(file.fd()));
+
+  rtl::mapped_map<uint64_t, uint64_t> snap;
+  ASSERT_TRUE(snap.open(file.fd()));
+  ASSERT_TRUE(snap.empty());
+  ASSERT_EQ(nullptr, snap.get(0U));
+
+  // Saving again replaces the old snapshot
+  ASSERT_TRUE(m.put(7U, 49U));
+  SnapshotFile other;
+  ASSERT_TRUE(m.save_snapshot(other.fd()));
+  ASSERT_TRUE(snap.open(other.path()));
+  ASSERT_EQ(1U, snap.size());
+  ASSERT_EQ(49U, *snap.get(7U));
+}
+
+TEST_F(SnapshotTest, SerializerTest) {
+  rtl::unordered_map<std::string, uint32_t, rtl::RTAllocatorMT> m(&allocMT);
+  ASSERT_TRUE(m.put(std::string("alpha"), 1U));
+  ASSERT_TRUE(m.put(std::string("beta"), 2U));
+  ASSERT_TRUE(m.put(std::string("gamma"), 3U));
+
+  SnapshotFile file;
+  ASSERT_TRUE(m.save_snapshot(file.fd()));
+
+  rtl::mapped_map<SnapshotStoredName, uint32_t> snap;
+  ASSERT_TRUE(snap.open(file.path()));
+  ASSERT_EQ(3U, snap.size());
+
+  SnapshotStoredName key;
+  ASSERT_TRUE(rtl::snapshot_serializer<std::string>::store("beta", &key));
+  ASSERT_EQ(2U, *snap.get(key));
+  ASSERT_TRUE(rtl::snapshot_serializer<std::string>::store("delta", &key));
+  ASSERT_EQ(nullptr, snap.get(key));
+
+  // A key the serializer can't store fails the save
+  ASSERT_TRUE(m.put(std::string("much too long"), 4U));
+  SnapshotFile bad;
+  ASSERT_FALSE(m.save_snapshot(bad.fd()));
+  ASSERT_FALSE(snap.open(bad.path()));
+}
+
+TEST_F(SnapshotTest, InvalidFileTest) {
+  rtl::unordered_map<uint32_t, uint32_t, rtl::RTAllocatorMT> m(&allocMT);
+  for (uint32_t i = 0U; i < 2000U; i++) {
+    ASSERT_TRUE(m.put(i, i + 1U));
+  }
+
+  rtl::mapped_map<uint32_t, uint32_t> snap;
+  ASSERT_FALSE(snap.open("/nonexistent/rtl_snapshot"));
+
+  // Empty file
+  SnapshotFile empty;
+  ASSERT_FALSE(snap.open(empty.path()));
+
+  SnapshotFile file;
+  ASSERT_TRUE(m.save_snapshot(file.fd()));
+  ASSERT_TRUE(snap.open(file.path()));
+  ASSERT_EQ(2000U, snap.size());
+
+  // Other key or value sizes
+  rtl::mapped_map<uint64_t, uint32_t> wrong_key;
+  ASSERT_FALSE(wrong_key.open(file.path()));
+  rtl::mapped_map<uint32_t, uint64_t> wrong_value;
+  ASSERT_FALSE(wrong_value.open(file.path()));
+
+  // Truncated
+  off_t size = lseek(file.fd(), 0, SEEK_END);
+  ASSERT_EQ(0, ftruncate(file.fd(), size - 1));
+  ASSERT_FALSE(snap.open(file.path()));
+  ASSERT_FALSE(snap.is_open());
+
+  // Bad magic
+  ASSERT_EQ(0, ftruncate(file.fd(), size));
+  uint64_t magic = 0U;
+  ASSERT_EQ(static_cast<ssize_t>(sizeof(magic)),
+            pwrite(file.fd(), &magic, sizeof(magic), 0));
+  ASSERT_FALSE(snap.open(file.path()));
+}
@@ -0,0 +1,198 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rtlcpp/static_map.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <map>
+#include <new>
+#include <random>
+
+#include "rtlcpp/allocator.hpp"
+
+namespace {
+
+// Constant initialized, no allocator and no run time constructor
+rtl::static_map<uint32_t, uint64_t, 64U> g_static_map;
+
+}  // namespace
+
+class StaticMapTest : public ::testing::Test {
+ protected:
+  rtl::MMapMemoryResource mr;
+  rtl::RTAllocatorMT allocMT;
+
+  StaticMapTest() {
+    // You can do set-up work for each test here.
+  }
+
+  ~StaticMapTest() override {
+    // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+    // Code here will be called immediately after the constructor (right
+    // before each test).
+
+    ASSERT_TRUE(mr.init(std::min(static_cast<size_t>(50 * 1024 * 1024),
+                                 rtl_tlsf_maximum_arena_size())));
+
+    ASSERT_TRUE(allocMT.init(mr.get_buf(), mr.get_capacity()));
+  }
+
+  void TearDown() override {
+    // Code here will be called immediately after each test (right
+    // before the destructor).
+
+    allocMT.uninit();
+
+    mr.uninit();
+  }
+};
+
+TEST_F(StaticMapTest, BasicTest) {
+  rtl::static_map<uint32_t, uint64_t, 64U> m;
+  ASSERT_TRUE(m.empty());
+  ASSERT_EQ(64U, m.capacity());
+  ASSERT_EQ(16U, m.max_probe());
+  ASSERT_EQ(nullptr, m.get(1U));
+  ASSERT_FALSE(m.del(1U));
+
+  for (uint32_t i = 0U; i < 32U; i++) {
+    ASSERT_TRUE(m.put(i, i * 10U));
+  }
+  ASSERT_EQ(32U, m.size());
+  for (uint32_t i = 0U; i < 32U; i++) {
+    ASSERT_NE(nullptr, m.get(i));
+    ASSERT_EQ(i * 10U, *m.get(i));
+  }
+  ASSERT_FALSE(m.contains(32U));
+
+  // Overwrites
+  ASSERT_TRUE(m.put(5U, 7U));
+  ASSERT_EQ(32U, m.size());
+  ASSERT_EQ(7U, *m.get(5U));
+  *m.get(5U) = 8U;
+  rtl::static_map<uint32_t, uint64_t, 64U> const& cm = m;
+  ASSERT_EQ(8U, *cm.get(5U));
+
+  ASSERT_TRUE(m.del(5U));
+  ASSERT_FALSE(m.del(5U));
+  ASSERT_FALSE(m.contains(5U));
+  ASSERT_EQ(31U, m.size());
+
+  size_t visited = 0U;
+  m.for_each([&visited](uint32_t const& k, uint64_t& v) {
+    EXPECT_EQ(k * 10U, v);
+    visited++;
+  });
+  ASSERT_EQ(31U, visited);
+
+  m.delete_all_keys();
+  ASSERT_TRUE(m.empty());
+  ASSERT_FALSE(m.contains(1U));
+}
+
+TEST_F(StaticMapTest, StaticStorageTest) {
+  ASSERT_TRUE(g_static_map.empty());
+  ASSERT_TRUE(g_static_map.put(3U, 9U));
+  ASSERT_EQ(9U, *g_static_map.get(3U));
+  g_static_map.delete_all_keys();
+}
+
+TEST_F(StaticMapTest, ArenaStorageTest) {
+  // The map is one flat object, so it can just as well live in arena memory
+  using Map = rtl::static_map<uint32_t, uint64_t, 256U>;
+  void* mem = allocMT.allocate(sizeof(Map));
+  ASSERT_NE(nullptr, mem);
+  Map* m = new (mem) Map();
+  for (uint32_t i = 0U; i < 100U; i++) {
+    ASSERT_TRUE(m->put(i, i + 1U));
+  }
+  ASSERT_EQ(100U, m->size());
+  ASSERT_EQ(51U, *m->get(50U));
+  m->~Map();
+  allocMT.deallocate(mem);
+}
+
+TEST_F(StaticMapTest, BoundedProbeTest) {
+  rtl::static_map<uint32_t, uint32_t, 8U, 3U> m;
+  ASSERT_EQ(3U, m.max_probe());
+
+  // Find four keys with the same home slot
+  uint32_t same[4];
+  size_t found = 0U;
+  rtl::hash<uint32_t> hasher;
+  uint32_t home = hasher(0U) & 7U;
+  for (uint32_t k = 0U; found < 4U; k++) {
+    if ((hasher(k) & 7U) == home) {
+      same[found++] = k;
+    }
+  }
+
+  ASSERT_TRUE(m.put(same[0], 0U));
+  ASSERT_TRUE(m.put(same[1], 1U));
+  ASSERT_TRUE(m.put(same[2], 2U));
+  // Would be 3 slots past home
+  ASSERT_FALSE(m.put(same[3], 3U));
+  ASSERT_EQ(3U, m.size());
+  // Overwriting never needs a new slot
+  ASSERT_TRUE(m.put(same[2], 20U));
+
+  // Deleting the first shifts the others back, making room again
+  ASSERT_TRUE(m.del(same[0]));
+  ASSERT_EQ(1U, *m.get(same[1]));
+  ASSERT_EQ(20U, *m.get(same[2]));
+  ASSERT_TRUE(m.put(same[3], 3U));
+  ASSERT_EQ(3U, *m.get(same[3]));
+}
+
+TEST_F(StaticMapTest, RandomTest) {
+  rtl::static_map<uint64_t, uint32_t, 1024U> m;
+  std::map<uint64_t, uint32_t> ref;
+  std::mt19937_64 gen(7U);
+
+  for (uint32_t i = 0U; i < 200000U; i++) {
+    uint64_t key = gen() % 1500U;
+    if (gen() % 2U == 0U) {
+      bool put = m.put(key, i);
+      if (put) {
+        ref[key] = i;
+      } else {
+        // Only fails on long runs, which need a fairly full map
+        ASSERT_EQ(0U, ref.count(key));
+        ASSERT_GT(m.size(), 512U);
+      }
+    } else {
+      ASSERT_EQ(ref.erase(key) == 1U, m.del(key));
+    }
+    ASSERT_EQ(ref.size(), m.size());
+  }
+
+  for (uint64_t key = 0U; key < 1500U; key++) {
+    auto it = ref.find(key);
+    uint32_t const* v = m.get(key);
+    if (it == ref.end()) {
+      ASSERT_EQ(nullptr, v);
+    } else {
+      ASSERT_NE(nullptr, v);
+      ASSERT_EQ(it->second, *v);
+    }
+  }
+}
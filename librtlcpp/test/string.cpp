@@ -0,0 +1,301 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rtlcpp/string.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "rtlcpp/map.hpp"
+#include "test_allocators.hpp"
+
+class StringTest : public ::testing::Test {
+ protected:
+  rtl::MMapMemoryResource mr;
+  rtl::RTAllocatorMT allocMT;
+
+  StringTest() {
+    // You can do set-up work for each test here.
+  }
+
+  ~StringTest() override {
+    // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+    // Code here will be called immediately after the constructor (right
+    // before each test).
+
+    ASSERT_TRUE(mr.init(std::min(static_cast<size_t>(50 * 1024 * 1024),
+                                 rtl_tlsf_maximum_arena_size())));
+
+    ASSERT_TRUE(allocMT.init(mr.get_buf(), mr.get_capacity()));
+  }
+
+  void TearDown() override {
+    // Code here will be called immediately after each test (right
+    // before the destructor).
+
+    allocMT.uninit();
+
+    mr.uninit();
+  }
+};
+
+// Counts allocations so the tests can check when the heap is used
+using TestString = rtl::basic_string<rtl_test::CountingAllocator>;
+
+TEST_F(StringTest, InlineBoundaryTest) {
+  rtl_test::CountingAllocator a;
+  {
+    TestString s(&a);
+    ASSERT_TRUE(s.empty());
+    ASSERT_STREQ("", s.c_str());
+
+    std::string inline_max(TestString::kInlineCapacity, 'x');
+    ASSERT_TRUE(s.assign(inline_max.c_str()));
+    ASSERT_TRUE(s.is_inline());
+    ASSERT_EQ(TestString::kInlineCapacity, s.size());
+    ASSERT_STREQ(inline_max.c_str(), s.c_str());
+    ASSERT_EQ(0U, a.allocations);
+
+    ASSERT_TRUE(s.push_back('y'));
+    ASSERT_FALSE(s.is_inline());
+    ASSERT_EQ(TestString::kInlineCapacity + 1U, s.size());
+    ASSERT_STREQ((inline_max + "y").c_str(), s.c_str());
+    ASSERT_EQ(1U, a.allocations);
+  }
+  ASSERT_EQ(0U, a.live);
+}
+
+TEST_F(StringTest, GrowthTest) {
+  rtl_test::CountingAllocator a;
+  {
+    TestString s(&a);
+    std::string expected;
+    for (int i = 0; i < 10000; i++) {
+      char c = static_cast<char>('a' + i % 26);
+      ASSERT_TRUE(s.push_back(c));
+      expected.push_back(c);
+    }
+    ASSERT_EQ(expected.size(), s.size());
+    ASSERT_STREQ(expected.c_str(), s.c_str());
+    // Geometric growth, not one allocation per character
+    ASSERT_LT(a.allocations, 20U);
+
+    // Clearing keeps the buffer around
+    size_t cap = s.capacity();
+    s.clear();
+    ASSERT_TRUE(s.empty());
+    ASSERT_EQ(cap, s.capacity());
+    ASSERT_TRUE(s.append("abc", 3U));
+    ASSERT_TRUE(s == "abc");
+
+    ASSERT_TRUE(s.reserve(cap + 100U));
+    ASSERT_EQ(cap + 100U, s.capacity());
+    ASSERT_TRUE(s == "abc");
+    ASSERT_TRUE(s.reserve(1U));
+    ASSERT_EQ(cap + 100U, s.capacity());
+  }
+  ASSERT_EQ(0U, a.live);
+}
+
+TEST_F(StringTest, EmbeddedNullTest) {
+  rtl::string s(&allocMT);
+  ASSERT_TRUE(s.assign("a\0b", 3U));
+  ASSERT_EQ(3U, s.size());
+  ASSERT_EQ('\0', s[1]);
+  ASSERT_EQ('b', s[2]);
+  ASSERT_FALSE(s == "a");
+}
+
+TEST_F(StringTest, MoveTest) {
+  rtl_test::CountingAllocator a;
+  {
+    TestString small(&a);
+    ASSERT_TRUE(small.assign("short"));
+    TestString small2(std::move(small));
+    ASSERT_TRUE(small2 == "short");
+    ASSERT_TRUE(small.empty());
+
+    TestString big(&a);
+    ASSERT_TRUE(big.assign("a string that does not fit inline"));
+    const char* buf = big.c_str();
+    TestString big2(std::move(big));
+    ASSERT_EQ(buf, big2.c_str());
+    ASSERT_TRUE(big.empty());
+    ASSERT_TRUE(big.is_inline());
+
+    // Move assignment frees the old heap buffer
+    ASSERT_TRUE(big.assign("another string that does not fit"));
+    big2 = std::move(small2);
+    ASSERT_TRUE(big2 == "short");
+    ASSERT_EQ(1U, a.live);
+  }
+  ASSERT_EQ(0U, a.live);
+}
+
+TEST_F(StringTest, AllocationFailureTest) {
+  rtl_test::FailingAllocator a;
+  rtl::basic_string<rtl_test::FailingAllocator> s(&a);
+  ASSERT_TRUE(s.assign("fits inline"));
+
+  std::string big(100U, 'z');
+  ASSERT_FALSE(s.assign(big.c_str()));
+  ASSERT_TRUE(s == "fits inline");
+  ASSERT_FALSE(s.append(big.c_str()));
+  ASSERT_TRUE(s == "fits inline");
+  ASSERT_FALSE(s.reserve(100U));
+  ASSERT_EQ(rtl::basic_string<rtl_test::FailingAllocator>::kInlineCapacity,
+            s.capacity());
+}
+
+TEST_F(StringTest, CompareAndHashTest) {
+  rtl::string s1(&allocMT);
+  rtl::string s2(&allocMT);
+  ASSERT_TRUE(s1.assign("apple"));
+  ASSERT_TRUE(s2.assign("apple"));
+  ASSERT_TRUE(s1 == s2);
+  ASSERT_FALSE(s1 != s2);
+
+  rtl::hash<rtl::string> h;
+  ASSERT_EQ(h(s1), h(s2));
+  ASSERT_EQ(rtl::fnv1a("apple"), h(s1));
+
+  ASSERT_TRUE(s2.append("s"));
+  ASSERT_TRUE(s1 != s2);
+  ASSERT_TRUE(s1 < s2);
+  ASSERT_FALSE(s2 < s1);
+  ASSERT_LT(s1.compare("banana"), 0);
+  ASSERT_GT(s1.compare("app"), 0);
+  ASSERT_EQ(0, s1.compare("apple"));
+}
+
+TEST_F(StringTest, MapKeyTest) {
+  rtl_test::CountingAllocator a;
+  {
+    rtl::unordered_map<TestString, int, rtl_test::CountingAllocator> m(&a, 20);
+    for (int i = 0; i < 1000; i++) {
+      TestString key(&a);
+      ASSERT_TRUE(key.assign(std::to_string(i).c_str()));
+      ASSERT_TRUE(m.put(std::move(key), i));
+    }
+
+    TestString probe(&a);
+    for (int i = 0; i < 1000; i++) {
+      ASSERT_TRUE(probe.assign(std::to_string(i).c_str()));
+      int* v = m.get(probe);
+      ASSERT_NE(nullptr, v);
+      ASSERT_EQ(i, *v);
+    }
+
+    // Lookups and overwrites don't copy the key
+    size_t before = a.allocations;
+    ASSERT_TRUE(probe.assign("500"));
+    ASSERT_NE(nullptr, m.get(probe));
+    ASSERT_TRUE(m.del(probe));
+    ASSERT_EQ(nullptr, m.get(probe));
+    ASSERT_EQ(before, a.allocations);
+  }
+  ASSERT_EQ(0U, a.live);
+}
+
+TEST_F(StringTest, MapKeyTransferTest) {
+  rtl::unordered_map<rtl::string, int> m(&allocMT);
+  rtl::hash<rtl::string> h;
+  rtl::string key(&allocMT);
+  // rtl::string can't be copied, every put moves in a new key
+  auto make_key = [this](int i) {
+    rtl::string k(&allocMT);
+    EXPECT_TRUE(k.assign(std::to_string(i).c_str()));
+    return k;
+  };
+
+  // Go through a first resize, after that new entries are appended to the
+  // back of their bucket
+  int n = 0;
+  while (m.get_state() != decltype(m)::MapState::TRANSFER) {
+    ASSERT_TRUE(m.put(make_key(n), n));
+    n++;
+  }
+  ASSERT_TRUE(m.finalize());
+
+  // A moved from key is empty, make sure a real empty key survives
+  ASSERT_TRUE(m.put(rtl::string(&allocMT), -1));
+  const int first_after_empty = n;
+
+  size_t main_buckets = m.get_num_buckets();
+  while (m.get_state() != decltype(m)::MapState::TRANSFER) {
+    main_buckets = m.get_num_buckets();
+    ASSERT_TRUE(m.put(make_key(n), n));
+    n++;
+  }
+
+  // Buckets are transferred back to front, so the old entry of a key added
+  // after the empty key in the same bucket is transferred before it
+  const size_t empty_bucket = h(key) % main_buckets;
+  int same_bucket = -1;
+  for (int i = first_after_empty; i < n && same_bucket < 0; i++) {
+    if (h(make_key(i)) % main_buckets == empty_bucket) {
+      same_bucket = i;
+    }
+  }
+  ASSERT_NE(-1, same_bucket);
+  ASSERT_TRUE(m.put(make_key(same_bucket), same_bucket + n));
+
+  // And everything else that is still waiting in the old table
+  for (int i = 0; i < n; i++) {
+    ASSERT_TRUE(m.put(make_key(i), i + n));
+  }
+
+  ASSERT_TRUE(m.finalize());
+  ASSERT_TRUE(m.get_state() == decltype(m)::MapState::STABLE);
+
+  key.clear();
+  int* v = m.get(key);
+  ASSERT_NE(nullptr, v);
+  ASSERT_EQ(-1, *v);
+  for (int i = 0; i < n; i++) {
+    ASSERT_TRUE(key.assign(std::to_string(i).c_str()));
+    v = m.get(key);
+    ASSERT_NE(nullptr, v);
+    ASSERT_EQ(i + n, *v);
+  }
+
+  // Same again with the empty key itself overwritten during the transfer
+  while (m.get_state() != decltype(m)::MapState::TRANSFER) {
+    ASSERT_TRUE(m.put(make_key(n), n));
+    n++;
+  }
+  ASSERT_TRUE(m.put(rtl::string(&allocMT), -2));
+  for (int i = 0; i < n; i++) {
+    ASSERT_TRUE(m.put(make_key(i), i));
+  }
+  ASSERT_TRUE(m.finalize());
+
+  key.clear();
+  v = m.get(key);
+  ASSERT_NE(nullptr, v);
+  ASSERT_EQ(-2, *v);
+  for (int i = 0; i < n; i++) {
+    ASSERT_TRUE(key.assign(std::to_string(i).c_str()));
+    v = m.get(key);
+    ASSERT_NE(nullptr, v);
+    ASSERT_EQ(i, *v);
+  }
+}
@@ -0,0 +1,57 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RTLCPP_TEST_ALLOCATORS_HPP
+#define RTLCPP_TEST_ALLOCATORS_HPP
+
+#include <cstddef>
+#include <cstdlib>
+
+namespace rtl_test {
+
+/*!
+ * A malloc backed allocator that keeps track of what it handed out, for
+ * tests that check a container's allocation behavior.  Allocations start
+ * failing once budget reaches zero.
+ */
+struct CountingAllocator {
+  size_t allocations = 0U;
+  size_t live = 0U;
+  size_t budget = static_cast<size_t>(-1);
+
+  void* allocate(size_t sz) {
+    if (budget == 0U) {
+      return nullptr;
+    }
+    budget--;
+    allocations++;
+    live++;
+    return std::malloc(sz);
+  }
+
+  void deallocate(void* p) {
+    if (p) live--;
+    std::free(p);
+  }
+};
+
+//! Fails every allocation
+struct FailingAllocator {
+  void* allocate(size_t) { return nullptr; }
+  void deallocate(void*) {}
+};
+
+}  // namespace rtl_test
+
+#endif  // RTLCPP_TEST_ALLOCATORS_HPP
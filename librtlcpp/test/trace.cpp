@@ -0,0 +1,322 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rtlcpp/trace.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+class TraceTest : public ::testing::Test {
+ protected:
+  rtl::MMapMemoryResource mr;
+  rtl::RTAllocatorMT allocMT;
+
+  TraceTest() {
+    // You can do set-up work for each test here.
+  }
+
+  ~TraceTest() override {
+    // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+    // Code here will be called immediately after the constructor (right
+    // before each test).
+
+    ASSERT_TRUE(mr.init(std::min(static_cast<size_t>(50 * 1024 * 1024),
+                                 rtl_tlsf_maximum_arena_size())));
+
+    ASSERT_TRUE(allocMT.init(mr.get_buf(), mr.get_capacity()));
+  }
+
+  void TearDown() override {
+    // Code here will be called immediately after each test (right
+    // before the destructor).
+
+    allocMT.uninit();
+
+    mr.uninit();
+  }
+};
+
+static std::string read_file(std::string const& path) {
+  std::ifstream in(path.c_str());
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+static size_t count_of(std::string const& haystack, std::string const& needle) {
+  size_t n = 0U;
+  for (size_t pos = haystack.find(needle); pos != std::string::npos;
+       pos = haystack.find(needle, pos + needle.size())) {
+    n++;
+  }
+  return n;
+}
+
+TEST_F(TraceTest, SmokeTest) {
+  std::string path = ::testing::TempDir() + "rtl_trace_smoke.rtltrace";
+  std::string json = path + ".json";
+
+  uint16_t work = rtl::trace::register_event("work");
+  uint16_t depth = rtl::trace::register_event("queue \"depth\"");
+  ASSERT_EQ(work, rtl::trace::register_event("work"));
+  ASSERT_NE(work, depth);
+
+  {
+    rtl::trace::Tracer tracer(&allocMT);
+    ASSERT_FALSE(tracer.open(nullptr));
+    ASSERT_TRUE(tracer.open(path.c_str()));
+    ASSERT_FALSE(tracer.open(path.c_str()));
+
+    size_t id = 0U;
+    ASSERT_FALSE(tracer.register_thread("main", nullptr));
+    ASSERT_TRUE(tracer.register_thread("main", &id));
+
+    ASSERT_TRUE(tracer.record(id, work, rtl::trace::event_type::kBegin, 7U));
+    ASSERT_TRUE(
+        tracer.record(id, depth, rtl::trace::event_type::kCounter, 42U));
+    ASSERT_TRUE(tracer.record(id, work, rtl::trace::event_type::kInstant, 1U));
+    ASSERT_TRUE(tracer.record(id, work, rtl::trace::event_type::kEnd, 0U));
+
+    ASSERT_EQ(4U, tracer.drain());
+    ASSERT_EQ(0U, tracer.drain());
+    ASSERT_EQ(4U, tracer.events_written());
+    ASSERT_EQ(0U, tracer.dropped());
+
+    tracer.unregister_thread(id);
+    tracer.close();
+  }
+
+  ASSERT_TRUE(rtl::trace::trace_to_chrome_json(path.c_str(), json.c_str()));
+  std::string out = read_file(json);
+
+  ASSERT_EQ(1U, count_of(out, "\"traceEvents\""));
+  ASSERT_EQ(1U, count_of(out, "\"thread_name\""));
+  ASSERT_EQ(1U, count_of(out, "{\"name\": \"main\"}"));
+  ASSERT_EQ(1U, count_of(out, "\"ph\": \"B\""));
+  ASSERT_EQ(1U, count_of(out, "\"ph\": \"E\""));
+  ASSERT_EQ(1U, count_of(out, "\"ph\": \"i\""));
+  ASSERT_EQ(1U, count_of(out, "\"ph\": \"C\""));
+  ASSERT_EQ(1U, count_of(out, "\"queue \\\"depth\\\"\""));
+  ASSERT_EQ(1U, count_of(out, "\"args\": {\"value\": 42}"));
+  ASSERT_EQ(1U, count_of(out, "\"args\": {\"arg\": 7}"));
+
+  // Not a trace file
+  ASSERT_FALSE(rtl::trace::trace_to_chrome_json(json.c_str(), path.c_str()));
+  ASSERT_FALSE(
+      rtl::trace::trace_to_chrome_json("/nonexistent/x", json.c_str()));
+
+  std::remove(path.c_str());
+  std::remove(json.c_str());
+}
+
+TEST_F(TraceTest, DroppedTest) {
+  uint16_t ev = rtl::trace::register_event("dropped");
+  rtl::trace::Tracer tracer(&allocMT, 4U);
+
+  size_t id = 0U;
+  ASSERT_TRUE(tracer.register_thread("t", &id));
+
+  size_t recorded = 0U;
+  for (size_t i = 0U; i < 10U; i++) {
+    if (tracer.record(id, ev, rtl::trace::event_type::kInstant, i)) {
+      recorded++;
+    }
+  }
+
+  // Without a file the events are discarded
+  ASSERT_EQ(4U, recorded);
+  ASSERT_EQ(6U, tracer.dropped());
+  ASSERT_EQ(4U, tracer.drain());
+  ASSERT_EQ(0U, tracer.events_written());
+
+  ASSERT_TRUE(tracer.record(id, ev, rtl::trace::event_type::kInstant, 0U));
+}
+
+TEST_F(TraceTest, SlotsTest) {
+  rtl::trace::Tracer tracer(&allocMT, 16U);
+
+  size_t ids[rtl::trace::Tracer::kMaxThreads];
+  for (size_t i = 0U; i < rtl::trace::Tracer::kMaxThreads; i++) {
+    ASSERT_TRUE(tracer.register_thread("t", &ids[i]));
+  }
+
+  size_t extra = 0U;
+  ASSERT_FALSE(tracer.register_thread("t", &extra));
+
+  // The slot is only released by the drain
+  tracer.unregister_thread(ids[3]);
+  ASSERT_FALSE(tracer.register_thread("t", &extra));
+  (void)tracer.drain();
+  ASSERT_TRUE(tracer.register_thread("t", &extra));
+  ASSERT_EQ(ids[3], extra);
+}
+
+TEST_F(TraceTest, UnregisteredTest) {
+  rtl::trace::Tracer tracer(&allocMT, 16U);
+
+  size_t ids[rtl::trace::Tracer::kMaxThreads];
+  for (size_t i = 0U; i < rtl::trace::Tracer::kMaxThreads; i++) {
+    ASSERT_TRUE(tracer.register_thread("t", &ids[i]));
+  }
+
+  rtl::trace::set_global_tracer(&tracer);
+
+  std::thread([&tracer, &ids]() {
+    // With every slot taken the events of a new thread are counted as
+    // dropped
+    for (size_t i = 0U; i < 10U; i++) {
+      RTL_TRACE_INSTANT("unregistered", i);
+    }
+    ASSERT_EQ(10U, tracer.dropped());
+    ASSERT_FALSE(rtl::trace::register_current_thread("late"));
+
+    // The failure is cached, a free slot is only used after an explicit
+    // registration
+    tracer.unregister_thread(ids[0]);
+    (void)tracer.drain();
+    RTL_TRACE_INSTANT("unregistered", 0U);
+    ASSERT_EQ(11U, tracer.dropped());
+
+    ASSERT_TRUE(rtl::trace::register_current_thread("late"));
+    RTL_TRACE_INSTANT("unregistered", 1U);
+  }).join();
+
+  ASSERT_EQ(11U, tracer.dropped());
+  ASSERT_EQ(1U, tracer.drain());
+
+  rtl::trace::set_global_tracer(nullptr);
+}
+
+TEST_F(TraceTest, MacroTest) {
+  constexpr size_t kNumThreads = 4U;
+  constexpr size_t kNumScopes = 1000U;
+
+  std::string path = ::testing::TempDir() + "rtl_trace_macro.rtltrace";
+  std::string json = path + ".json";
+
+  // Without a global tracer the macros do nothing
+  ASSERT_EQ(nullptr, rtl::trace::global_tracer());
+  ASSERT_FALSE(rtl::trace::register_current_thread("nothing"));
+  { RTL_TRACE_SCOPE("disabled"); }
+
+  rtl::trace::Tracer tracer(&allocMT, 8192U);
+  ASSERT_TRUE(tracer.open(path.c_str()));
+  tracer.start(std::chrono::microseconds(100));
+  rtl::trace::set_global_tracer(&tracer);
+
+  std::vector<std::thread> threads;
+  for (size_t t = 0U; t < kNumThreads; t++) {
+    threads.emplace_back([t]() {
+      // Half of the threads register themselves under a name
+      if (t % 2U == 0U) {
+        rtl::trace::register_current_thread("worker");
+      }
+      for (size_t i = 0U; i < kNumScopes; i++) {
+        RTL_TRACE_SCOPE_ARG("outer", i);
+        {
+          RTL_TRACE_SCOPE("inner");
+          RTL_TRACE_COUNTER("count", i);
+        }
+        RTL_TRACE_INSTANT("tick", i);
+
+        // Give the drain a chance to keep up so nothing is dropped
+        if (i % 8U == 0U) {
+          std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+      }
+    });
+  }
+
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  rtl::trace::set_global_tracer(nullptr);
+  tracer.close();
+
+  uint64_t expected = kNumThreads * kNumScopes * 6U;
+  ASSERT_EQ(expected, tracer.events_written() + tracer.dropped());
+
+  ASSERT_TRUE(rtl::trace::trace_to_chrome_json(path.c_str(), json.c_str()));
+  std::string out = read_file(json);
+
+  ASSERT_EQ(count_of(out, "\"ph\": \"B\""), count_of(out, "\"ph\": \"E\""));
+  ASSERT_EQ(tracer.events_written(),
+            count_of(out, "\"ph\": \"B\"") + count_of(out, "\"ph\": \"E\"") +
+                count_of(out, "\"ph\": \"C\"") +
+                count_of(out, "\"ph\": \"i\""));
+  ASSERT_EQ(kNumThreads, count_of(out, "\"thread_name\""));
+  ASSERT_EQ(kNumThreads / 2U, count_of(out, "{\"name\": \"worker\"}"));
+  ASSERT_EQ(0U, count_of(out, "\"disabled\""));
+
+  std::remove(path.c_str());
+  std::remove(json.c_str());
+}
+
+TEST_F(TraceTest, RestartTest) {
+  constexpr size_t kNumEvents = 100U;
+
+  uint16_t ev = rtl::trace::register_event("restart");
+  rtl::trace::Tracer tracer(&allocMT, 16U);
+
+  // Closing a tracer that was never started must not stop a later start()
+  tracer.close();
+
+  size_t id = 0U;
+  ASSERT_TRUE(tracer.register_thread("main", &id));
+
+  for (size_t run = 0U; run < 2U; run++) {
+    std::string path = ::testing::TempDir() + "rtl_trace_restart_" +
+                       std::to_string(run) + ".rtltrace";
+    std::string json = path + ".json";
+
+    uint64_t before = tracer.events_written();
+    ASSERT_TRUE(tracer.open(path.c_str()));
+    tracer.start(std::chrono::microseconds(100));
+
+    // The ring only holds 16 events so this relies on the drain thread
+    for (size_t i = 0U; i < kNumEvents; i++) {
+      size_t tries = 0U;
+      while (!tracer.record(id, ev, rtl::trace::event_type::kInstant, i)) {
+        ASSERT_LT(++tries, 10000U) << "the drain thread is not running";
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+    }
+
+    tracer.close();
+    ASSERT_EQ(kNumEvents, tracer.events_written() - before);
+
+    ASSERT_TRUE(rtl::trace::trace_to_chrome_json(path.c_str(), json.c_str()));
+    std::string out = read_file(json);
+    ASSERT_EQ(kNumEvents, count_of(out, "\"ph\": \"i\""));
+    ASSERT_EQ(1U, count_of(out, "{\"name\": \"main\"}"));
+
+    std::remove(path.c_str());
+    std::remove(json.c_str());
+  }
+
+  tracer.unregister_thread(id);
+}
@@ -75,4 +75,27 @@ TEST_F(UtilityTest, PowerOf2PrimeTest) {
   ASSERT_EQ(rtl::get_prime_power_of_2(31), 2147483659);
   ASSERT_EQ(rtl::get_prime_power_of_2(32), 0);
 
-}
\ No newline at end of file
+}
+
+TEST_F(UtilityTest, CycleClockTest) {
+  rtl::cycle_clock::calibrate();
+  ASSERT_GT(rtl::cycle_clock::frequency(), 0.0);
+
+  uint64_t t0 = rtl::cycle_clock::start();
+  uint64_t ref0 = rtl::cycle_clock::reference_ns();
+  uint64_t ref1 = ref0;
+  while (ref1 - ref0 < 20000000U) {
+    ref1 = rtl::cycle_clock::reference_ns();
+  }
+  uint64_t t1 = rtl::cycle_clock::stop();
+  ASSERT_GE(t1, t0);
+
+  // Within 10% of the reference clock over 20 ms
+  double ns = rtl::cycle_clock::to_ns(t1 - t0);
+  double ref_ns = static_cast<double>(ref1 - ref0);
+  ASSERT_GT(ns, ref_ns * 0.9);
+  ASSERT_LT(ns, ref_ns * 1.1 + 1000000.0);
+
+  uint64_t ticks = rtl::cycle_clock::from_ns(1000000.0);
+  ASSERT_NEAR(rtl::cycle_clock::to_ns(ticks), 1000000.0, 1000.0);
+}
@@ -0,0 +1,37 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Converts a trace file written by rtl::trace::Tracer to the Chrome trace
+// event JSON format, which can be loaded in chrome://tracing or
+// ui.perfetto.dev
+
+#include <cstdlib>
+#include <iostream>
+
+#include "rtlcpp/trace.hpp"
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <trace file> <output json>"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (!rtl::trace::trace_to_chrome_json(argv[1], argv[2])) {
+    std::cerr << "Could not convert " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,676 @@
+// Copyright (c) 2023. Akiscode
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rtlcpp/trace.hpp"
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace rtl {
+namespace trace {
+
+// -------------------------------------------
+// Trace file format
+//
+// A file header followed by chunks, each chunk is a chunk_header followed
+// by size bytes of payload.  All values are in host byte order.
+
+namespace {
+
+const char kMagic[8] = {'R', 'T', 'L', 'T', 'R', 'A', 'C', 'E'};
+const uint32_t kVersion = 1U;
+
+enum ChunkType : uint32_t {
+  kEventsChunk = 1U,
+  kThreadNameChunk = 2U,
+  kEventNameChunk = 3U,
+  kClockChunk = 4U,
+};
+
+struct file_header {
+  char m_magic[8];
+  uint32_t m_version;
+  uint32_t m_event_size;
+};
+
+struct chunk_header {
+  uint32_t m_type;
+  uint32_t m_size;
+};
+
+struct name_record {
+  uint32_t m_id;
+  char m_name[kMaxNameLength + 1U];
+};
+
+// Two points in time on both clocks, the later the more precise
+struct clock_record {
+  uint64_t m_timestamp0;
+  uint64_t m_ns0;
+  uint64_t m_timestamp1;
+  uint64_t m_ns1;
+};
+
+// Events are drained in batches of this many
+const size_t kDrainBatch = 256U;
+
+void copy_name(char* dst, const char* src) {
+  std::strncpy(dst, src, kMaxNameLength);
+  dst[kMaxNameLength] = '\0';
+}
+
+// -------------------------------------------
+// Event names and the global tracer
+
+std::mutex g_event_mtx;
+const char* g_event_names[kMaxEvents];
+std::atomic<uint16_t> g_num_events(0U);
+
+std::atomic<Tracer*> g_tracer(nullptr);
+
+// Cached with the tracer when registering the thread failed
+const size_t kNoSlot = Tracer::kMaxThreads;
+
+struct thread_cache {
+  Tracer* m_tracer;
+  size_t m_id;
+
+  ~thread_cache() {
+    if (m_tracer != nullptr && m_id != kNoSlot &&
+        m_tracer == global_tracer()) {
+      m_tracer->unregister_thread(m_id);
+    }
+  }
+};
+
+thread_local thread_cache t_cache = {nullptr, 0U};
+
+bool register_with(Tracer* t, const char* name) {
+  size_t id = 0U;
+  if (!t->register_thread(name, &id)) {
+    return false;
+  }
+  t_cache.m_tracer = t;
+  t_cache.m_id = id;
+  return true;
+}
+
+}  // namespace
+
+uint16_t register_event(const char* name) {
+  std::lock_guard<std::mutex> lck(g_event_mtx);
+
+  uint16_t n = g_num_events.load(std::memory_order_relaxed);
+  for (uint16_t i = 0U; i < n; i++) {
+    if (g_event_names[i] == name) {
+      return i;
+    }
+  }
+
+  if (n == kMaxEvents) {
+    return kInvalidEvent;
+  }
+
+  g_event_names[n] = name;
+  // Publishes the name to the draining thread
+  g_num_events.store(static_cast<uint16_t>(n + 1U), std::memory_order_release);
+  return n;
+}
+
+Tracer* global_tracer() { return g_tracer.load(std::memory_order_acquire); }
+
+void set_global_tracer(Tracer* tracer) {
+  g_tracer.store(tracer, std::memory_order_release);
+}
+
+bool register_current_thread(const char* name) {
+  Tracer* t = global_tracer();
+  if (t == nullptr) {
+    return false;
+  }
+  if (t_cache.m_tracer == t && t_cache.m_id != kNoSlot) {
+    return true;
+  }
+  return register_with(t, name);
+}
+
+namespace detail {
+
+void record_global(uint16_t event_id, event_type type, uint64_t arg) {
+  Tracer* t = global_tracer();
+  if (t == nullptr || event_id == kInvalidEvent) {
+    return;
+  }
+
+  if (t_cache.m_tracer != t) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "thread-%ld",
+                  static_cast<long>(syscall(SYS_gettid)));
+    if (!register_with(t, name)) {
+      // Don't retry on every event, that is a system call and a scan of
+      // all the slots on the real time path
+      t_cache.m_tracer = t;
+      t_cache.m_id = kNoSlot;
+    }
+  }
+
+  if (t_cache.m_id == kNoSlot) {
+    t->drop_unregistered();
+    return;
+  }
+
+  (void)t->record(t_cache.m_id, event_id, type, arg);
+}
+
+}  // namespace detail
+
+// -------------------------------------------
+// Tracer
+
+Tracer::Tracer(RTDefaultAllocator* alloc, uint32_t events_per_thread)
+    : m_alloc(alloc),
+      // One byte of the ring buffer is never used
+      m_buffer_size(events_per_thread * static_cast<uint32_t>(sizeof(event)) +
+                    1U),
+      m_slots(),
+      m_unregistered_dropped(0U),
+      m_drain_mtx(),
+      m_file(nullptr),
+      m_names_written(0U),
+      m_events_written(0U),
+      m_clock_timestamp(0U),
+      m_clock_ns(0U),
+      m_thread(),
+      m_thread_mtx(),
+      m_thread_cv(),
+      m_shutdown(false),
+      m_options() {
+  assert(events_per_thread > 0U);
+}
+
+Tracer::~Tracer() {
+  if (global_tracer() == this) {
+    set_global_tracer(nullptr);
+  }
+
+  close();
+
+  for (Slot& s : m_slots) {
+    if (s.m_buf != nullptr) {
+      release_slot(s);
+    }
+  }
+}
+
+bool Tracer::open(const char* path) {
+  std::lock_guard<std::mutex> lck(m_drain_mtx);
+  if (m_file != nullptr || path == nullptr) {
+    return false;
+  }
+
+  m_file = std::fopen(path, "wb");
+  if (m_file == nullptr) {
+    return false;
+  }
+
+  file_header h;
+  std::memcpy(h.m_magic, kMagic, sizeof(kMagic));
+  h.m_version = kVersion;
+  h.m_event_size = static_cast<uint32_t>(sizeof(event));
+  if (std::fwrite(&h, sizeof(h), 1U, m_file) != 1U) {
+    std::fclose(m_file);
+    m_file = nullptr;
+    return false;
+  }
+
+  // Names are written again for every file
+  m_names_written = 0U;
+  for (Slot& s : m_slots) {
+    s.m_name_written = false;
+  }
+
+  // Calibrate the timestamp counter, close() writes a more precise clock
+  // record covering the whole trace
+  m_clock_timestamp = cycle_clock::now();
+  m_clock_ns = cycle_clock::reference_ns();
+  while (cycle_clock::reference_ns() - m_clock_ns < 10000000U) {
+    asm_cpu_relax();
+  }
+
+  return write_clock();
+}
+
+void Tracer::close() {
+  stop();
+  (void)drain();
+
+  std::lock_guard<std::mutex> lck(m_drain_mtx);
+  if (m_file != nullptr) {
+    (void)write_clock();
+    std::fclose(m_file);
+    m_file = nullptr;
+  }
+}
+
+void Tracer::start(std::chrono::microseconds period) {
+  assert(period != std::chrono::microseconds(0));
+  start(PeriodicTaskOptions(period));
+}
+
+void Tracer::start(PeriodicTaskOptions options) {
+  if (m_thread.joinable()) {
+    return;
+  }
+
+  // A previous stop() or close() left the flag set
+  {
+    std::lock_guard<std::mutex> lck(m_thread_mtx);
+    m_shutdown = false;
+  }
+
+  m_options = std::move(options);
+  m_thread = std::thread([this]() { drain_loop(); });
+}
+
+void Tracer::stop() {
+  // Don't hold the mutex while notifying
+  {
+    std::lock_guard<std::mutex> lck(m_thread_mtx);
+    m_shutdown = true;
+  }
+  m_thread_cv.notify_one();
+
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+void Tracer::drain_loop() {
+  if (m_options.get_set_sched_params()) {
+    if (pthread_setschedparam(pthread_self(), m_options.get_policy(),
+                              &m_options.get_param()) != 0) {
+      return;
+    }
+  }
+
+  while (true) {
+    (void)drain();
+
+    std::unique_lock<std::mutex> lck(m_thread_mtx);
+    if (m_shutdown) {
+      break;
+    }
+    if (m_options.get_timeout_micro() == std::chrono::microseconds(0)) {
+      m_thread_cv.wait(lck);
+    } else {
+      (void)m_thread_cv.wait_for(lck, m_options.get_timeout_micro());
+    }
+  }
+}
+
+bool Tracer::write_chunk(uint32_t type, const void* data, uint32_t size) {
+  chunk_header h{type, size};
+  return std::fwrite(&h, sizeof(h), 1U, m_file) == 1U &&
+         std::fwrite(data, size, 1U, m_file) == 1U;
+}
+
+bool Tracer::write_clock() {
+  clock_record c{m_clock_timestamp, m_clock_ns, cycle_clock::now(),
+                 cycle_clock::reference_ns()};
+  return write_chunk(kClockChunk, &c, sizeof(c));
+}
+
+void Tracer::write_names() {
+  uint16_t n = g_num_events.load(std::memory_order_acquire);
+  for (; m_names_written < n; m_names_written++) {
+    name_record r;
+    std::memset(&r, 0, sizeof(r));
+    r.m_id = m_names_written;
+    copy_name(r.m_name, g_event_names[m_names_written]);
+    (void)write_chunk(kEventNameChunk, &r, sizeof(r));
+  }
+
+  for (Slot& s : m_slots) {
+    uint8_t state = s.m_state.load(std::memory_order_acquire);
+    if ((state == kActive || state == kClosing) && !s.m_name_written) {
+      name_record r;
+      std::memset(&r, 0, sizeof(r));
+      r.m_id = s.m_thread_id;
+      copy_name(r.m_name, s.m_name);
+      (void)write_chunk(kThreadNameChunk, &r, sizeof(r));
+      s.m_name_written = true;
+    }
+  }
+}
+
+size_t Tracer::drain_slot(Slot& s) {
+  event batch[kDrainBatch];
+  size_t total = 0U;
+
+  while (true) {
+    // Events are written whole, so reading a multiple of the event size
+    // always gives whole events
+    uint32_t bytes = s.m_rb.read(reinterpret_cast<unsigned char*>(batch),
+                                 static_cast<uint32_t>(sizeof(batch)));
+    if (bytes == 0U) {
+      break;
+    }
+
+    if (m_file != nullptr) {
+      (void)write_chunk(kEventsChunk, batch, bytes);
+    }
+    total += bytes / sizeof(event);
+  }
+
+  return total;
+}
+
+void Tracer::release_slot(Slot& s) {
+  m_alloc->deallocate(s.m_buf);
+  s.m_buf = nullptr;
+  s.m_rb = spsc_ringbuffer();
+  s.m_state.store(kFree, std::memory_order_release);
+}
+
+size_t Tracer::drain() {
+  std::lock_guard<std::mutex> lck(m_drain_mtx);
+
+  if (m_file != nullptr) {
+    write_names();
+  }
+
+  size_t total = 0U;
+  for (Slot& s : m_slots) {
+    uint8_t state = s.m_state.load(std::memory_order_acquire);
+    if (state != kActive && state != kClosing) {
+      continue;
+    }
+
+    total += drain_slot(s);
+
+    // The owner is gone so nothing can be written after the drain
+    if (state == kClosing) {
+      release_slot(s);
+    }
+  }
+
+  if (m_file != nullptr) {
+    (void)m_events_written.fetch_add(total, std::memory_order_relaxed);
+    std::fflush(m_file);
+  }
+  return total;
+}
+
+bool Tracer::register_thread(const char* name, size_t* id) {
+  if (id == nullptr) {
+    return false;
+  }
+
+  for (size_t i = 0U; i < kMaxThreads; i++) {
+    Slot& s = m_slots[i];
+    uint8_t expected = kFree;
+    if (!s.m_state.compare_exchange_strong(expected, kClaimed,
+                                           std::memory_order_acquire)) {
+      continue;
+    }
+
+    void* mem = m_alloc->allocate(m_buffer_size);
+    if (mem == nullptr) {
+      s.m_state.store(kFree, std::memory_order_release);
+      return false;
+    }
+
+    s.m_buf = static_cast<unsigned char*>(mem);
+    s.m_rb = spsc_ringbuffer(s.m_buf, m_buffer_size);
+    s.m_thread_id = static_cast<uint32_t>(syscall(SYS_gettid));
+    s.m_name_written = false;
+    copy_name(s.m_name, name != nullptr ? name : "unnamed");
+
+    // Publishes the buffer to the draining thread
+    s.m_state.store(kActive, std::memory_order_release);
+    *id = i;
+    return true;
+  }
+
+  return false;
+}
+
+void Tracer::unregister_thread(size_t id) {
+  assert(id < kMaxThreads);
+  uint8_t expected = kActive;
+  (void)m_slots[id].m_state.compare_exchange_strong(
+      expected, kClosing, std::memory_order_release);
+}
+
+uint64_t Tracer::dropped() const {
+  uint64_t total = m_unregistered_dropped.load(std::memory_order_relaxed);
+  for (Slot const& s : m_slots) {
+    total += s.m_dropped.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+// -------------------------------------------
+// Chrome trace event JSON conversion
+
+namespace {
+
+void write_json_string(FILE* out, const char* s) {
+  std::fputc('"', out);
+  for (; *s != '\0'; s++) {
+    unsigned char c = static_cast<unsigned char>(*s);
+    if (c == '"' || c == '\\') {
+      std::fputc('\\', out);
+      std::fputc(c, out);
+    } else if (c < 0x20U) {
+      std::fprintf(out, "\\u%04x", c);
+    } else {
+      std::fputc(c, out);
+    }
+  }
+  std::fputc('"', out);
+}
+
+bool read_header(FILE* in) {
+  file_header h;
+  return std::fread(&h, sizeof(h), 1U, in) == 1U &&
+         std::memcmp(h.m_magic, kMagic, sizeof(kMagic)) == 0 &&
+         h.m_version == kVersion && h.m_event_size == sizeof(event);
+}
+
+// Reads the next chunk into buf (which is grown as needed)
+bool read_chunk(FILE* in, chunk_header* h, unsigned char** buf,
+                size_t* buf_size) {
+  if (std::fread(h, sizeof(*h), 1U, in) != 1U) {
+    return false;
+  }
+  if (h->m_size > *buf_size) {
+    void* p = std::realloc(*buf, h->m_size);
+    if (p == nullptr) {
+      return false;
+    }
+    *buf = static_cast<unsigned char*>(p);
+    *buf_size = h->m_size;
+  }
+  return h->m_size == 0U || std::fread(*buf, h->m_size, 1U, in) == 1U;
+}
+
+struct converter {
+  FILE* m_in;
+  FILE* m_out;
+  unsigned char* m_buf;
+  size_t m_buf_size;
+  char (*m_names)[kMaxNameLength + 1U];
+  clock_record m_clock;
+  bool m_first;
+
+  double to_us(uint64_t timestamp) const {
+    double ticks = static_cast<double>(m_clock.m_timestamp1 -
+                                       m_clock.m_timestamp0);
+    double ns = static_cast<double>(m_clock.m_ns1 - m_clock.m_ns0);
+    double ns_per_tick = ticks > 0.0 ? ns / ticks : 1.0;
+    // Events may predate the calibration point slightly
+    double delta = timestamp >= m_clock.m_timestamp0
+                       ? static_cast<double>(timestamp - m_clock.m_timestamp0)
+                       : -static_cast<double>(m_clock.m_timestamp0 -
+                                              timestamp);
+    return delta * ns_per_tick / 1000.0;
+  }
+
+  void begin_event() {
+    std::fputs(m_first ? "\n    {" : ",\n    {", m_out);
+    m_first = false;
+  }
+
+  // The clock used for the whole file is the last (most precise) one
+  bool find_clock() {
+    chunk_header h;
+    bool found = false;
+    while (read_chunk(m_in, &h, &m_buf, &m_buf_size)) {
+      if (h.m_type == kClockChunk && h.m_size == sizeof(clock_record)) {
+        std::memcpy(&m_clock, m_buf, sizeof(m_clock));
+        found = true;
+      }
+    }
+    return found;
+  }
+
+  void write_event(event const& e) {
+    const char* name =
+        e.m_event_id < kMaxEvents && m_names[e.m_event_id][0] != '\0'
+            ? m_names[e.m_event_id]
+            : "unknown";
+    const char* ph = "i";
+    switch (static_cast<event_type>(e.m_type)) {
+      case event_type::kBegin:
+        ph = "B";
+        break;
+      case event_type::kEnd:
+        ph = "E";
+        break;
+      case event_type::kInstant:
+        ph = "i";
+        break;
+      case event_type::kCounter:
+        ph = "C";
+        break;
+    }
+
+    begin_event();
+    std::fputs("\"name\": ", m_out);
+    write_json_string(m_out, name);
+    std::fprintf(m_out, ", \"ph\": \"%s\", \"ts\": %.3f", ph,
+                 to_us(e.m_timestamp));
+    std::fprintf(m_out, ", \"pid\": 1, \"tid\": %" PRIu32, e.m_thread_id);
+    if (e.m_type == static_cast<uint8_t>(event_type::kInstant)) {
+      std::fputs(", \"s\": \"t\"", m_out);
+    }
+    if (e.m_type == static_cast<uint8_t>(event_type::kCounter)) {
+      std::fprintf(m_out, ", \"args\": {\"value\": %" PRIu64 "}", e.m_arg);
+    } else if (e.m_type != static_cast<uint8_t>(event_type::kEnd)) {
+      std::fprintf(m_out, ", \"args\": {\"arg\": %" PRIu64 "}", e.m_arg);
+    }
+    std::fputc('}', m_out);
+  }
+
+  bool convert() {
+    chunk_header h;
+    std::fputs("{\n  \"displayTimeUnit\": \"ns\",\n  \"traceEvents\": [",
+               m_out);
+
+    while (read_chunk(m_in, &h, &m_buf, &m_buf_size)) {
+      if (h.m_type == kEventNameChunk && h.m_size == sizeof(name_record)) {
+        name_record r;
+        std::memcpy(&r, m_buf, sizeof(r));
+        r.m_name[kMaxNameLength] = '\0';
+        if (r.m_id < kMaxEvents) {
+          std::memcpy(m_names[r.m_id], r.m_name, sizeof(r.m_name));
+        }
+      } else if (h.m_type == kThreadNameChunk &&
+                 h.m_size == sizeof(name_record)) {
+        name_record r;
+        std::memcpy(&r, m_buf, sizeof(r));
+        r.m_name[kMaxNameLength] = '\0';
+        begin_event();
+        std::fprintf(m_out,
+                     "\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+                     "\"tid\": %" PRIu32 ", \"args\": {\"name\": ",
+                     r.m_id);
+        write_json_string(m_out, r.m_name);
+        std::fputs("}}", m_out);
+      } else if (h.m_type == kEventsChunk) {
+        for (size_t off = 0U; off + sizeof(event) <= h.m_size;
+             off += sizeof(event)) {
+          event e;
+          std::memcpy(&e, m_buf + off, sizeof(e));
+          write_event(e);
+        }
+      }
+    }
+
+    std::fputs("\n  ]\n}\n", m_out);
+    return std::ferror(m_in) == 0 && std::ferror(m_out) == 0;
+  }
+};
+
+}  // namespace
+
+bool trace_to_chrome_json(const char* in_path, const char* out_path) {
+  if (in_path == nullptr || out_path == nullptr) {
+    return false;
+  }
+
+  FILE* in = std::fopen(in_path, "rb");
+  if (in == nullptr) {
+    return false;
+  }
+
+  converter c;
+  std::memset(&c, 0, sizeof(c));
+  c.m_in = in;
+  c.m_first = true;
+
+  bool ok = read_header(in);
+  long events_start = std::ftell(in);
+
+  if (ok) {
+    c.m_names = static_cast<char(*)[kMaxNameLength + 1U]>(
+        std::calloc(kMaxEvents, kMaxNameLength + 1U));
+    ok = c.m_names != nullptr && c.find_clock() &&
+         std::fseek(in, events_start, SEEK_SET) == 0;
+  }
+
+  if (ok) {
+    c.m_out = std::fopen(out_path, "w");
+    ok = c.m_out != nullptr && c.convert();
+    if (c.m_out != nullptr && std::fclose(c.m_out) != 0) {
+      ok = false;
+    }
+  }
+
+  std::free(c.m_names);
+  std::free(c.m_buf);
+  std::fclose(in);
+  return ok;
+}
+
+}  // namespace trace
+}  // namespace rtl